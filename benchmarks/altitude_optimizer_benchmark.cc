@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "path_planner.h"
+#include "profile_filters.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Compares `PathPlanner::OptimizeAltitude` with the filter then clip
+/// chains of `filter_large_path` over a long synthetic elevation profile.
+/// For each, reports the time per value and how the altitude flies: the
+/// steepest step up and down, the steps beyond the climb and descent rates,
+/// the mean height above the lowest allowed altitude and the total climb.
+///
+/// Usage: altitude_optimizer_benchmark [profile_length] [min_alt]
+///                                     [max_climb] [max_descent] [roughness]
+int main(int argc, char** argv) {
+  const size_t length = argc > 1 ? size_t(std::atol(argv[1])) : 200000;
+  const int min_alt = argc > 2 ? std::atoi(argv[2]) : 20;
+  const int max_climb = argc > 3 ? std::atoi(argv[3]) : 4;
+  const int max_descent = argc > 4 ? std::atoi(argv[4]) : 6;
+  const double roughness = argc > 5 ? std::atof(argv[5]) : 2.0;
+
+  std::vector<int> elevation(length);
+  for (size_t i = 0; i < length; i++) {
+    elevation[i] = bm::SyntheticElevation(3, int(i / 1000), int(i % 1000),
+                                          roughness);
+  }
+  std::vector<int> agl = elevation;
+  pp::AddOffset(agl.data(), agl.size(), min_alt);
+
+  pp::PathPlanner planner;
+  struct Method {
+    std::string name;
+    std::function<std::vector<int>()> run;
+  };
+  const std::vector<Method> methods = {
+      {"median 3 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation, planner.MedianFilter(agl, 3),
+                                    min_alt);
+       }},
+      {"median 9 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation, planner.MedianFilter(agl, 9),
+                                    min_alt);
+       }},
+      {"mean 3 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation, planner.MeanFilter(agl, 3),
+                                    min_alt);
+       }},
+      {"mean 9 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation, planner.MeanFilter(agl, 9),
+                                    min_alt);
+       }},
+      {"lowpass 0.05 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation,
+                                    planner.LowpassFilter(agl, 0.05),
+                                    min_alt);
+       }},
+      {"lowpass 0.2 + clip",
+       [&]() {
+         return planner.CorrectPath(elevation,
+                                    planner.LowpassFilter(agl, 0.2),
+                                    min_alt);
+       }},
+      {"optimize altitude",
+       [&]() {
+         return planner.OptimizeAltitude(elevation, min_alt, max_climb,
+                                         max_descent);
+       }},
+  };
+
+  std::cout << length << " values, min_alt " << min_alt << ", climb "
+            << max_climb << " descent " << max_descent << " per value"
+            << std::endl;
+  for (const Method& method : methods) {
+    // The fastest of a few runs
+    double seconds = 1e30;
+    std::vector<int> altitude;
+    for (int run = 0; run < 5; run++) {
+      bm::Stopwatch timer;
+      altitude = method.run();
+      seconds = std::min(seconds, timer.Seconds());
+    }
+    int steepest_climb = 0;
+    int steepest_descent = 0;
+    size_t over_rate = 0;
+    int64_t excess = 0;
+    int64_t total_climb = 0;
+    for (size_t i = 0; i < length; i++) {
+      excess += int64_t(altitude[i]) - agl[i];
+      if (i == 0) {
+        continue;
+      }
+      const int step = altitude[i] - altitude[i - 1];
+      steepest_climb = std::max(steepest_climb, step);
+      steepest_descent = std::max(steepest_descent, -step);
+      over_rate += step > max_climb || -step > max_descent;
+      total_climb += std::max(step, 0);
+    }
+    std::cout << method.name << ": " << seconds * 1e9 / double(length)
+              << " ns/value, steepest +" << steepest_climb << " -"
+              << steepest_descent << ", " << over_rate
+              << " steps over the rates, mean height above clearance "
+              << double(excess) / double(length) << ", total climb "
+              << total_climb << std::endl;
+  }
+  return 0;
+}
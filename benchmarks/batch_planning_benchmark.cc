@@ -0,0 +1,66 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Plans a fixed batch of random queries on one synthetic map with 1..N
+/// worker threads and reports the throughput and speedup of each.
+///
+/// Usage: batch_planning_benchmark [map_size] [queries] [max_threads]
+int main(int argc, char** argv) {
+  int size = argc > 1 ? std::atoi(argv[1]) : 1000;
+  int num_queries = argc > 2 ? std::atoi(argv[2]) : 200;
+  int max_threads = argc > 3
+                        ? std::atoi(argv[3])
+                        : std::max(1, int(std::thread::hardware_concurrency()));
+
+  pp::ElevationMap emap;
+  const std::string text = bm::SyntheticMapText(size, size);
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return -1;
+  }
+
+  // Medium length missions so every query does a similar amount of work
+  std::vector<pp::PlanQuery> queries;
+  uint32_t seed = 11;
+  for (int i = 0; i < num_queries; i++) {
+    pp::PlanQuery query;
+    seed = bm::HashCell(seed, 0, 0);
+    query.start.first = int(seed % uint32_t(size / 2));
+    seed = bm::HashCell(seed, 0, 0);
+    query.start.second = int(seed % uint32_t(size / 2));
+    query.goal = std::make_pair(query.start.first + size / 4,
+                                query.start.second + size / 4);
+    query.agl = 20;
+    queries.push_back(query);
+  }
+
+  pp::PathPlanner planner(emap);
+  std::vector<pp::PlanResult> results;
+  double single_thread_rate = 0.0;
+  for (int threads = 1; threads <= max_threads; threads++) {
+    // Warm up the pool and the per-worker scratch state first
+    planner.PlanPaths(queries, &results, threads);
+    bm::Stopwatch timer;
+    if (!planner.PlanPaths(queries, &results, threads)) {
+      std::cerr << "batch_planning_benchmark: ERROR! Planning failed"
+                << std::endl;
+      return -1;
+    }
+    double rate = num_queries / timer.Seconds();
+    if (threads == 1) {
+      single_thread_rate = rate;
+    }
+    std::cout << threads << " threads: " << rate << " plans/s, speedup "
+              << rate / single_thread_rate << "x" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,424 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace path_planning {
+namespace benchmark {
+
+/// @class Per run state handed to a benchmark function. Follows the shape of
+/// Google Benchmark's `benchmark::State` so the suite can move to it without
+/// rewriting the benchmarks:
+///
+///     void BM_Thing(State& state) {
+///       while (state.KeepRunning()) { ... }
+///       state.SetItemsProcessed(state.iterations() * items_per_op);
+///     }
+class State {
+ public:
+  /// @brief Constructor
+  /// @param max_iterations - The number of times `KeepRunning` returns true
+  /// @param args - The arguments the benchmark was registered with
+  State(int64_t max_iterations, const std::vector<int64_t>& args)
+      : max_iterations_(max_iterations),
+        iterations_(0),
+        args_(args),
+        items_processed_(0),
+        bytes_processed_(0),
+        paused_seconds_(0.0),
+        paused_cpu_seconds_(0.0),
+        real_seconds_(0.0),
+        cpu_seconds_(0.0) {}
+  /// @brief Check if the benchmark loop should run again. Starts the timer on
+  /// the first call and stops it on the last.
+  bool KeepRunning() {
+    if (iterations_ == 0) {
+      start_ = std::chrono::steady_clock::now();
+      cpu_start_ = std::clock();
+    }
+    if (iterations_ < max_iterations_) {
+      iterations_++;
+      return true;
+    }
+    real_seconds_ = std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - start_)
+                        .count() -
+                    paused_seconds_;
+    cpu_seconds_ = double(std::clock() - cpu_start_) / CLOCKS_PER_SEC -
+                   paused_cpu_seconds_;
+    return false;
+  }
+  /// @brief Stop timing, e.g. while resetting inputs between iterations
+  void PauseTiming() {
+    pause_start_ = std::chrono::steady_clock::now();
+    pause_cpu_start_ = std::clock();
+  }
+  /// @brief Resume timing after `PauseTiming`
+  void ResumeTiming() {
+    paused_seconds_ += std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - pause_start_)
+                           .count();
+    paused_cpu_seconds_ +=
+        double(std::clock() - pause_cpu_start_) / CLOCKS_PER_SEC;
+  }
+  /// @brief Get a registered argument
+  int64_t range(size_t index = 0) const {
+    return index < args_.size() ? args_[index] : 0;
+  }
+  /// @brief Get the number of iterations run so far
+  int64_t iterations() const { return iterations_; }
+  /// @brief Set the total items processed over all iterations, reported as
+  /// items per second
+  void SetItemsProcessed(int64_t items) { items_processed_ = items; }
+  /// @brief Set the total bytes processed over all iterations, reported as
+  /// bytes per second
+  void SetBytesProcessed(int64_t bytes) { bytes_processed_ = bytes; }
+  /// @brief Set a free form label printed with the result
+  void SetLabel(const std::string& label) { label_ = label; }
+  /// @brief Mark the run as failed, e.g. if planning did not find a path
+  void SkipWithError(const std::string& error) {
+    error_ = error;
+    max_iterations_ = iterations_;
+  }
+  /// @brief Get the total items processed
+  int64_t items_processed() const { return items_processed_; }
+  /// @brief Get the total bytes processed
+  int64_t bytes_processed() const { return bytes_processed_; }
+  /// @brief Get the label
+  const std::string& label() const { return label_; }
+  /// @brief Get the error, empty if the run succeeded
+  const std::string& error() const { return error_; }
+  /// @brief Get the timed wall clock seconds
+  double real_seconds() const { return real_seconds_; }
+  /// @brief Get the timed process CPU seconds
+  double cpu_seconds() const { return cpu_seconds_; }
+
+ private:
+  /// The number of iterations to run
+  int64_t max_iterations_;
+  /// The number of iterations started
+  int64_t iterations_;
+  /// The registered arguments
+  std::vector<int64_t> args_;
+  /// Reported items and bytes
+  int64_t items_processed_;
+  int64_t bytes_processed_;
+  /// Reported label and error
+  std::string label_;
+  std::string error_;
+  /// Timing
+  std::chrono::steady_clock::time_point start_;
+  std::chrono::steady_clock::time_point pause_start_;
+  std::clock_t cpu_start_;
+  std::clock_t pause_cpu_start_;
+  double paused_seconds_;
+  double paused_cpu_seconds_;
+  double real_seconds_;
+  double cpu_seconds_;
+};
+
+/// @class A registered benchmark function and the arguments to run it with
+class Benchmark {
+ public:
+  /// @brief Constructor
+  Benchmark(const std::string& name, std::function<void(State&)> function)
+      : name_(name), function_(function) {}
+  /// @brief Add a run with a single argument, available as `state.range(0)`
+  Benchmark* Arg(int64_t arg) {
+    args_.push_back({arg});
+    return this;
+  }
+  /// @brief Add a run with several arguments
+  Benchmark* Args(const std::vector<int64_t>& args) {
+    args_.push_back(args);
+    return this;
+  }
+  /// @brief Get the name of the benchmark
+  const std::string& name() const { return name_; }
+  /// @brief Get the function to run
+  const std::function<void(State&)>& function() const { return function_; }
+  /// @brief Get the argument lists, one run per list
+  const std::vector<std::vector<int64_t>>& args() const { return args_; }
+
+ private:
+  /// The benchmark name
+  std::string name_;
+  /// The function to run
+  std::function<void(State&)> function_;
+  /// The argument lists, one run per list
+  std::vector<std::vector<int64_t>> args_;
+};
+
+/// @brief Get every registered benchmark. A deque so the pointers handed out
+/// by `RegisterBenchmark` stay valid as more are registered.
+inline std::deque<Benchmark>& Registry() {
+  static std::deque<Benchmark> registry;
+  return registry;
+}
+
+/// @brief Register a benchmark function
+/// @return The benchmark, to chain `Arg` calls on
+inline Benchmark* RegisterBenchmark(const std::string& name,
+                                    std::function<void(State&)> function) {
+  Registry().emplace_back(name, function);
+  return &Registry().back();
+}
+
+/// @struct The result of running a benchmark with one argument list
+struct BenchmarkResult {
+  /// The name, with the arguments appended as `/arg`
+  std::string name;
+  /// The number of timed iterations
+  int64_t iterations;
+  /// Wall clock and CPU nanoseconds per iteration
+  double real_ns;
+  double cpu_ns;
+  /// Throughput, 0 when not reported
+  double items_per_second;
+  double bytes_per_second;
+  /// The label and error reported by the benchmark
+  std::string label;
+  std::string error;
+};
+
+/// @struct Options for running the registered benchmarks
+struct RunOptions {
+  /// Only run benchmarks whose name matches this regular expression
+  std::string filter = ".";
+  /// Write the results as JSON to this file if not empty
+  std::string out;
+  /// The minimum timed seconds per benchmark run
+  double min_time = 0.5;
+};
+
+/// @brief Parse and remove the `--benchmark_*` flags from the command line,
+/// leaving the rest for the caller
+/// @param argc - The argument count, updated in place
+/// @param argv - The arguments, compacted in place
+/// @return The parsed options
+inline RunOptions Initialize(int* argc, char** argv) {
+  RunOptions options;
+  int kept = 1;
+  for (int i = 1; i < *argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 19, "--benchmark_filter=") == 0) {
+      options.filter = arg.substr(19);
+    } else if (arg.compare(0, 16, "--benchmark_out=") == 0) {
+      options.out = arg.substr(16);
+    } else if (arg.compare(0, 21, "--benchmark_min_time=") == 0) {
+      options.min_time = std::atof(arg.c_str() + 21);
+    } else {
+      argv[kept++] = argv[i];
+    }
+  }
+  *argc = kept;
+  return options;
+}
+
+/// @brief Run one benchmark with one argument list, growing the iteration
+/// count until the timed section takes at least `min_time`
+inline BenchmarkResult RunBenchmark(const Benchmark& benchmark,
+                                    const std::vector<int64_t>& args,
+                                    double min_time) {
+  BenchmarkResult result;
+  result.name = benchmark.name();
+  for (int64_t arg : args) {
+    result.name += "/" + std::to_string(arg);
+  }
+
+  int64_t iterations = 1;
+  while (true) {
+    State state(iterations, args);
+    benchmark.function()(state);
+    double seconds = state.real_seconds();
+    if (!state.error().empty() || seconds >= min_time ||
+        iterations >= 1000000000) {
+      int64_t done = std::max<int64_t>(state.iterations(), 1);
+      result.iterations = state.iterations();
+      result.real_ns = seconds * 1e9 / done;
+      result.cpu_ns = state.cpu_seconds() * 1e9 / done;
+      result.items_per_second =
+          seconds > 0 ? state.items_processed() / seconds : 0.0;
+      result.bytes_per_second =
+          seconds > 0 ? state.bytes_processed() / seconds : 0.0;
+      result.label = state.label();
+      result.error = state.error();
+      return result;
+    }
+    // Aim for the minimum time with some headroom, growing at most 10x per
+    // attempt so a noisy first iteration does not overshoot
+    double scale = seconds > 0 ? 1.4 * min_time / seconds : 10.0;
+    iterations = std::max(iterations + 1,
+                          int64_t(double(iterations) *
+                                  std::min(std::max(scale, 2.0), 10.0)));
+  }
+}
+
+/// @brief Format a rate like Google Benchmark, e.g. `12.3M/s`
+inline std::string HumanRate(double rate, const char* unit) {
+  const char* prefixes[] = {"", "k", "M", "G", "T"};
+  int prefix = 0;
+  while (rate >= 1000.0 && prefix < 4) {
+    rate /= 1000.0;
+    prefix++;
+  }
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(rate < 10 ? 2 : 1) << rate
+      << prefixes[prefix] << unit << "/s";
+  return out.str();
+}
+
+/// @brief Escape a string for a JSON document
+inline std::string JsonEscape(const std::string& text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+/// @brief Write results in the Google Benchmark JSON layout so existing
+/// comparison tooling can read them
+inline bool WriteJson(const std::string& filename,
+                      const std::vector<BenchmarkResult>& results,
+                      const std::vector<std::pair<std::string, std::string>>&
+                          context) {
+  std::ofstream out(filename);
+  if (!out.is_open()) {
+    return false;
+  }
+  std::time_t now = std::time(nullptr);
+  char date[64];
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+  out << "{\n  \"context\": {\n    \"date\": \"" << date << "\",\n"
+      << "    \"num_cpus\": " << std::thread::hardware_concurrency();
+  for (const auto& entry : context) {
+    out << ",\n    \"" << JsonEscape(entry.first) << "\": \""
+        << JsonEscape(entry.second) << "\"";
+  }
+  out << "\n  },\n  \"benchmarks\": [";
+  out << std::setprecision(10);
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchmarkResult& result = results[i];
+    out << (i == 0 ? "\n" : ",\n") << "    {\n"
+        << "      \"name\": \"" << JsonEscape(result.name) << "\",\n"
+        << "      \"run_type\": \"iteration\",\n"
+        << "      \"iterations\": " << result.iterations << ",\n"
+        << "      \"real_time\": " << result.real_ns << ",\n"
+        << "      \"cpu_time\": " << result.cpu_ns << ",\n"
+        << "      \"time_unit\": \"ns\"";
+    if (result.items_per_second > 0) {
+      out << ",\n      \"items_per_second\": " << result.items_per_second;
+    }
+    if (result.bytes_per_second > 0) {
+      out << ",\n      \"bytes_per_second\": " << result.bytes_per_second;
+    }
+    if (!result.label.empty()) {
+      out << ",\n      \"label\": \"" << JsonEscape(result.label) << "\"";
+    }
+    if (!result.error.empty()) {
+      out << ",\n      \"error_occurred\": true,\n      \"error_message\": \""
+          << JsonEscape(result.error) << "\"";
+    }
+    out << "\n    }";
+  }
+  out << "\n  ]\n}\n";
+  return bool(out);
+}
+
+/// @brief Run every registered benchmark matching the filter, print a table
+/// and optionally write JSON
+/// @param options - The options from `Initialize`
+/// @param context - Extra key value pairs for the JSON context, e.g. the map
+/// size the suite generated
+/// @return The number of benchmarks that reported an error
+inline int RunSpecifiedBenchmarks(
+    const RunOptions& options,
+    const std::vector<std::pair<std::string, std::string>>& context = {}) {
+  std::regex filter;
+  try {
+    filter = std::regex(options.filter);
+  } catch (const std::regex_error&) {
+    std::cerr << "RunSpecifiedBenchmarks: ERROR! Invalid filter "
+              << options.filter << std::endl;
+    return 1;
+  }
+
+  std::cout << std::left << std::setw(40) << "Benchmark" << std::right
+            << std::setw(14) << "Time" << std::setw(14) << "CPU"
+            << std::setw(12) << "Iterations" << "  Throughput" << std::endl
+            << std::string(100, '-') << std::endl;
+
+  std::vector<BenchmarkResult> results;
+  int errors = 0;
+  for (const Benchmark& benchmark : Registry()) {
+    std::vector<std::vector<int64_t>> arg_lists = benchmark.args();
+    if (arg_lists.empty()) {
+      arg_lists.push_back({});
+    }
+    for (const auto& args : arg_lists) {
+      std::string name = benchmark.name();
+      for (int64_t arg : args) {
+        name += "/" + std::to_string(arg);
+      }
+      if (!std::regex_search(name, filter)) {
+        continue;
+      }
+      BenchmarkResult result = RunBenchmark(benchmark, args, options.min_time);
+      std::cout << std::left << std::setw(40) << result.name << std::right
+                << std::fixed << std::setprecision(0) << std::setw(11)
+                << result.real_ns << " ns" << std::setw(11) << result.cpu_ns
+                << " ns" << std::setw(12) << result.iterations;
+      if (!result.error.empty()) {
+        std::cout << "  ERROR: " << result.error;
+        errors++;
+      }
+      if (result.bytes_per_second > 0) {
+        std::cout << "  " << HumanRate(result.bytes_per_second, "B");
+      }
+      if (result.items_per_second > 0) {
+        std::cout << "  " << HumanRate(result.items_per_second, " items");
+      }
+      if (!result.label.empty()) {
+        std::cout << "  " << result.label;
+      }
+      std::cout << std::endl;
+      results.push_back(result);
+    }
+  }
+
+  if (!options.out.empty() && !WriteJson(options.out, results, context)) {
+    std::cerr << "RunSpecifiedBenchmarks: ERROR! Unable to write "
+              << options.out << std::endl;
+    errors++;
+  }
+  return errors;
+}
+
+}  // namespace benchmark
+}  // namespace path_planning
+
+/// Register a benchmark function at static initialization, e.g.
+/// `PP_BENCHMARK(BM_ReadMap)->Arg(1000);`
+#define PP_BENCHMARK_CONCAT_(a, b) a##b
+#define PP_BENCHMARK_CONCAT(a, b) PP_BENCHMARK_CONCAT_(a, b)
+#define PP_BENCHMARK(function)                                      \
+  static ::path_planning::benchmark::Benchmark* PP_BENCHMARK_CONCAT( \
+      pp_benchmark_, __LINE__) =                                     \
+      ::path_planning::benchmark::RegisterBenchmark(#function, function)
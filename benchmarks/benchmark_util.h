@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace path_planning {
+namespace benchmark {
+
+/// @class Wall clock stopwatch for timing benchmark sections
+class Stopwatch {
+ public:
+  /// @brief Constructor, starts timing immediately
+  Stopwatch() : start_(std::chrono::steady_clock::now()) {}
+  /// @brief Restart the stopwatch
+  void Reset() { start_ = std::chrono::steady_clock::now(); }
+  /// @brief Get the elapsed time since construction or the last `Reset()`
+  /// @return The elapsed seconds
+  double Seconds() const {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                         start_)
+        .count();
+  }
+
+ private:
+  /// When timing started
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// @brief Small deterministic integer hash used to add noise to synthetic
+/// terrain without depending on the standard library's distributions
+inline uint32_t HashCell(uint32_t seed, uint32_t row, uint32_t col) {
+  uint32_t h = seed ^ (row * 0x9E3779B1u) ^ (col * 0x85EBCA77u);
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+  return h;
+}
+
+/// @brief Get the elevation of a synthetic rolling terrain at a cell
+/// @param seed - The noise seed
+/// @param row - The row of the cell
+/// @param col - The column of the cell
+/// @param roughness - Scale of the short ridges and per cell noise on top of
+/// the long rolling hills. 0 is smooth, 1 is the default terrain.
+inline int SyntheticElevation(uint32_t seed, int row, int col,
+                              double roughness = 1.0) {
+  double rolling = 200.0 * std::sin(row / 53.0) * std::cos(col / 71.0) +
+                   roughness * 80.0 * std::sin((row + col) / 17.0);
+  return 500 + int(rolling) +
+         int(roughness * double(HashCell(seed, row, col) % 10));
+}
+
+/// @brief Build the text of a synthetic map in the bracketed map format with
+/// `(A)` near the top left and `(B)` near the bottom right
+/// @param rows - The number of rows to generate
+/// @param cols - The number of columns to generate
+/// @param seed - The noise seed
+/// @param roughness - The terrain roughness, see `SyntheticElevation`
+/// @return The map text
+inline std::string SyntheticMapText(int rows, int cols, uint32_t seed = 1,
+                                    double roughness = 1.0) {
+  std::string text;
+  text.reserve(size_t(rows) * size_t(cols) * 4 + 16);
+  text += '[';
+  for (int row = 0; row < rows; row++) {
+    text += '[';
+    for (int col = 0; col < cols; col++) {
+      if (row == rows / 8 && col == cols / 8) {
+        text += "(A)";
+      } else if (row == rows - 1 - rows / 8 && col == cols - 1 - cols / 8) {
+        text += "(B)";
+      } else {
+        text += std::to_string(SyntheticElevation(seed, row, col, roughness));
+      }
+      if (col + 1 < cols) {
+        text += ',';
+      }
+    }
+    text += row + 1 < rows ? "],\n" : "]";
+  }
+  text += "]\n";
+  return text;
+}
+
+/// @brief Write a synthetic map in the bracketed map format to a file
+/// @return true if the file was written
+inline bool WriteSyntheticMap(const std::string& filename, int rows, int cols,
+                              uint32_t seed = 1, double roughness = 1.0) {
+  std::ofstream out_file(filename, std::ios::binary);
+  if (!out_file.is_open()) {
+    return false;
+  }
+  out_file << SyntheticMapText(rows, cols, seed, roughness);
+  return bool(out_file);
+}
+
+/// @brief Get a percentile of a set of samples
+/// @param samples - The samples, reordered in place
+/// @param percentile - The percentile on [0, 100]
+/// @return The sample at the given percentile
+inline double Percentile(std::vector<double>* samples, double percentile) {
+  if (samples->empty()) {
+    return 0.0;
+  }
+  size_t index =
+      std::min(samples->size() - 1,
+               size_t(percentile / 100.0 * (samples->size() - 1) + 0.5));
+  std::nth_element(samples->begin(), samples->begin() + index,
+                   samples->end());
+  return (*samples)[index];
+}
+
+}  // namespace benchmark
+}  // namespace path_planning
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Plans long queries across a synthetic square map, from a cell near one
+/// corner to a cell near the opposite one, with A* on one thread and the
+/// bidirectional search on one and two threads. Reports the plan latency
+/// of each and its speedup over A*.
+///
+/// Usage: bidirectional_search_benchmark [size] [queries]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 2000;
+  const int queries = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  pp::ElevationMap emap;
+  const std::string text = bm::SyntheticMapText(size, size);
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return -1;
+  }
+  // Each end within the outer quarter of the map on its side
+  std::vector<std::pair<std::pair<int, int>, std::pair<int, int>>> ends;
+  uint32_t query_seed = 7;
+  auto random_offset = [&query_seed, size]() {
+    query_seed = bm::HashCell(query_seed, 0, 0);
+    return int(query_seed % uint32_t(std::max(1, size / 4)));
+  };
+  for (int q = 0; q < queries; q++) {
+    const int start_row = random_offset();
+    const int start_col = random_offset();
+    const int goal_row = size - 1 - random_offset();
+    const int goal_col = size - 1 - random_offset();
+    ends.push_back({{start_row, start_col}, {goal_row, goal_col}});
+  }
+
+  struct Mode {
+    const char* name;
+    pp::SearchAlgorithm algorithm;
+    int threads;
+  };
+  const Mode modes[] = {
+      {"A*", pp::SearchAlgorithm::kAStar, 1},
+      {"bidirectional", pp::SearchAlgorithm::kBidirectional, 1},
+      {"bidirectional", pp::SearchAlgorithm::kBidirectional, 2},
+  };
+  for (auto connectivity :
+       {pp::Connectivity::kFour, pp::Connectivity::kEight}) {
+    double a_star_p50 = 0.0;
+    for (const Mode& mode : modes) {
+      pp::SearchOptions options;
+      options.algorithm = mode.algorithm;
+      options.connectivity = connectivity;
+      options.bidirectional_threads = mode.threads;
+      pp::GridSearch search(options);
+      std::vector<std::pair<int, int>> path;
+      std::vector<double> latencies;
+      size_t nodes_expanded = 0;
+      // Warm up the buffers and threads
+      search.FindPath(emap, ends[0].first, ends[0].second, 0, &path);
+      for (const auto& query : ends) {
+        bm::Stopwatch timer;
+        if (!search.FindPath(emap, query.first, query.second, 0, &path)) {
+          std::cerr << "bidirectional_search_benchmark: ERROR! No path found"
+                    << std::endl;
+          return -1;
+        }
+        latencies.push_back(timer.Seconds() * 1e3);
+        nodes_expanded += search.stats().nodes_expanded;
+      }
+
+      const double p50 = bm::Percentile(&latencies, 50);
+      if (mode.algorithm == pp::SearchAlgorithm::kAStar) {
+        a_star_p50 = p50;
+      }
+      std::cout << size << " x " << size << ", " << int(connectivity)
+                << "-connected, " << mode.name << " on " << mode.threads
+                << (mode.threads == 1 ? " thread" : " threads")
+                << ": latency ms p50 " << p50 << " p90 "
+                << bm::Percentile(&latencies, 90) << ", "
+                << nodes_expanded / ends.size() << " nodes/query, speedup "
+                << a_star_p50 / p50 << "x" << std::endl;
+    }
+  }
+  return 0;
+}
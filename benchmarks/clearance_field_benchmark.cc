@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "benchmark_util.h"
+#include "clearance_field.h"
+#include "elevation_map.h"
+#include "thread_pool.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Builds the clearance field of a synthetic square map on one thread and on
+/// the whole pool, then compares random clearance queries against scanning
+/// the square around each cell.
+///
+/// Usage: clearance_field_benchmark [map_size] [radius] [queries]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 4000;
+  const int radius = argc > 2 ? std::atoi(argv[2]) : 16;
+  const int queries = argc > 3 ? std::atoi(argv[3]) : 100000;
+  if (size < 16 || radius < 0 || queries < 1) {
+    std::cerr << "clearance_field_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+  const double cells = double(emap.size());
+
+  pp::ClearanceField field;
+  bm::Stopwatch serial_timer;
+  field.Build(emap, radius);
+  const double serial_seconds = serial_timer.Seconds();
+  pp::ThreadPool pool;
+  bm::Stopwatch parallel_timer;
+  field.Build(emap, radius, &pool);
+  const double parallel_seconds = parallel_timer.Seconds();
+  std::cout << size << " x " << size << " map, radius " << radius
+            << std::endl
+            << "Build on 1 thread:  " << serial_seconds * 1e3 << " ms, "
+            << serial_seconds * 1e9 / cells << " ns/cell" << std::endl
+            << "Build on " << pool.size() << " thread(s): "
+            << parallel_seconds * 1e3 << " ms, "
+            << parallel_seconds * 1e9 / cells << " ns/cell" << std::endl;
+
+  // The same random cells both ways, summing the answers so neither loop
+  // can be optimized away
+  int64_t field_sum = 0;
+  bm::Stopwatch field_timer;
+  for (int i = 0; i < queries; i++) {
+    const uint32_t hash = bm::HashCell(7, uint32_t(i), 0);
+    const int row = int(hash % uint32_t(size));
+    const int col = int((hash >> 12) % uint32_t(size));
+    field_sum += field.MaxElevation(row, col);
+  }
+  const double field_seconds = field_timer.Seconds();
+  int64_t scan_sum = 0;
+  bm::Stopwatch scan_timer;
+  for (int i = 0; i < queries; i++) {
+    const uint32_t hash = bm::HashCell(7, uint32_t(i), 0);
+    const int row = int(hash % uint32_t(size));
+    const int col = int((hash >> 12) % uint32_t(size));
+    int highest = INT32_MIN;
+    for (int r = std::max(0, row - radius);
+         r <= std::min(size - 1, row + radius); r++) {
+      for (int c = std::max(0, col - radius);
+           c <= std::min(size - 1, col + radius); c++) {
+        highest = std::max(highest, int(emap.At(r, c)));
+      }
+    }
+    scan_sum += highest;
+  }
+  const double scan_seconds = scan_timer.Seconds();
+  // Markers are the only cells where the two may differ
+  std::cout << "Field query: " << field_seconds * 1e9 / queries << " ns, "
+            << "square scan: " << scan_seconds * 1e9 / queries << " ns ("
+            << scan_seconds / field_seconds << "x), checksums " << field_sum
+            << " / " << scan_sum << std::endl
+            << "A scan of every cell would take "
+            << scan_seconds / queries * cells << " s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Plans between random cell pairs on synthetic square maps and reports the
+/// search rate and plan latency percentiles.
+///
+/// Usage: grid_search_benchmark [queries] [size...]
+int main(int argc, char** argv) {
+  int queries = argc > 1 ? std::atoi(argv[1]) : 10;
+  std::vector<int> sizes;
+  for (int i = 2; i < argc; i++) {
+    sizes.push_back(std::atoi(argv[i]));
+  }
+  if (sizes.empty()) {
+    sizes = {1000, 2000};
+  }
+
+  for (int size : sizes) {
+    pp::ElevationMap emap;
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+
+    for (auto connectivity : {pp::Connectivity::kFour,
+                              pp::Connectivity::kEight,
+                              pp::Connectivity::kSixteen}) {
+      pp::SearchOptions options;
+      options.connectivity = connectivity;
+      pp::GridSearch search(options);
+      std::vector<std::pair<int, int>> path;
+      std::vector<double> latencies;
+      size_t nodes_expanded = 0;
+      double total_seconds = 0.0;
+      uint32_t query_seed = 7;
+
+      for (int q = 0; q < queries; q++) {
+        auto random_cell = [&query_seed, size]() {
+          query_seed = bm::HashCell(query_seed, 0, 0);
+          int row = int(query_seed % uint32_t(size));
+          query_seed = bm::HashCell(query_seed, 0, 0);
+          return std::make_pair(row, int(query_seed % uint32_t(size)));
+        };
+        auto start = random_cell();
+        auto goal = random_cell();
+        bm::Stopwatch timer;
+        if (!search.FindPath(emap, start, goal, 0, &path)) {
+          std::cerr << "grid_search_benchmark: ERROR! No path found"
+                    << std::endl;
+          return -1;
+        }
+        double seconds = timer.Seconds();
+        latencies.push_back(seconds * 1e3);
+        total_seconds += seconds;
+        nodes_expanded += search.stats().nodes_expanded;
+      }
+
+      std::cout << size << " x " << size << ", " << int(connectivity)
+                << "-connected: " << nodes_expanded / total_seconds / 1e6
+                << " M nodes/s, latency ms p50 "
+                << bm::Percentile(&latencies, 50) << " p90 "
+                << bm::Percentile(&latencies, 90) << " p99 "
+                << bm::Percentile(&latencies, 99) << std::endl;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "map_pyramid.h"
+#include "path_planner.h"
+#include "thread_pool.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Plans corner to corner across a synthetic square map at full resolution
+/// and coarse-to-fine, and reports the nodes each expanded, their latency
+/// and path cost, and how long the map pyramid takes to build.
+///
+/// Usage: hierarchical_planning_benchmark [map_size] [level] [margin]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 4096;
+  const int level = argc > 2 ? std::atoi(argv[2]) : 0;
+  const int margin = argc > 3 ? std::atoi(argv[3]) : 2;
+  if (size < 16) {
+    std::cerr << "hierarchical_planning_benchmark: ERROR! Invalid map size"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+
+  // Pyramid construction, one thread against the whole pool
+  pp::MapPyramid pyramid;
+  bm::Stopwatch serial_timer;
+  pyramid.Build(emap);
+  const double serial_seconds = serial_timer.Seconds();
+  pp::ThreadPool pool;
+  bm::Stopwatch parallel_timer;
+  pyramid.Build(emap, 0, &pool);
+  const double parallel_seconds = parallel_timer.Seconds();
+  bm::Stopwatch update_timer;
+  pyramid.Update(emap, size / 2, size / 2, 64, 64, &pool);
+  const double update_seconds = update_timer.Seconds();
+  std::cout << "Pyramid of " << pyramid.num_levels() << " levels built in "
+            << serial_seconds * 1e3 << " ms on 1 thread, "
+            << parallel_seconds * 1e3 << " ms on " << pool.size()
+            << " threads, 64 x 64 update in " << update_seconds * 1e3
+            << " ms" << std::endl;
+
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+
+  pp::PathPlanner full(emap);
+  full.SetSearchOptions(options);
+  bm::Stopwatch full_timer;
+  if (!full.PlanPath(&profile, &agl_profile, 100)) {
+    std::cerr << "hierarchical_planning_benchmark: ERROR! Unable to plan"
+              << std::endl;
+    return -1;
+  }
+  const double full_seconds = full_timer.Seconds();
+  const size_t full_nodes = full.search_stats().nodes_expanded;
+  const double full_cost = full.search_stats().path_cost;
+
+  pp::PathPlanner planner(emap);
+  planner.SetSearchOptions(options);
+  pp::HierarchicalOptions hierarchical;
+  hierarchical.enabled = true;
+  hierarchical.level = level;
+  hierarchical.corridor_margin = margin;
+  planner.SetHierarchicalOptions(hierarchical);
+  // The first plan builds the pyramid, time the second
+  if (!planner.PlanPath(&profile, &agl_profile, 100)) {
+    return -1;
+  }
+  bm::Stopwatch hierarchical_timer;
+  planner.PlanPath(&profile, &agl_profile, 100);
+  const double hierarchical_seconds = hierarchical_timer.Seconds();
+  const size_t coarse_nodes = planner.coarse_search_stats().nodes_expanded;
+  const size_t fine_nodes = planner.search_stats().nodes_expanded;
+  const double cost = planner.search_stats().path_cost;
+
+  std::cout << "Full resolution: " << full_nodes << " nodes expanded in "
+            << full_seconds * 1e3 << " ms, cost " << full_cost << std::endl
+            << "Coarse-to-fine: " << coarse_nodes << " coarse + "
+            << fine_nodes << " fine nodes expanded in "
+            << hierarchical_seconds * 1e3 << " ms, cost " << cost << " ("
+            << 100.0 * (cost / full_cost - 1.0) << "% above optimal)"
+            << std::endl
+            << "Expanded " << double(full_nodes) / (coarse_nodes + fine_nodes)
+            << "x fewer nodes" << std::endl;
+  return 0;
+}
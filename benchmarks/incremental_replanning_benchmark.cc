@@ -0,0 +1,112 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "incremental_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Applies localized edits to a synthetic square map, raising or lowering a
+/// square block on or near the current path, and after each one compares an
+/// incremental replan against a full search of the edited map.
+///
+/// Usage: incremental_replanning_benchmark [map_size] [edits] [edit_size]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const int edits = argc > 2 ? std::atoi(argv[2]) : 20;
+  const int edit_size = argc > 3 ? std::atoi(argv[3]) : 8;
+  if (size < 16 || edits < 1 || edit_size < 1 || edit_size >= size) {
+    std::cerr << "incremental_replanning_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+  const std::pair<int, int> start = emap.GetLocations(pp::kStartPos)[0];
+  const std::pair<int, int> goal = emap.GetLocations(pp::kEndPos)[0];
+
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  options.cost.max_altitude = 1000;
+  pp::IncrementalPlanner planner(options);
+  planner.SetMap(emap);
+  std::vector<std::pair<int, int>> path;
+  bm::Stopwatch plan_timer;
+  if (!planner.Plan(start, goal, 100, &path)) {
+    std::cerr << "incremental_replanning_benchmark: ERROR! Unable to plan"
+              << std::endl;
+    return -1;
+  }
+  std::cout << "Initial plan: " << planner.stats().nodes_expanded
+            << " nodes expanded in " << plan_timer.Seconds() * 1e3 << " ms"
+            << std::endl;
+
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> full_path;
+  std::vector<double> replan_ms;
+  std::vector<double> full_ms;
+  size_t replan_nodes = 0;
+  size_t full_nodes = 0;
+  uint32_t seed = 11;
+  for (int edit = 0; edit < edits; edit++) {
+    // Alternate obstacles on the path with terrain lowered beside it
+    seed = bm::HashCell(seed, uint32_t(edit), 0);
+    const std::pair<int, int> center = path[seed % path.size()];
+    const bool raise = edit % 2 == 0;
+    const int offset = raise ? 0 : edit_size;
+    for (int row = center.first - edit_size / 2;
+         row < center.first - edit_size / 2 + edit_size; row++) {
+      for (int col = center.second + offset - edit_size / 2;
+           col < center.second + offset - edit_size / 2 + edit_size; col++) {
+        if (row >= 0 && row < size && col >= 0 && col < size &&
+            std::make_pair(row, col) != start &&
+            std::make_pair(row, col) != goal) {
+          planner.map()(row, col) = pp::Elevation(raise ? 950 : 200);
+        }
+      }
+    }
+
+    bm::Stopwatch replan_timer;
+    const bool replanned = planner.Replan(&path);
+    replan_ms.push_back(replan_timer.Seconds() * 1e3);
+    replan_nodes += planner.stats().nodes_expanded;
+
+    bm::Stopwatch full_timer;
+    const bool found =
+        search.FindPath(planner.map(), start, goal, 100, &full_path);
+    full_ms.push_back(full_timer.Seconds() * 1e3);
+    full_nodes += search.stats().nodes_expanded;
+    if (!replanned || !found) {
+      std::cerr << "incremental_replanning_benchmark: ERROR! An edit cut the "
+                   "start off from the goal" << std::endl;
+      return -1;
+    }
+  }
+
+  const double replan_p50 = bm::Percentile(&replan_ms, 50);
+  const double full_p50 = bm::Percentile(&full_ms, 50);
+  std::cout << edits << " edits of " << edit_size << " x " << edit_size
+            << " cells on a " << size << " x " << size << " map" << std::endl
+            << "Incremental replan: p50 " << replan_p50 << " ms, p90 "
+            << bm::Percentile(&replan_ms, 90) << " ms, "
+            << replan_nodes / size_t(edits) << " nodes expanded per edit"
+            << std::endl
+            << "Full replan:        p50 " << full_p50 << " ms, p90 "
+            << bm::Percentile(&full_ms, 90) << " ms, "
+            << full_nodes / size_t(edits) << " nodes expanded per edit"
+            << std::endl
+            << "Speedup at p50: " << full_p50 / replan_p50 << "x"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace path_planning {
+namespace benchmark {
+
+/// @brief The original sort-per-sample median filter, kept verbatim as the
+/// reference that the sliding window `SlidingMedian` is measured and tested
+/// against. Requires a `filter_width` of at least 2.
+inline std::vector<int> LegacyMedianFilter(
+    const std::vector<int>& elevation_profile, const int& filter_width) {
+  std::vector<int> filtered_data;
+  for (int i = 0; i < int(elevation_profile.size()); i++) {
+    if (i < filter_width) {
+      filtered_data.emplace_back(elevation_profile[i]);
+      continue;
+    }
+
+    std::vector<int> filter_vals(elevation_profile.begin() + i - filter_width,
+                                 elevation_profile.begin() + i);
+    std::sort(filter_vals.begin(), filter_vals.end());
+    if (filter_width % 2 == 0) {
+      filtered_data.emplace_back(
+          (filter_vals[filter_width / 2 - 1] + filter_vals[filter_width / 2]) /
+          2);
+    } else {
+      filtered_data.emplace_back(
+          filter_vals[int(std::ceil(filter_width / 2.0))]);
+    }
+  }
+  return filtered_data;
+}
+
+}  // namespace benchmark
+}  // namespace path_planning
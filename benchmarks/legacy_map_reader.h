@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "elevation_map.h"
+
+namespace path_planning {
+namespace benchmark {
+
+/// @brief The original getline/stringstream map parser, kept verbatim as the
+/// baseline that `ElevationMap::ReadMap` is measured against.
+/// @param map_filename - The file to read the map from
+/// @param map - Output. The parsed rows of the map
+/// @return true if the map was successfully read
+inline bool LegacyReadMap(const std::string& map_filename,
+                          std::vector<std::vector<int>>* map) {
+  map->clear();
+  std::ifstream in_file(map_filename);
+  if (!in_file.is_open()) {
+    return false;
+  }
+
+  std::string row;
+  std::string token;
+  while (std::getline(in_file, row, ']')) {
+    if (row.size() <= 1) {
+      continue;
+    }
+    map->emplace_back(std::vector<int>());
+    std::istringstream rowss(row);
+    while (std::getline(rowss, token, ',')) {
+      token.erase(std::remove(token.begin(), token.end(), ' '), token.end());
+      token.erase(std::remove(token.begin(), token.end(), ','), token.end());
+      token.erase(std::remove(token.begin(), token.end(), '\r'), token.end());
+      token.erase(std::remove(token.begin(), token.end(), '\n'), token.end());
+      token.erase(std::remove(token.begin(), token.end(), '['), token.end());
+      if (token.size() == 0) {
+        continue;
+      }
+      try {
+        map->back().emplace_back(std::stoi(token));
+      } catch (const std::invalid_argument&) {
+        if (token.size() >= 3 && token[0] == '(') {
+          const int marker = MarkerValue(token[1]);
+          if (marker == 0) {
+            return false;
+          }
+          map->back().emplace_back(marker);
+        } else {
+          return false;
+        }
+      }
+    }
+  }
+
+  // The final newline after the outer bracket shows up as an empty row
+  if (!map->empty() && map->back().empty()) {
+    map->pop_back();
+  }
+  for (const auto& map_row : *map) {
+    if (map_row.size() != map->front().size()) {
+      return false;
+    }
+  }
+  return !map->empty();
+}
+
+}  // namespace benchmark
+}  // namespace path_planning
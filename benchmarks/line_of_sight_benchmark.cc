@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "line_of_sight.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief The usual floating point way to sample a segment, stepping a
+/// quarter cell at a time and rounding to the nearest cell. Slower, and
+/// it can step past the corners of cells the segment clips.
+int64_t SampledMaxElevation(const pp::ElevationMap& emap,
+                            const std::pair<int, int>& from,
+                            const std::pair<int, int>& to) {
+  const double row_diff = to.first - from.first;
+  const double col_diff = to.second - from.second;
+  const int samples =
+      int(4.0 * std::max(std::abs(row_diff), std::abs(col_diff))) + 1;
+  int64_t highest = INT64_MIN;
+  for (int i = 0; i <= samples; i++) {
+    const double t = double(i) / samples;
+    highest = std::max(
+        highest, int64_t(emap(int(std::lround(from.first + t * row_diff)),
+                              int(std::lround(from.second + t * col_diff)))));
+  }
+  return highest;
+}
+
+}  // namespace
+
+/// Times the line of sight kernel on random segments of a synthetic map,
+/// against sampling the segments at quarter cell steps, then smooths long
+/// straight line staircase paths with it.
+///
+/// Usage: line_of_sight_benchmark [map_size] [segments] [max_length]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 4000;
+  const int segments = argc > 2 ? std::atoi(argv[2]) : 100000;
+  const int max_length = argc > 3 ? std::atoi(argv[3]) : 1000;
+  if (size < 16 || segments < 1 || max_length < 1) {
+    std::cerr << "line_of_sight_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+
+  std::vector<std::pair<std::pair<int, int>, std::pair<int, int>>> ends;
+  ends.reserve(size_t(segments));
+  int64_t steps = 0;
+  for (int i = 0; i < segments; i++) {
+    const uint32_t hash = bm::HashCell(11, uint32_t(i), 0);
+    const int row = int(hash % uint32_t(size));
+    const int col = int(bm::HashCell(11, uint32_t(i), 1) % uint32_t(size));
+    const int length = int(bm::HashCell(11, uint32_t(i), 2) %
+                           uint32_t(max_length)) + 1;
+    const double angle = double(hash >> 8) * 1e-6;
+    const int to_row = std::min(size - 1, std::max(0, row + int(length *
+                                                      std::sin(angle))));
+    const int to_col = std::min(size - 1, std::max(0, col + int(length *
+                                                      std::cos(angle))));
+    ends.emplace_back(std::make_pair(row, col),
+                      std::make_pair(to_row, to_col));
+    steps += std::abs(to_row - row) + std::abs(to_col - col) + 1;
+  }
+
+  const pp::ElevationMap& view = emap;
+  int64_t traversal_sum = 0;
+  bm::Stopwatch traversal_timer;
+  for (const auto& segment : ends) {
+    traversal_sum += pp::MaxElevationAlong(view, segment.first,
+                                           segment.second);
+  }
+  const double traversal_seconds = traversal_timer.Seconds();
+  int64_t sampled_sum = 0;
+  bm::Stopwatch sampled_timer;
+  for (const auto& segment : ends) {
+    sampled_sum += SampledMaxElevation(view, segment.first, segment.second);
+  }
+  const double sampled_seconds = sampled_timer.Seconds();
+  std::cout << size << " x " << size << " map, " << segments
+            << " segments up to " << max_length << " cells" << std::endl
+            << "Grid traversal:  " << traversal_seconds * 1e9 / segments
+            << " ns/segment, " << traversal_seconds * 1e9 / double(steps)
+            << " ns/cell" << std::endl
+            << "Sampled segment: " << sampled_seconds * 1e9 / segments
+            << " ns/segment (" << sampled_seconds / traversal_seconds
+            << "x), checksums " << traversal_sum << " / " << sampled_sum
+            << std::endl;
+
+  // Straight line staircases from near the top left to across the map
+  for (int64_t rise : {int64_t(0), int64_t(100), int64_t(1) << 30}) {
+    size_t cells = 0;
+    size_t corners = 0;
+    double seconds = 0.0;
+    std::vector<std::pair<int, int>> path;
+    for (int i = 0; i < 16; i++) {
+      std::pair<int, int> position(i * size / 64, 0);
+      const std::pair<int, int> goal(size - 1 - i * size / 32, size - 1);
+      path.assign(1, position);
+      while (position != goal) {
+        const int row_diff = goal.first - position.first;
+        const int col_diff = goal.second - position.second;
+        if (row_diff != 0 && std::abs(row_diff) >= std::abs(col_diff)) {
+          position.first += row_diff > 0 ? 1 : -1;
+        } else {
+          position.second += col_diff > 0 ? 1 : -1;
+        }
+        path.push_back(position);
+      }
+      cells += path.size();
+      bm::Stopwatch timer;
+      pp::SmoothPath(view, INT64_MAX, rise, &path);
+      seconds += timer.Seconds();
+      corners += path.size();
+    }
+    std::cout << "Smoothing with a rise of " << rise << ": " << cells
+              << " cells to " << corners << " corners in " << seconds * 1e3
+              << " ms" << std::endl;
+  }
+  return 0;
+}
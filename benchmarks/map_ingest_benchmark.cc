@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "map_ingest.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Writes a synthetic text map and reads it with the serial
+/// `ElevationMap::ReadMap` and with `MapIngester` on 1, 2, 4, ... threads up
+/// to `max_threads`, by default the hardware threads, then converts a batch of copies of it to the
+/// binary format end to end, reporting the throughput of each.
+///
+/// Usage: map_ingest_benchmark [map_size] [files] [tile_size] [max_threads]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 4000;
+  const int files = argc > 2 ? std::atoi(argv[2]) : 4;
+  const int tile_size = argc > 3 ? std::atoi(argv[3]) : 0;
+  const int max_threads =
+      argc > 4 ? std::atoi(argv[4])
+               : std::max(1, int(std::thread::hardware_concurrency()));
+  if (size < 16 || files < 1 || tile_size < 0 || max_threads < 1) {
+    std::cerr << "map_ingest_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+  const std::string filename = "map_ingest_benchmark.txt";
+  if (!bm::WriteSyntheticMap(filename, size, size)) {
+    std::cerr << "map_ingest_benchmark: ERROR! Unable to write " << filename
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  bm::Stopwatch serial_timer;
+  if (!emap.ReadMap(filename)) {
+    std::remove(filename.c_str());
+    return -1;
+  }
+  const double serial_seconds = serial_timer.Seconds();
+  std::ifstream in_file(filename, std::ios::binary | std::ios::ate);
+  const double megabytes = double(in_file.tellg()) / 1e6;
+  std::cout << size << " x " << size << " map, " << megabytes << " MB of text"
+            << std::endl
+            << "Serial ReadMap:         " << megabytes / serial_seconds
+            << " MB/s" << std::endl;
+
+  for (int threads = 1;; threads = std::min(threads * 2, max_threads)) {
+    pp::MapIngester ingester(threads);
+    pp::ElevationMap sharded;
+    // Take the best of a few reads so the page cache is warm for all of them
+    double best = 1e30;
+    for (int run = 0; run < 3; run++) {
+      bm::Stopwatch timer;
+      if (!ingester.ReadMap(filename, &sharded)) {
+        std::remove(filename.c_str());
+        return -1;
+      }
+      best = std::min(best, timer.Seconds());
+    }
+    std::cout << "Sharded on " << threads << " thread(s): "
+              << megabytes / best << " MB/s, "
+              << serial_seconds / best << "x serial" << std::endl;
+    if (threads == max_threads) {
+      break;
+    }
+  }
+
+  // Parse each map while the previous one is written out
+  std::vector<pp::IngestJob> jobs(static_cast<size_t>(files));
+  for (int i = 0; i < files; i++) {
+    jobs[size_t(i)].input = filename;
+    jobs[size_t(i)].output =
+        "map_ingest_benchmark_" + std::to_string(i) + ".emap";
+    jobs[size_t(i)].tile_size = tile_size;
+  }
+  pp::MapIngester ingester(max_threads);
+  bm::Stopwatch convert_timer;
+  const bool converted = ingester.ConvertAll(jobs);
+  const double convert_seconds = convert_timer.Seconds();
+  for (const pp::IngestJob& job : jobs) {
+    std::remove(job.output.c_str());
+  }
+  std::remove(filename.c_str());
+  if (!converted) {
+    return -1;
+  }
+  std::cout << "Converted " << files << " maps to the binary format on "
+            << ingester.num_threads() << " thread(s): "
+            << megabytes * files / convert_seconds << " MB/s end to end ("
+            << ingester.stats().parse_seconds << " s parsing, "
+            << ingester.stats().write_seconds << " s writing overlapped)"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "legacy_map_reader.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Compares the throughput of the memory mapped `ElevationMap::ReadMap` with
+/// the original getline/stringstream parser on a generated map.
+///
+/// Usage: map_read_benchmark [rows] [cols] [repetitions]
+int main(int argc, char** argv) {
+  int rows = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int cols = argc > 2 ? std::atoi(argv[2]) : 2000;
+  int repetitions = argc > 3 ? std::atoi(argv[3]) : 3;
+  const std::string filename = "map_read_benchmark_map.txt";
+
+  if (!bm::WriteSyntheticMap(filename, rows, cols)) {
+    std::cerr << "map_read_benchmark: ERROR! Unable to write " << filename
+              << std::endl;
+    return -1;
+  }
+  std::ifstream size_check(filename, std::ios::binary | std::ios::ate);
+  double megabytes = double(size_check.tellg()) / (1024.0 * 1024.0);
+
+  double best_legacy = 1e30;
+  double best_mapped = 1e30;
+  for (int i = 0; i < repetitions; i++) {
+    std::vector<std::vector<int>> legacy_map;
+    bm::Stopwatch legacy_timer;
+    if (!bm::LegacyReadMap(filename, &legacy_map)) {
+      std::cerr << "map_read_benchmark: ERROR! Legacy parser failed"
+                << std::endl;
+      return -1;
+    }
+    best_legacy = std::min(best_legacy, legacy_timer.Seconds());
+
+    pp::ElevationMap emap;
+    bm::Stopwatch mapped_timer;
+    if (!emap.ReadMap(filename)) {
+      return -1;
+    }
+    best_mapped = std::min(best_mapped, mapped_timer.Seconds());
+
+    if (emap.rows() != int(legacy_map.size()) ||
+        emap.cols() != int(legacy_map[0].size())) {
+      std::cerr << "map_read_benchmark: ERROR! Parsers disagree on the map "
+                   "dimensions" << std::endl;
+      return -1;
+    }
+  }
+  std::remove(filename.c_str());
+
+  std::cout << "map: " << rows << " x " << cols << " (" << megabytes
+            << " MB)" << std::endl;
+  std::cout << "legacy getline parser: " << best_legacy << " s, "
+            << megabytes / best_legacy << " MB/s" << std::endl;
+  std::cout << "mapped single pass parser: " << best_mapped << " s, "
+            << megabytes / best_mapped << " MB/s" << std::endl;
+  std::cout << "speedup: " << best_legacy / best_mapped << "x" << std::endl;
+  return 0;
+}
@@ -0,0 +1,53 @@
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "legacy_filters.h"
+#include "profile_filters.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Compares the sliding window median filter against the original sort per
+/// sample filter over a synthetic profile for a range of window widths.
+///
+/// Usage: median_filter_benchmark [profile_length] [width...]
+int main(int argc, char** argv) {
+  size_t length = argc > 1 ? size_t(std::atol(argv[1])) : 200000;
+  std::vector<int> widths;
+  for (int i = 2; i < argc; i++) {
+    widths.push_back(std::atoi(argv[i]));
+  }
+  if (widths.empty()) {
+    widths = {3, 9, 31, 101, 201};
+  }
+
+  std::vector<int> profile(length);
+  for (size_t i = 0; i < length; i++) {
+    profile[i] = bm::SyntheticElevation(3, int(i / 1000), int(i % 1000));
+  }
+
+  pp::SlidingMedian median;
+  std::vector<int> filtered(length);
+  for (int width : widths) {
+    bm::Stopwatch legacy_timer;
+    std::vector<int> legacy = bm::LegacyMedianFilter(profile, width);
+    double legacy_seconds = legacy_timer.Seconds();
+
+    bm::Stopwatch sliding_timer;
+    median.Filter(profile.data(), profile.size(), width, filtered.data());
+    double sliding_seconds = sliding_timer.Seconds();
+
+    if (legacy != filtered) {
+      std::cerr << "median_filter_benchmark: ERROR! Filters disagree for "
+                << "width " << width << std::endl;
+      return -1;
+    }
+    std::cout << "width " << width << ": sort per sample "
+              << legacy_seconds * 1e9 / length << " ns/sample, sliding "
+              << sliding_seconds * 1e9 / length << " ns/sample, speedup "
+              << legacy_seconds / sliding_seconds << "x" << std::endl;
+  }
+  return 0;
+}
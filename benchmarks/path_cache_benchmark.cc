@@ -0,0 +1,76 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_cache.h"
+#include "path_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Plans a set of queries across a synthetic square map through a
+/// `PathCache`, first cold so every plan is searched and cached, then warm
+/// `repeats` times so every plan is served from the cache. Reports the
+/// latency of both in microseconds and the cache's counters.
+///
+/// Usage: path_cache_benchmark [size] [queries] [repeats]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const int num_queries = argc > 2 ? std::atoi(argv[2]) : 50;
+  const int repeats = argc > 3 ? std::atoi(argv[3]) : 20;
+
+  pp::ElevationMap emap;
+  const std::string text = bm::SyntheticMapText(size, size);
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return -1;
+  }
+  std::vector<pp::PlanQuery> queries(static_cast<size_t>(num_queries));
+  uint32_t seed = 11;
+  auto random_cell = [&seed, size]() {
+    seed = bm::HashCell(seed, 0, 0);
+    return int(seed % uint32_t(size));
+  };
+  for (auto& query : queries) {
+    query.start = {random_cell(), random_cell()};
+    query.goal = {random_cell(), random_cell()};
+    query.agl = 20;
+  }
+
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  pp::PlanResult result;
+  auto run = [&](const char* name, int rounds) {
+    std::vector<double> latencies;
+    for (int round = 0; round < rounds; round++) {
+      for (const auto& query : queries) {
+        bm::Stopwatch timer;
+        if (!planner.Plan(query, &result)) {
+          std::cerr << "path_cache_benchmark: ERROR! No path found"
+                    << std::endl;
+          return -1.0;
+        }
+        latencies.push_back(timer.Seconds() * 1e6);
+      }
+    }
+    const double p50 = bm::Percentile(&latencies, 50);
+    std::cout << size << " x " << size << ", " << name << ": latency us p50 "
+              << p50 << " p99 " << bm::Percentile(&latencies, 99)
+              << std::endl;
+    return p50;
+  };
+  const double cold = run("cold", 1);
+  const double warm = run("warm", repeats);
+  if (cold < 0.0 || warm < 0.0) {
+    return -1;
+  }
+  const pp::PathCacheStats stats = cache.stats();
+  std::cout << "speedup " << cold / warm << "x, " << stats.hits << " hits, "
+            << stats.misses << " misses, hit rate " << stats.hit_rate()
+            << ", " << stats.entries << " plans in " << stats.bytes
+            << " bytes" << std::endl;
+  return 0;
+}
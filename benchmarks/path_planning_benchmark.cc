@@ -0,0 +1,223 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark.h"
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Microbenchmark suite for the public map and planning API. Terrain is
+/// synthetic so runs are comparable between machines and releases.
+///
+/// Usage: path_planning_benchmark [--map_size=N] [--roughness=R]
+///          [--benchmark_filter=REGEX] [--benchmark_out=FILE.json]
+///          [--benchmark_min_time=SECONDS]
+
+namespace {
+
+/// @struct Inputs shared by every benchmark, built once in `main`
+struct Fixture {
+  /// The side length of the square synthetic map
+  int map_size = 1000;
+  /// The roughness of the synthetic terrain, see `SyntheticElevation`
+  double roughness = 1.0;
+  /// The map text and the file it was written to
+  std::string map_text;
+  std::string map_filename = "path_planning_benchmark_map.txt";
+  /// The parsed map
+  pp::ElevationMap emap;
+  /// An A* elevation profile between the map's A and B, the input of the
+  /// filter benchmarks
+  std::vector<int> profile;
+};
+
+Fixture& fixture() {
+  static Fixture instance;
+  return instance;
+}
+
+/// @brief Number of cells in the fixture map
+int64_t MapCells() {
+  return int64_t(fixture().map_size) * fixture().map_size;
+}
+
+void BM_ReadMap(bm::State& state) {
+  pp::ElevationMap emap;
+  while (state.KeepRunning()) {
+    if (!emap.ReadMap(fixture().map_filename)) {
+      state.SkipWithError("Unable to read the map");
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * MapCells());
+  state.SetBytesProcessed(state.iterations() *
+                          int64_t(fixture().map_text.size()));
+}
+
+void BM_ParseMap(bm::State& state) {
+  pp::ElevationMap emap;
+  const std::string& text = fixture().map_text;
+  while (state.KeepRunning()) {
+    if (!emap.ParseMap(text.data(), text.size())) {
+      state.SkipWithError("Unable to parse the map");
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * MapCells());
+  state.SetBytesProcessed(state.iterations() * int64_t(text.size()));
+}
+
+void BM_GetLocations(bm::State& state) {
+  size_t found = 0;
+  while (state.KeepRunning()) {
+    found += fixture().emap.GetLocations('A').size();
+  }
+  if (found != size_t(state.iterations())) {
+    state.SkipWithError("Unable to find A");
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+/// @brief Plan between A and B with the algorithm in `state.range(0)`
+void BM_PlanPath(bm::State& state) {
+  pp::PathPlanner planner(fixture().emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm(state.range(0));
+  planner.SetSearchOptions(options);
+
+  // Items are expanded nodes for the searches and profile cells for the
+  // straight line, which does not search
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  int64_t items = 0;
+  while (state.KeepRunning()) {
+    if (!planner.PlanPath(&profile, &agl_profile, 100)) {
+      state.SkipWithError("Unable to plan a path");
+    }
+    items += options.algorithm == pp::SearchAlgorithm::kStraightLine
+                 ? int64_t(profile.size())
+                 : int64_t(planner.search_stats().nodes_expanded);
+  }
+  state.SetItemsProcessed(items);
+  const char* names[] = {"straight line", "dijkstra", "a*"};
+  state.SetLabel(names[state.range(0)]);
+}
+
+void BM_MedianFilter(bm::State& state) {
+  pp::PathPlanner planner;
+  const std::vector<int>& profile = fixture().profile;
+  while (state.KeepRunning()) {
+    std::vector<int> filtered =
+        planner.MedianFilter(profile, int(state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(profile.size()));
+}
+
+void BM_MeanFilter(bm::State& state) {
+  pp::PathPlanner planner;
+  const std::vector<int>& profile = fixture().profile;
+  while (state.KeepRunning()) {
+    std::vector<int> filtered =
+        planner.MeanFilter(profile, int(state.range(0)));
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(profile.size()));
+}
+
+void BM_LowpassFilter(bm::State& state) {
+  pp::PathPlanner planner;
+  const std::vector<int>& profile = fixture().profile;
+  while (state.KeepRunning()) {
+    std::vector<int> filtered = planner.LowpassFilter(profile, 0.2);
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(profile.size()));
+}
+
+void BM_CorrectPath(bm::State& state) {
+  pp::PathPlanner planner;
+  const std::vector<int>& profile = fixture().profile;
+  std::vector<int> filtered = planner.LowpassFilter(profile, 0.2);
+  while (state.KeepRunning()) {
+    std::vector<int> corrected = planner.CorrectPath(profile, filtered, 50);
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(profile.size()));
+}
+
+/// @brief The full agl, median, mean, lowpass and clip chain over reused
+/// buffers, the allocation free counterpart of the per filter benchmarks
+void BM_ProfilePipeline(bm::State& state) {
+  pp::ProfilePipeline pipeline;
+  pipeline.AddAgl(100).Median(9).Mean(5).Lowpass(0.2).Clip(50);
+  const std::vector<int>& profile = fixture().profile;
+  std::vector<int> filtered;
+  while (state.KeepRunning()) {
+    pipeline.Run(profile, &filtered);
+  }
+  state.SetItemsProcessed(state.iterations() * int64_t(profile.size()));
+}
+
+PP_BENCHMARK(BM_ReadMap);
+PP_BENCHMARK(BM_ParseMap);
+PP_BENCHMARK(BM_GetLocations);
+PP_BENCHMARK(BM_PlanPath)
+    ->Arg(int(pp::SearchAlgorithm::kStraightLine))
+    ->Arg(int(pp::SearchAlgorithm::kDijkstra))
+    ->Arg(int(pp::SearchAlgorithm::kAStar));
+PP_BENCHMARK(BM_MedianFilter)->Arg(5)->Arg(31)->Arg(101);
+PP_BENCHMARK(BM_MeanFilter)->Arg(5)->Arg(31)->Arg(101);
+PP_BENCHMARK(BM_LowpassFilter);
+PP_BENCHMARK(BM_CorrectPath);
+PP_BENCHMARK(BM_ProfilePipeline);
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bm::RunOptions options = bm::Initialize(&argc, argv);
+  Fixture& f = fixture();
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 11, "--map_size=") == 0) {
+      f.map_size = std::atoi(arg.c_str() + 11);
+    } else if (arg.compare(0, 12, "--roughness=") == 0) {
+      f.roughness = std::atof(arg.c_str() + 12);
+    } else {
+      std::cerr << "path_planning_benchmark: ERROR! Unknown argument " << arg
+                << std::endl;
+      return -1;
+    }
+  }
+  if (f.map_size < 8) {
+    std::cerr << "path_planning_benchmark: ERROR! The map size must be at "
+                 "least 8" << std::endl;
+    return -1;
+  }
+
+  f.map_text = bm::SyntheticMapText(f.map_size, f.map_size, 1, f.roughness);
+  if (!bm::WriteSyntheticMap(f.map_filename, f.map_size, f.map_size, 1,
+                             f.roughness) ||
+      !f.emap.ParseMap(f.map_text.data(), f.map_text.size())) {
+    std::cerr << "path_planning_benchmark: ERROR! Unable to create the "
+                 "synthetic map" << std::endl;
+    return -1;
+  }
+  pp::PathPlanner planner(f.emap);
+  std::vector<int> agl_profile;
+  if (!planner.PlanPath(&f.profile, &agl_profile)) {
+    std::cerr << "path_planning_benchmark: ERROR! Unable to plan the filter "
+                 "input profile" << std::endl;
+    return -1;
+  }
+
+  std::cout << "Synthetic map " << f.map_size << "x" << f.map_size
+            << ", roughness " << f.roughness << ", filter profile of "
+            << f.profile.size() << " values" << std::endl;
+  int errors = bm::RunSpecifiedBenchmarks(
+      options, {{"map_size", std::to_string(f.map_size)},
+                {"roughness", std::to_string(f.roughness)},
+                {"profile_length", std::to_string(f.profile.size())}});
+  std::remove(f.map_filename.c_str());
+  return errors == 0 ? 0 : -1;
+}
@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Calls to the global operator new from any thread
+static std::atomic<size_t> g_allocations(0);
+
+void* operator new(size_t size) {
+  g_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/// @brief Run every query on `threads` threads, planning each with `plan`,
+/// and report the allocations per plan and the latency percentiles
+/// @param plan - Plans a query on a thread, returning false on failure
+template <typename Plan>
+bool RunQueries(const std::string& name,
+                const std::vector<pp::PlanQuery>& queries, int threads,
+                const Plan& plan) {
+  std::vector<double> latencies(queries.size());
+  std::atomic<bool> planned(true);
+  const size_t before = g_allocations;
+  bm::Stopwatch total;
+  std::vector<std::thread> workers;
+  workers.reserve(size_t(threads));
+  for (int thread = 0; thread < threads; thread++) {
+    workers.emplace_back([&, thread]() {
+      for (size_t i = size_t(thread); i < queries.size(); i += threads) {
+        bm::Stopwatch timer;
+        if (!plan(queries[i], thread)) {
+          planned = false;
+        }
+        latencies[i] = timer.Seconds() * 1e3;
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  const double seconds = total.Seconds();
+  // Each thread allocates a little to start, which is not the plans'
+  const double allocations =
+      double(g_allocations - before - size_t(threads)) / queries.size();
+  std::cout << name << ": " << allocations << " allocations/plan, p50 "
+            << bm::Percentile(&latencies, 50) << " ms, p99 "
+            << bm::Percentile(&latencies, 99) << " ms, "
+            << queries.size() / seconds << " plans/s" << std::endl;
+  return planned;
+}
+
+}  // namespace
+
+/// Plans random queries from several threads at once, first the way a
+/// caller without shared state would, with a new planner and results for
+/// every query, then through one prepared planner whose pool of contexts
+/// and each thread's results are reused. Reports the allocations per plan
+/// and the p50 and p99 latency of each.
+///
+/// Usage: planner_pool_benchmark [map_size] [queries] [threads]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const int num_queries = argc > 2 ? std::atoi(argv[2]) : 2000;
+  const int threads =
+      argc > 3 ? std::atoi(argv[3])
+               : std::max(2, int(std::thread::hardware_concurrency()));
+  if (size < 64 || num_queries < 1 || threads < 1) {
+    std::cerr << "planner_pool_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+  // Queries of up to a few hundred cells searched in a window around them,
+  // the shape of a steady stream of short plans
+  std::vector<pp::PlanQuery> queries(static_cast<size_t>(num_queries));
+  for (int i = 0; i < num_queries; i++) {
+    pp::PlanQuery& query = queries[size_t(i)];
+    const uint32_t hash = bm::HashCell(5, uint32_t(i), 0);
+    query.start.first = int(hash % uint32_t(size));
+    query.start.second =
+        int(bm::HashCell(5, uint32_t(i), 1) % uint32_t(size));
+    const int reach = 50 + int(hash >> 24);
+    query.goal.first =
+        std::min(size - 1, std::max(0, query.start.first + reach - 150));
+    query.goal.second = std::min(size - 1, query.start.second + reach);
+    query.agl = 20;
+  }
+  pp::SearchOptions options;
+  options.window_margin = 32;
+  std::cout << size << " x " << size << " map, " << num_queries
+            << " queries on " << threads << " thread(s)" << std::endl;
+
+  if (!RunQueries("New planner per query", queries, threads,
+                  [&](const pp::PlanQuery& query, int) {
+                    pp::PathPlanner planner(emap);
+                    planner.SetSearchOptions(options);
+                    pp::PlanResult result;
+                    return planner.Plan(query, &result);
+                  })) {
+    return -1;
+  }
+
+  pp::PathPlanner planner(emap);
+  planner.SetSearchOptions(options);
+  planner.Prepare(threads);
+  std::vector<pp::PlanResult> results(static_cast<size_t>(threads));
+  auto pooled = [&](const pp::PlanQuery& query, int thread) {
+    return planner.Plan(query, &results[size_t(thread)]);
+  };
+  // The first run warms the contexts, the thread arenas and the results
+  if (!RunQueries("Pooled contexts, cold  ", queries, threads, pooled) ||
+      !RunQueries("Pooled contexts, warm  ", queries, threads, pooled)) {
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+#include "planning_service.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Load generator for `PlanningService`. Replays random queries across a
+/// map, a synthetic square one of the given size or a text map file, as
+/// fast as the service takes them. Reports the throughput, the end to end
+/// latency percentiles of the planned requests, how every request ended and
+/// the deepest the queue got.
+///
+/// Usage: planning_service_benchmark [size|map_file] [requests] [threads]
+///                                   [queue_capacity] [deadline_ms] [block]
+int main(int argc, char** argv) {
+  const std::string map_arg = argc > 1 ? argv[1] : "1000";
+  const int num_requests = argc > 2 ? std::atoi(argv[2]) : 500;
+  const int threads = argc > 3 ? std::atoi(argv[3]) : 0;
+  const int queue_capacity = argc > 4 ? std::atoi(argv[4]) : 64;
+  const int deadline_ms = argc > 5 ? std::atoi(argv[5]) : 0;
+  const bool block = argc > 6 ? std::atoi(argv[6]) != 0 : true;
+
+  pp::ElevationMap emap;
+  const int size = std::atoi(map_arg.c_str());
+  if (size > 0) {
+    const std::string text = bm::SyntheticMapText(size, size);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  } else if (!emap.ReadMap(map_arg)) {
+    return -1;
+  }
+  std::vector<pp::PlanQuery> queries(static_cast<size_t>(num_requests));
+  uint32_t seed = 3;
+  auto random_below = [&seed](int limit) {
+    seed = bm::HashCell(seed, 0, 0);
+    return int(seed % uint32_t(limit));
+  };
+  for (auto& query : queries) {
+    query.start = {random_below(emap.rows()), random_below(emap.cols())};
+    query.goal = {random_below(emap.rows()), random_below(emap.cols())};
+  }
+
+  pp::PathPlanner planner(emap);
+  pp::PlanningServiceOptions options;
+  options.num_threads = threads;
+  options.queue_capacity = size_t(queue_capacity);
+  options.block_when_full = block;
+  pp::PlanningService service(&planner, options);
+  planner.Prepare(service.num_threads());
+
+  using Clock = pp::PlanningService::Clock;
+  std::vector<double> latencies(queries.size(), -1.0);
+  std::vector<pp::PlanStatus> statuses(queries.size());
+  std::atomic<size_t> answered(0);
+  bm::Stopwatch total;
+  for (size_t i = 0; i < queries.size(); i++) {
+    const Clock::time_point submitted = Clock::now();
+    const Clock::time_point deadline =
+        deadline_ms > 0 ? submitted + std::chrono::milliseconds(deadline_ms)
+                        : Clock::time_point::max();
+    service.Submit(queries[i], deadline,
+                   [&, i, submitted](pp::PlanResponse&& response) {
+                     statuses[i] = response.status;
+                     latencies[i] = std::chrono::duration<double, std::milli>(
+                                        Clock::now() - submitted)
+                                        .count();
+                     answered++;
+                   });
+  }
+  while (answered < queries.size()) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  const double seconds = total.Seconds();
+  const pp::PlanningServiceStats stats = service.stats();
+  const int num_threads = service.num_threads();
+  service.Shutdown();
+
+  std::vector<double> planned;
+  for (size_t i = 0; i < queries.size(); i++) {
+    if (statuses[i] == pp::PlanStatus::kOk) {
+      planned.push_back(latencies[i]);
+    }
+  }
+  std::cout << emap.rows() << " x " << emap.cols() << ", "
+            << num_threads << " threads, queue " << queue_capacity
+            << (block ? " blocking" : " rejecting") << ": "
+            << double(stats.planned) / seconds << " plans/s";
+  if (!planned.empty()) {
+    std::cout << ", latency ms p50 " << bm::Percentile(&planned, 50)
+              << " p90 " << bm::Percentile(&planned, 90) << " p99 "
+              << bm::Percentile(&planned, 99);
+  }
+  std::cout << std::endl
+            << "planned " << stats.planned << ", no path " << stats.failed
+            << ", expired " << stats.expired << ", cancelled "
+            << stats.cancelled << ", rejected " << stats.rejected
+            << ", max queue depth " << stats.max_queue_depth << std::endl;
+  return 0;
+}
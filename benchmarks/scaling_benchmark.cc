@@ -0,0 +1,208 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+#include "terrain_generator.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+namespace {
+
+/// The tile size of the `tiled` format
+const int kTileSize = 256;
+/// The corridor around the straight line the `tiled` format searches in
+const int kWindowMargin = 64;
+
+/// @brief Get the peak resident memory of this process so far in MB, or 0
+/// where it is not available
+double PeakRssMb() {
+#ifdef _WIN32
+  return 0.0;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0.0;
+  }
+#ifdef __APPLE__
+  return double(usage.ru_maxrss) / 1e6;
+#else
+  return double(usage.ru_maxrss) * 1024.0 / 1e6;
+#endif
+#endif
+}
+
+/// @brief Generate, load, plan across and filter a map of one size tier,
+/// printing a row of the results table
+/// @param rows - The number of rows of the map
+/// @param cols - The number of columns of the map
+/// @param format - `text`, `emap` or `tiled`
+/// @param filename - The file to write the map to
+/// @return true if every step succeeded
+bool RunTier(int rows, int cols, const std::string& format,
+             const std::string& filename) {
+  pp::TerrainOptions terrain;
+  terrain.locations = pp::DefaultTerrainLocations(rows, cols);
+  const pp::TerrainGenerator generator(terrain);
+  bm::Stopwatch timer;
+  const bool written =
+      format == "text"
+          ? generator.WriteTextMap(filename, rows, cols)
+          : generator.WriteBinaryMap(filename, rows, cols,
+                                     format == "tiled" ? kTileSize : 0);
+  if (!written) {
+    return false;
+  }
+  const double generate_seconds = timer.Seconds();
+
+  timer.Reset();
+  pp::ElevationMap emap;
+  if (format == "text" ? !emap.ReadMap(filename)
+                       : !emap.OpenBinaryMap(filename)) {
+    return false;
+  }
+  const double load_seconds = timer.Seconds();
+  const double load_rss = PeakRssMb();
+
+  timer.Reset();
+  pp::PathPlanner planner(emap);
+  if (format == "tiled") {
+    pp::SearchOptions options;
+    options.window_margin = kWindowMargin;
+    planner.SetSearchOptions(options);
+  }
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  if (!planner.PlanPath(&profile, &agl_profile, 20)) {
+    return false;
+  }
+  const double plan_seconds = timer.Seconds();
+  const double plan_rss = PeakRssMb();
+
+  // The filter chains of `filter_large_path`, and the altitude optimizer
+  timer.Reset();
+  size_t filtered = 0;
+  filtered +=
+      planner.CorrectPath(profile, planner.MedianFilter(agl_profile, 9), 20)
+          .size();
+  filtered +=
+      planner.CorrectPath(profile, planner.MeanFilter(agl_profile, 9), 20)
+          .size();
+  filtered += planner
+                  .CorrectPath(profile,
+                               planner.LowpassFilter(agl_profile, 0.05), 20)
+                  .size();
+  filtered += planner.OptimizeAltitude(profile, 20, 4, 6).size();
+  const double filter_seconds = timer.Seconds();
+  if (filtered != 4 * profile.size()) {
+    return false;
+  }
+
+  std::cout << std::setw(12) << uint64_t(rows) * uint64_t(cols)
+            << std::setw(14) << (std::to_string(rows) + "x" +
+                                 std::to_string(cols))
+            << std::setw(11) << generate_seconds << std::setw(11)
+            << load_seconds << std::setw(11) << plan_seconds << std::setw(11)
+            << filter_seconds << std::setw(9) << profile.size()
+            << std::setprecision(1) << std::setw(11) << load_rss
+            << std::setw(11) << plan_rss << std::setprecision(4)
+            << std::endl;
+  return true;
+}
+
+}  // namespace
+
+/// Finds where the library stops scaling. Generates maps of 1e3, 1e4, ...
+/// cells with `TerrainGenerator`, and for each size loads the map, plans
+/// from `(A)` to `(B)` and runs the profile filters, reporting the time of
+/// each step and the peak resident memory after loading and after
+/// planning. Each size runs in a process of its own, so the memory of one
+/// does not count towards the next, and a size that runs out of memory is
+/// reported before the harness stops.
+///
+/// The format is `text` (bracketed text read with `ReadMap`), `emap`
+/// (row-major binary, memory mapped) or `tiled` (tiles read on demand,
+/// searched within a corridor). The maps are written to the directory and
+/// deleted afterwards, so it needs room for the largest.
+///
+/// Usage: scaling_benchmark [max_cells] [text|emap|tiled] [directory]
+///                          [min_cells]
+int main(int argc, char** argv) {
+  const double max_cells = argc > 1 ? std::atof(argv[1]) : 1e7;
+  const std::string format = argc > 2 ? argv[2] : "emap";
+  const std::string directory = argc > 3 ? argv[3] : ".";
+  const double min_cells = argc > 4 ? std::atof(argv[4]) : 1e3;
+  if (format != "text" && format != "emap" && format != "tiled") {
+    std::cerr << "scaling_benchmark: ERROR! Unknown format " << format
+              << std::endl;
+    return -1;
+  }
+  const std::string filename = directory + "/scaling_benchmark_map" +
+                               (format == "text" ? ".txt" : ".emap");
+
+  std::cout << std::fixed << std::setprecision(4) << format
+            << " maps, times in seconds, peak RSS in MB"
+            << std::endl
+            << std::setw(12) << "cells" << std::setw(14) << "size"
+            << std::setw(11) << "generate" << std::setw(11) << "load"
+            << std::setw(11) << "plan" << std::setw(11) << "filter"
+            << std::setw(9) << "path" << std::setw(11) << "load RSS"
+            << std::setw(11) << "plan RSS" << std::endl;
+  for (double cells = min_cells; cells <= max_cells * 1.0001; cells *= 10) {
+    const int rows = int(std::lround(std::sqrt(cells)));
+    const int cols = int(std::lround(cells / rows));
+    const uint64_t tier_cells = uint64_t(rows) * uint64_t(cols);
+#ifdef _WIN32
+    // Without fork the tiers share a process, and no peak memory is read
+    const bool passed = RunTier(rows, cols, format, filename);
+    std::remove(filename.c_str());
+    if (!passed) {
+      std::cout << "Stopped at " << tier_cells << " cells" << std::endl;
+      return -1;
+    }
+#else
+    std::cout.flush();
+    const pid_t child = fork();
+    if (child < 0) {
+      std::cerr << "scaling_benchmark: ERROR! Unable to fork" << std::endl;
+      return -1;
+    }
+    if (child == 0) {
+      const bool passed = RunTier(rows, cols, format, filename);
+      std::cout.flush();
+      _exit(passed ? 0 : 1);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    std::remove(filename.c_str());
+    if (WIFSIGNALED(status)) {
+      std::cout << "Stopped at " << tier_cells << " cells: killed by signal "
+                << WTERMSIG(status)
+                << (WTERMSIG(status) == SIGKILL ? ", likely out of memory"
+                                                : "")
+                << std::endl;
+      return -1;
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      std::cout << "Stopped at " << tier_cells << " cells: a step failed"
+                << std::endl;
+      return -1;
+    }
+#endif
+  }
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+
+namespace bm = path_planning::benchmark;
+namespace pp = path_planning;
+
+/// Bytes currently allocated through the global operator new, and the most
+/// since the last reset, to compare what each mode holds at its peak
+static size_t g_live_bytes = 0;
+static size_t g_peak_bytes = 0;
+
+/// Each allocation is prefixed with its size, keeping the 16 byte alignment
+static const size_t kHeader = 16;
+
+void* operator new(size_t size) {
+  char* p = static_cast<char*>(std::malloc(size + kHeader));
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  *reinterpret_cast<size_t*>(p) = size;
+  g_live_bytes += size;
+  g_peak_bytes = std::max(g_peak_bytes, g_live_bytes);
+  return p + kHeader;
+}
+
+void operator delete(void* p) noexcept {
+  if (p == nullptr) {
+    return;
+  }
+  char* block = static_cast<char*>(p) - kHeader;
+  g_live_bytes -= *reinterpret_cast<size_t*>(block);
+  std::free(block);
+}
+
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
+/// Plans a long straight line path across a wide synthetic map and filters
+/// it, once into full profile vectors and once streamed in chunks, and
+/// reports the time until the first altitudes are available and the peak
+/// heap each mode adds on top of the map.
+///
+/// Usage: streaming_path_benchmark [map_cols] [chunk_size]
+int main(int argc, char** argv) {
+  const int cols = argc > 1 ? std::atoi(argv[1]) : 2000000;
+  const int chunk_size = argc > 2 ? std::atoi(argv[2]) : 4096;
+  const int rows = 8;
+  if (cols < 16 || chunk_size < 1) {
+    std::cerr << "streaming_path_benchmark: ERROR! Invalid arguments"
+              << std::endl;
+    return -1;
+  }
+
+  pp::ElevationMap emap;
+  {
+    const std::string text = bm::SyntheticMapText(rows, cols);
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return -1;
+    }
+  }
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kStraightLine;
+  planner.SetSearchOptions(options);
+  pp::ProfilePipeline pipeline;
+  pipeline.AddAgl(100).Median(15).Mean(9).Lowpass(0.3).Clip(50);
+
+  // Batch: nothing is available until the whole profile is filtered
+  size_t baseline = g_live_bytes;
+  g_peak_bytes = baseline;
+  size_t batch_cells = 0;
+  int64_t batch_sum = 0;
+  bm::Stopwatch batch_timer;
+  {
+    std::vector<int> profile;
+    std::vector<int> filtered;
+    std::vector<std::pair<int, int>> path;
+    if (!planner.PlanFilteredPath(&pipeline, &profile, &filtered, &path)) {
+      std::cerr << "streaming_path_benchmark: ERROR! Unable to plan"
+                << std::endl;
+      return -1;
+    }
+    batch_cells = path.size();
+    for (int altitude : filtered) {
+      batch_sum += altitude;
+    }
+  }
+  const double batch_seconds = batch_timer.Seconds();
+  const size_t batch_peak = g_peak_bytes - baseline;
+
+  // Streamed: the consumer sees the first chunk right away
+  baseline = g_live_bytes;
+  g_peak_bytes = baseline;
+  size_t stream_cells = 0;
+  int64_t stream_sum = 0;
+  double first_chunk_seconds = -1.0;
+  bm::Stopwatch stream_timer;
+  auto consume = [&](const pp::ProfileSample* samples, size_t count) {
+    if (first_chunk_seconds < 0.0) {
+      first_chunk_seconds = stream_timer.Seconds();
+    }
+    for (size_t i = 0; i < count; i++) {
+      stream_sum += samples[i].altitude;
+    }
+    stream_cells += count;
+    return true;
+  };
+  if (!planner.StreamPath(&pipeline, consume, size_t(chunk_size))) {
+    return -1;
+  }
+  const double stream_seconds = stream_timer.Seconds();
+  const size_t stream_peak = g_peak_bytes - baseline;
+
+  if (stream_cells != batch_cells || stream_sum != batch_sum) {
+    std::cerr << "streaming_path_benchmark: ERROR! The streamed profile does "
+                 "not match the batch profile" << std::endl;
+    return -1;
+  }
+  std::cout << batch_cells << " cell path, chunks of " << chunk_size
+            << std::endl
+            << "Batch:    " << batch_seconds * 1e3 << " ms to the first and "
+            << "last altitude, peak " << batch_peak / 1024 << " KiB"
+            << std::endl
+            << "Streamed: " << first_chunk_seconds * 1e3
+            << " ms to the first chunk, " << stream_seconds * 1e3
+            << " ms to the last, peak " << stream_peak / 1024 << " KiB"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,147 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "benchmark_util.h"
+#include "binary_map_format.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+#include "tile_cache.h"
+
+namespace bm = path_planning::benchmark;
+namespace bmf = path_planning::binary_map;
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Write a synthetic tiled map one tile at a time, so maps far larger
+/// than memory can be generated. A and B sit on a diagonal corridor.
+bool WriteSyntheticTiledMap(const std::string& filename, int size,
+                            int tile_size, std::pair<int, int> start,
+                            std::pair<int, int> goal) {
+  bmf::BinaryMapLocation locations[2] = {
+      {pp::kStartPos, start.first, start.second, 0},
+      {pp::kEndPos, goal.first, goal.second, 0}};
+  bmf::BinaryMapHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, bmf::kMagic, sizeof(header.magic));
+  header.version = bmf::kVersion;
+  header.byte_order_mark = bmf::kByteOrderMark;
+  header.elevation_type = bmf::NativeElevationType();
+  header.rows = size;
+  header.cols = size;
+  header.tile_size = uint32_t(tile_size);
+  header.num_locations = 2;
+  header.locations_offset = sizeof(header);
+  header.data_offset = bmf::kDataAlignment;
+
+  std::ofstream out_file(filename, std::ios::binary | std::ios::trunc);
+  if (!out_file.is_open()) {
+    return false;
+  }
+  out_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out_file.write(reinterpret_cast<const char*>(locations), sizeof(locations));
+  std::vector<char> padding(
+      size_t(header.data_offset) - sizeof(header) - sizeof(locations), 0);
+  out_file.write(padding.data(), padding.size());
+
+  std::vector<pp::Elevation> tile(size_t(tile_size) * size_t(tile_size));
+  for (int tile_row = 0; tile_row < size && out_file; tile_row += tile_size) {
+    for (int tile_col = 0; tile_col < size; tile_col += tile_size) {
+      for (int r = 0; r < tile_size; r++) {
+        for (int c = 0; c < tile_size; c++) {
+          const int row = tile_row + r;
+          const int col = tile_col + c;
+          pp::Elevation value = 0;
+          if (row < size && col < size) {
+            value = pp::Elevation(bm::SyntheticElevation(5, row, col) / 4);
+          }
+          if (std::make_pair(row, col) == start) {
+            value = pp::Elevation(pp::MarkerValue(pp::kStartPos));
+          } else if (std::make_pair(row, col) == goal) {
+            value = pp::Elevation(pp::MarkerValue(pp::kEndPos));
+          }
+          tile[size_t(r) * size_t(tile_size) + size_t(c)] = value;
+        }
+      }
+      out_file.write(reinterpret_cast<const char*>(tile.data()),
+                     tile.size() * sizeof(pp::Elevation));
+    }
+  }
+  return bool(out_file);
+}
+
+}  // namespace
+
+/// Plans a corridor across a tiled map that is read on demand through a small
+/// tile cache, and reports how much of the map was actually read.
+///
+/// Usage: tiled_map_benchmark [map_size] [tile_size] [cache_mb] [margin]
+int main(int argc, char** argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 8192;
+  const int tile_size = argc > 2 ? std::atoi(argv[2]) : 256;
+  const size_t cache_bytes =
+      size_t(argc > 3 ? std::atol(argv[3]) : 64) << 20;
+  const int margin = argc > 4 ? std::atoi(argv[4]) : 64;
+  if (size < 16 || tile_size < 1) {
+    std::cerr << "tiled_map_benchmark: ERROR! Invalid map or tile size"
+              << std::endl;
+    return -1;
+  }
+
+  const std::string filename = "tiled_map_benchmark.emap";
+  const std::pair<int, int> start(size / 16, size / 16);
+  const std::pair<int, int> goal(size - 1 - size / 16, size - 1 - size / 16);
+  bm::Stopwatch write_timer;
+  if (!WriteSyntheticTiledMap(filename, size, tile_size, start, goal)) {
+    std::cerr << "tiled_map_benchmark: ERROR! Unable to write " << filename
+              << std::endl;
+    return -1;
+  }
+  const double map_gb = double(size) * size * sizeof(pp::Elevation) / 1e9;
+  std::cout << "Wrote " << size << " x " << size << " map (" << map_gb
+            << " GB) in " << write_timer.Seconds() << " s" << std::endl;
+
+  bm::Stopwatch open_timer;
+  pp::ElevationMap emap;
+  if (!emap.OpenBinaryMap(filename, cache_bytes)) {
+    std::remove(filename.c_str());
+    return -1;
+  }
+  std::cout << "Opened in " << open_timer.Seconds() * 1e3 << " ms"
+            << std::endl;
+
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  options.window_margin = margin;
+  planner.SetSearchOptions(options);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  bm::Stopwatch plan_timer;
+  bool planned = planner.PlanPath(&profile, &agl_profile, 100);
+  double plan_seconds = plan_timer.Seconds();
+  std::remove(filename.c_str());
+  if (!planned) {
+    std::cerr << "tiled_map_benchmark: ERROR! Unable to plan" << std::endl;
+    return -1;
+  }
+
+  pp::TileCacheStats stats = emap.tile_cache()->stats();
+  const uint64_t tiles_per_side = (size + tile_size - 1) / tile_size;
+  std::cout << "Planned " << profile.size() << " cells in " << plan_seconds
+            << " s, " << planner.search_stats().nodes_expanded
+            << " nodes expanded" << std::endl
+            << "Read " << stats.misses << " of "
+            << tiles_per_side * tiles_per_side << " tiles ("
+            << 100.0 * stats.misses / (tiles_per_side * tiles_per_side)
+            << "% of the map), hit rate " << stats.hit_rate() * 100.0
+            << "%, " << stats.evictions << " evictions, "
+            << stats.resident_bytes / (1 << 20) << " MiB resident"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cstdint>
+
+#include "arena.h"
+#include "instrumentation.h"
+
+using namespace path_planning;
+
+MonotonicArena::MonotonicArena(size_t block_bytes)
+    : block_bytes_(std::max(block_bytes, size_t(64))),
+      current_(0),
+      offset_(0),
+      peak_bytes_(0) {
+}
+
+void* MonotonicArena::Allocate(size_t bytes, size_t alignment) {
+  // Find the first block from the current one with room, skipping blocks
+  // left too small by earlier allocations
+  for (; current_ < blocks_.size(); current_++, offset_ = 0) {
+    Block& block = blocks_[current_];
+    const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+    const uintptr_t aligned =
+        (base + offset_ + alignment - 1) & ~uintptr_t(alignment - 1);
+    const size_t start = size_t(aligned - base);
+    if (start <= block.size && bytes <= block.size - start) {
+      offset_ = start + bytes;
+      peak_bytes_ = std::max(peak_bytes_, bytes_used());
+      return block.data.get() + start;
+    }
+  }
+  // Each new block doubles the arena, so a warm arena stops growing
+  size_t size = blocks_.empty() ? block_bytes_ : 2 * blocks_.back().size;
+  size = std::max(size, bytes + alignment);
+  PP_COUNTER_ADD(Counter::kAllocations, 1);
+  blocks_.push_back(Block{std::unique_ptr<char[]>(new char[size]), size});
+  current_ = blocks_.size() - 1;
+  offset_ = 0;
+  return Allocate(bytes, alignment);
+}
+
+void MonotonicArena::Rewind(const Mark& mark) {
+  current_ = mark.block;
+  offset_ = mark.offset;
+}
+
+void MonotonicArena::Release() {
+  blocks_.clear();
+  blocks_.shrink_to_fit();
+  current_ = 0;
+  offset_ = 0;
+}
+
+size_t MonotonicArena::bytes_used() const {
+  size_t used = 0;
+  for (size_t i = 0; i < current_ && i < blocks_.size(); i++) {
+    used += blocks_[i].size;
+  }
+  return used + offset_;
+}
+
+size_t MonotonicArena::capacity() const {
+  size_t total = 0;
+  for (const Block& block : blocks_) {
+    total += block.size;
+  }
+  return total;
+}
+
+MonotonicArena& path_planning::ThreadArena() {
+  thread_local MonotonicArena arena;
+  return arena;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace path_planning {
+
+/// @class Bump allocator over a list of memory blocks, for the temporaries
+/// of a single plan. Allocating is a pointer increment and freeing is a
+/// no-op. Memory is given back all at once by rewinding to a `Mark` or
+/// resetting, and the blocks are kept, so a warm arena never calls the
+/// system allocator. Not thread safe, see `ThreadArena`.
+class MonotonicArena {
+ public:
+  /// The size of the first block, later blocks double in size
+  static const size_t kDefaultBlockBytes = size_t(64) << 10;
+
+  /// @struct A position in the arena to rewind to
+  struct Mark {
+    /// The block being allocated from
+    size_t block;
+    /// The first free byte of that block
+    size_t offset;
+  };
+
+  /// @brief Constructor. No memory is allocated until it is needed.
+  /// @param block_bytes - The size of the first block
+  explicit MonotonicArena(size_t block_bytes = kDefaultBlockBytes);
+  MonotonicArena(const MonotonicArena&) = delete;
+  MonotonicArena& operator=(const MonotonicArena&) = delete;
+  /// @brief Allocate memory that lives until the arena is rewound past it
+  /// @param bytes - The number of bytes
+  /// @param alignment - The alignment, a power of two
+  /// @return The memory. Throws `bad_alloc` if the system is out of memory.
+  void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+  /// @brief Get the current position, to rewind to later
+  Mark mark() const { return Mark{current_, offset_}; }
+  /// @brief Free everything allocated since a mark was taken
+  /// @param mark - A mark taken from this arena and not rewound past since
+  void Rewind(const Mark& mark);
+  /// @brief Free everything, keeping the blocks for reuse
+  void Reset() { Rewind(Mark{0, 0}); }
+  /// @brief Free everything and give the blocks back to the system
+  void Release();
+  /// @brief Get the number of bytes handed out since the last reset,
+  /// including alignment padding and the unused ends of filled blocks
+  size_t bytes_used() const;
+  /// @brief Get the most bytes that were ever in use at once
+  size_t peak_bytes() const { return peak_bytes_; }
+  /// @brief Get the total size of the blocks
+  size_t capacity() const;
+  /// @brief Get the number of blocks allocated from the system
+  size_t num_blocks() const { return blocks_.size(); }
+
+ private:
+  /// @struct A block of memory from the system
+  struct Block {
+    std::unique_ptr<char[]> data;
+    size_t size;
+  };
+
+  /// The size of the first block
+  size_t block_bytes_;
+  /// The blocks, in the order they are allocated from
+  std::vector<Block> blocks_;
+  /// The block being allocated from, `blocks_.size()` before the first
+  size_t current_;
+  /// The first free byte of the current block
+  size_t offset_;
+  /// The most bytes in use at once
+  size_t peak_bytes_;
+};
+
+/// @brief Get the arena of the calling thread. It lives as long as the
+/// thread and is shared by everything the thread runs, so users take a
+/// scoped mark with `ArenaScope` rather than resetting it.
+MonotonicArena& ThreadArena();
+
+/// @class Frees everything allocated from an arena during its lifetime when
+/// it goes out of scope. Scopes nest.
+class ArenaScope {
+ public:
+  /// @brief Constructor, marks the arena
+  /// @param arena - The arena to rewind on destruction
+  explicit ArenaScope(MonotonicArena& arena)
+      : arena_(arena), mark_(arena.mark()) {}
+  /// @brief Destructor, rewinds the arena to the mark
+  ~ArenaScope() { arena_.Rewind(mark_); }
+  ArenaScope(const ArenaScope&) = delete;
+  ArenaScope& operator=(const ArenaScope&) = delete;
+
+ private:
+  /// The arena to rewind
+  MonotonicArena& arena_;
+  /// Where to rewind it to
+  MonotonicArena::Mark mark_;
+};
+
+/// @class Standard allocator that draws from a `MonotonicArena`, e.g. for
+/// the scratch containers of a plan. Deallocation does nothing, the memory
+/// is freed when the arena is rewound, so containers using it must not
+/// outlive the enclosing `ArenaScope`.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+  /// @brief Constructor
+  /// @param arena - The arena to allocate from
+  explicit ArenaAllocator(MonotonicArena* arena) : arena_(arena) {}
+  /// @brief Constructor, from the allocator of another type
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : arena_(other.arena()) {}
+  /// @brief Allocate memory for `count` objects
+  T* allocate(size_t count) {
+    if (count > size_t(-1) / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+    return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T)));
+  }
+  /// @brief Does nothing, see the class comment
+  void deallocate(T*, size_t) {}
+  /// @brief Get the arena allocated from
+  MonotonicArena* arena() const { return arena_; }
+
+ private:
+  /// The arena to allocate from
+  MonotonicArena* arena_;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+/// A vector whose storage comes from a `MonotonicArena`
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+}
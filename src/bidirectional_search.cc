@@ -0,0 +1,501 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+
+#include "bidirectional_search.h"
+#include "clearance_field.h"
+#include "instrumentation.h"
+#include "search_policies.h"
+#include "thread_pool.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// @brief Get the forward potential of a cell, half the difference of its
+/// distance heuristics to the goal and to the start. The backward potential
+/// is its negative. Both keep every step's reduced cost non-negative, so
+/// each side settles cells in order of cost like Dijkstra on the reduced
+/// costs.
+template <typename Neighbors>
+float Potential(double weight, int row, int col, int start_row,
+                int start_col, int goal_row, int goal_col) {
+  return float(0.5 * weight *
+               (Neighbors::Distance(std::abs(goal_row - row),
+                                    std::abs(goal_col - col)) -
+                Neighbors::Distance(std::abs(start_row - row),
+                                    std::abs(start_col - col))));
+}
+
+/// @brief Pack a generation and a cost into one word, so the other side
+/// never reads the cost of one search with the generation of another
+uint64_t Publication(uint32_t generation, float g) {
+  uint32_t bits;
+  std::memcpy(&bits, &g, sizeof(bits));
+  return (uint64_t(generation) << 32) | bits;
+}
+
+}  // namespace
+
+BidirectionalSearch::BidirectionalSearch()
+    : window_row_begin_(0),
+      window_col_begin_(0),
+      window_rows_(0),
+      window_cols_(0),
+      generation_(0),
+      best_cost_(std::numeric_limits<float>::infinity()),
+      stop_(false),
+      cancelled_(false),
+      meet_cell_(kNoCell) {
+}
+
+BidirectionalSearch::BidirectionalSearch(const SearchOptions& options)
+    : BidirectionalSearch() {
+  options_ = options;
+}
+
+BidirectionalSearch::~BidirectionalSearch() = default;
+
+bool BidirectionalSearch::FindPath(const ElevationMap& emap,
+                                   const std::pair<int, int>& start,
+                                   const std::pair<int, int>& goal, int agl,
+                                   std::vector<std::pair<int, int>>* path) {
+  PP_SCOPED_TIMER(Stage::kSearch);
+  stats_ = SearchStats();
+  path->clear();
+  auto in_map = [&emap](const std::pair<int, int>& cell) {
+    return cell.first >= 0 && cell.first < emap.rows() && cell.second >= 0 &&
+           cell.second < emap.cols();
+  };
+  if (!in_map(start) || !in_map(goal)) {
+    std::cerr << "BidirectionalSearch::FindPath: ERROR! Start or goal is "
+                 "outside of the map" << std::endl;
+    return false;
+  }
+  const CostModel& cost = options_.cost;
+  if (cost.distance_weight < 0.0 || cost.climb_weight < 0.0 ||
+      cost.descent_weight < 0.0) {
+    std::cerr << "BidirectionalSearch::FindPath: ERROR! Cost weights must "
+                 "not be negative" << std::endl;
+    return false;
+  }
+  const ClearanceField* clearance = options_.clearance;
+  if (clearance != nullptr && (clearance->rows() != emap.rows() ||
+                               clearance->cols() != emap.cols())) {
+    std::cerr << "BidirectionalSearch::FindPath: ERROR! The clearance field "
+                 "was not built from the searched map" << std::endl;
+    return false;
+  }
+
+  // The whole map, or the rectangle within the margin of both ends
+  const int margin = options_.window_margin;
+  if (margin < 0) {
+    window_row_begin_ = 0;
+    window_col_begin_ = 0;
+    window_rows_ = emap.rows();
+    window_cols_ = emap.cols();
+  } else {
+    window_row_begin_ = int(std::max<int64_t>(
+        0, int64_t(std::min(start.first, goal.first)) - margin));
+    window_col_begin_ = int(std::max<int64_t>(
+        0, int64_t(std::min(start.second, goal.second)) - margin));
+    window_rows_ =
+        int(std::min<int64_t>(emap.rows(),
+                              int64_t(std::max(start.first, goal.first)) +
+                                  margin + 1)) -
+        window_row_begin_;
+    window_cols_ =
+        int(std::min<int64_t>(emap.cols(),
+                              int64_t(std::max(start.second, goal.second)) +
+                                  margin + 1)) -
+        window_col_begin_;
+  }
+  const uint64_t cell_count = uint64_t(window_rows_) * uint64_t(window_cols_);
+  if (cell_count >= kUnqueued) {
+    std::cerr << "BidirectionalSearch::FindPath: ERROR! Map is too large to "
+              << "search, limit the search window" << std::endl;
+    return false;
+  }
+  if (start == goal) {
+    path->push_back(start);
+    return true;
+  }
+
+  Reset(size_t(cell_count));
+  Problem problem;
+  problem.start_cell = CellIndex(start.first, start.second);
+  problem.goal_cell = CellIndex(goal.first, goal.second);
+  problem.start_row = start.first;
+  problem.start_col = start.second;
+  problem.goal_row = goal.first;
+  problem.goal_col = goal.second;
+  problem.start_elevation =
+      double(TerrainElevation(emap, start.first, start.second));
+  problem.goal_elevation =
+      double(TerrainElevation(emap, goal.first, goal.second));
+  problem.max_terrain = double(int64_t(cost.max_altitude) - agl);
+  problem.clearance = clearance;
+  problem.heuristic_weight = options_.algorithm == SearchAlgorithm::kDijkstra
+                                 ? 0.0
+                                 : cost.distance_weight;
+
+  Expand(emap, problem);
+  for (const Side& side : sides_) {
+    stats_.nodes_expanded += side.nodes_expanded;
+    stats_.cells_visited += side.cells_visited;
+  }
+  // Counted once per search to keep the expansion loop free of atomics
+  PP_COUNTER_ADD(Counter::kNodesExpanded, stats_.nodes_expanded);
+  PP_COUNTER_ADD(Counter::kCellsVisited, stats_.cells_visited);
+  if (meet_cell_ == kNoCell || cancelled_.load()) {
+    return false;
+  }
+  stats_.path_cost = best_cost_.load();
+
+  // The forward parents lead from the meeting cell back to the start, the
+  // backward ones on to the goal
+  auto cell_of = [this](uint32_t cell) {
+    return std::make_pair(int(cell / uint32_t(window_cols_)) +
+                              window_row_begin_,
+                          int(cell % uint32_t(window_cols_)) +
+                              window_col_begin_);
+  };
+  const std::vector<Node>& forward = sides_[kForward].nodes;
+  for (uint32_t cell = meet_cell_;; cell = forward[cell].parent) {
+    path->push_back(cell_of(cell));
+    if (cell == problem.start_cell) {
+      break;
+    }
+  }
+  std::reverse(path->begin(), path->end());
+  const std::vector<Node>& backward = sides_[kBackward].nodes;
+  for (uint32_t cell = meet_cell_; cell != problem.goal_cell;) {
+    cell = backward[cell].parent;
+    path->push_back(cell_of(cell));
+  }
+  return true;
+}
+
+void BidirectionalSearch::Expand(const ElevationMap& emap,
+                                 const Problem& problem) {
+  // Rows and columns are map coordinates, so the terrain is read from the
+  // first cell of the map
+  if (emap.data() == nullptr) {
+    ExpandOn(TiledTerrain{&emap, 0}, problem);
+  } else {
+    ExpandOn(RowMajorTerrain<Elevation>{emap.data(), size_t(emap.cols())},
+             problem);
+  }
+}
+
+template <typename Terrain>
+void BidirectionalSearch::ExpandOn(const Terrain& terrain,
+                                   const Problem& problem) {
+  switch (options_.connectivity) {
+    case Connectivity::kFour:
+      ExpandWith<Terrain, Neighborhood<Connectivity::kFour>>(terrain,
+                                                             problem);
+      return;
+    case Connectivity::kEight:
+      ExpandWith<Terrain, Neighborhood<Connectivity::kEight>>(terrain,
+                                                              problem);
+      return;
+    case Connectivity::kSixteen:
+      ExpandWith<Terrain, Neighborhood<Connectivity::kSixteen>>(terrain,
+                                                                problem);
+      return;
+  }
+}
+
+template <typename Terrain, typename Neighbors>
+void BidirectionalSearch::ExpandWith(const Terrain& terrain,
+                                     const Problem& problem) {
+  if (options_.cost_policy == CostPolicy::kDistance) {
+    ExpandSides<Terrain, Neighbors, DistanceCost>(terrain, problem);
+  } else {
+    ExpandSides<Terrain, Neighbors, TerrainCost>(terrain, problem);
+  }
+}
+
+template <typename Terrain, typename Neighbors, typename Cost>
+void BidirectionalSearch::ExpandSides(const Terrain& terrain,
+                                      const Problem& problem) {
+  double step_distances[Neighbors::kCount];
+  for (int k = 0; k < Neighbors::kCount; k++) {
+    step_distances[k] = options_.cost.distance_weight * kNeighborDistances[k];
+  }
+  const double weight = problem.heuristic_weight;
+  // Both ends are open before either thread starts, so a side running
+  // alone still finds the path once it reaches the other end
+  const float start_key = Potential<Neighbors>(
+      weight, problem.start_row, problem.start_col, problem.start_row,
+      problem.start_col, problem.goal_row, problem.goal_col);
+  const float goal_key = -Potential<Neighbors>(
+      weight, problem.goal_row, problem.goal_col, problem.start_row,
+      problem.start_col, problem.goal_row, problem.goal_col);
+  Reach(kForward, problem.start_cell, problem.start_cell, 0.0f, start_key);
+  Reach(kBackward, problem.goal_cell, problem.goal_cell, 0.0f, goal_key);
+  sides_[kForward].top_key.store(start_key);
+  sides_[kBackward].top_key.store(goal_key);
+
+  if (options_.bidirectional_threads < 2) {
+    while (Step<Terrain, Neighbors, Cost>(kForward, terrain, problem,
+                                          step_distances) &&
+           Step<Terrain, Neighbors, Cost>(kBackward, terrain, problem,
+                                          step_distances)) {
+    }
+    return;
+  }
+  if (!pool_) {
+    pool_.reset(new ThreadPool(2));
+  }
+  auto run = [&](size_t direction, int) {
+    while (Step<Terrain, Neighbors, Cost>(int(direction), terrain, problem,
+                                          step_distances)) {
+    }
+  };
+  // Wrapped in a reference so the `std::function` does not allocate a copy
+  pool_->ParallelFor(2, std::ref(run));
+}
+
+template <typename Terrain, typename Neighbors, typename Cost>
+bool BidirectionalSearch::Step(int direction, const Terrain& terrain,
+                               const Problem& problem,
+                               const double* step_distances) {
+  using Value = typename Terrain::Value;
+  if (stop_.load(std::memory_order_relaxed)) {
+    return false;
+  }
+  Side& side = sides_[direction];
+  const Side& other = sides_[1 - direction];
+  std::vector<Node>& nodes = side.nodes;
+  const std::vector<HeapEntry>& heap = side.heap;
+  if (heap.empty()) {
+    stop_.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  // A path cheaper than the best one found would have to pass a cell open
+  // on both sides, and costs at least the sum of their lowest keys. The
+  // other side's key may be stale, but keys only grow, and any meeting it
+  // found before publishing the key is already in `best_cost_`.
+  const float key = heap.front().f;
+  side.top_key.store(key, std::memory_order_release);
+  const float other_key = other.top_key.load(std::memory_order_acquire);
+  if (key + other_key >= best_cost_.load(std::memory_order_relaxed)) {
+    stop_.store(true, std::memory_order_relaxed);
+    return false;
+  }
+  const uint32_t cell = PopMin(&side);
+  side.nodes_expanded++;
+  if (cancel_ != nullptr && side.nodes_expanded % kCancelCheckInterval == 0 &&
+      cancel_->IsCancelled()) {
+    cancelled_.store(true, std::memory_order_relaxed);
+    stop_.store(true, std::memory_order_relaxed);
+    return false;
+  }
+
+  const bool forward = direction == kForward;
+  const CostModel& cost = options_.cost;
+  const uint32_t start_cell = problem.start_cell;
+  const uint32_t goal_cell = problem.goal_cell;
+  // A path may finish on a cell above the ceiling, so the backward side may
+  // also leave from one, and each side may enter the far end
+  const uint32_t target_cell = forward ? goal_cell : start_cell;
+  const double weight = forward ? problem.heuristic_weight
+                                : -problem.heuristic_weight;
+  const Value max_terrain = Value(problem.max_terrain);
+  const ClearanceField* clearance = problem.clearance;
+  const int row_end = window_row_begin_ + window_rows_;
+  const int col_end = window_col_begin_ + window_cols_;
+  // The terrain of a cell, with the start and goal markers substituted
+  auto elevation_of = [&](uint32_t index, int row, int col) {
+    if (index == start_cell) {
+      return Value(problem.start_elevation);
+    }
+    if (index == goal_cell) {
+      return Value(problem.goal_elevation);
+    }
+    return terrain(row, col);
+  };
+
+  // Whether a cell, or the terrain around it, is above the ceiling
+  auto too_high = [&](int row, int col) {
+    return (clearance != nullptr ? Value(clearance->MaxElevation(row, col))
+                                 : terrain(row, col)) > max_terrain;
+  };
+
+  const int row = int(cell / uint32_t(window_cols_)) + window_row_begin_;
+  const int col = int(cell % uint32_t(window_cols_)) + window_col_begin_;
+  const float g = nodes[cell].g;
+  const Value elevation =
+      Cost::kUsesClimb ? elevation_of(cell, row, col) : Value(0);
+  for (int k = 0; k < Neighbors::kCount; k++) {
+    const int next_row = row + kNeighborRows[k];
+    const int next_col = col + kNeighborCols[k];
+    if (next_row < window_row_begin_ || next_row >= row_end ||
+        next_col < window_col_begin_ || next_col >= col_end) {
+      continue;
+    }
+    const uint32_t next = CellIndex(next_row, next_col);
+    const Node& next_node = nodes[next];
+    if (next_node.generation == generation_ &&
+        next_node.heap_index == kClosed) {
+      continue;
+    }
+    side.cells_visited++;
+    const Value next_elevation = elevation_of(next, next_row, next_col);
+    const Value next_highest =
+        clearance != nullptr
+            ? Value(clearance->MaxElevation(next_row, next_col))
+            : next_elevation;
+    if (next_highest > max_terrain && next != target_cell) {
+      continue;
+    }
+    if (k >= 4 && StepSlipsThrough(row, col, kNeighborRows[k],
+                                   kNeighborCols[k], too_high)) {
+      continue;
+    }
+    // The backward side walks each step in reverse, so it climbs where the
+    // path descends
+    const Value climb =
+        forward ? next_elevation - elevation : elevation - next_elevation;
+    const float next_g =
+        g + float(Cost::Step(cost, step_distances[k], climb));
+    if (next_node.generation == generation_ && next_g >= next_node.g) {
+      continue;
+    }
+    Reach(direction, next, cell, next_g,
+          next_g + Potential<Neighbors>(weight, next_row, next_col,
+                                        problem.start_row, problem.start_col,
+                                        problem.goal_row, problem.goal_col));
+  }
+  return true;
+}
+
+void BidirectionalSearch::Reach(int direction, uint32_t cell,
+                                uint32_t parent, float g, float f) {
+  Side& side = sides_[direction];
+  Node& node = side.nodes[cell];
+  if (node.generation != generation_) {
+    node.generation = generation_;
+    node.heap_index = kUnqueued;
+  }
+  node.g = g;
+  node.parent = parent;
+  if (node.heap_index == kUnqueued) {
+    node.heap_index = uint32_t(side.heap.size());
+    side.heap.push_back(HeapEntry{f, cell});
+  } else {
+    side.heap[node.heap_index].f = f;
+  }
+  // Keys only ever decrease, so the entry can only move up
+  SiftUp(&side, node.heap_index);
+
+  // Publish before looking at the other side, which does the same, so of
+  // two sides reaching a cell at once at least one sees the other
+  side.published[cell].store(Publication(generation_, g));
+  const uint64_t other = sides_[1 - direction].published[cell].load();
+  if (uint32_t(other >> 32) != generation_) {
+    return;
+  }
+  const uint32_t other_bits = uint32_t(other);
+  float other_g;
+  std::memcpy(&other_g, &other_bits, sizeof(other_g));
+  const float through = g + other_g;
+  if (through < best_cost_.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(meet_mutex_);
+    if (through < best_cost_.load(std::memory_order_relaxed)) {
+      best_cost_.store(through, std::memory_order_relaxed);
+      meet_cell_ = cell;
+    }
+  }
+}
+
+void BidirectionalSearch::Reset(size_t cell_count) {
+  generation_++;
+  // Generations wrapped around, so stamps from long ago could look current
+  const bool wrapped = generation_ == 0;
+  if (wrapped) {
+    generation_ = 1;
+  }
+  for (Side& side : sides_) {
+    side.heap.clear();
+    side.nodes_expanded = 0;
+    side.cells_visited = 0;
+    if (side.nodes.size() < cell_count) {
+      PP_COUNTER_ADD(Counter::kAllocations, 1);
+      side.nodes.resize(cell_count, Node{0.0f, 0, kUnqueued, 0});
+    }
+    if (side.published_size < cell_count) {
+      side.published.reset(new std::atomic<uint64_t>[cell_count]());
+      side.published_size = cell_count;
+    }
+    if (wrapped) {
+      for (Node& node : side.nodes) {
+        node.generation = 0;
+      }
+      for (size_t i = 0; i < side.published_size; i++) {
+        side.published[i].store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+  best_cost_.store(std::numeric_limits<float>::infinity());
+  stop_.store(false);
+  cancelled_.store(false);
+  meet_cell_ = kNoCell;
+}
+
+uint32_t BidirectionalSearch::PopMin(Side* side) {
+  std::vector<HeapEntry>& heap = side->heap;
+  const uint32_t cell = heap.front().cell;
+  side->nodes[cell].heap_index = kClosed;
+  heap.front() = heap.back();
+  heap.pop_back();
+  if (!heap.empty()) {
+    side->nodes[heap.front().cell].heap_index = 0;
+    SiftDown(side, 0);
+  }
+  return cell;
+}
+
+void BidirectionalSearch::SiftUp(Side* side, size_t index) {
+  std::vector<HeapEntry>& heap = side->heap;
+  const HeapEntry entry = heap[index];
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (heap[parent].f <= entry.f) {
+      break;
+    }
+    heap[index] = heap[parent];
+    side->nodes[heap[index].cell].heap_index = uint32_t(index);
+    index = parent;
+  }
+  heap[index] = entry;
+  side->nodes[entry.cell].heap_index = uint32_t(index);
+}
+
+void BidirectionalSearch::SiftDown(Side* side, size_t index) {
+  std::vector<HeapEntry>& heap = side->heap;
+  const HeapEntry entry = heap[index];
+  const size_t size = heap.size();
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && heap[child + 1].f < heap[child].f) {
+      child++;
+    }
+    if (entry.f <= heap[child].f) {
+      break;
+    }
+    heap[index] = heap[child];
+    side->nodes[heap[index].cell].heap_index = uint32_t(index);
+    index = child;
+  }
+  heap[index] = entry;
+  side->nodes[entry.cell].heap_index = uint32_t(index);
+}
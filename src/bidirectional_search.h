@@ -0,0 +1,210 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "cancellation.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+
+namespace path_planning {
+
+class ThreadPool;
+
+/// @class Bidirectional A* over an `ElevationMap`, for single long queries
+/// that have to come back fast. One search runs forwards from the start and
+/// one backwards from the goal, each on its own thread with its own node
+/// array and open list. They share the cost each has reached every cell
+/// with, so whenever one side reaches a cell the other has, the cost of the
+/// path through it is a candidate for the best path, and the lowest key on
+/// each open list.
+///
+/// The sides order their cells by cost plus the average of the two distance
+/// heuristics: half the distance to their own goal minus half the distance
+/// to their own start. With one heuristic per side the searches would each
+/// cover most of what a single A* covers before they could stop. With the
+/// average they are one search on reduced costs run from both ends, and stop
+/// as soon as the lowest keys of the two sides add up to the best path.
+///
+/// Gives paths of the same cost as `GridSearch` with `SearchAlgorithm::kAStar`
+/// under the same options, though not always the same cells where several
+/// paths cost the same. `SearchOptions::window_margin` limits the search to
+/// the rectangle around the start and goal rather than the band along the
+/// line between them. `SearchAlgorithm::kDijkstra` searches both ways
+/// without a heuristic; any other algorithm uses the distance heuristic.
+class BidirectionalSearch {
+ public:
+  /// @brief Constructor
+  BidirectionalSearch();
+  /// @brief Constructor
+  /// @param options - The options to search with
+  explicit BidirectionalSearch(const SearchOptions& options);
+  /// @brief Destructor, stops the search threads
+  ~BidirectionalSearch();
+  BidirectionalSearch(const BidirectionalSearch&) = delete;
+  BidirectionalSearch& operator=(const BidirectionalSearch&) = delete;
+  /// @brief Set the options to use for subsequent searches
+  void SetOptions(const SearchOptions& options) { options_ = options; }
+  /// @brief Get the current search options
+  const SearchOptions& options() const { return options_; }
+  /// @brief Set the token that stops searches early. A cancelled search
+  /// fails as if there were no path,
+  /// and either side may notice it.
+  /// @param cancel - Optional. Not owned, it must outlive the searches.
+  void SetCancellation(const CancellationToken* cancel) { cancel_ = cancel; }
+  /// @brief Get the counters from the most recent search, summed over both
+  /// directions
+  const SearchStats& stats() const { return stats_; }
+  /// @brief Find the cheapest path between two cells, see
+  /// `GridSearch::FindPath`
+  /// @param emap - The map to search
+  /// @param start - The row and column to start from
+  /// @param goal - The row and column to finish at
+  /// @param agl - The altitude above the terrain that will be flown, used
+  /// with `CostModel::max_altitude`
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  bool FindPath(const ElevationMap& emap, const std::pair<int, int>& start,
+                const std::pair<int, int>& goal, int agl,
+                std::vector<std::pair<int, int>>* path);
+
+ private:
+  /// @struct Search state of a single cell in one direction
+  struct Node {
+    /// The cost of the cheapest known path from the side's origin
+    float g;
+    /// The cell index this node was reached from
+    uint32_t parent;
+    /// The position of this node in the side's heap, or `kClosed`
+    uint32_t heap_index;
+    /// The search generation the other fields belong to
+    uint32_t generation;
+  };
+  /// @struct An entry in an open list
+  struct HeapEntry {
+    /// The cost of the cell plus its potential
+    float f;
+    /// The cell index
+    uint32_t cell;
+  };
+  /// @struct One direction of the search
+  struct Side {
+    /// Per-cell search state, only touched by the side's own thread
+    std::vector<Node> nodes;
+    /// The open list, an indexed binary heap on `f`
+    std::vector<HeapEntry> heap;
+    /// The generation and cost of each cell packed into 64 bits, read by
+    /// the other side to find where the searches meet
+    std::unique_ptr<std::atomic<uint64_t>[]> published;
+    /// The number of entries in `published`
+    size_t published_size = 0;
+    /// The lowest key on the open list when the side last looked
+    std::atomic<float> top_key{0.0f};
+    /// Counters of the side
+    size_t nodes_expanded = 0;
+    size_t cells_visited = 0;
+  };
+  /// @struct The parts of a search the expansion loop needs besides the
+  /// terrain. Rows and columns are map rows and columns.
+  struct Problem {
+    /// The node indices of the start and goal
+    uint32_t start_cell;
+    uint32_t goal_cell;
+    /// The start and goal cells
+    int start_row;
+    int start_col;
+    int goal_row;
+    int goal_col;
+    /// The terrain of the start and goal cells, with markers substituted
+    double start_elevation;
+    double goal_elevation;
+    /// The highest terrain a path may cross
+    double max_terrain;
+    /// Optional. The field to check `max_terrain` against instead
+    const ClearanceField* clearance;
+    /// The weight of the distance heuristic, 0 to search without one
+    double heuristic_weight;
+  };
+
+  /// The index of the forward and backward sides in `sides_`
+  static const int kForward = 0;
+  static const int kBackward = 1;
+  /// Marks that the searches have not met
+  static const uint32_t kNoCell = std::numeric_limits<uint32_t>::max();
+  /// Marks a node that has already been expanded
+  static const uint32_t kClosed = std::numeric_limits<uint32_t>::max();
+  /// Marks a node that has been reached but is not on the open list yet
+  static const uint32_t kUnqueued = std::numeric_limits<uint32_t>::max() - 1;
+
+  /// @brief Pick the expansion loop for the cell type
+  void Expand(const ElevationMap& emap, const Problem& problem);
+  /// @brief Pick the expansion loop for the neighborhood
+  template <typename Terrain>
+  void ExpandOn(const Terrain& terrain, const Problem& problem);
+  /// @brief Pick the expansion loop for the cost policy
+  template <typename Terrain, typename Neighbors>
+  void ExpandWith(const Terrain& terrain, const Problem& problem);
+  /// @brief Run both sides to the end, on two threads or alternating on
+  /// this one
+  template <typename Terrain, typename Neighbors, typename Cost>
+  void ExpandSides(const Terrain& terrain, const Problem& problem);
+  /// @brief Expand the node with the lowest key on one side
+  /// @param direction - `kForward` or `kBackward`
+  /// @param step_distances - The weighted length of each step
+  /// @return false once the search is over
+  template <typename Terrain, typename Neighbors, typename Cost>
+  bool Step(int direction, const Terrain& terrain, const Problem& problem,
+            const double* step_distances);
+  /// @brief Open a cell on one side or lower its cost, publish the cost and
+  /// check if the other side has reached the cell
+  void Reach(int direction, uint32_t cell, uint32_t parent, float g,
+             float f);
+  /// @brief Size the scratch state of both sides and start a new generation
+  void Reset(size_t cell_count);
+  /// @brief Remove the cell with the lowest key from a side's open list
+  static uint32_t PopMin(Side* side);
+  /// @brief Move a heap entry of a side towards the root
+  static void SiftUp(Side* side, size_t index);
+  /// @brief Move a heap entry of a side towards the leaves
+  static void SiftDown(Side* side, size_t index);
+  /// @brief Get the node index of a map row and column inside the window
+  uint32_t CellIndex(int row, int col) const {
+    return uint32_t(size_t(row - window_row_begin_) * size_t(window_cols_) +
+                    size_t(col - window_col_begin_));
+  }
+
+  /// The options to search with
+  SearchOptions options_;
+  /// Counters from the most recent search
+  SearchStats stats_;
+  /// The first map row and column of the search window and its size
+  int window_row_begin_;
+  int window_col_begin_;
+  int window_rows_;
+  int window_cols_;
+  /// The generation of the current search
+  uint32_t generation_;
+  /// The forward and backward sides
+  Side sides_[2];
+  /// The cost of the cheapest path found through a cell both sides reached
+  std::atomic<float> best_cost_;
+  /// Set by the side that finishes the search
+  std::atomic<bool> stop_;
+  /// Optional. Stops searches early, see `SetCancellation`
+  const CancellationToken* cancel_ = nullptr;
+  /// Set by the side that found the search cancelled
+  std::atomic<bool> cancelled_;
+  /// Guards `meet_cell_` and updates of `best_cost_`
+  std::mutex meet_mutex_;
+  /// The cell the cheapest path passes through, or `kNoCell`
+  uint32_t meet_cell_;
+  /// Runs the two sides, created on the first threaded search
+  std::unique_ptr<ThreadPool> pool_;
+};
+}
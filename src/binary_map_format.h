@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include "elevation_map.h"
+
+namespace path_planning {
+
+/// The on-disk layout of a binary elevation map (`.emap`) file:
+///
+///   BinaryMapHeader
+///   BinaryMapLocation[num_locations]   at locations_offset
+///   elevation cells                     at data_offset, page aligned
+///
+/// All values are stored in the byte order of the machine that wrote the file
+/// and `byte_order_mark` is used to reject files from a foreign machine. With
+/// a `tile_size` of 0 the cells are row-major, which lets `OpenBinaryMap`
+/// serve them straight out of the mapping. Otherwise the cells are stored in
+/// `tile_size` x `tile_size` tiles in row-major tile order, each tile
+/// row-major and zero padded past the map edge, and are read through a
+/// `TileCache`.
+namespace binary_map {
+
+/// The magic bytes at the start of every file
+static const char kMagic[4] = {'E', 'M', 'A', 'P'};
+/// The current format version
+static const uint32_t kVersion = 1;
+/// Written natively so a reader on a different endianness sees it reversed
+static const uint32_t kByteOrderMark = 0x01020304u;
+/// The alignment of the cell data from the start of the file
+static const uint64_t kDataAlignment = 4096;
+
+/// The element type of the stored cells
+enum ElevationType : uint32_t {
+  kInt16 = 1,
+  kInt32 = 2
+};
+
+/// @struct Fixed size header at the start of the file
+struct BinaryMapHeader {
+  /// Always `kMagic`
+  char magic[4];
+  /// The format version, `kVersion`
+  uint32_t version;
+  /// Always `kByteOrderMark` in the writer's byte order
+  uint32_t byte_order_mark;
+  /// The `ElevationType` of the cells
+  uint32_t elevation_type;
+  /// The number of rows in the map
+  int64_t rows;
+  /// The number of columns in the map
+  int64_t cols;
+  /// The edge length of the square tiles the cells are stored in, or 0 for
+  /// row-major storage
+  uint32_t tile_size;
+  /// The number of entries in the special location table
+  uint32_t num_locations;
+  /// The offset of the special location table from the start of the file
+  uint64_t locations_offset;
+  /// The offset of the cell data from the start of the file
+  uint64_t data_offset;
+};
+
+/// @struct An entry in the special location table
+struct BinaryMapLocation {
+  /// The marker character from `kMarkers`
+  int32_t marker;
+  /// The row of the location
+  int32_t row;
+  /// The column of the location
+  int32_t col;
+  /// Padding, always 0
+  int32_t reserved;
+};
+
+/// @brief Get the type tag for the elevation type the library was built with
+inline uint32_t NativeElevationType() {
+  return sizeof(Elevation) == sizeof(int16_t) ? kInt16 : kInt32;
+}
+
+/// @brief Get the size in bytes of a single cell of the given type
+inline uint64_t ElevationTypeSize(uint32_t elevation_type) {
+  return elevation_type == kInt16 ? sizeof(int16_t) : sizeof(int32_t);
+}
+
+/// @brief Build the header of a file with the native elevation type, its
+/// location table right after the header and its cells at the next aligned
+/// offset
+/// @param rows - The number of rows in the map
+/// @param cols - The number of columns in the map
+/// @param tile_size - The edge length of the tiles, or 0 for row-major cells
+/// @param num_locations - The number of entries in the location table
+inline BinaryMapHeader MakeHeader(int64_t rows, int64_t cols,
+                                  uint32_t tile_size,
+                                  uint32_t num_locations) {
+  BinaryMapHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(header.magic));
+  header.version = kVersion;
+  header.byte_order_mark = kByteOrderMark;
+  header.elevation_type = NativeElevationType();
+  header.rows = rows;
+  header.cols = cols;
+  header.tile_size = tile_size;
+  header.num_locations = num_locations;
+  header.locations_offset = sizeof(header);
+  const uint64_t locations_end =
+      header.locations_offset + num_locations * sizeof(BinaryMapLocation);
+  header.data_offset =
+      (locations_end + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+  return header;
+}
+
+}  // namespace binary_map
+}  // namespace path_planning
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace path_planning {
+
+/// Searches check their `CancellationToken` once per this many nodes
+/// expanded, so the check costs little and a cancelled search stops within
+/// a fraction of a millisecond
+static const uint32_t kCancelCheckInterval = 1024;
+
+/// @class Asks a plan to stop early, when `Cancel` is called from any thread
+/// or once its deadline passes. Searches poll it cooperatively every
+/// `kCancelCheckInterval` expansions and fail as if no path existed, so a
+/// plan never runs far past its deadline. The exception is the first search
+/// of a `GridSearch`, which sizes its nodes to the map before it first
+/// checks, and so can overshoot by that allocation. See `PlanQuery::cancel`.
+class CancellationToken {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /// @brief Constructor. Without a deadline only `Cancel` stops the plan.
+  CancellationToken() : cancelled_(false), deadline_(Clock::time_point::max()) {}
+  /// @brief Constructor
+  /// @param deadline - The time after which the plan is cancelled
+  explicit CancellationToken(Clock::time_point deadline)
+      : cancelled_(false), deadline_(deadline) {}
+  CancellationToken(const CancellationToken&) = delete;
+  CancellationToken& operator=(const CancellationToken&) = delete;
+  /// @brief Ask the plan to stop. Safe to call from any thread.
+  void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+  /// @brief Check if `Cancel` was called
+  bool cancel_requested() const {
+    return cancelled_.load(std::memory_order_relaxed);
+  }
+  /// @brief Get the deadline, `Clock::time_point::max()` for none
+  Clock::time_point deadline() const { return deadline_; }
+  /// @brief Check if the deadline has passed
+  bool expired() const {
+    return deadline_ != Clock::time_point::max() && Clock::now() >= deadline_;
+  }
+  /// @brief Check if the plan should stop, either cancelled or expired
+  bool IsCancelled() const { return cancel_requested() || expired(); }
+
+ private:
+  /// Set by `Cancel`
+  std::atomic<bool> cancelled_;
+  /// The time after which the plan is cancelled
+  const Clock::time_point deadline_;
+};
+}
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <limits>
+
+#include "clearance_field.h"
+#include "grid_search.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// @brief Take the max of every window of `2 * radius + 1` steps of `lanes`
+/// sequences stored interleaved, with the van Herk/Gil-Werman algorithm.
+/// The steps are cut into blocks of the window size. Every window spans
+/// the end of one block and the start of the next, so it is the max of a
+/// suffix max and a prefix max.
+/// @param padded - The `length + 2 * radius` steps of the sequences, with
+/// `radius` steps of the lowest elevation on both ends. Overwritten.
+/// @param prefix - Scratch of the same size
+/// @param length - The number of steps of the unpadded sequences
+/// @param radius - The half width of the window
+/// @param lanes - The number of sequences
+/// @param out - Output. The lanes of each step, `out_stride` values apart
+/// @param out_stride - The distance between the steps of `out`
+void WindowMax(Elevation* padded, Elevation* prefix, size_t length,
+               size_t radius, size_t lanes, Elevation* out,
+               size_t out_stride) {
+  const size_t window = 2 * radius + 1;
+  const size_t steps = length + 2 * radius;
+  for (size_t j = 0; j < steps; j++) {
+    const Elevation* in = padded + j * lanes;
+    Elevation* run = prefix + j * lanes;
+    if (j % window == 0) {
+      std::copy(in, in + lanes, run);
+    } else {
+      const Elevation* previous = run - lanes;
+      for (size_t l = 0; l < lanes; l++) {
+        run[l] = std::max(previous[l], in[l]);
+      }
+    }
+  }
+  // The suffix maxima are taken in place, back to front
+  for (size_t j = steps - 1; j-- > 0;) {
+    if ((j + 1) % window != 0) {
+      Elevation* run = padded + j * lanes;
+      const Elevation* next = run + lanes;
+      for (size_t l = 0; l < lanes; l++) {
+        run[l] = std::max(run[l], next[l]);
+      }
+    }
+  }
+  for (size_t i = 0; i < length; i++) {
+    const Elevation* suffix = padded + i * lanes;
+    const Elevation* start = prefix + (i + 2 * radius) * lanes;
+    Elevation* result = out + i * out_stride;
+    for (size_t l = 0; l < lanes; l++) {
+      result[l] = std::max(suffix[l], start[l]);
+    }
+  }
+}
+
+}  // namespace
+
+ClearanceField::ClearanceField() : radius_(0) {
+}
+
+void ClearanceField::Clear() {
+  max_.Clear();
+  radius_ = 0;
+}
+
+bool ClearanceField::Build(const ElevationMap& emap, int radius,
+                           ThreadPool* pool) {
+  Clear();
+  if (radius < 0 || emap.size() == 0) {
+    std::cerr << "ClearanceField::Build: ERROR! The map is empty or the "
+                 "radius is negative" << std::endl;
+    return false;
+  }
+  const int rows = emap.rows();
+  const int cols = emap.cols();
+  const size_t stride = size_t(cols);
+
+  // The terrain the search sees, with the markers replaced
+  std::vector<Elevation> terrain(emap.size());
+  if (emap.data() != nullptr) {
+    std::copy(emap.data(), emap.data() + emap.size(), terrain.begin());
+  } else {
+    for (int row = 0; row < rows; row++) {
+      for (int col = 0; col < cols; col++) {
+        terrain[emap.Index(row, col)] = emap.At(row, col);
+      }
+    }
+  }
+  for (const Marker& marker : kMarkers) {
+    for (const auto& loc : emap.GetLocations(marker.symbol)) {
+      terrain[emap.Index(loc.first, loc.second)] =
+          Elevation(TerrainElevation(emap, loc.first, loc.second));
+    }
+  }
+
+  scratch_.resize(size_t(pool ? pool->size() : 1));
+  auto run = [pool](size_t count,
+                    const std::function<void(size_t, int)>& fn) {
+    if (pool) {
+      pool->ParallelFor(count, fn);
+    } else {
+      for (size_t i = 0; i < count; i++) {
+        fn(i, 0);
+      }
+    }
+  };
+  const Elevation lowest = std::numeric_limits<Elevation>::min();
+
+  // Along the rows. A radius past the end of a row covers all of it.
+  std::vector<Elevation> row_max(emap.size());
+  const size_t row_radius = std::min(size_t(radius), stride - 1);
+  run(size_t((rows + kBandSize - 1) / kBandSize), [&](size_t band,
+                                                     int worker) {
+    std::vector<Elevation>& scratch = scratch_[size_t(worker)];
+    const size_t steps = stride + 2 * row_radius;
+    scratch.resize(2 * steps);
+    Elevation* padded = scratch.data();
+    const int row_end = std::min(rows, int(band + 1) * kBandSize);
+    for (int row = int(band) * kBandSize; row < row_end; row++) {
+      const Elevation* in = terrain.data() + size_t(row) * stride;
+      std::fill(padded, padded + row_radius, lowest);
+      std::copy(in, in + stride, padded + row_radius);
+      std::fill(padded + row_radius + stride, padded + steps, lowest);
+      WindowMax(padded, padded + steps, stride, row_radius, 1,
+                row_max.data() + size_t(row) * stride, 1);
+    }
+  });
+
+  // Along the columns, a band of columns at a time so each row is read in
+  // one contiguous run. The terrain is no longer needed and takes the result.
+  const size_t col_radius = std::min(size_t(radius), size_t(rows) - 1);
+  run(size_t((cols + kBandSize - 1) / kBandSize), [&](size_t band,
+                                                     int worker) {
+    std::vector<Elevation>& scratch = scratch_[size_t(worker)];
+    const size_t col = band * size_t(kBandSize);
+    const size_t lanes = std::min(size_t(kBandSize), stride - col);
+    const size_t steps = size_t(rows) + 2 * col_radius;
+    scratch.resize(2 * steps * lanes);
+    Elevation* padded = scratch.data();
+    std::fill(padded, padded + col_radius * lanes, lowest);
+    for (int row = 0; row < rows; row++) {
+      const Elevation* in = row_max.data() + size_t(row) * stride + col;
+      std::copy(in, in + lanes,
+                padded + (size_t(row) + col_radius) * lanes);
+    }
+    std::fill(padded + (size_t(rows) + col_radius) * lanes,
+              padded + steps * lanes, lowest);
+    WindowMax(padded, padded + steps * lanes, size_t(rows), col_radius,
+              lanes, terrain.data() + col, stride);
+  });
+
+  max_.Assign(rows, cols, std::move(terrain));
+  radius_ = radius;
+  return true;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "elevation_map.h"
+#include "thread_pool.h"
+
+namespace path_planning {
+
+/// @class The highest terrain within a radius of every cell of a map, so
+/// lateral clearance can be checked in constant time during search and
+/// clipping instead of scanning the neighborhood of each cell.
+///
+/// The neighborhood is the square of cells within `radius` rows and columns,
+/// which contains the disk of that radius, so the field never underestimates
+/// the terrain within the radius. Cells a location marker was placed at
+/// count as the terrain the search gives them, see `TerrainElevation`.
+///
+/// The field is built with the van Herk/Gil-Werman running max, one pass
+/// along the rows and one along the columns, each taking three comparisons
+/// per cell whatever the radius. Bands of rows, then of columns, are spread
+/// over a `ThreadPool`. The field takes the same memory as the map, plus as
+/// much again while it is built.
+class ClearanceField {
+ public:
+  /// @brief Constructor
+  ClearanceField();
+  /// @brief Build the field for a map
+  /// @param emap - The map
+  /// @param radius - The half width of the square around each cell, 0 for
+  /// the cell alone
+  /// @param pool - Optional. The threads to build on
+  /// @return false if the map is empty or the radius is negative
+  bool Build(const ElevationMap& emap, int radius,
+             ThreadPool* pool = nullptr);
+  /// @brief Empty the field
+  void Clear();
+  /// @brief Get the radius the field was built with
+  int radius() const { return radius_; }
+  /// @brief Get the number of rows of the field, the same as its map
+  int rows() const { return max_.rows(); }
+  /// @brief Get the number of columns of the field, the same as its map
+  int cols() const { return max_.cols(); }
+  /// @brief Get the field as a map of the highest terrain around each cell
+  const ElevationMap& max_elevation() const { return max_; }
+  /// @brief Get the highest terrain within the radius of a cell, without
+  /// bounds checking
+  /// @param row - The row index into the map
+  /// @param col - The column index into the map
+  Elevation MaxElevation(int row, int col) const { return max_.At(row, col); }
+  /// @brief Check if flying over a cell at an altitude keeps a clearance
+  /// over all the terrain within the radius, without bounds checking
+  /// @param row - The row index into the map
+  /// @param col - The column index into the map
+  /// @param altitude - The altitude flown over the cell
+  /// @param min_clearance - The height to keep above the terrain
+  /// @return true if the altitude clears the terrain
+  bool IsSafe(int row, int col, int altitude, int min_clearance = 0) const {
+    return int64_t(altitude) >=
+           int64_t(MaxElevation(row, col)) + min_clearance;
+  }
+
+ private:
+  /// The number of rows, or columns, handed to a thread at a time
+  static const int kBandSize = 32;
+
+  /// The highest terrain around each cell
+  ElevationMap max_;
+  /// The half width of the square around each cell
+  int radius_;
+  /// Running max scratch for each thread
+  std::vector<std::vector<Elevation>> scratch_;
+};
+}
@@ -1,109 +1,604 @@
-#include <iostream> 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
-#include <sstream>
+#include <iostream> 
+#include <limits>
+#include <stdexcept>
+#include <string>
 
+#include "binary_map_format.h"
 #include "elevation_map.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+#include "tile_cache.h"
 
 using namespace path_planning;
 
-ElevationMap::ElevationMap() {
+namespace {
+
+/// Largest magnitude accepted while accumulating digits, well past any
+/// Elevation but far from overflowing the accumulator
+const int64_t kMaxParsedMagnitude = int64_t(1) << 40;
+
+/// @brief Fill in a parse error, working out the line and column from the
+/// byte offset. Only called on failure so the parse loop never has to track
+/// line numbers.
+/// @return Always false so callers can `return Fail(...)`
+bool Fail(const char* text, const char* where, const std::string& message,
+          MapReadError* error) {
+  if (error) {
+    error->offset = size_t(where - text);
+    error->line = 1;
+    const char* line_start = text;
+    for (const char* p = text; p < where; p++) {
+      if (*p == '\n') {
+        error->line++;
+        line_start = p + 1;
+      }
+    }
+    error->column = int(where - line_start) + 1;
+    error->message = message;
+  }
+  return false;
+}
+
+/// Source of `ElevationMap::id_`
+std::atomic<uint64_t> g_next_map_id(1);
+
+}  // namespace
+
+ElevationMap::ElevationMap()
+    : cells_(nullptr),
+      size_(0),
+      rows_(0),
+      cols_(0),
+      id_(g_next_map_id.fetch_add(1)),
+      version_(0),
+      track_changes_(false),
+      changes_begin_(0) {
+}
+
+ElevationMap::ElevationMap(const ElevationMap& other)
+    : owned_(other.owned_),
+      mapping_(other.mapping_),
+      tiles_(other.tiles_),
+      cells_(other.cells_),
+      size_(other.size_),
+      rows_(other.rows_),
+      cols_(other.cols_),
+      special_locations_(other.special_locations_),
+      id_(other.id_),
+      version_(other.version_),
+      track_changes_(false),
+      changes_begin_(other.version_) {
+}
+
+ElevationMap::ElevationMap(ElevationMap&& other)
+    : owned_(std::move(other.owned_)),
+      mapping_(std::move(other.mapping_)),
+      tiles_(std::move(other.tiles_)),
+      cells_(other.cells_),
+      size_(other.size_),
+      rows_(other.rows_),
+      cols_(other.cols_),
+      special_locations_(std::move(other.special_locations_)),
+      id_(other.id_),
+      version_(other.version_),
+      track_changes_(other.track_changes_),
+      changes_begin_(other.changes_begin_),
+      changes_(std::move(other.changes_)) {
+  other.Clear();
 }
 
 ElevationMap::~ElevationMap() {
 }
 
-bool ElevationMap::ReadMap(const std::string& map_filename) {
+ElevationMap& ElevationMap::operator=(const ElevationMap& other) {
+  if (this != &other) {
+    owned_ = other.owned_;
+    mapping_ = other.mapping_;
+    tiles_ = other.tiles_;
+    cells_ = other.cells_;
+    size_ = other.size_;
+    rows_ = other.rows_;
+    cols_ = other.cols_;
+    special_locations_ = other.special_locations_;
+    // The version goes on from this map's own, so the pair can not match
+    // the other map's
+    id_ = g_next_map_id.fetch_add(1);
+    ForgetChanges();
+  }
+  return *this;
+}
+
+ElevationMap& ElevationMap::operator=(ElevationMap&& other) {
+  if (this != &other) {
+    owned_ = std::move(other.owned_);
+    mapping_ = std::move(other.mapping_);
+    tiles_ = std::move(other.tiles_);
+    cells_ = other.cells_;
+    size_ = other.size_;
+    rows_ = other.rows_;
+    cols_ = other.cols_;
+    special_locations_ = std::move(other.special_locations_);
+    id_ = g_next_map_id.fetch_add(1);
+    ForgetChanges();
+    other.Clear();
+  }
+  return *this;
+}
+
+void ElevationMap::Clear() {
+  owned_.reset();
+  mapping_.reset();
+  tiles_.reset();
+  cells_ = nullptr;
+  size_ = 0;
+  rows_ = 0;
+  cols_ = 0;
+  special_locations_.reset();
+  id_ = g_next_map_id.fetch_add(1);
+  ForgetChanges();
+}
+
+void ElevationMap::SetChangeTracking(bool enabled) {
+  track_changes_ = enabled;
+  changes_.clear();
+  changes_begin_ = version_;
+}
+
+bool ElevationMap::ChangesSince(
+    uint64_t version, std::vector<std::pair<int, int>>* cells) const {
+  if (version < changes_begin_ || version > version_) {
+    return false;
+  }
+  cells->assign(changes_.begin() + ptrdiff_t(version - changes_begin_),
+                changes_.end());
+  return true;
+}
+
+void ElevationMap::ClearChanges() {
+  changes_.clear();
+  changes_begin_ = version_;
+}
+
+void ElevationMap::UseOwnedCells(
+    std::shared_ptr<std::vector<Elevation>> cells) {
+  owned_ = std::move(cells);
+  mapping_.reset();
+  tiles_.reset();
+  cells_ = owned_->data();
+  size_ = owned_->size();
+}
+
+void ElevationMap::Detach() {
+  // The copies that shared the cells keep the id, and with it the versions
+  // this map reaches from here on
+  id_ = g_next_map_id.fetch_add(1);
+  if (cells_ != nullptr) {
+    UseOwnedCells(
+        std::make_shared<std::vector<Elevation>>(cells_, cells_ + size_));
+    return;
+  }
+  // A tiled map has to be read in full to be written
+  auto cells = std::make_shared<std::vector<Elevation>>(size_);
+  for (int row = 0; row < rows_; row++) {
+    for (int col = 0; col < cols_; col++) {
+      (*cells)[Index(row, col)] = TiledAt(row, col);
+    }
+  }
+  UseOwnedCells(std::move(cells));
+}
+
+Elevation ElevationMap::TiledAt(int row, int col) const {
+  return tiles_->Get(row, col);
+}
+
+bool ElevationMap::ReadMap(const std::string& map_filename,
+                           MapReadError* error) {
+  PP_SCOPED_TIMER(Stage::kMapLoad);
   Clear();
-  std::ifstream in_file(map_filename);
+  MappedFile file;
   // Try to open the file or fail out
-  if (!in_file.is_open()) {
+  if (!file.Open(map_filename)) {
     std::cerr << "ElevationMap::ReadMap(): ERROR! Unable to read map file: "
               << map_filename << std::endl;
+    if (error) {
+      *error = MapReadError();
+      error->message = "Unable to open file";
+    }
+    return false;
+  }
+  file.AdviseSequential();
+
+  MapReadError local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  if (!ParseMap(file.data(), file.size(), error)) {
+    std::cerr << "ElevationMap::ReadMap: " << map_filename << ":"
+              << error->line << ":" << error->column << ": "
+              << error->message << std::endl;
     return false;
   }
+  return true;
+}
 
-  std::string row;
-  std::string token;
-  // For each row in the map bookended by []
-  while (std::getline(in_file, row, ']')) {
-    // Check for an empty row at the end of the file, or just a comma
-    if(row.size() <= 1) {
+bool ElevationMap::ParseMap(const char* text, size_t size,
+                            MapReadError* error) {
+  Clear();
+  auto cells = std::make_shared<std::vector<Elevation>>();
+  std::vector<MarkedLocation> locations;
+  const char* p = text;
+  const char* end = text + size;
+  // How many brackets are open, cells are only valid inside a row
+  int depth = 0;
+  // Where the row that is currently being parsed starts in `cells`
+  size_t row_start = 0;
+
+  auto fail = [&](const char* where, const std::string& message) {
+    Clear();
+    return Fail(text, where, message, error);
+  };
+
+  while (p < end) {
+    const char c = *p;
+    // Digits and signs are by far the most common characters, so check them
+    // first with a single unsigned compare
+    if (unsigned(c - '0') < 10u || c == '-' || c == '+') {
+      const char* token = p;
+      bool negative = c == '-';
+      if (c == '-' || c == '+') {
+        p++;
+      }
+      int64_t value = 0;
+      const char* digits = p;
+      unsigned digit;
+      while (p < end && (digit = unsigned(*p - '0')) < 10u) {
+        value = value * 10 + digit;
+        if (value > kMaxParsedMagnitude) {
+          return fail(token, "Elevation does not fit in the elevation type");
+        }
+        p++;
+      }
+      if (p == digits) {
+        return fail(token, "Expected digits after sign");
+      }
+      if (negative) {
+        value = -value;
+      }
+      if (value < std::numeric_limits<Elevation>::min() ||
+          value > std::numeric_limits<Elevation>::max()) {
+        return fail(token, "Elevation does not fit in the elevation type");
+      }
+      if (depth == 0) {
+        return fail(token, "Elevation outside of a [] row");
+      }
+      cells->push_back(Elevation(value));
       continue;
     }
-    map_.emplace_back(std::vector<int>());
-    // Go through the row and tokenize elements by commas
-    std::istringstream rowss(row);
-    while (std::getline(rowss, token, ',')) {
-      // Strip off the opening brackets if there are any
-      token.erase(std::remove(token.begin(), token.end(), ' '), token.end());
-      token.erase(std::remove(token.begin(), token.end(), ','), token.end());
-      token.erase(std::remove(token.begin(), token.end(), '\r'), token.end());
-      token.erase(std::remove(token.begin(), token.end(), '\n'), token.end());
-      token.erase(std::remove(token.begin(), token.end(), '['), token.end());
-      if (token.size() == 0) {
-        continue;
+
+    switch (c) {
+      case ',':
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        p++;
+        break;
+      case '[':
+        depth++;
+        p++;
+        break;
+      case ']': {
+        if (depth == 0) {
+          return fail(p, "Unmatched ]");
+        }
+        depth--;
+        int row_size = int(cells->size() - row_start);
+        // The closing bracket of the outer list, or an empty row
+        if (row_size > 0) {
+          if (rows_ == 0) {
+            cols_ = row_size;
+            // Now that a whole row has been seen, guess the total number of
+            // rows from the bytes it took and size the grid up front
+            size_t row_bytes = size_t(p - text) + 1;
+            size_t expected_rows = size / row_bytes + 1;
+            cells->reserve(expected_rows * size_t(cols_));
+          } else if (row_size != cols_) {
+            return fail(p, "Inconsistent row size " + std::to_string(cols_) +
+                               " vs. " + std::to_string(row_size));
+          }
+          rows_++;
+          row_start = cells->size();
+        }
+        p++;
+        break;
       }
-      try {
-        // If we can parse it as an int, then put it in the map, otherwise its a 
-        // special location or a bad character
-        map_.back().emplace_back(std::stoi(token));
-      } catch(const std::invalid_argument& ia) {
-        // A () marks a special location in the map, first make sure its big 
-        // enough to hold a location without segfaulting
-        if(token.size() >= 3 && token[0] == '(') {
-          auto key_loc = kSpecialLocations.find(token[1]);
-          // Make sure we know about this location
-          if(key_loc != kSpecialLocations.end()) {
-            map_.back().emplace_back(key_loc->second);
-            // Store the special locations for convenience
-            special_locations_[key_loc->first].emplace_back(std::make_pair(
-                int(map_.size()) - 1, int(map_.back().size()) - 1));
-          }  else {
-            std::cerr << "ElevationMap::ReadMap: Unable to parse location "
-                      << token << std::endl;
-            Clear();
-            return false;
+      case '(': {
+        // A () marks a special location in the map
+        if (end - p < 3 || p[2] != ')') {
+          return fail(p, "Malformed location marker");
+        }
+        const int marker = MarkerValue(p[1]);
+        // Make sure we know about this location
+        if (marker == 0) {
+          return fail(p, std::string("Unknown location marker ") + p[1]);
+        }
+        if (depth == 0) {
+          return fail(p, "Location outside of a [] row");
+        }
+        cells->push_back(Elevation(marker));
+        // Store the special locations for convenience
+        locations.push_back(MarkedLocation{
+            p[1], rows_, int(cells->size() - row_start) - 1});
+        p += 3;
+        break;
+      }
+      default:
+        return fail(p, std::string("Unexpected character '") + c + "'");
+    }
+  }
+
+  if (cells->size() != row_start) {
+    return fail(end, "Row is missing its closing ]");
+  }
+  if (depth != 0) {
+    return fail(end, "Missing closing ]");
+  }
+  if (rows_ == 0) {
+    return fail(end, "No map data");
+  }
+  // Only give back the slack if the row estimate was badly off, shrinking
+  // copies the whole grid
+  if (cells->capacity() - cells->size() > cells->size() / 8) {
+    cells->shrink_to_fit();
+  }
+  UseOwnedCells(std::move(cells));
+  special_locations_ = std::make_shared<LocationIndex>(locations);
+  return true;
+}
+
+bool ElevationMap::Assign(int rows, int cols, std::vector<Elevation> cells) {
+  if (rows <= 0 || cols <= 0 ||
+      cells.size() != size_t(rows) * size_t(cols)) {
+    std::cerr << "ElevationMap::Assign: ERROR! The cells do not match the "
+              << rows << " x " << cols << " map" << std::endl;
+    return false;
+  }
+  Clear();
+  rows_ = rows;
+  cols_ = cols;
+  UseOwnedCells(std::make_shared<std::vector<Elevation>>(std::move(cells)));
+  return true;
+}
+
+bool ElevationMap::Assign(int rows, int cols, std::vector<Elevation> cells,
+                          const std::vector<MarkedLocation>& locations) {
+  if (!Assign(rows, cols, std::move(cells))) {
+    return false;
+  }
+  special_locations_ = std::make_shared<LocationIndex>(locations);
+  return true;
+}
+
+bool ElevationMap::WriteBinaryMap(const std::string& map_filename,
+                                  int tile_size) const {
+  namespace bmf = binary_map;
+  if (tile_size < 0) {
+    std::cerr << "ElevationMap::WriteBinaryMap: ERROR! The tile size must "
+              << "not be negative" << std::endl;
+    return false;
+  }
+  std::vector<bmf::BinaryMapLocation> locations;
+  for (int c = 0; c < 256; c++) {
+    for (const auto& loc : GetLocations(char(c))) {
+      locations.push_back(
+          bmf::BinaryMapLocation{char(c), loc.first, loc.second, 0});
+    }
+  }
+
+  const bmf::BinaryMapHeader header =
+      bmf::MakeHeader(rows_, cols_, uint32_t(tile_size),
+                      uint32_t(locations.size()));
+  const uint64_t locations_end =
+      header.locations_offset +
+      locations.size() * sizeof(bmf::BinaryMapLocation);
+
+  std::ofstream out_file(map_filename, std::ios::binary | std::ios::trunc);
+  if (!out_file.is_open()) {
+    std::cerr << "ElevationMap::WriteBinaryMap: ERROR! Unable to open map "
+              << "file for writing: " << map_filename << std::endl;
+    return false;
+  }
+  out_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!locations.empty()) {
+    out_file.write(reinterpret_cast<const char*>(locations.data()),
+                   locations.size() * sizeof(bmf::BinaryMapLocation));
+  }
+  std::vector<char> padding(size_t(header.data_offset - locations_end), 0);
+  out_file.write(padding.data(), padding.size());
+  if (tile_size == 0 && cells_ != nullptr) {
+    out_file.write(reinterpret_cast<const char*>(cells_),
+                   size_ * sizeof(Elevation));
+  } else if (tile_size == 0) {
+    std::vector<Elevation> row_cells(static_cast<size_t>(cols_));
+    for (int row = 0; row < rows_ && out_file; row++) {
+      for (int col = 0; col < cols_; col++) {
+        row_cells[size_t(col)] = At(row, col);
+      }
+      out_file.write(reinterpret_cast<const char*>(row_cells.data()),
+                     row_cells.size() * sizeof(Elevation));
+    }
+  } else {
+    // Tiles are written in row-major tile order, each one row-major and
+    // padded with zeros past the edge of the map so every tile is the same
+    // size and can be found by index
+    std::vector<Elevation> tile(size_t(tile_size) * size_t(tile_size));
+    for (int tile_row = 0; tile_row < rows_ && out_file;
+         tile_row += tile_size) {
+      for (int tile_col = 0; tile_col < cols_; tile_col += tile_size) {
+        std::fill(tile.begin(), tile.end(), Elevation(0));
+        const int row_end = std::min(rows_, tile_row + tile_size);
+        const int col_end = std::min(cols_, tile_col + tile_size);
+        for (int row = tile_row; row < row_end; row++) {
+          for (int col = tile_col; col < col_end; col++) {
+            tile[size_t(row - tile_row) * size_t(tile_size) +
+                 size_t(col - tile_col)] = At(row, col);
           }
-        } else {
-            std::cerr << "ElevationMap::ReadMap: Unable to parse token "
-                      << token << std::endl;
-            Clear();
-            return false;
         }
+        out_file.write(reinterpret_cast<const char*>(tile.data()),
+                       tile.size() * sizeof(Elevation));
       }
     }
   }
+  if (!out_file) {
+    std::cerr << "ElevationMap::WriteBinaryMap: ERROR! Unable to write map "
+              << "file: " << map_filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool ElevationMap::OpenBinaryMap(const std::string& map_filename,
+                                 size_t tile_cache_bytes) {
+  PP_SCOPED_TIMER(Stage::kMapLoad);
+  namespace bmf = binary_map;
+  Clear();
+  auto file = std::make_shared<MappedFile>();
+  if (!file->Open(map_filename, MappedFile::Mode::kCopyOnWrite)) {
+    std::cerr << "ElevationMap::OpenBinaryMap: ERROR! Unable to open map "
+              << "file: " << map_filename << std::endl;
+    return false;
+  }
+  auto fail = [&map_filename](const char* reason) {
+    std::cerr << "ElevationMap::OpenBinaryMap: ERROR! " << map_filename
+              << ": " << reason << std::endl;
+    return false;
+  };
 
-  // Validate that all rows are the same size
-  size_t row_size = map_.begin()->size();
-  for(const auto& row : map_) {
-    if(row.size() != row_size) {
+  bmf::BinaryMapHeader header;
+  if (file->size() < sizeof(header)) {
+    return fail("File is too small to be a binary map");
+  }
+  std::memcpy(&header, file->data(), sizeof(header));
+  if (std::memcmp(header.magic, bmf::kMagic, sizeof(header.magic)) != 0) {
+    return fail("Not a binary map file");
+  }
+  if (header.byte_order_mark != bmf::kByteOrderMark) {
+    return fail("Map was written on a machine with a different byte order");
+  }
+  if (header.version != bmf::kVersion) {
+    return fail("Unsupported format version");
+  }
+  if (header.elevation_type != bmf::kInt16 &&
+      header.elevation_type != bmf::kInt32) {
+    return fail("Unknown elevation type");
+  }
+  if (header.rows <= 0 || header.cols <= 0 ||
+      header.rows > std::numeric_limits<int>::max() ||
+      header.cols > std::numeric_limits<int>::max()) {
+    return fail("Invalid map dimensions");
+  }
+  uint64_t cell_count = uint64_t(header.rows) * uint64_t(header.cols);
+  uint64_t stored_cells = cell_count;
+  if (header.tile_size != 0) {
+    const uint64_t tile_rows =
+        (uint64_t(header.rows) + header.tile_size - 1) / header.tile_size;
+    const uint64_t tile_cols =
+        (uint64_t(header.cols) + header.tile_size - 1) / header.tile_size;
+    stored_cells = tile_rows * tile_cols * uint64_t(header.tile_size) *
+                   uint64_t(header.tile_size);
+  }
+  uint64_t cell_bytes =
+      stored_cells * bmf::ElevationTypeSize(header.elevation_type);
+  uint64_t locations_bytes =
+      uint64_t(header.num_locations) * sizeof(bmf::BinaryMapLocation);
+  if (header.data_offset % bmf::kDataAlignment != 0 ||
+      header.data_offset + cell_bytes > file->size() ||
+      header.locations_offset + locations_bytes > header.data_offset) {
+    return fail("File is truncated or its offsets are corrupt");
+  }
+
+  std::vector<MarkedLocation> locations(header.num_locations);
+  for (uint32_t i = 0; i < header.num_locations; i++) {
+    bmf::BinaryMapLocation loc;
+    std::memcpy(&loc,
+                file->data() + header.locations_offset +
+                    i * sizeof(bmf::BinaryMapLocation),
+                sizeof(loc));
+    if (loc.row < 0 || loc.row >= header.rows || loc.col < 0 ||
+        loc.col >= header.cols) {
+      return fail("Special location is outside of the map");
+    }
+    locations[i] = MarkedLocation{char(loc.marker), int(loc.row),
+                                  int(loc.col)};
+  }
+  special_locations_ = std::make_shared<LocationIndex>(locations);
+
+  rows_ = int(header.rows);
+  cols_ = int(header.cols);
+  if (header.tile_size != 0) {
+    // Tiles are read through the cache on demand, the mapping was only
+    // needed for the header and locations
+    auto tiles = std::make_shared<TileCache>();
+    if (!tiles->Open(map_filename, rows_, cols_, int(header.tile_size),
+                     header.elevation_type, header.data_offset,
+                     tile_cache_bytes)) {
       Clear();
-      std::cerr << "ElevationMap::ReadMap: Inconsistent row size "
-                << row_size << " vs. " << row.size() << std::endl;
       return false;
     }
+    tiles_ = std::move(tiles);
+    size_ = size_t(cell_count);
+    return true;
+  }
+  if (header.elevation_type == bmf::NativeElevationType()) {
+    // Serve the cells directly from the mapping
+    cells_ = reinterpret_cast<Elevation*>(file->mutable_data() +
+                                          header.data_offset);
+    size_ = size_t(cell_count);
+    mapping_ = file;
+    return true;
   }
 
+  // The file was written by a build with a different elevation type, so
+  // convert the cells into owned memory
+  auto cells = std::make_shared<std::vector<Elevation>>(size_t(cell_count));
+  const char* cell_data = file->data() + header.data_offset;
+  for (size_t i = 0; i < cells->size(); i++) {
+    int64_t value;
+    if (header.elevation_type == bmf::kInt16) {
+      int16_t cell;
+      std::memcpy(&cell, cell_data + i * sizeof(cell), sizeof(cell));
+      value = cell;
+    } else {
+      int32_t cell;
+      std::memcpy(&cell, cell_data + i * sizeof(cell), sizeof(cell));
+      value = cell;
+    }
+    if (value < std::numeric_limits<Elevation>::min() ||
+        value > std::numeric_limits<Elevation>::max()) {
+      Clear();
+      return fail("Elevation does not fit in the elevation type");
+    }
+    (*cells)[i] = Elevation(value);
+  }
+  UseOwnedCells(std::move(cells));
   return true;
 }
 
-std::vector<std::pair<int, int>> ElevationMap::GetLocations(char c) {
-  auto it = special_locations_.find(c);
-  if(it != special_locations_.end()) {
-    return it->second;
+ElevationMap::CellReference ElevationMap::operator()(int row, int col) {
+  if (row < 0 || row >= rows_ || col < 0 || col >= cols_) {
+    throw std::out_of_range("ElevationMap: cell is outside of the map");
   }
-  return std::vector<std::pair<int, int>>();
+  return CellReference(this, Index(row, col));
 }
 
-int& ElevationMap::operator()(int row, int col) {
-  // This function is supposed to throw, but just let the natural vector 
-  // throw handle it
-  return map_.at(row).at(col);
-}
-
-int ElevationMap::operator()(int row, int col) const {
-  // This function is supposed to throw, but just let the natural vector 
-  // throw handle it
-  return map_.at(row).at(col);
+Elevation ElevationMap::operator()(int row, int col) const {
+  if (row < 0 || row >= rows_ || col < 0 || col >= cols_) {
+    throw std::out_of_range("ElevationMap: cell is outside of the map");
+  }
+  return At(row, col);
 }
\ No newline at end of file
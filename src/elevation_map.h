@@ -1,61 +1,356 @@
 #pragma once
 
-#include <map>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include "span.h"
+#include "special_locations.h"
+
 namespace path_planning {
 
-/// The default starting position for a map
-static const char kStartPos = 'A';
-/// The default end position for a map
-static const char kEndPos = 'B';
-/// A map of special character in the map to indicate their semantic meaning
-/// and assign an integer value to them.
-static const std::map<char, int> kSpecialLocations{
-    {kStartPos, -1},  // Start location
-    {kEndPos, -2}   // End location
+class MappedFile;
+class TileCache;
+
+#ifdef DRONE_PATH_PLANNING_INT16_ELEVATION
+/// The storage type of a single map cell. Selected at compile time with the
+/// `DRONE_PATH_PLANNING_INT16_ELEVATION` option to halve the map footprint.
+using Elevation = int16_t;
+#else
+/// The storage type of a single map cell
+using Elevation = int;
+#endif
+
+/// The default memory budget for the tiles of a tiled map
+static const size_t kDefaultTileCacheBytes = size_t(256) << 20;
+
+/// @struct Description of why a map failed to parse
+struct MapReadError {
+  /// The byte offset into the map text where parsing failed
+  size_t offset = 0;
+  /// The 1-based line of `offset`
+  int line = 0;
+  /// The 1-based column of `offset`
+  int column = 0;
+  /// A human readable description of the failure
+  std::string message;
 };
 
 /// @class Data structure for reading and querying map data
 class ElevationMap {
  public:
+  /// @class Reference to a single cell returned by the mutable `operator()`.
+  /// Reading through it never unshares the map's cells, only assigning does.
+  class CellReference {
+   public:
+    /// @brief Read the cell
+    operator Elevation() const {
+      return map_->cells_ != nullptr
+                 ? map_->cells_[index_]
+                 : map_->TiledAt(int(index_ / size_t(map_->cols_)),
+                                 int(index_ % size_t(map_->cols_)));
+    }
+    /// @brief Write the cell, unsharing the map's cells first
+    CellReference& operator=(Elevation value) {
+      map_->MakeUnique();
+      map_->cells_[index_] = value;
+      map_->RecordChange(index_);
+      return *this;
+    }
+    /// @brief Write the value of another cell into this one
+    CellReference& operator=(const CellReference& other) {
+      return *this = Elevation(other);
+    }
+    /// @brief Add to the cell
+    CellReference& operator+=(int value) {
+      return *this = Elevation(Elevation(*this) + value);
+    }
+    /// @brief Subtract from the cell
+    CellReference& operator-=(int value) {
+      return *this = Elevation(Elevation(*this) - value);
+    }
+
+   private:
+    friend class ElevationMap;
+    /// @brief Constructor
+    CellReference(ElevationMap* map, size_t index)
+        : map_(map), index_(index) {}
+
+    /// The map the cell belongs to
+    ElevationMap* map_;
+    /// The flat index of the cell
+    size_t index_;
+  };
+
   /// @brief Constructor
   ElevationMap();
+  /// @brief Copy constructor. Copies share the cells and location index in
+  /// constant time. The first write through a mutable accessor of a map
+  /// whose cells are shared gives it a private copy of the cells
+  /// (copy-on-write), so writes are never seen by other copies.
+  ElevationMap(const ElevationMap& other);
+  /// @brief Move constructor
+  ElevationMap(ElevationMap&& other);
   /// @brief Destructor
   ~ElevationMap();
-  /// @brief Read in a map from the given file
+  /// @brief Copy assignment, shares the cells like the copy constructor
+  ElevationMap& operator=(const ElevationMap& other);
+  /// @brief Move assignment
+  ElevationMap& operator=(ElevationMap&& other);
+  /// @brief Read in a map from the given file. The file is memory mapped and
+  /// parsed in place by `ParseMap`.
   /// @param map_filename - The file to read the map from
+  /// @param error - Optional. Filled in with the location and reason of a
+  /// failure
   /// @return true if the map was successfully read
-  bool ReadMap(const std::string& map_filename);
+  bool ReadMap(const std::string& map_filename, MapReadError* error = nullptr);
+  /// @brief Parse a map from the bracketed text format, e.g.
+  /// `[[123,(A),121],[122,121,(B)]]`, in a single pass over the text.
+  /// @param text - The start of the map text
+  /// @param size - The number of bytes of map text
+  /// @param error - Optional. Filled in with the location and reason of a
+  /// failure
+  /// @return true if the map was successfully parsed
+  bool ParseMap(const char* text, size_t size, MapReadError* error = nullptr);
+  /// @brief Replace the map with the given cells, e.g. a map computed from
+  /// another one. The map has no special locations.
+  /// @param rows - The number of rows
+  /// @param cols - The number of columns
+  /// @param cells - The `rows * cols` row-major cells
+  /// @return true if the cells match the dimensions
+  bool Assign(int rows, int cols, std::vector<Elevation> cells);
+  /// @brief Replace the map with the given cells and the special locations
+  /// marked in them, e.g. a map parsed by `ParseMapSharded`
+  /// @param rows - The number of rows
+  /// @param cols - The number of columns
+  /// @param cells - The `rows * cols` row-major cells
+  /// @param locations - The marker character, row and column of each
+  /// special location, in row-major order
+  /// @return true if the cells match the dimensions
+  bool Assign(int rows, int cols, std::vector<Elevation> cells,
+              const std::vector<MarkedLocation>& locations);
+  /// @brief Write the map in the binary `.emap` format described in
+  /// `binary_map_format.h`
+  /// @param map_filename - The file to write
+  /// @param tile_size - The edge length of the square tiles to store the
+  /// cells in, or 0 for row-major storage. Tiled files are opened through a
+  /// `TileCache` and can be larger than memory.
+  /// @return true if the map was successfully written
+  bool WriteBinaryMap(const std::string& map_filename,
+                      int tile_size = 0) const;
+  /// @brief Open a map written by `WriteBinaryMap`.
+  ///
+  /// A row-major file is memory mapped and cells are read straight from the
+  /// mapping, so opening is constant time and processes opening the same
+  /// file share its pages. Writes through `operator()` are private to this
+  /// map and never reach the file.
+  ///
+  /// A tiled file is served by a `TileCache` that reads tiles on first use
+  /// and keeps at most `tile_cache_bytes` of them in memory. `data()` and
+  /// `Row()` are empty for tiled maps, and the first write through a mutable
+  /// accessor reads the whole map into memory.
+  /// @param map_filename - The file to open
+  /// @param tile_cache_bytes - The memory budget for the tiles of a tiled map
+  /// @return true if the map was successfully opened
+  bool OpenBinaryMap(const std::string& map_filename,
+                     size_t tile_cache_bytes = kDefaultTileCacheBytes);
+  /// @brief Check if the cells are served from a memory mapped file
+  bool is_mapped() const { return mapping_ != nullptr; }
+  /// @brief Check if the cells are served from a tiled file on demand
+  bool is_tiled() const { return tiles_ != nullptr; }
+  /// @brief Get the cache serving a tiled map, shared by all copies of the
+  /// map. Null if the map is not tiled.
+  const std::shared_ptr<TileCache>& tile_cache() const { return tiles_; }
+  /// @brief Check if this map and another share the same cells
+  bool SharesCellsWith(const ElevationMap& other) const {
+    return size_ > 0 && cells_ == other.cells_ && tiles_ == other.tiles_;
+  }
   /// @brief Get an element in the current map
   /// @param row - The row index into the map
   /// @param col - The column index into the map
   /// @return The value at row, col. Throws `out_of_range` if row, col does
   /// not exist
-  int operator()(int row, int col) const;
-  /// @brief Get an element in the current map for mutating
+  Elevation operator()(int row, int col) const;
+  /// @brief Get an element in the current map for mutating. Assigning through
+  /// the returned reference unshares the cells from any copies first.
   /// @param row - The row index into the map
   /// @param col - The column index into the map
-  /// @return The value at row, col. Throws `out_of_range` if row, col does
-  /// not exist
-  int& operator()(int row, int col);
+  /// @return A reference to the value at row, col. Throws `out_of_range` if
+  /// row, col does not exist
+  CellReference operator()(int row, int col);
+  /// @brief Get an element without bounds checking. For hot loops that have
+  /// already validated their coordinates.
+  /// @param row - The row index into the map
+  /// @param col - The column index into the map
+  /// @return The value at row, col
+  Elevation At(int row, int col) const {
+    return cells_ != nullptr ? cells_[Index(row, col)] : TiledAt(row, col);
+  }
+  /// @brief Get an element for mutating without bounds checking. Like all
+  /// the mutable views this unshares the cells up front, and the reference is
+  /// only valid until the map is next copied.
+  /// @param row - The row index into the map
+  /// @param col - The column index into the map
+  /// @return The value at row, col
+  Elevation& At(int row, int col) {
+    MakeUnique();
+    ForgetChanges();
+    return cells_[Index(row, col)];
+  }
+  /// @brief Get the flat row-major index of a cell
+  /// @param row - The row index into the map
+  /// @param col - The column index into the map
+  /// @return The offset of row, col from the start of `data()`
+  size_t Index(int row, int col) const {
+    return size_t(row) * size_t(cols_) + size_t(col);
+  }
+  /// @brief Get a view of a single row of the map. The row is not bounds
+  /// checked.
+  /// @param row - The row index into the map
+  /// @return A span over the `cols()` elements of the row, empty for a tiled
+  /// map
+  Span<const Elevation> Row(int row) const {
+    if (cells_ == nullptr) {
+      return Span<const Elevation>();
+    }
+    return Span<const Elevation>(cells_ + Index(row, 0), size_t(cols_));
+  }
+  /// @brief Get a mutable view of a single row of the map. The row is not
+  /// bounds checked.
+  /// @param row - The row index into the map
+  /// @return A span over the `cols()` elements of the row
+  Span<Elevation> Row(int row) {
+    MakeUnique();
+    ForgetChanges();
+    return Span<Elevation>(cells_ + Index(row, 0), size_t(cols_));
+  }
+  /// @brief Get the contiguous row-major cell data, null for a tiled map
+  const Elevation* data() const { return cells_; }
+  /// @brief Get the contiguous row-major cell data for mutating
+  Elevation* data() {
+    MakeUnique();
+    ForgetChanges();
+    return cells_;
+  }
+  /// @brief Get the total number of cells in the map
+  size_t size() const { return size_; }
   /// @brief Get the total number of rows in the map
   /// @return The total number of rows
-  const int rows() const { return int(map_.size()); }
+  const int rows() const { return rows_; }
   /// @brief Get the total number of columns in the map
   /// @return The total number of columns
-  const int cols() const { return rows() > 0 ? int(map_[0].size()) : 0;}
+  const int cols() const { return cols_; }
   /// @brief Clear all the map data and meta data
-  void Clear() {map_.clear(); special_locations_.clear();}
+  void Clear();
   /// @brief Get the special locations in the map for the specified character.
-  /// @param c - The character from kSpecialLocations that IDs the location
-  /// @return A vector of all locations that correspond with c
-  std::vector<std::pair<int, int>> GetLocations(char c);
+  /// Takes constant time and copies nothing.
+  /// @param c - The character from `kMarkers` that IDs the location
+  /// @return A view of all locations that correspond with c, in row-major
+  /// order. Valid until the map is loaded or assigned again, or destroyed,
+  /// unless a copy of the map still holds the index.
+  Span<const std::pair<int, int>> GetLocations(char c) const {
+    return special_locations_ ? special_locations_->Get(c)
+                              : Span<const std::pair<int, int>>();
+  }
+  /// @brief Check if a location marker was placed at a cell. Markers are
+  /// told apart by position, so a cell whose real elevation equals a
+  /// marker's value is still terrain.
+  /// @param row - The row of the cell
+  /// @param col - The column of the cell
+  bool IsMarked(int row, int col) const {
+    return special_locations_ && special_locations_->Contains(row, col);
+  }
+  /// @brief Get the version of the cells. Every write through `operator()`
+  /// adds one. Anything else that can change the cells, such as loading,
+  /// assigning or the mutable `At`, `Row` and `data` views, also adds one and
+  /// forgets the change journal.
+  uint64_t version() const { return version_; }
+  /// @brief Get the identity of the cells' lineage, unique in the process.
+  /// Copies share it until one of them is written, and loading, assigning
+  /// or clearing gives the map a new one. Two maps with the same `id()` and
+  /// `version()` hold the same cells, so the pair can key results computed
+  /// from a map, see `PathCache`.
+  uint64_t id() const { return id_; }
+  /// @brief Turn the journal of cells written through `operator()` on or
+  /// off, e.g. for `IncrementalPlanner` to find out what changed. Off by
+  /// default and for copies. Turning it on starts an empty journal.
+  void SetChangeTracking(bool enabled);
+  /// @brief Check if writes through `operator()` are journaled
+  bool change_tracking() const { return track_changes_; }
+  /// @brief Get the cells written since a version, oldest first. A cell
+  /// written several times is listed several times.
+  /// @param version - An earlier `version()`
+  /// @param cells - Output. The row and column of each write
+  /// @return false if the journal does not reach back to `version`, because
+  /// tracking was off or the whole map may have changed since
+  bool ChangesSince(uint64_t version,
+                    std::vector<std::pair<int, int>>* cells) const;
+  /// @brief Forget the journal up to the current version
+  void ClearChanges();
  private:
-  /// The map data structure for querying
-  std::vector<std::vector<int>> map_;
-  /// A map of all the special locations that were placed in the map
-  std::map<char, std::vector<std::pair<int, int>>> special_locations_;
+  /// @brief Take ownership of a buffer of cells and point `cells_` at it
+  void UseOwnedCells(std::shared_ptr<std::vector<Elevation>> cells);
+  /// @brief Give this map a private copy of its cells if they are shared
+  /// with another map or served from tiles
+  void MakeUnique() {
+    if ((owned_ && owned_.use_count() > 1) ||
+        (mapping_ && mapping_.use_count() > 1) || tiles_) {
+      Detach();
+    }
+  }
+  /// @brief Copy the cells into a new buffer owned only by this map
+  void Detach();
+  /// @brief Get an element of a tiled map through the tile cache
+  Elevation TiledAt(int row, int col) const;
+  /// @brief Count a write to a single cell, journaling it if tracked
+  void RecordChange(size_t index) {
+    version_++;
+    if (track_changes_) {
+      changes_.emplace_back(int(index / size_t(cols_)),
+                            int(index % size_t(cols_)));
+    } else {
+      changes_begin_ = version_;
+    }
+  }
+  /// @brief Count a change to any number of cells, which the journal can
+  /// not describe
+  void ForgetChanges() {
+    version_++;
+    changes_.clear();
+    changes_begin_ = version_;
+  }
+
+  /// The map data in a single contiguous row-major buffer, unless the map
+  /// is served from `mapping_`. Shared between copies until written.
+  std::shared_ptr<std::vector<Elevation>> owned_;
+  /// The file the cells are mapped from, if any. Shared between copies
+  /// until written.
+  std::shared_ptr<MappedFile> mapping_;
+  /// The tiles of a tiled map, if any. Shared between copies until written.
+  std::shared_ptr<TileCache> tiles_;
+  /// The row-major cells, either in `owned_` or inside `mapping_`. Null for
+  /// a tiled map.
+  Elevation* cells_;
+  /// The total number of cells
+  size_t size_;
+  /// The number of rows in the map
+  int rows_;
+  /// The number of columns in the map
+  int cols_;
+  /// The index of all the special locations that were placed in the map.
+  /// It never changes after loading so copies always share it.
+  std::shared_ptr<const LocationIndex> special_locations_;
+  /// The lineage of the cells, see `id()`
+  uint64_t id_;
+  /// Counts the changes to the cells, see `version()`
+  uint64_t version_;
+  /// Whether writes through `operator()` are journaled
+  bool track_changes_;
+  /// The version `changes_` starts after
+  uint64_t changes_begin_;
+  /// The cells written since `changes_begin_`, oldest first
+  std::vector<std::pair<int, int>> changes_;
 };
-}
\ No newline at end of file
+}
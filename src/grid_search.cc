@@ -0,0 +1,633 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "bidirectional_search.h"
+#include "clearance_field.h"
+#include "grid_search.h"
+#include "instrumentation.h"
+#include "search_policies.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// Marks a node that has been reached but is not on the open list yet
+const uint32_t kUnqueued = std::numeric_limits<uint32_t>::max() - 1;
+
+}  // namespace
+
+int64_t path_planning::TerrainElevation(const ElevationMap& emap, int row,
+                                        int col) {
+  if (!emap.IsMarked(row, col)) {
+    return emap.At(row, col);
+  }
+  int64_t lowest = std::numeric_limits<int64_t>::max();
+  for (int k = 0; k < 4; k++) {
+    const int next_row = row + kNeighborRows[k];
+    const int next_col = col + kNeighborCols[k];
+    if (next_row >= 0 && next_row < emap.rows() && next_col >= 0 &&
+        next_col < emap.cols() && !emap.IsMarked(next_row, next_col)) {
+      lowest = std::min(lowest, int64_t(emap.At(next_row, next_col)));
+    }
+  }
+  return lowest == std::numeric_limits<int64_t>::max() ? 0 : lowest;
+}
+
+GridSearch::GridSearch()
+    : window_row_begin_(0), window_rows_(0), uniform_width_(0),
+      generation_(0) {
+}
+
+GridSearch::GridSearch(const SearchOptions& options)
+    : options_(options),
+      window_row_begin_(0),
+      window_rows_(0),
+      uniform_width_(0),
+      generation_(0) {
+}
+
+GridSearch::~GridSearch() = default;
+
+GridSearch::GridSearch(GridSearch&& other) = default;
+
+GridSearch& GridSearch::operator=(GridSearch&& other) = default;
+
+bool GridSearch::FindPath(const ElevationMap& emap,
+                          const std::pair<int, int>& start,
+                          const std::pair<int, int>& goal, int agl,
+                          std::vector<std::pair<int, int>>* path) {
+  if (options_.algorithm == SearchAlgorithm::kBidirectional) {
+    if (!bidirectional_) {
+      bidirectional_.reset(new BidirectionalSearch());
+    }
+    bidirectional_->SetOptions(options_);
+    bidirectional_->SetCancellation(cancel_);
+    const bool found = bidirectional_->FindPath(emap, start, goal, agl, path);
+    stats_ = bidirectional_->stats();
+    return found;
+  }
+  return Search(MapSource(emap), start,
+                Span<const std::pair<int, int>>(&goal, 1), agl, nullptr, path);
+}
+
+bool GridSearch::FindPathToAny(const ElevationMap& emap,
+                               const std::pair<int, int>& start,
+                               Span<const std::pair<int, int>> goals, int agl,
+                               std::vector<std::pair<int, int>>* path) {
+  if (goals.size() == 1) {
+    return FindPath(emap, start, goals[0], agl, path);
+  }
+  return Search(MapSource(emap), start, goals, agl, nullptr, path);
+}
+
+bool GridSearch::FindPath(const ElevationMap& emap,
+                          const std::pair<int, int>& start,
+                          const std::pair<int, int>& goal, int agl,
+                          const SearchCorridor& corridor,
+                          std::vector<std::pair<int, int>>* path) {
+  return Search(MapSource(emap), start,
+                Span<const std::pair<int, int>>(&goal, 1), agl, &corridor,
+                path);
+}
+
+bool GridSearch::FindPathToAny(const ElevationMap& emap,
+                               const std::pair<int, int>& start,
+                               Span<const std::pair<int, int>> goals, int agl,
+                               const SearchCorridor& corridor,
+                               std::vector<std::pair<int, int>>* path) {
+  return Search(MapSource(emap), start, goals, agl, &corridor, path);
+}
+
+template <typename T>
+bool GridSearch::FindPath(const TerrainGrid<T>& grid,
+                          const std::pair<int, int>& start,
+                          const std::pair<int, int>& goal, int agl,
+                          std::vector<std::pair<int, int>>* path) {
+  static_assert(std::is_same<T, int16_t>::value ||
+                    std::is_same<T, int32_t>::value ||
+                    std::is_same<T, float>::value,
+                "Grids of int16_t, int32_t or float cells can be searched");
+  if (grid.cells == nullptr && grid.rows > 0 && grid.cols > 0) {
+    std::cerr << "GridSearch::FindPath: ERROR! The grid has no cells"
+              << std::endl;
+    return false;
+  }
+  const CellType type = std::is_same<T, float>::value ? CellType::kFloat
+                        : sizeof(T) == sizeof(int16_t) ? CellType::kInt16
+                                                       : CellType::kInt32;
+  return Search(Source{grid.cells, type, nullptr, grid.rows, grid.cols},
+                start, Span<const std::pair<int, int>>(&goal, 1), agl, nullptr,
+                path);
+}
+
+template bool GridSearch::FindPath<int16_t>(
+    const TerrainGrid<int16_t>&, const std::pair<int, int>&,
+    const std::pair<int, int>&, int, std::vector<std::pair<int, int>>*);
+template bool GridSearch::FindPath<int32_t>(
+    const TerrainGrid<int32_t>&, const std::pair<int, int>&,
+    const std::pair<int, int>&, int, std::vector<std::pair<int, int>>*);
+template bool GridSearch::FindPath<float>(
+    const TerrainGrid<float>&, const std::pair<int, int>&,
+    const std::pair<int, int>&, int, std::vector<std::pair<int, int>>*);
+
+GridSearch::Source GridSearch::MapSource(const ElevationMap& emap) {
+  CellType type = CellType::kTiled;
+  if (emap.data() != nullptr) {
+    type = sizeof(Elevation) == sizeof(int16_t) ? CellType::kInt16
+                                                : CellType::kInt32;
+  }
+  return Source{emap.data(), type, &emap, emap.rows(), emap.cols()};
+}
+
+bool GridSearch::Search(const Source& source,
+                        const std::pair<int, int>& start,
+                        Span<const std::pair<int, int>> goals, int agl,
+                        const SearchCorridor* corridor,
+                        std::vector<std::pair<int, int>>* path) {
+  PP_SCOPED_TIMER(Stage::kSearch);
+  stats_ = SearchStats();
+  path->clear();
+  auto in_map = [&source](const std::pair<int, int>& cell) {
+    return cell.first >= 0 && cell.first < source.rows && cell.second >= 0 &&
+           cell.second < source.cols;
+  };
+  if (goals.empty() || !in_map(start) ||
+      !std::all_of(goals.begin(), goals.end(), in_map)) {
+    std::cerr << "GridSearch::FindPath: ERROR! Start or goal is outside of "
+                 "the map" << std::endl;
+    return false;
+  }
+
+  if (corridor != nullptr
+          ? !UseCorridor(source.rows, source.cols, *corridor)
+          : !BuildWindow(source.rows, source.cols, start, goals)) {
+    std::cerr << "GridSearch::FindPath: ERROR! Map is too large to search, "
+              << "limit the search window" << std::endl;
+    return false;
+  }
+  // Only a corridor can leave out the endpoints, the window always has them
+  auto in_window = [this](const std::pair<int, int>& cell) {
+    const int row = cell.first - window_row_begin_;
+    return row >= 0 && row < window_rows_ &&
+           cell.second >= span_begin_[size_t(row)] &&
+           cell.second < span_end_[size_t(row)];
+  };
+  if (!in_window(start) ||
+      std::none_of(goals.begin(), goals.end(), in_window)) {
+    std::cerr << "GridSearch::FindPath: ERROR! Start or goal is outside of "
+                 "the corridor" << std::endl;
+    return false;
+  }
+  const CostModel& cost = options_.cost;
+  if (cost.distance_weight < 0.0 || cost.climb_weight < 0.0 ||
+      cost.descent_weight < 0.0) {
+    std::cerr << "GridSearch::FindPath: ERROR! Cost weights must not be "
+                 "negative" << std::endl;
+    return false;
+  }
+  const ClearanceField* clearance = options_.clearance;
+  if (clearance != nullptr && (clearance->rows() != source.rows ||
+                               clearance->cols() != source.cols)) {
+    std::cerr << "GridSearch::FindPath: ERROR! The clearance field was not "
+                 "built from the searched map" << std::endl;
+    return false;
+  }
+
+  Reset(size_t(span_offset_[window_rows_]));
+  // Rows are relative to the window and columns are map columns
+  const int row_begin = window_row_begin_;
+  // Markers only exist in maps, a grid's endpoints are terrain like any
+  // other cell
+  auto endpoint_elevation = [&source](const std::pair<int, int>& cell) {
+    if (source.emap != nullptr) {
+      return double(TerrainElevation(*source.emap, cell.first, cell.second));
+    }
+    const size_t index =
+        size_t(cell.first) * size_t(source.cols) + size_t(cell.second);
+    if (source.type == CellType::kFloat) {
+      return double(static_cast<const float*>(source.cells)[index]);
+    }
+    if (source.type == CellType::kInt16) {
+      return double(static_cast<const int16_t*>(source.cells)[index]);
+    }
+    return double(static_cast<const int32_t*>(source.cells)[index]);
+  };
+  goals_.clear();
+  for (const auto& goal : goals) {
+    if (in_window(goal)) {
+      const int row = goal.first - row_begin;
+      goals_.push_back(Goal{CellIndex(row, goal.second), row, goal.second,
+                            endpoint_elevation(goal)});
+    }
+  }
+  std::sort(goals_.begin(), goals_.end(),
+            [](const Goal& a, const Goal& b) { return a.cell < b.cell; });
+  goals_.erase(std::unique(goals_.begin(), goals_.end(),
+                           [](const Goal& a, const Goal& b) {
+                             return a.cell == b.cell;
+                           }),
+               goals_.end());
+  Problem problem;
+  problem.start_cell = CellIndex(start.first - row_begin, start.second);
+  problem.start_elevation = endpoint_elevation(start);
+  problem.goals = goals_.data();
+  problem.goal_count = goals_.size();
+  problem.max_terrain = double(int64_t(cost.max_altitude) - agl);
+  problem.clearance = clearance;
+
+  const bool found = Expand(source, problem);
+  // Counted once per search to keep the expansion loop free of atomics
+  PP_COUNTER_ADD(Counter::kNodesExpanded, stats_.nodes_expanded);
+  PP_COUNTER_ADD(Counter::kCellsVisited, stats_.cells_visited);
+  if (!found) {
+    return false;
+  }
+  const uint32_t start_cell = problem.start_cell;
+  const uint32_t goal_cell = reached_cell_;
+  stats_.path_cost = nodes_[goal_cell].g;
+  // Walk the parents back from the goal, then flip into start to goal order
+  for (uint32_t cell = goal_cell;; cell = nodes_[cell].parent) {
+    const int row = CellRow(cell);
+    path->emplace_back(row + row_begin,
+                       int(cell - span_offset_[row]) + span_begin_[row]);
+    if (cell == start_cell) {
+      break;
+    }
+  }
+  std::reverse(path->begin(), path->end());
+  return true;
+}
+
+bool GridSearch::Expand(const Source& source, const Problem& problem) {
+  // In memory cells are read through a pointer to the window, tiled maps
+  // cell by cell through their tile cache
+  const size_t stride = size_t(source.cols);
+  const size_t window = size_t(window_row_begin_) * stride;
+  switch (source.type) {
+    case CellType::kInt16:
+      return ExpandOn(
+          RowMajorTerrain<int16_t>{
+              static_cast<const int16_t*>(source.cells) + window, stride},
+          problem);
+    case CellType::kInt32:
+      return ExpandOn(
+          RowMajorTerrain<int32_t>{
+              static_cast<const int32_t*>(source.cells) + window, stride},
+          problem);
+    case CellType::kFloat:
+      return ExpandOn(
+          RowMajorTerrain<float>{
+              static_cast<const float*>(source.cells) + window, stride},
+          problem);
+    case CellType::kTiled:
+      return ExpandOn(TiledTerrain{source.emap, window_row_begin_}, problem);
+  }
+  return false;
+}
+
+template <typename Terrain>
+bool GridSearch::ExpandOn(const Terrain& terrain, const Problem& problem) {
+  switch (options_.connectivity) {
+    case Connectivity::kFour:
+      return ExpandWith<Terrain, Neighborhood<Connectivity::kFour>>(terrain,
+                                                                    problem);
+    case Connectivity::kEight:
+      return ExpandWith<Terrain, Neighborhood<Connectivity::kEight>>(
+          terrain, problem);
+    case Connectivity::kSixteen:
+      return ExpandWith<Terrain, Neighborhood<Connectivity::kSixteen>>(
+          terrain, problem);
+  }
+  return false;
+}
+
+template <typename Terrain, typename Neighbors>
+bool GridSearch::ExpandWith(const Terrain& terrain, const Problem& problem) {
+  const bool a_star = options_.algorithm != SearchAlgorithm::kDijkstra;
+  if (options_.cost_policy == CostPolicy::kDistance) {
+    return a_star
+               ? ExpandNodes<Terrain, Neighbors, DistanceCost, true>(terrain,
+                                                                    problem)
+               : ExpandNodes<Terrain, Neighbors, DistanceCost, false>(
+                     terrain, problem);
+  }
+  return a_star ? ExpandNodes<Terrain, Neighbors, TerrainCost, true>(terrain,
+                                                                    problem)
+                : ExpandNodes<Terrain, Neighbors, TerrainCost, false>(
+                      terrain, problem);
+}
+
+template <typename Terrain, typename Neighbors, typename Cost, bool kAStar>
+bool GridSearch::ExpandNodes(const Terrain& terrain, const Problem& problem) {
+  using Value = typename Terrain::Value;
+  const CostModel& cost = options_.cost;
+  const int rows = window_rows_;
+  const int row_begin = window_row_begin_;
+  const uint32_t start_cell = problem.start_cell;
+  const Goal* const goals = problem.goals;
+  const Goal* const goals_end = problem.goals + problem.goal_count;
+  const Value start_elevation = Value(problem.start_elevation);
+  const Value max_terrain = Value(problem.max_terrain);
+  const ClearanceField* clearance = problem.clearance;
+  // The weighted length of each step
+  double step_distances[Neighbors::kCount];
+  for (int k = 0; k < Neighbors::kCount; k++) {
+    step_distances[k] = cost.distance_weight * kNeighborDistances[k];
+  }
+  // Whether a cell, or the terrain around it, is above the ceiling
+  auto too_high = [&](int row, int col) {
+    return (clearance != nullptr
+                ? Value(clearance->MaxElevation(row + row_begin, col))
+                : terrain(row, col)) > max_terrain;
+  };
+  // The distance to the nearest goal, which never overestimates the cost
+  // of reaching any of them
+  auto heuristic = [&](int row, int col) {
+    if (!kAStar) {
+      return 0.0f;
+    }
+    double nearest = std::numeric_limits<double>::max();
+    for (const Goal* goal = goals; goal != goals_end; goal++) {
+      nearest = std::min(nearest,
+                         Neighbors::Distance(std::abs(goal->row - row),
+                                             std::abs(goal->col - col)));
+    }
+    return float(cost.distance_weight * nearest);
+  };
+  // The goal at a cell, or null. A single goal is one comparison.
+  auto goal_at = [&](uint32_t cell) -> const Goal* {
+    if (goals_end - goals == 1) {
+      return goals->cell == cell ? goals : nullptr;
+    }
+    const Goal* goal = std::lower_bound(
+        goals, goals_end, cell,
+        [](const Goal& a, uint32_t b) { return a.cell < b; });
+    return goal != goals_end && goal->cell == cell ? goal : nullptr;
+  };
+  // The terrain of a cell, with the start and goal markers substituted
+  auto elevation_of = [&](uint32_t cell, int row, int col) {
+    if (cell == start_cell) {
+      return start_elevation;
+    }
+    const Goal* goal = goal_at(cell);
+    if (goal != nullptr) {
+      return Value(goal->elevation);
+    }
+    return terrain(row, col);
+  };
+
+  const int start_row = CellRow(start_cell);
+  const int start_col =
+      int(start_cell - span_offset_[start_row]) + span_begin_[start_row];
+  Node& start_node = nodes_[start_cell];
+  start_node.g = 0.0f;
+  start_node.parent = start_cell;
+  start_node.heap_index = kUnqueued;
+  start_node.generation = generation_;
+  PushOrDecrease(start_cell, heuristic(start_row, start_col));
+
+  while (!heap_.empty()) {
+    const uint32_t cell = PopMin();
+    stats_.nodes_expanded++;
+    if (goal_at(cell) != nullptr) {
+      reached_cell_ = cell;
+      return true;
+    }
+    if (cancel_ != nullptr &&
+        stats_.nodes_expanded % kCancelCheckInterval == 0 &&
+        cancel_->IsCancelled()) {
+      return false;
+    }
+    const int row = CellRow(cell);
+    const int col = int(cell - span_offset_[row]) + span_begin_[row];
+    const float g = nodes_[cell].g;
+    const Value elevation =
+        Cost::kUsesClimb ? elevation_of(cell, row, col) : Value(0);
+
+    for (int k = 0; k < Neighbors::kCount; k++) {
+      const int next_row = row + kNeighborRows[k];
+      const int next_col = col + kNeighborCols[k];
+      if (next_row < 0 || next_row >= rows ||
+          next_col < span_begin_[next_row] || next_col >= span_end_[next_row]) {
+        continue;
+      }
+      const uint32_t next = CellIndex(next_row, next_col);
+      Node& next_node = nodes_[next];
+      if (next_node.generation == generation_ &&
+          next_node.heap_index == kClosed) {
+        continue;
+      }
+      stats_.cells_visited++;
+      const Value next_elevation = elevation_of(next, next_row, next_col);
+      // The start and goal are always reachable
+      const Value next_highest =
+          clearance != nullptr
+              ? Value(clearance->MaxElevation(next_row + row_begin, next_col))
+              : next_elevation;
+      if (next_highest > max_terrain && goal_at(next) == nullptr) {
+        continue;
+      }
+      if (k >= 4 && StepSlipsThrough(row, col, kNeighborRows[k],
+                                     kNeighborCols[k], too_high)) {
+        continue;
+      }
+
+      const float next_g =
+          g + float(Cost::Step(cost, step_distances[k],
+                               next_elevation - elevation));
+      if (next_node.generation != generation_) {
+        next_node.generation = generation_;
+        next_node.heap_index = kUnqueued;
+      } else if (next_g >= next_node.g) {
+        continue;
+      }
+      next_node.g = next_g;
+      next_node.parent = cell;
+      PushOrDecrease(next, next_g + heuristic(next_row, next_col));
+    }
+  }
+  return false;
+}
+
+bool GridSearch::BuildWindow(int map_rows, int map_cols,
+                             const std::pair<int, int>& start,
+                             Span<const std::pair<int, int>> goals) {
+  const int margin = options_.window_margin;
+  if (margin < 0) {
+    window_row_begin_ = 0;
+    window_rows_ = map_rows;
+    span_begin_.assign(size_t(window_rows_), 0);
+    span_end_.assign(size_t(window_rows_), map_cols);
+    uniform_width_ = map_cols;
+    return IndexSpans();
+  }
+  int first_row = start.first;
+  int last_row = start.first;
+  for (const auto& goal : goals) {
+    first_row = std::min(first_row, goal.first);
+    last_row = std::max(last_row, goal.first);
+  }
+  window_row_begin_ = std::max(0, first_row - std::min(margin, map_rows));
+  window_rows_ =
+      int(std::min<int64_t>(map_rows, int64_t(last_row) + margin + 1)) -
+      window_row_begin_;
+  span_begin_.assign(size_t(window_rows_), map_cols);
+  span_end_.assign(size_t(window_rows_), 0);
+  uniform_width_ = 0;
+
+  // Each row spans the columns within `margin` rows and columns of the
+  // straight line from start to each goal, so a diagonal corridor costs its
+  // own area rather than its bounding box
+  for (const auto& goal : goals) {
+    const double slope =
+        goal.first == start.first
+            ? 0.0
+            : double(goal.second - start.second) / (goal.first - start.first);
+    const int line_row_min = std::min(start.first, goal.first);
+    const int line_row_max = std::max(start.first, goal.first);
+    const int row_end = std::min(window_row_begin_ + window_rows_,
+                                 line_row_max + margin + 1);
+    for (int row = std::max(window_row_begin_, line_row_min - margin);
+         row < row_end; row++) {
+      double low;
+      double high;
+      if (goal.first == start.first) {
+        low = std::min(start.second, goal.second);
+        high = std::max(start.second, goal.second);
+      } else {
+        // The line's columns over the rows within the margin, widened by
+        // half a row so shallow lines cover every column they pass through
+        const double first =
+            std::max(double(line_row_min), row - margin - 0.5);
+        const double last =
+            std::min(double(line_row_max), row + margin + 0.5);
+        const double a = start.second + slope * (first - start.first);
+        const double b = start.second + slope * (last - start.first);
+        low = std::floor(std::min(a, b));
+        high = std::ceil(std::max(a, b));
+      }
+      const size_t i = size_t(row - window_row_begin_);
+      span_begin_[i] =
+          std::min(span_begin_[i], int(std::max(0.0, low - margin)));
+      span_end_[i] = std::max(
+          span_end_[i], int(std::min(double(map_cols), high + margin + 1)));
+    }
+  }
+  for (int i = 0; i < window_rows_; i++) {
+    span_begin_[size_t(i)] =
+        std::min(span_begin_[size_t(i)], span_end_[size_t(i)]);
+  }
+  return IndexSpans();
+}
+
+bool GridSearch::UseCorridor(int map_rows, int map_cols,
+                             const SearchCorridor& corridor) {
+  // Clip the rows, then each span, to the map
+  const int first = std::max(0, corridor.row_begin);
+  const int last = std::min(map_rows, corridor.row_begin + corridor.rows());
+  window_row_begin_ = first;
+  window_rows_ = std::max(0, last - first);
+  span_begin_.resize(size_t(window_rows_));
+  span_end_.resize(size_t(window_rows_));
+  uniform_width_ = 0;
+  for (int i = 0; i < window_rows_; i++) {
+    const size_t span = size_t(first + i - corridor.row_begin);
+    const int col_begin = std::max(0, corridor.col_begin[span]);
+    const int col_end = std::min(map_cols, corridor.col_end[span]);
+    span_begin_[size_t(i)] = col_begin;
+    span_end_[size_t(i)] = std::max(col_begin, col_end);
+  }
+  return IndexSpans();
+}
+
+bool GridSearch::IndexSpans() {
+  span_offset_.resize(size_t(window_rows_) + 1);
+  uint64_t offset = 0;
+  for (int i = 0; i < window_rows_; i++) {
+    span_offset_[size_t(i)] = uint32_t(offset);
+    offset += uint64_t(span_end_[size_t(i)] - span_begin_[size_t(i)]);
+    if (offset >= kUnqueued) {
+      return false;
+    }
+  }
+  span_offset_[size_t(window_rows_)] = uint32_t(offset);
+  return true;
+}
+
+void GridSearch::Reset(size_t cell_count) {
+  heap_.clear();
+  if (nodes_.size() < cell_count) {
+    PP_COUNTER_ADD(Counter::kAllocations, 1);
+    nodes_.resize(cell_count, Node{0.0f, 0, kUnqueued, 0});
+  }
+  generation_++;
+  // Generations wrapped around, so stamps from long ago could look current
+  if (generation_ == 0) {
+    for (auto& node : nodes_) {
+      node.generation = 0;
+    }
+    generation_ = 1;
+  }
+}
+
+void GridSearch::PushOrDecrease(uint32_t cell, float f) {
+  Node& node = nodes_[cell];
+  if (node.heap_index == kUnqueued) {
+    node.heap_index = uint32_t(heap_.size());
+    heap_.push_back(HeapEntry{f, cell});
+  } else {
+    heap_[node.heap_index].f = f;
+  }
+  // Keys only ever decrease, so the entry can only move up
+  SiftUp(node.heap_index);
+}
+
+uint32_t GridSearch::PopMin() {
+  const uint32_t cell = heap_.front().cell;
+  nodes_[cell].heap_index = kClosed;
+  heap_.front() = heap_.back();
+  heap_.pop_back();
+  if (!heap_.empty()) {
+    nodes_[heap_.front().cell].heap_index = 0;
+    SiftDown(0);
+  }
+  return cell;
+}
+
+void GridSearch::SiftUp(size_t index) {
+  const HeapEntry entry = heap_[index];
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (heap_[parent].f <= entry.f) {
+      break;
+    }
+    heap_[index] = heap_[parent];
+    nodes_[heap_[index].cell].heap_index = uint32_t(index);
+    index = parent;
+  }
+  heap_[index] = entry;
+  nodes_[entry.cell].heap_index = uint32_t(index);
+}
+
+void GridSearch::SiftDown(size_t index) {
+  const HeapEntry entry = heap_[index];
+  const size_t size = heap_.size();
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && heap_[child + 1].f < heap_[child].f) {
+      child++;
+    }
+    if (entry.f <= heap_[child].f) {
+      break;
+    }
+    heap_[index] = heap_[child];
+    nodes_[heap_[index].cell].heap_index = uint32_t(index);
+    index = child;
+  }
+  heap_[index] = entry;
+  nodes_[entry.cell].heap_index = uint32_t(index);
+}
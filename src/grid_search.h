@@ -0,0 +1,407 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "cancellation.h"
+#include "elevation_map.h"
+#include "span.h"
+
+namespace path_planning {
+
+class BidirectionalSearch;
+class ClearanceField;
+
+/// The algorithm used to generate the base path between two cells
+enum class SearchAlgorithm {
+  /// Walk straight from start to goal one row/column step at a time, giving
+  /// row movement priority. Ignores the terrain.
+  kStraightLine,
+  /// Uniform cost search, expands every cell cheaper than the goal
+  kDijkstra,
+  /// A* with an admissible distance heuristic
+  kAStar,
+  /// A* from the start and from the goal at once, meeting in the middle,
+  /// see `BidirectionalSearch`. Searches in a corridor and of a
+  /// `TerrainGrid` run as `kAStar`.
+  kBidirectional
+};
+
+/// Which neighbors a cell may move to
+enum class Connectivity {
+  /// Up, down, left and right
+  kFour = 4,
+  /// The four above plus the diagonals
+  kEight = 8,
+  /// The eight above plus the knight's moves, one row and two columns or the
+  /// reverse. Paths turn in finer angles, but consecutive cells of a path
+  /// are no longer always touching.
+  kSixteen = 16
+};
+
+/// How the cost of a step is worked out from the `CostModel`
+enum class CostPolicy {
+  /// The distance, climb and descent weights
+  kTerrain,
+  /// The distance weight alone. The terrain only matters through
+  /// `CostModel::max_altitude`, e.g. to fly the shortest route under a
+  /// ceiling.
+  kDistance
+};
+
+/// @struct The cost of moving between two neighboring cells:
+///
+///   distance_weight * step_length
+///     + climb_weight * elevation_gained
+///     + descent_weight * elevation_lost
+///
+/// All weights must be non-negative so the distance heuristic stays
+/// admissible.
+struct CostModel {
+  /// Cost per cell of horizontal distance travelled
+  double distance_weight = 1.0;
+  /// Cost per unit of elevation gained
+  double climb_weight = 1.0;
+  /// Cost per unit of elevation lost
+  double descent_weight = 0.5;
+  /// The highest altitude the drone may fly at. Cells whose elevation plus
+  /// the planning agl exceed it are impassable.
+  int max_altitude = std::numeric_limits<int>::max();
+};
+
+/// @struct Options for `GridSearch`
+struct SearchOptions {
+  /// The algorithm used to find the path
+  SearchAlgorithm algorithm = SearchAlgorithm::kAStar;
+  /// Which neighbors a cell may move to
+  Connectivity connectivity = Connectivity::kFour;
+  /// The cost of moving between cells
+  CostModel cost;
+  /// Which terms of `cost` are used
+  CostPolicy cost_policy = CostPolicy::kTerrain;
+  /// Limit the search to the cells within this many rows and columns of the
+  /// straight line from start to goal, or to each goal, or search the whole
+  /// map if negative.
+  /// Bounds the search memory and, for tiled maps, the tiles that are read,
+  /// to the area of the corridor. A path that would have to leave the
+  /// corridor is not found.
+  int window_margin = -1;
+  /// Optional. Checks the terrain around each cell against
+  /// `CostModel::max_altitude` instead of the cell alone. A cell is
+  /// impassable if the highest terrain within the field's radius plus the
+  /// planning agl exceeds it. The field must be built from the searched map
+  /// and outlive the search.
+  const ClearanceField* clearance = nullptr;
+  /// The threads a `kBidirectional` search runs on. With 2 each direction
+  /// has its own thread, with 1 the calling thread alternates between them.
+  int bidirectional_threads = 2;
+};
+
+/// @struct The cells a search may visit, as one span of columns per row. Any
+/// shape whose rows are contiguous can be described, e.g. a band around a
+/// coarse path.
+struct SearchCorridor {
+  /// The map row of the first span
+  int row_begin = 0;
+  /// The first map column of each span
+  std::vector<int> col_begin;
+  /// One past the last map column of each span
+  std::vector<int> col_end;
+  /// @brief Get the number of rows the corridor covers
+  int rows() const { return int(col_begin.size()); }
+};
+
+/// @struct Counters from the most recent search
+struct SearchStats {
+  /// The number of cells taken off the open list
+  size_t nodes_expanded = 0;
+  /// The number of neighbor cells whose cost was evaluated
+  size_t cells_visited = 0;
+  /// The cost of the path that was found
+  double path_cost = 0.0;
+};
+
+/// @struct A read-only grid of row-major elevations that is not an
+/// `ElevationMap`, e.g. a floating point elevation model or a derived grid.
+/// It has no location markers.
+template <typename T>
+struct TerrainGrid {
+  /// The cells, `rows * cols` of them
+  const T* cells = nullptr;
+  /// The number of rows
+  int rows = 0;
+  /// The number of columns
+  int cols = 0;
+};
+
+/// @brief Get the terrain elevation to cost moves into and out of a cell.
+/// Cells a location marker was placed at have no terrain of their own, so
+/// they take the lowest of their 4-connected neighbors that are not marked
+/// too, or 0 if there are none. Markers are found by position, see
+/// `ElevationMap::IsMarked`, so other cells keep their value even if it
+/// equals a marker's.
+int64_t TerrainElevation(const ElevationMap& emap, int row, int col);
+
+/// @class Cost based shortest path search over an `ElevationMap`.
+///
+/// Per-cell search state lives in one flat array indexed by cell index and
+/// the open list is an indexed binary heap with decrease-key. Both are kept
+/// between calls and reset with a generation stamp instead of being cleared,
+/// so repeated searches on the same map do not allocate.
+///
+/// The expansion loop is a template over the cell type, the neighborhood,
+/// the cost policy and the heuristic. Each search picks the instantiation
+/// for its options once up front, so the loop has no per-step branches on
+/// them and its neighbor tables are constants.
+class GridSearch {
+ public:
+  /// @brief Constructor
+  GridSearch();
+  /// @brief Constructor
+  /// @param options - The options to search with
+  explicit GridSearch(const SearchOptions& options);
+  /// @brief Destructor
+  ~GridSearch();
+  GridSearch(GridSearch&& other);
+  GridSearch& operator=(GridSearch&& other);
+  /// @brief Set the options to use for subsequent searches
+  void SetOptions(const SearchOptions& options) { options_ = options; }
+  /// @brief Get the current search options
+  const SearchOptions& options() const { return options_; }
+  /// @brief Set the token that stops searches early. A cancelled search
+  /// fails as if there were no path.
+  /// @param cancel - Optional. Not owned, it must outlive the searches.
+  void SetCancellation(const CancellationToken* cancel) { cancel_ = cancel; }
+  /// @brief Get the token that stops searches early, nullptr if none
+  const CancellationToken* cancellation() const { return cancel_; }
+  /// @brief Get the counters from the most recent search
+  const SearchStats& stats() const { return stats_; }
+  /// @brief Find the cheapest path between two cells. A start or goal cell
+  /// holding a location marker from `kMarkers` has no terrain of
+  /// its own and is costed as its lowest 4-connected neighbor.
+  /// @param emap - The map to search
+  /// @param start - The row and column to start from
+  /// @param goal - The row and column to finish at
+  /// @param agl - The altitude above the terrain that will be flown, used
+  /// with `CostModel::max_altitude`
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  bool FindPath(const ElevationMap& emap, const std::pair<int, int>& start,
+                const std::pair<int, int>& goal, int agl,
+                std::vector<std::pair<int, int>>* path);
+  /// @brief Find the cheapest path from a cell to any of several goals,
+  /// searching towards all of them at once and stopping at the first one
+  /// settled. A* is guided by the distance to the nearest goal, which costs
+  /// a pass over the goals per cell pushed. With several goals
+  /// `SearchAlgorithm::kBidirectional` searches as A*.
+  /// @param emap - The map to search
+  /// @param start - The row and column to start from
+  /// @param goals - The rows and columns to finish at, at least one
+  /// @param agl - The altitude above the terrain that will be flown
+  /// @param path - Output. The cells from start to the goal reached,
+  /// inclusive
+  /// @return true if a path to any goal was found
+  bool FindPathToAny(const ElevationMap& emap,
+                     const std::pair<int, int>& start,
+                     Span<const std::pair<int, int>> goals, int agl,
+                     std::vector<std::pair<int, int>>* path);
+  /// @brief Find the cheapest path between two cells without leaving a
+  /// corridor. `SearchOptions::window_margin` is ignored. Spans are clipped
+  /// to the map.
+  /// @param emap - The map to search
+  /// @param start - The row and column to start from, inside the corridor
+  /// @param goal - The row and column to finish at, inside the corridor
+  /// @param agl - The altitude above the terrain that will be flown
+  /// @param corridor - The cells the path may use
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  bool FindPath(const ElevationMap& emap, const std::pair<int, int>& start,
+                const std::pair<int, int>& goal, int agl,
+                const SearchCorridor& corridor,
+                std::vector<std::pair<int, int>>* path);
+  /// @brief Find the cheapest path from a cell to any of several goals
+  /// without leaving a corridor. Goals outside the corridor are skipped.
+  /// @param emap - The map to search
+  /// @param start - The row and column to start from, inside the corridor
+  /// @param goals - The rows and columns to finish at, at least one inside
+  /// the corridor
+  /// @param agl - The altitude above the terrain that will be flown
+  /// @param corridor - The cells the path may use
+  /// @param path - Output. The cells from start to the goal reached,
+  /// inclusive
+  /// @return true if a path to any goal was found
+  bool FindPathToAny(const ElevationMap& emap,
+                     const std::pair<int, int>& start,
+                     Span<const std::pair<int, int>> goals, int agl,
+                     const SearchCorridor& corridor,
+                     std::vector<std::pair<int, int>>* path);
+  /// @brief Find the cheapest path between two cells of a grid. Available
+  /// for `int16_t`, `int32_t` and `float` cells.
+  /// @param grid - The grid to search
+  /// @param start - The row and column to start from
+  /// @param goal - The row and column to finish at
+  /// @param agl - The altitude above the terrain that will be flown
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  template <typename T>
+  bool FindPath(const TerrainGrid<T>& grid, const std::pair<int, int>& start,
+                const std::pair<int, int>& goal, int agl,
+                std::vector<std::pair<int, int>>* path);
+
+ private:
+  /// @struct Search state of a single cell
+  struct Node {
+    /// The cost of the cheapest known path from the start
+    float g;
+    /// The cell index this node was reached from
+    uint32_t parent;
+    /// The position of this node in `heap_`, or `kClosed`
+    uint32_t heap_index;
+    /// The search generation the other fields belong to
+    uint32_t generation;
+  };
+  /// @struct An entry in the open list
+  struct HeapEntry {
+    /// The estimated total cost through the cell
+    float f;
+    /// The cell index
+    uint32_t cell;
+  };
+
+  /// The type of the cells a search reads
+  enum class CellType { kInt16, kInt32, kFloat, kTiled };
+  /// @struct The terrain a search reads
+  struct Source {
+    /// The row-major cells, null for a tiled map
+    const void* cells;
+    /// The type of `cells`
+    CellType type;
+    /// The map the cells belong to, null for a `TerrainGrid`
+    const ElevationMap* emap;
+    /// The dimensions of the terrain
+    int rows;
+    int cols;
+  };
+  /// @struct A goal of a search
+  struct Goal {
+    /// The node index
+    uint32_t cell;
+    /// The window row and map column
+    int row;
+    int col;
+    /// The terrain of the cell, with a marker substituted
+    double elevation;
+  };
+  /// @struct The parts of a search the expansion loop needs besides the
+  /// terrain
+  struct Problem {
+    /// The node index of the start
+    uint32_t start_cell;
+    /// The terrain of the start cell, with a marker substituted
+    double start_elevation;
+    /// The goals, sorted by node index without repeats
+    const Goal* goals;
+    size_t goal_count;
+    /// The highest terrain a path may cross
+    double max_terrain;
+    /// Optional. The field to check `max_terrain` against instead
+    const ClearanceField* clearance;
+  };
+
+  /// Marks a node that has already been expanded
+  static const uint32_t kClosed = std::numeric_limits<uint32_t>::max();
+
+  /// @brief Describe the cells of a map
+  static Source MapSource(const ElevationMap& emap);
+  /// @brief Run a search over the window, or over the corridor if given
+  bool Search(const Source& source, const std::pair<int, int>& start,
+              Span<const std::pair<int, int>> goals, int agl,
+              const SearchCorridor* corridor,
+              std::vector<std::pair<int, int>>* path);
+  /// @brief Pick the expansion loop for the cell type
+  bool Expand(const Source& source, const Problem& problem);
+  /// @brief Pick the expansion loop for the neighborhood
+  template <typename Terrain>
+  bool ExpandOn(const Terrain& terrain, const Problem& problem);
+  /// @brief Pick the expansion loop for the cost policy and heuristic
+  template <typename Terrain, typename Neighbors>
+  bool ExpandWith(const Terrain& terrain, const Problem& problem);
+  /// @brief Expand nodes until a goal is reached or the open list runs
+  /// out
+  /// @return true if a goal was reached, which is left in `reached_cell_`
+  template <typename Terrain, typename Neighbors, typename Cost,
+            bool kAStar>
+  bool ExpandNodes(const Terrain& terrain, const Problem& problem);
+  /// @brief Work out the cells the search may visit, see
+  /// `SearchOptions::window_margin`
+  /// @return false if the window has too many cells to index
+  bool BuildWindow(int map_rows, int map_cols,
+                   const std::pair<int, int>& start,
+                   Span<const std::pair<int, int>> goals);
+  /// @brief Use a corridor as the window, clipped to the map
+  /// @return false if the window has too many cells to index
+  bool UseCorridor(int map_rows, int map_cols,
+                   const SearchCorridor& corridor);
+  /// @brief Fill in `span_offset_` from the spans
+  /// @return false if the window has too many cells to index
+  bool IndexSpans();
+  /// @brief Get the node index of a window row and map column
+  uint32_t CellIndex(int row, int col) const {
+    return span_offset_[size_t(row)] + uint32_t(col - span_begin_[size_t(row)]);
+  }
+  /// @brief Get the window row of a node index
+  int CellRow(uint32_t cell) const {
+    if (uniform_width_ > 0) {
+      return int(cell / uint32_t(uniform_width_));
+    }
+    return int(std::upper_bound(span_offset_.begin(), span_offset_.end(),
+                                cell) -
+               span_offset_.begin()) -
+           1;
+  }
+  /// @brief Size the scratch buffers for a map and start a new generation
+  void Reset(size_t cell_count);
+  /// @brief Add a cell to the open list or lower its key
+  void PushOrDecrease(uint32_t cell, float f);
+  /// @brief Remove the cheapest cell from the open list
+  uint32_t PopMin();
+  /// @brief Move the heap entry at `index` towards the root
+  void SiftUp(size_t index);
+  /// @brief Move the heap entry at `index` towards the leaves
+  void SiftDown(size_t index);
+
+  /// The options to search with
+  SearchOptions options_;
+  /// Optional. Stops searches early, see `SetCancellation`
+  const CancellationToken* cancel_ = nullptr;
+  /// Counters from the most recent search
+  SearchStats stats_;
+  /// The first map row of the search window and its number of rows
+  int window_row_begin_;
+  int window_rows_;
+  /// The first and one past the last map column of each window row
+  std::vector<int> span_begin_;
+  std::vector<int> span_end_;
+  /// The node index of the first cell of each window row, plus the total
+  std::vector<uint32_t> span_offset_;
+  /// The width of every row when the window is the whole map, else 0
+  int uniform_width_;
+  /// Per-cell search state, indexed by `CellIndex`
+  std::vector<Node> nodes_;
+  /// The open list
+  std::vector<HeapEntry> heap_;
+  /// The generation of the current search
+  uint32_t generation_;
+  /// The goals of the current search, see `Problem::goals`
+  std::vector<Goal> goals_;
+  /// The node index of the goal the last search reached
+  uint32_t reached_cell_ = 0;
+  /// Runs `SearchAlgorithm::kBidirectional` searches, created on the first
+  std::unique_ptr<BidirectionalSearch> bidirectional_;
+};
+}
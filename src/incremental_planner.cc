@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "incremental_planner.h"
+#include "instrumentation.h"
+#include "search_policies.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// The cost of an unreachable cell or impassable step
+const float kInfinity = std::numeric_limits<float>::infinity();
+
+}  // namespace
+
+IncrementalPlanner::IncrementalPlanner()
+    : planned_version_(0),
+      planned_(false),
+      restart_(true),
+      agl_(0),
+      start_cell_(0),
+      goal_cell_(0),
+      start_elevation_(0),
+      goal_elevation_(0),
+      changed_cells_(0) {
+}
+
+IncrementalPlanner::IncrementalPlanner(const SearchOptions& options)
+    : IncrementalPlanner() {
+  options_ = options;
+}
+
+void IncrementalPlanner::SetOptions(const SearchOptions& options) {
+  options_ = options;
+  restart_ = true;
+}
+
+void IncrementalPlanner::SetMap(const ElevationMap& emap) {
+  map_ = emap;
+  map_.SetChangeTracking(true);
+  restart_ = true;
+}
+
+bool IncrementalPlanner::Plan(const std::pair<int, int>& start,
+                              const std::pair<int, int>& goal, int agl,
+                              std::vector<std::pair<int, int>>* path) {
+  start_ = start;
+  goal_ = goal;
+  agl_ = agl;
+  planned_ = true;
+  return Restart(path);
+}
+
+bool IncrementalPlanner::Replan(std::vector<std::pair<int, int>>* path) {
+  if (!planned_) {
+    std::cerr << "IncrementalPlanner::Replan: ERROR! Plan must be called "
+                 "before Replan" << std::endl;
+    path->clear();
+    return false;
+  }
+  if (restart_ || !map_.ChangesSince(planned_version_, &changes_)) {
+    return Restart(path);
+  }
+
+  PP_SCOPED_TIMER(Stage::kReplan);
+  stats_ = SearchStats();
+  path->clear();
+  std::sort(changes_.begin(), changes_.end());
+  changes_.erase(std::unique(changes_.begin(), changes_.end()),
+                 changes_.end());
+  changed_cells_ = changes_.size();
+
+  // A written cell changes the cost of every step into and out of it, so
+  // it and its neighbors need their lookahead recomputed. The start and goal
+  // markers take their terrain from their neighbors, so they can change
+  // without being written.
+  const int rows = map_.rows();
+  const int cols = map_.cols();
+  const int num_neighbors = int(options_.connectivity);
+  affected_.clear();
+  auto add_with_neighbors = [&](int row, int col) {
+    affected_.push_back(uint32_t(map_.Index(row, col)));
+    for (int k = 0; k < num_neighbors; k++) {
+      const int next_row = row + kNeighborRows[k];
+      const int next_col = col + kNeighborCols[k];
+      if (next_row >= 0 && next_row < rows && next_col >= 0 &&
+          next_col < cols) {
+        affected_.push_back(uint32_t(map_.Index(next_row, next_col)));
+      }
+    }
+  };
+  for (const auto& cell : changes_) {
+    add_with_neighbors(cell.first, cell.second);
+  }
+  const int64_t start_elevation =
+      TerrainElevation(map_, start_.first, start_.second);
+  const int64_t goal_elevation =
+      TerrainElevation(map_, goal_.first, goal_.second);
+  if (start_elevation != start_elevation_) {
+    start_elevation_ = start_elevation;
+    add_with_neighbors(start_.first, start_.second);
+  }
+  if (goal_elevation != goal_elevation_) {
+    goal_elevation_ = goal_elevation;
+    add_with_neighbors(goal_.first, goal_.second);
+  }
+  std::sort(affected_.begin(), affected_.end());
+  affected_.erase(std::unique(affected_.begin(), affected_.end()),
+                  affected_.end());
+
+  for (uint32_t cell : affected_) {
+    UpdateVertex(cell);
+  }
+  ComputeShortestPath();
+  planned_version_ = map_.version();
+  map_.ClearChanges();
+  return Finish(path);
+}
+
+bool IncrementalPlanner::Restart(std::vector<std::pair<int, int>>* path) {
+  PP_SCOPED_TIMER(Stage::kSearch);
+  stats_ = SearchStats();
+  path->clear();
+  heap_.clear();
+  nodes_.clear();
+  changed_cells_ = map_.size();
+  restart_ = true;
+  auto in_map = [this](const std::pair<int, int>& cell) {
+    return cell.first >= 0 && cell.first < map_.rows() && cell.second >= 0 &&
+           cell.second < map_.cols();
+  };
+  if (!in_map(start_) || !in_map(goal_)) {
+    std::cerr << "IncrementalPlanner::Plan: ERROR! Start or goal is outside "
+                 "of the map" << std::endl;
+    return false;
+  }
+  if (map_.size() >= kNotQueued) {
+    std::cerr << "IncrementalPlanner::Plan: ERROR! Map is too large to "
+                 "search" << std::endl;
+    return false;
+  }
+  const CostModel& cost = options_.cost;
+  if (cost.distance_weight < 0.0 || cost.climb_weight < 0.0 ||
+      cost.descent_weight < 0.0) {
+    std::cerr << "IncrementalPlanner::Plan: ERROR! Cost weights must not be "
+                 "negative" << std::endl;
+    return false;
+  }
+  // Writes made while the journal was off are part of the new state
+  map_.SetChangeTracking(true);
+  restart_ = false;
+
+  if (nodes_.capacity() < map_.size()) {
+    PP_COUNTER_ADD(Counter::kAllocations, 1);
+  }
+  nodes_.assign(map_.size(), Node{kInfinity, kInfinity, kNotQueued});
+  start_cell_ = uint32_t(map_.Index(start_.first, start_.second));
+  goal_cell_ = uint32_t(map_.Index(goal_.first, goal_.second));
+  start_elevation_ = TerrainElevation(map_, start_.first, start_.second);
+  goal_elevation_ = TerrainElevation(map_, goal_.first, goal_.second);
+
+  nodes_[start_cell_].rhs = 0.0f;
+  HeapSet(start_cell_, Heuristic(start_cell_), 0.0f);
+  ComputeShortestPath();
+  planned_version_ = map_.version();
+  map_.ClearChanges();
+  return Finish(path);
+}
+
+bool IncrementalPlanner::Finish(std::vector<std::pair<int, int>>* path) {
+  if (!ExtractPath(path)) {
+    PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+    return false;
+  }
+  stats_.path_cost = nodes_[goal_cell_].g;
+  PP_COUNTER_ADD(Counter::kPathCells, path->size());
+  return true;
+}
+
+void IncrementalPlanner::ComputeShortestPath() {
+  const int rows = map_.rows();
+  const int cols = map_.cols();
+  const int num_neighbors = int(options_.connectivity);
+  const Node& goal = nodes_[goal_cell_];
+  size_t nodes_expanded = 0;
+  while (!heap_.empty()) {
+    // Stop once nothing queued can lower the goal's cost and the goal is
+    // consistent
+    const float goal_key = std::min(goal.g, goal.rhs);
+    const HeapEntry top = heap_.front();
+    if (!KeyLess(top.k1, top.k2, goal_key + Heuristic(goal_cell_),
+                 goal_key) &&
+        goal.rhs == goal.g) {
+      break;
+    }
+    nodes_expanded++;
+    const uint32_t cell = top.cell;
+    Node& node = nodes_[cell];
+    const int row = int(cell / uint32_t(cols));
+    const int col = int(cell % uint32_t(cols));
+    const bool overconsistent = node.g > node.rhs;
+    const float old_g = node.g;
+    if (overconsistent) {
+      // The cell got cheaper, settle it and offer it to its neighbors
+      node.g = node.rhs;
+      HeapRemove(cell);
+    } else {
+      // The cell got more expensive, retract it and re-derive the
+      // neighbors that may have depended on it
+      node.g = kInfinity;
+      UpdateVertex(cell);
+    }
+    for (int k = 0; k < num_neighbors; k++) {
+      const int next_row = row + kNeighborRows[k];
+      const int next_col = col + kNeighborCols[k];
+      if (next_row < 0 || next_row >= rows || next_col < 0 ||
+          next_col >= cols) {
+        continue;
+      }
+      const uint32_t next = uint32_t(next_row) * uint32_t(cols) +
+                            uint32_t(next_col);
+      if (next == start_cell_) {
+        continue;
+      }
+      const float step = StepCost(cell, next, k);
+      if (step == kInfinity) {
+        continue;
+      }
+      Node& next_node = nodes_[next];
+      if (overconsistent) {
+        stats_.cells_visited++;
+        const float through = node.g + step;
+        if (through < next_node.rhs) {
+          next_node.rhs = through;
+          Requeue(next);
+        }
+      } else if (old_g != kInfinity && next_node.rhs == old_g + step) {
+        UpdateVertex(next);
+      }
+    }
+  }
+  stats_.nodes_expanded += nodes_expanded;
+  PP_COUNTER_ADD(Counter::kNodesExpanded, nodes_expanded);
+  PP_COUNTER_ADD(Counter::kCellsVisited, stats_.cells_visited);
+}
+
+void IncrementalPlanner::UpdateVertex(uint32_t cell) {
+  Node& node = nodes_[cell];
+  if (cell != start_cell_) {
+    const int rows = map_.rows();
+    const int cols = map_.cols();
+    const int row = int(cell / uint32_t(cols));
+    const int col = int(cell % uint32_t(cols));
+    float best = kInfinity;
+    for (int k = 0; k < int(options_.connectivity); k++) {
+      const int prev_row = row + kNeighborRows[k];
+      const int prev_col = col + kNeighborCols[k];
+      if (prev_row < 0 || prev_row >= rows || prev_col < 0 ||
+          prev_col >= cols) {
+        continue;
+      }
+      const uint32_t prev = uint32_t(prev_row) * uint32_t(cols) +
+                            uint32_t(prev_col);
+      const float g = nodes_[prev].g;
+      if (g == kInfinity) {
+        continue;
+      }
+      stats_.cells_visited++;
+      best = std::min(best, g + StepCost(prev, cell, k));
+    }
+    node.rhs = best;
+  }
+  Requeue(cell);
+}
+
+void IncrementalPlanner::Requeue(uint32_t cell) {
+  const Node& node = nodes_[cell];
+  if (node.g != node.rhs) {
+    const float key = std::min(node.g, node.rhs);
+    HeapSet(cell, key + Heuristic(cell), key);
+  } else if (node.heap_index != kNotQueued) {
+    HeapRemove(cell);
+  }
+}
+
+bool IncrementalPlanner::ExtractPath(
+    std::vector<std::pair<int, int>>* path) const {
+  if (nodes_[goal_cell_].g == kInfinity) {
+    return false;
+  }
+  const int rows = map_.rows();
+  const int cols = map_.cols();
+  // Each step goes to the neighbor the cell's cost came through, a path can
+  // not be longer than the map
+  uint32_t cell = goal_cell_;
+  path->emplace_back(goal_);
+  while (cell != start_cell_) {
+    if (path->size() > nodes_.size()) {
+      std::cerr << "IncrementalPlanner::Replan: ERROR! Unable to trace the "
+                   "path back to the start" << std::endl;
+      path->clear();
+      return false;
+    }
+    const int row = int(cell / uint32_t(cols));
+    const int col = int(cell % uint32_t(cols));
+    uint32_t best_cell = cell;
+    float best = kInfinity;
+    for (int k = 0; k < int(options_.connectivity); k++) {
+      const int prev_row = row + kNeighborRows[k];
+      const int prev_col = col + kNeighborCols[k];
+      if (prev_row < 0 || prev_row >= rows || prev_col < 0 ||
+          prev_col >= cols) {
+        continue;
+      }
+      const uint32_t prev = uint32_t(prev_row) * uint32_t(cols) +
+                            uint32_t(prev_col);
+      const float g = nodes_[prev].g;
+      if (g == kInfinity) {
+        continue;
+      }
+      const float through = g + StepCost(prev, cell, k);
+      if (through < best || (through == best && g < nodes_[best_cell].g)) {
+        best = through;
+        best_cell = prev;
+      }
+    }
+    if (best_cell == cell) {
+      path->clear();
+      return false;
+    }
+    cell = best_cell;
+    path->emplace_back(int(cell / uint32_t(cols)),
+                       int(cell % uint32_t(cols)));
+  }
+  std::reverse(path->begin(), path->end());
+  return true;
+}
+
+int64_t IncrementalPlanner::Terrain(uint32_t cell) const {
+  if (cell == start_cell_) {
+    return start_elevation_;
+  }
+  if (cell == goal_cell_) {
+    return goal_elevation_;
+  }
+  return map_.data() != nullptr ? int64_t(map_.data()[cell])
+                                : int64_t(map_.At(int(cell / map_.cols()),
+                                                  int(cell % map_.cols())));
+}
+
+float IncrementalPlanner::StepCost(uint32_t from, uint32_t to, int k) const {
+  const CostModel& cost = options_.cost;
+  const int64_t next_elevation = Terrain(to);
+  // The goal is always reachable
+  const int64_t ceiling = int64_t(cost.max_altitude) - agl_;
+  if (next_elevation > ceiling && to != goal_cell_) {
+    return kInfinity;
+  }
+  if (k >= 4) {
+    const int cols = map_.cols();
+    const int from_row = int(from / uint32_t(cols));
+    const int from_col = int(from % uint32_t(cols));
+    auto too_high = [&](int row, int col) {
+      return Terrain(uint32_t(row) * uint32_t(cols) + uint32_t(col)) >
+             ceiling;
+    };
+    if (StepSlipsThrough(from_row, from_col,
+                         int(to / uint32_t(cols)) - from_row,
+                         int(to % uint32_t(cols)) - from_col, too_high)) {
+      return kInfinity;
+    }
+  }
+  const int64_t climb = next_elevation - Terrain(from);
+  return float(CostOfStep(options_.cost_policy, cost,
+                          cost.distance_weight * kNeighborDistances[k],
+                          climb));
+}
+
+float IncrementalPlanner::Heuristic(uint32_t cell) const {
+  if (options_.algorithm == SearchAlgorithm::kDijkstra) {
+    return 0.0f;
+  }
+  const int cols = map_.cols();
+  const int row_diff = std::abs(goal_.first - int(cell / uint32_t(cols)));
+  const int col_diff = std::abs(goal_.second - int(cell % uint32_t(cols)));
+  return float(options_.cost.distance_weight *
+               NeighborhoodDistance(options_.connectivity, row_diff,
+                                    col_diff));
+}
+
+void IncrementalPlanner::HeapSet(uint32_t cell, float k1, float k2) {
+  Node& node = nodes_[cell];
+  if (node.heap_index == kNotQueued) {
+    node.heap_index = uint32_t(heap_.size());
+    heap_.push_back(HeapEntry{k1, k2, cell});
+    SiftUp(node.heap_index);
+    return;
+  }
+  // Keys can move either way when costs rise and fall
+  const size_t index = node.heap_index;
+  heap_[index].k1 = k1;
+  heap_[index].k2 = k2;
+  SiftUp(index);
+  SiftDown(nodes_[cell].heap_index);
+}
+
+void IncrementalPlanner::HeapRemove(uint32_t cell) {
+  const size_t index = nodes_[cell].heap_index;
+  nodes_[cell].heap_index = kNotQueued;
+  if (index + 1 == heap_.size()) {
+    heap_.pop_back();
+    return;
+  }
+  heap_[index] = heap_.back();
+  heap_.pop_back();
+  nodes_[heap_[index].cell].heap_index = uint32_t(index);
+  // The moved entry can belong above or below its new position
+  SiftUp(index);
+  SiftDown(index);
+}
+
+void IncrementalPlanner::SiftUp(size_t index) {
+  const HeapEntry entry = heap_[index];
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (!KeyLess(entry.k1, entry.k2, heap_[parent].k1, heap_[parent].k2)) {
+      break;
+    }
+    heap_[index] = heap_[parent];
+    nodes_[heap_[index].cell].heap_index = uint32_t(index);
+    index = parent;
+  }
+  heap_[index] = entry;
+  nodes_[entry.cell].heap_index = uint32_t(index);
+}
+
+void IncrementalPlanner::SiftDown(size_t index) {
+  const HeapEntry entry = heap_[index];
+  const size_t size = heap_.size();
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && KeyLess(heap_[child + 1].k1, heap_[child + 1].k2,
+                                    heap_[child].k1, heap_[child].k2)) {
+      child++;
+    }
+    if (!KeyLess(heap_[child].k1, heap_[child].k2, entry.k1, entry.k2)) {
+      break;
+    }
+    heap_[index] = heap_[child];
+    nodes_[heap_[index].cell].heap_index = uint32_t(index);
+    index = child;
+  }
+  heap_[index] = entry;
+  nodes_[entry.cell].heap_index = uint32_t(index);
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "elevation_map.h"
+#include "grid_search.h"
+
+namespace path_planning {
+
+/// @class Stateful planner that repairs its previous path after map cells
+/// change instead of searching again from scratch, using Lifelong Planning
+/// A* (LPA*).
+///
+/// The planner owns a copy of the map with change tracking turned on. Edit
+/// the terrain through `map()(row, col) = value` and call `Replan`: only the
+/// written cells and their neighbors are re-evaluated, and the search only
+/// re-expands cells whose cost from the start changed, so a localized edit
+/// costs time in proportion to the region it affects rather than the map.
+///
+/// Costs follow `GridSearch` exactly for the same `SearchOptions`, except
+/// that the whole map is always searched and `window_margin` is ignored, as
+/// is `clearance`, which edits to the map would leave out of date.
+/// The search state takes 12 bytes per map cell and is kept between plans.
+class IncrementalPlanner {
+ public:
+  /// @brief Constructor
+  IncrementalPlanner();
+  /// @brief Constructor
+  /// @param options - The options to search with
+  explicit IncrementalPlanner(const SearchOptions& options);
+  /// @brief Set the options to search with. The next `Replan` searches from
+  /// scratch.
+  void SetOptions(const SearchOptions& options);
+  /// @brief Get the current search options
+  const SearchOptions& options() const { return options_; }
+  /// @brief Set the map to plan on. Takes constant time until the first
+  /// write, which unshares the cells from `emap`.
+  void SetMap(const ElevationMap& emap);
+  /// @brief Get the map for editing. Writes through `operator()` are
+  /// journaled and repaired by the next `Replan`. Any other kind of write
+  /// makes the next `Replan` search from scratch.
+  ElevationMap& map() { return map_; }
+  /// @brief Get the map
+  const ElevationMap& map() const { return map_; }
+  /// @brief Plan from scratch between two cells
+  /// @param start - The row and column to start from
+  /// @param goal - The row and column to finish at
+  /// @param agl - The altitude above the terrain that will be flown, used
+  /// with `CostModel::max_altitude`
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  bool Plan(const std::pair<int, int>& start, const std::pair<int, int>& goal,
+            int agl, std::vector<std::pair<int, int>>* path);
+  /// @brief Bring the path of the last `Plan` up to date with the map
+  /// changes since the last plan
+  /// @param path - Output. The cells from start to goal, inclusive
+  /// @return true if a path was found
+  bool Replan(std::vector<std::pair<int, int>>* path);
+  /// @brief Get the counters from the most recent `Plan` or `Replan`
+  const SearchStats& stats() const { return stats_; }
+  /// @brief Get the number of distinct cells the most recent `Replan`
+  /// repaired, or the map size if it searched from scratch
+  size_t changed_cells() const { return changed_cells_; }
+
+ private:
+  /// @struct Search state of a single cell
+  struct Node {
+    /// The cost of the cheapest path from the start found so far
+    float g;
+    /// The one step lookahead cost, the cheapest `g` of a neighbor plus the
+    /// step from it
+    float rhs;
+    /// The position of this node in `heap_`, or `kNotQueued`
+    uint32_t heap_index;
+  };
+  /// @struct An entry in the priority queue, ordered by `(k1, k2)`
+  struct HeapEntry {
+    float k1;
+    float k2;
+    uint32_t cell;
+  };
+
+  /// Marks a node that is not on the priority queue
+  static const uint32_t kNotQueued = std::numeric_limits<uint32_t>::max();
+
+  /// @brief Search from scratch with the current start and goal
+  bool Restart(std::vector<std::pair<int, int>>* path);
+  /// @brief Expand inconsistent cells until the goal's cost is settled
+  void ComputeShortestPath();
+  /// @brief Recompute the `rhs` of a cell and requeue it
+  void UpdateVertex(uint32_t cell);
+  /// @brief Queue a cell if it is inconsistent, `g != rhs`, else dequeue it
+  void Requeue(uint32_t cell);
+  /// @brief Trace the path once the search state is settled
+  /// @return false if the goal is unreachable
+  bool Finish(std::vector<std::pair<int, int>>* path);
+  /// @brief Walk the cheapest neighbors back from the goal
+  /// @return false if the goal is unreachable
+  bool ExtractPath(std::vector<std::pair<int, int>>* path) const;
+  /// @brief Get the terrain of a cell, with the start and goal markers
+  /// substituted
+  int64_t Terrain(uint32_t cell) const;
+  /// @brief Get the cost of stepping from a cell to neighbor `k` of it,
+  /// infinite if the neighbor is impassable
+  float StepCost(uint32_t from, uint32_t to, int k) const;
+  /// @brief Get the estimated cost from a cell to the goal
+  float Heuristic(uint32_t cell) const;
+  /// @brief Check if a queue key orders before another
+  static bool KeyLess(float a1, float a2, float b1, float b2) {
+    return a1 < b1 || (a1 == b1 && a2 < b2);
+  }
+  /// @brief Add, move or remove a cell in the queue
+  void HeapSet(uint32_t cell, float k1, float k2);
+  void HeapRemove(uint32_t cell);
+  void SiftUp(size_t index);
+  void SiftDown(size_t index);
+
+  /// The options to search with
+  SearchOptions options_;
+  /// The map, with change tracking on
+  ElevationMap map_;
+  /// The map version the search state is up to date with
+  uint64_t planned_version_;
+  /// Set once `Plan` has been called
+  bool planned_;
+  /// Set when the search state can not be repaired and `Replan` has to
+  /// search from scratch
+  bool restart_;
+  /// The endpoints and agl of the last `Plan`
+  std::pair<int, int> start_;
+  std::pair<int, int> goal_;
+  int agl_;
+  /// The cell indices of the endpoints
+  uint32_t start_cell_;
+  uint32_t goal_cell_;
+  /// The terrain under the start and goal markers
+  int64_t start_elevation_;
+  int64_t goal_elevation_;
+  /// Counters from the most recent plan
+  SearchStats stats_;
+  size_t changed_cells_;
+  /// Per-cell search state, indexed by row-major cell index
+  std::vector<Node> nodes_;
+  /// The priority queue of inconsistent cells
+  std::vector<HeapEntry> heap_;
+  /// Scratch for the cells a replan repairs
+  std::vector<std::pair<int, int>> changes_;
+  std::vector<uint32_t> affected_;
+};
+}
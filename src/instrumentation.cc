@@ -0,0 +1,202 @@
+#include "instrumentation.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+using namespace path_planning;
+
+std::atomic<MetricsSink*> path_planning::internal::g_metrics_sink(nullptr);
+
+namespace {
+
+/// @brief Get the histogram bucket of a latency, the number of significant
+/// bits so bucket `b` holds [2^(b-1), 2^b)
+int Bucket(int64_t nanoseconds) {
+  int bucket = 0;
+  uint64_t value = nanoseconds > 0 ? uint64_t(nanoseconds) : 0;
+  while (value != 0 && bucket < HistogramSink::kBuckets - 1) {
+    value >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+const char* path_planning::StageName(Stage stage) {
+  switch (stage) {
+    case Stage::kMapLoad:
+      return "map_load";
+    case Stage::kPlanPath:
+      return "plan_path";
+    case Stage::kBasePath:
+      return "base_path";
+    case Stage::kSearch:
+      return "search";
+    case Stage::kReplan:
+      return "replan";
+    case Stage::kSmoothPath:
+      return "smooth_path";
+    case Stage::kAglOffset:
+      return "agl_offset";
+    case Stage::kMedianFilter:
+      return "median_filter";
+    case Stage::kMeanFilter:
+      return "mean_filter";
+    case Stage::kLowpassFilter:
+      return "lowpass_filter";
+    case Stage::kCorrectPath:
+      return "correct_path";
+    case Stage::kOptimizeAltitude:
+      return "optimize_altitude";
+    case Stage::kQueueWait:
+      return "queue_wait";
+    default:
+      return "unknown";
+  }
+}
+
+const char* path_planning::CounterName(Counter counter) {
+  switch (counter) {
+    case Counter::kCellsVisited:
+      return "cells_visited";
+    case Counter::kNodesExpanded:
+      return "nodes_expanded";
+    case Counter::kPathCells:
+      return "path_cells";
+    case Counter::kAllocations:
+      return "allocations";
+    case Counter::kFailedPlans:
+      return "failed_plans";
+    case Counter::kTileCacheHits:
+      return "tile_cache_hits";
+    case Counter::kTileCacheMisses:
+      return "tile_cache_misses";
+    case Counter::kPathCacheHits:
+      return "path_cache_hits";
+    case Counter::kPathCacheMisses:
+      return "path_cache_misses";
+    case Counter::kRejectedRequests:
+      return "rejected_requests";
+    case Counter::kCancelledRequests:
+      return "cancelled_requests";
+    case Counter::kExpiredRequests:
+      return "expired_requests";
+    default:
+      return "unknown";
+  }
+}
+
+void path_planning::SetMetricsSink(MetricsSink* sink) {
+  internal::g_metrics_sink.store(sink, std::memory_order_release);
+}
+
+HistogramSink::HistogramSink() {
+  Reset();
+}
+
+void HistogramSink::RecordLatency(Stage stage, int64_t nanoseconds) {
+  StageHistogram& histogram = stages_[int(stage)];
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+  histogram.total_ns.fetch_add(nanoseconds, std::memory_order_relaxed);
+  histogram.buckets[Bucket(nanoseconds)].fetch_add(
+      1, std::memory_order_relaxed);
+  int64_t max = histogram.max_ns.load(std::memory_order_relaxed);
+  while (nanoseconds > max &&
+         !histogram.max_ns.compare_exchange_weak(max, nanoseconds,
+                                                 std::memory_order_relaxed)) {
+  }
+}
+
+void HistogramSink::RecordCount(Counter counter, int64_t value) {
+  counters_[int(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void HistogramSink::Reset() {
+  for (StageHistogram& histogram : stages_) {
+    histogram.count.store(0, std::memory_order_relaxed);
+    histogram.total_ns.store(0, std::memory_order_relaxed);
+    histogram.max_ns.store(0, std::memory_order_relaxed);
+    for (auto& bucket : histogram.buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+  for (auto& counter : counters_) {
+    counter.store(0, std::memory_order_relaxed);
+  }
+}
+
+int64_t HistogramSink::count(Stage stage) const {
+  return stages_[int(stage)].count.load(std::memory_order_relaxed);
+}
+
+int64_t HistogramSink::total_ns(Stage stage) const {
+  return stages_[int(stage)].total_ns.load(std::memory_order_relaxed);
+}
+
+int64_t HistogramSink::max_ns(Stage stage) const {
+  return stages_[int(stage)].max_ns.load(std::memory_order_relaxed);
+}
+
+int64_t HistogramSink::Percentile(Stage stage, double percentile) const {
+  const StageHistogram& histogram = stages_[int(stage)];
+  int64_t total = histogram.count.load(std::memory_order_relaxed);
+  if (total == 0) {
+    return 0;
+  }
+  // The rank of the percentile sample, counting from 1
+  int64_t rank = int64_t(percentile / 100.0 * double(total) + 0.5);
+  rank = std::max<int64_t>(1, std::min(rank, total));
+  int64_t seen = 0;
+  for (int bucket = 0; bucket < kBuckets; bucket++) {
+    seen += histogram.buckets[bucket].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      if (bucket == 0 || bucket == kBuckets - 1) {
+        return bucket == 0 ? 0 : max_ns(stage);
+      }
+      return std::min((int64_t(1) << bucket) - 1, max_ns(stage));
+    }
+  }
+  return max_ns(stage);
+}
+
+int64_t HistogramSink::counter(Counter counter) const {
+  return counters_[int(counter)].load(std::memory_order_relaxed);
+}
+
+void HistogramSink::WriteJson(std::ostream& out) const {
+  out << "{\n  \"stages\": {";
+  bool first = true;
+  for (int i = 0; i < int(Stage::kCount); i++) {
+    Stage stage = Stage(i);
+    int64_t runs = count(stage);
+    if (runs == 0) {
+      continue;
+    }
+    out << (first ? "\n" : ",\n") << "    \"" << StageName(stage)
+        << "\": {\"count\": " << runs << ", \"total_ns\": " << total_ns(stage)
+        << ", \"mean_ns\": " << total_ns(stage) / runs
+        << ", \"p50_ns\": " << Percentile(stage, 50)
+        << ", \"p99_ns\": " << Percentile(stage, 99)
+        << ", \"max_ns\": " << max_ns(stage) << "}";
+    first = false;
+  }
+  out << "\n  },\n  \"counters\": {";
+  for (int i = 0; i < int(Counter::kCount); i++) {
+    out << (i == 0 ? "\n" : ",\n") << "    \"" << CounterName(Counter(i))
+        << "\": " << counter(Counter(i));
+  }
+  out << "\n  }\n}\n";
+}
+
+bool HistogramSink::WriteJson(const std::string& filename) const {
+  std::ofstream out_file(filename);
+  if (!out_file.is_open()) {
+    std::cerr << "HistogramSink::WriteJson: ERROR! Unable to open "
+              << filename << std::endl;
+    return false;
+  }
+  WriteJson(out_file);
+  return bool(out_file);
+}
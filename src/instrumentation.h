@@ -0,0 +1,247 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+namespace path_planning {
+
+/// The planning stages that are timed
+enum class Stage {
+  /// Reading a text map or opening a binary map
+  kMapLoad = 0,
+  /// A whole `PlanPath` call, base path plus agl offset
+  kPlanPath,
+  /// Generating the base path between the start and goal
+  kBasePath,
+  /// The grid search inside base path generation
+  kSearch,
+  /// Repairing a path after map changes in `IncrementalPlanner::Replan`
+  kReplan,
+  /// Pulling a planned path taut into straight segments
+  kSmoothPath,
+  /// Adding the agl to a profile
+  kAglOffset,
+  /// The profile filters
+  kMedianFilter,
+  kMeanFilter,
+  kLowpassFilter,
+  /// Clipping a filtered profile to the minimum clearance
+  kCorrectPath,
+  /// Planning the altitude along a path within climb and descent rates
+  kOptimizeAltitude,
+  /// A request waiting in the queue of a `PlanningService`
+  kQueueWait,
+  /// The number of stages
+  kCount
+};
+
+/// The events that are counted
+enum class Counter {
+  /// Cells whose cost was computed by a search
+  kCellsVisited = 0,
+  /// Cells popped from a search's open list
+  kNodesExpanded,
+  /// Cells in planned paths
+  kPathCells,
+  /// Planner, search and pipeline buffers that had to grow
+  kAllocations,
+  /// Plans that failed
+  kFailedPlans,
+  /// Tile lookups served from and missing a `TileCache`
+  kTileCacheHits,
+  kTileCacheMisses,
+  /// Plans served from and missing a `PathCache`
+  kPathCacheHits,
+  kPathCacheMisses,
+  /// Requests a `PlanningService` turned away with a full queue, that were
+  /// cancelled and that missed their deadline
+  kRejectedRequests,
+  kCancelledRequests,
+  kExpiredRequests,
+  /// The number of counters
+  kCount
+};
+
+/// @brief Get the name of a stage, as used in the JSON dump
+const char* StageName(Stage stage);
+
+/// @brief Get the name of a counter, as used in the JSON dump
+const char* CounterName(Counter counter);
+
+/// @class Receives the timings and counts from the library. Implementations
+/// must be thread safe since batch planning records from every worker.
+class MetricsSink {
+ public:
+  /// @brief Destructor
+  virtual ~MetricsSink() {}
+  /// @brief Record the latency of one run of a stage
+  virtual void RecordLatency(Stage stage, int64_t nanoseconds) = 0;
+  /// @brief Add to a counter
+  virtual void RecordCount(Counter counter, int64_t value) = 0;
+};
+
+/// @brief Install the sink that receives metrics, or nullptr to stop
+/// recording. The sink is not owned and must outlive any planning that runs
+/// while it is installed.
+void SetMetricsSink(MetricsSink* sink);
+
+/// @brief Get the installed sink, nullptr if none
+inline MetricsSink* metrics_sink();
+
+/// @class In memory sink that keeps a log2 latency histogram per stage and a
+/// total per counter, all in relaxed atomics so recording never locks
+class HistogramSink : public MetricsSink {
+ public:
+  /// The number of histogram buckets. Bucket `b` holds latencies in
+  /// [2^(b-1), 2^b) nanoseconds, so the last covers about 292 years.
+  static const int kBuckets = 64;
+
+  /// @brief Constructor
+  HistogramSink();
+  void RecordLatency(Stage stage, int64_t nanoseconds) override;
+  void RecordCount(Counter counter, int64_t value) override;
+  /// @brief Zero every histogram and counter
+  void Reset();
+  /// @brief Get the number of recorded runs of a stage
+  int64_t count(Stage stage) const;
+  /// @brief Get the total nanoseconds recorded for a stage
+  int64_t total_ns(Stage stage) const;
+  /// @brief Get the largest latency recorded for a stage
+  int64_t max_ns(Stage stage) const;
+  /// @brief Get an approximate latency percentile for a stage, the upper
+  /// bound of the bucket the percentile falls in
+  /// @param percentile - The percentile on [0, 100]
+  int64_t Percentile(Stage stage, double percentile) const;
+  /// @brief Get the total of a counter
+  int64_t counter(Counter counter) const;
+  /// @brief Write every stage and counter as a JSON object
+  void WriteJson(std::ostream& out) const;
+  /// @brief Write the JSON dump to a file
+  /// @return true if the file was written
+  bool WriteJson(const std::string& filename) const;
+
+ private:
+  /// @struct Latency statistics of one stage
+  struct StageHistogram {
+    std::atomic<int64_t> count;
+    std::atomic<int64_t> total_ns;
+    std::atomic<int64_t> max_ns;
+    std::atomic<int64_t> buckets[kBuckets];
+  };
+
+  /// Per stage histograms
+  StageHistogram stages_[int(Stage::kCount)];
+  /// Per counter totals
+  std::atomic<int64_t> counters_[int(Counter::kCount)];
+};
+
+/// @class Sink that forwards every record to callbacks, e.g. to feed an
+/// existing metrics system
+class CallbackSink : public MetricsSink {
+ public:
+  /// @brief Constructor
+  /// @param on_latency - Called for every stage latency, may be empty
+  /// @param on_count - Called for every counter increment, may be empty
+  CallbackSink(std::function<void(Stage, int64_t)> on_latency,
+               std::function<void(Counter, int64_t)> on_count)
+      : on_latency_(on_latency), on_count_(on_count) {}
+  void RecordLatency(Stage stage, int64_t nanoseconds) override {
+    if (on_latency_) {
+      on_latency_(stage, nanoseconds);
+    }
+  }
+  void RecordCount(Counter counter, int64_t value) override {
+    if (on_count_) {
+      on_count_(counter, value);
+    }
+  }
+
+ private:
+  /// The callbacks
+  std::function<void(Stage, int64_t)> on_latency_;
+  std::function<void(Counter, int64_t)> on_count_;
+};
+
+/// @class Times the enclosing scope and records it to the sink that was
+/// installed when the scope was entered. With no sink it does not read the
+/// clock. Use through `PP_SCOPED_TIMER` so it compiles out when
+/// instrumentation is disabled.
+class ScopedTimer {
+ public:
+  /// @brief Constructor, starts timing if a sink is installed
+  explicit ScopedTimer(Stage stage) : stage_(stage), sink_(metrics_sink()) {
+    if (sink_ != nullptr) {
+      start_ = std::chrono::steady_clock::now();
+    }
+  }
+  /// @brief Destructor, records the elapsed time
+  ~ScopedTimer() {
+    if (sink_ != nullptr) {
+      sink_->RecordLatency(
+          stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - start_)
+                      .count());
+    }
+  }
+  ScopedTimer(const ScopedTimer&) = delete;
+  ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+ private:
+  /// The stage being timed
+  Stage stage_;
+  /// The sink to record to, nullptr if not timing
+  MetricsSink* sink_;
+  /// When the scope was entered
+  std::chrono::steady_clock::time_point start_;
+};
+
+/// @brief Add to a counter if a sink is installed
+inline void AddCount(Counter counter, int64_t value) {
+  MetricsSink* sink = metrics_sink();
+  if (sink != nullptr && value != 0) {
+    sink->RecordCount(counter, value);
+  }
+}
+
+/// @brief Record a latency measured outside of a scope if a sink is
+/// installed
+inline void AddLatency(Stage stage, int64_t nanoseconds) {
+  MetricsSink* sink = metrics_sink();
+  if (sink != nullptr) {
+    sink->RecordLatency(stage, nanoseconds);
+  }
+}
+
+namespace internal {
+/// The installed sink, read on every timed scope
+extern std::atomic<MetricsSink*> g_metrics_sink;
+}
+
+inline MetricsSink* metrics_sink() {
+  return internal::g_metrics_sink.load(std::memory_order_acquire);
+}
+}
+
+#define PP_INSTRUMENTATION_CONCAT_(a, b) a##b
+#define PP_INSTRUMENTATION_CONCAT(a, b) PP_INSTRUMENTATION_CONCAT_(a, b)
+
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+/// Time the rest of the enclosing scope as a `Stage`
+#define PP_SCOPED_TIMER(stage)                                       \
+  ::path_planning::ScopedTimer PP_INSTRUMENTATION_CONCAT(pp_timer_, \
+                                                         __LINE__)(stage)
+/// Add to a `Counter`
+#define PP_COUNTER_ADD(counter, value) \
+  ::path_planning::AddCount(counter, int64_t(value))
+/// Record a latency in nanoseconds as a `Stage`
+#define PP_LATENCY_ADD(stage, nanoseconds) \
+  ::path_planning::AddLatency(stage, int64_t(nanoseconds))
+#else
+#define PP_SCOPED_TIMER(stage) static_cast<void>(0)
+#define PP_COUNTER_ADD(counter, value) static_cast<void>(0)
+#define PP_LATENCY_ADD(stage, nanoseconds) static_cast<void>(0)
+#endif
@@ -0,0 +1,193 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+
+#include "line_of_sight.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// The most a shortcut is ever allowed to rise, past any elevation a map
+/// can hold, so adding it to an elevation cannot overflow
+const int64_t kMaxRise = int64_t(1) << 40;
+
+/// @brief Visit the cells on the segment between the centers of two cells.
+/// The error term tracks which cell boundary the segment crosses next, so
+/// each step is one comparison and a few selects rather than branches.
+/// When the error is zero the segment passes through a corner, and the cell
+/// across the column step is visited before taking the row step.
+/// @param read - Gets an elevation from a cell index, row and column
+/// @param visit - Takes each elevation, returning false to stop
+/// @return false if the visitor stopped the traversal
+template <typename Reader, typename Visitor>
+bool Traverse(const std::pair<int, int>& from, const std::pair<int, int>& to,
+              ptrdiff_t cols, const Reader& read, const Visitor& visit) {
+  const int64_t row_diff = std::abs(int64_t(to.first) - from.first);
+  const int64_t col_diff = std::abs(int64_t(to.second) - from.second);
+  const int row_inc = to.first > from.first ? 1 : -1;
+  const int col_inc = to.second > from.second ? 1 : -1;
+  const ptrdiff_t row_step = row_inc * cols;
+  int row = from.first;
+  int col = from.second;
+  ptrdiff_t index = ptrdiff_t(row) * cols + col;
+  int64_t error = col_diff - row_diff;
+  for (int64_t remaining = row_diff + col_diff;; remaining--) {
+    if (!visit(read(index, row, col))) {
+      return false;
+    }
+    if (remaining == 0) {
+      return true;
+    }
+    if (error == 0 && !visit(read(index + col_inc, row, col + col_inc))) {
+      return false;
+    }
+    const bool along_row = error > 0;
+    index += along_row ? col_inc : row_step;
+    row += along_row ? 0 : row_inc;
+    col += along_row ? col_inc : 0;
+    error += along_row ? -2 * row_diff : 2 * col_diff;
+  }
+}
+
+/// @brief Visit the cells on a segment of a map, reading the cells directly
+/// when they are in memory
+template <typename Visitor>
+bool TraverseMap(const ElevationMap& emap, const std::pair<int, int>& from,
+                 const std::pair<int, int>& to, const Visitor& visit) {
+  const Elevation* cells = emap.data();
+  if (cells != nullptr) {
+    return Traverse(from, to, emap.cols(),
+                    [cells](ptrdiff_t index, int, int) {
+                      return int64_t(cells[index]);
+                    },
+                    visit);
+  }
+  return Traverse(from, to, emap.cols(),
+                  [&emap](ptrdiff_t, int row, int col) {
+                    return int64_t(emap.At(row, col));
+                  },
+                  visit);
+}
+
+}  // namespace
+
+int64_t path_planning::MaxElevationAlong(const ElevationMap& emap,
+                                         const std::pair<int, int>& from,
+                                         const std::pair<int, int>& to) {
+  int64_t highest = std::numeric_limits<int64_t>::min();
+  TraverseMap(emap, from, to, [&highest](int64_t elevation) {
+    highest = std::max(highest, elevation);
+    return true;
+  });
+  return highest;
+}
+
+bool path_planning::LineOfSight(const ElevationMap& emap,
+                                const std::pair<int, int>& from,
+                                const std::pair<int, int>& to,
+                                int64_t ceiling) {
+  return TraverseMap(emap, from, to, [ceiling](int64_t elevation) {
+    return elevation <= ceiling;
+  });
+}
+
+void path_planning::SmoothPath(const ElevationMap& terrain, int64_t ceiling,
+                               int64_t allowed_rise,
+                               std::vector<std::pair<int, int>>* path) {
+  std::vector<std::pair<int, int>>& cells = *path;
+  const size_t count = cells.size();
+  if (count <= 2) {
+    return;
+  }
+  const int64_t rise = std::min(std::max(allowed_rise, int64_t(0)), kMaxRise);
+  // The highest cell of the path from `first` to `last` inclusive
+  auto section_max = [&](size_t first, size_t last) {
+    int64_t highest = std::numeric_limits<int64_t>::min();
+    for (size_t i = first; i <= last; i++) {
+      highest = std::max(
+          highest, int64_t(terrain.At(cells[i].first, cells[i].second)));
+    }
+    return highest;
+  };
+  auto in_sight = [&](size_t anchor, size_t target, int64_t section) {
+    return LineOfSight(terrain, cells[anchor], cells[target],
+                       std::min(ceiling, section + rise));
+  };
+
+  // The corners are written over the front of the path. Only cells at or
+  // after the current anchor are read, and those are never written.
+  size_t kept = 1;
+  size_t anchor = 0;
+  while (anchor + 1 < count) {
+    // The next cell is a step the path already takes, so it is in sight
+    size_t seen = anchor + 1;
+    int64_t seen_max = section_max(anchor, seen);
+    size_t blocked = count;
+    for (size_t step = 2; seen + 1 < count; step *= 2) {
+      const size_t target = std::min(anchor + step, count - 1);
+      const int64_t section =
+          std::max(seen_max, section_max(seen + 1, target));
+      if (!in_sight(anchor, target, section)) {
+        blocked = target;
+        break;
+      }
+      seen = target;
+      seen_max = section;
+    }
+    while (blocked < count && blocked - seen > 1) {
+      const size_t middle = seen + (blocked - seen) / 2;
+      const int64_t section =
+          std::max(seen_max, section_max(seen + 1, middle));
+      if (in_sight(anchor, middle, section)) {
+        seen = middle;
+        seen_max = section;
+      } else {
+        blocked = middle;
+      }
+    }
+    cells[kept++] = cells[seen];
+    anchor = seen;
+  }
+  path->resize(kept);
+}
+
+void path_planning::SegmentProfile(
+    const ElevationMap& emap, const std::vector<std::pair<int, int>>& path,
+    std::vector<int>* profile) {
+  profile->clear();
+  profile->reserve(path.size());
+  int64_t before = std::numeric_limits<int64_t>::min();
+  for (size_t i = 0; i < path.size(); i++) {
+    // The last corner has only the segment before it, which covers its cell
+    const int64_t after = MaxElevationAlong(
+        emap, path[i], path[std::min(i + 1, path.size() - 1)]);
+    profile->push_back(int(std::max(before, after)));
+    before = after;
+  }
+}
+
+void path_planning::StepProfile(
+    const ElevationMap& emap, const std::vector<std::pair<int, int>>& path,
+    std::vector<int>* profile) {
+  profile->clear();
+  profile->reserve(path.size());
+  // Steps to an adjacent cell cross nothing else
+  auto crosses = [&](size_t from, size_t to) {
+    return std::abs(path[to].first - path[from].first) > 1 ||
+           std::abs(path[to].second - path[from].second) > 1;
+  };
+  for (size_t i = 0; i < path.size(); i++) {
+    int64_t elevation = emap.At(path[i].first, path[i].second);
+    if (i > 0 && crosses(i - 1, i)) {
+      elevation =
+          std::max(elevation, MaxElevationAlong(emap, path[i - 1], path[i]));
+    }
+    if (i + 1 < path.size() && crosses(i, i + 1)) {
+      elevation =
+          std::max(elevation, MaxElevationAlong(emap, path[i], path[i + 1]));
+    }
+    profile->push_back(int(elevation));
+  }
+}
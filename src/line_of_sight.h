@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "elevation_map.h"
+
+namespace path_planning {
+
+/// @brief Get the highest cell on the straight segment between the centers
+/// of two cells. Every cell the segment passes through is visited once with
+/// integer steps, which makes the cells a 4-connected line. Where the
+/// segment passes exactly through a corner both cells beside the corner are
+/// taken, so no terrain the segment touches is missed. Markers count as the
+/// value stored in their cell.
+/// @param emap - The map to read, in memory, mapped or tiled
+/// @param from - The row and column to start from, inside the map
+/// @param to - The row and column to finish at, inside the map
+/// @return The highest elevation along the segment
+int64_t MaxElevationAlong(const ElevationMap& emap,
+                          const std::pair<int, int>& from,
+                          const std::pair<int, int>& to);
+
+/// @brief Check if no cell on the straight segment between the centers of
+/// two cells is higher than a ceiling. Visits the same cells as
+/// `MaxElevationAlong`, stopping at the first one above the ceiling.
+/// @param emap - The map to read, in memory, mapped or tiled
+/// @param from - The row and column to start from, inside the map
+/// @param to - The row and column to finish at, inside the map
+/// @param ceiling - The highest elevation the segment may pass over
+/// @return true if the segment stays at or below the ceiling
+bool LineOfSight(const ElevationMap& emap, const std::pair<int, int>& from,
+                 const std::pair<int, int>& to, int64_t ceiling);
+
+/// @brief Pull a path of neighboring cells taut into straight segments,
+/// keeping only the cells where it turns. Works in place, without
+/// allocating.
+///
+/// From each kept cell the path is shortcut to the furthest later cell in
+/// sight, found by doubling the distance along the path and then bisecting.
+/// A shortcut is in sight if no cell along it is higher than the ceiling,
+/// nor higher than the highest cell of the section of path it replaces by
+/// more than `allowed_rise`. A shortcut therefore never has to climb above
+/// the terrain the search chose to fly over, unless allowed to.
+/// @param terrain - The map to check shortcuts against, e.g. the terrain or
+/// the `ClearanceField::max_elevation` of it
+/// @param ceiling - The highest elevation a shortcut may pass over
+/// @param allowed_rise - How far a shortcut may pass above the highest cell
+/// of the section it replaces
+/// @param path - Input and output. The cells from start to goal, each a
+/// neighbor of the one before, replaced by the corners of the pulled path
+void SmoothPath(const ElevationMap& terrain, int64_t ceiling,
+                int64_t allowed_rise,
+                std::vector<std::pair<int, int>>* path);
+
+/// @brief Get the elevation profile of a path of straight segments. Each
+/// corner takes the highest cell of the segments on either side of it, so
+/// an altitude interpolated between corners clears every segment.
+/// @param emap - The map to read
+/// @param path - The corners of the path
+/// @param profile - Output. One elevation per corner.
+void SegmentProfile(const ElevationMap& emap,
+                    const std::vector<std::pair<int, int>>& path,
+                    std::vector<int>* profile);
+
+/// @brief Get the elevation profile of a path of neighboring cells. Each
+/// cell takes its own elevation, and a cell at either end of a knight's
+/// step takes the highest cell along the step like `SegmentProfile`, so an
+/// altitude interpolated between cells clears the cells every step crosses.
+/// @param emap - The map to read
+/// @param path - The cells from start to goal, each a neighbor of the one
+/// before
+/// @param profile - Output. One elevation per cell.
+void StepProfile(const ElevationMap& emap,
+                 const std::vector<std::pair<int, int>>& path,
+                 std::vector<int>* profile);
+}
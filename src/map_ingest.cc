@@ -0,0 +1,389 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MAP_INGEST_SSE2
+#endif
+
+#include "map_ingest.h"
+#include "instrumentation.h"
+#include "mapped_file.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// Largest magnitude accepted while accumulating digits, the same as
+/// `ElevationMap::ParseMap`
+const int64_t kMaxParsedMagnitude = int64_t(1) << 40;
+
+/// @struct A piece of the map text that ends just after a row's closing `]`
+struct Shard {
+  /// The text of the shard
+  const char* begin;
+  const char* end;
+  /// The bracket depth the shard starts at, 0 for the first shard and the
+  /// depth between rows for the others
+  int start_depth = 0;
+  /// The bracket depth the shard ends at
+  int end_depth = 0;
+  /// The number of cells counted by the first pass
+  size_t cells = 0;
+  /// Where the cells of the shard start in the grid
+  size_t cell_offset = 0;
+  /// Set if the shard is only separators, e.g. after the closing `]`
+  bool blank = true;
+  /// Set if the shard parsed and held exactly the counted cells
+  bool parsed = false;
+  /// The number of non-empty rows, and their size
+  int rows = 0;
+  int cols = 0;
+  /// The special locations in the shard in order, on rows of the shard
+  std::vector<MarkedLocation> locations;
+};
+
+/// @brief Count the cells of a shard the way `ParseShard` will find them.
+/// A run of signs and digits is one cell and a `(` starts a location marker.
+/// Malformed runs like `1-2`, which the parser splits, are counted as one
+/// so the counts disagree and the text is parsed serially instead.
+size_t CountCells(const char* begin, const char* end) {
+  size_t count = 0;
+  bool in_number = false;
+  const char* p = begin;
+#if defined(MAP_INGEST_SSE2)
+  // 16 bytes at a time: a cell starts at a number byte whose predecessor is
+  // not one, or at a `(`
+  const __m128i zero = _mm_set1_epi8('0' - 1);
+  const __m128i nine = _mm_set1_epi8('9' + 1);
+  const __m128i minus = _mm_set1_epi8('-');
+  const __m128i plus = _mm_set1_epi8('+');
+  const __m128i paren = _mm_set1_epi8('(');
+  for (; end - p >= 16; p += 16) {
+    const __m128i bytes =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(bytes, zero),
+                                        _mm_cmplt_epi8(bytes, nine));
+    const __m128i number =
+        _mm_or_si128(digit, _mm_or_si128(_mm_cmpeq_epi8(bytes, minus),
+                                         _mm_cmpeq_epi8(bytes, plus)));
+    const unsigned numbers = unsigned(_mm_movemask_epi8(number));
+    const unsigned parens =
+        unsigned(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, paren)));
+    unsigned starts =
+        (numbers & ~((numbers << 1) | unsigned(in_number))) | parens;
+    // Clear the lowest set bit until none are left
+    for (; starts != 0; starts &= starts - 1) {
+      count++;
+    }
+    in_number = (numbers >> 15) & 1u;
+  }
+#endif
+  for (; p < end; p++) {
+    const char c = *p;
+    const bool number = unsigned(c - '0') < 10u || c == '-' || c == '+';
+    count += size_t((number && !in_number) || c == '(');
+    in_number = number;
+  }
+  return count;
+}
+
+/// @brief Parse a shard into its slice of the grid, following the grammar of
+/// `ElevationMap::ParseMap`
+/// @return false if the shard is malformed on its own or its cells do not
+/// match the first pass, without saying why
+bool ParseShard(Shard* shard, Elevation* cells) {
+  const char* p = shard->begin;
+  const char* end = shard->end;
+  int depth = shard->start_depth;
+  size_t count = 0;
+  size_t row_start = 0;
+  while (p < end) {
+    const char c = *p;
+    if (unsigned(c - '0') < 10u || c == '-' || c == '+') {
+      const bool negative = c == '-';
+      if (c == '-' || c == '+') {
+        p++;
+      }
+      int64_t value = 0;
+      const char* digits = p;
+      unsigned digit;
+      while (p < end && (digit = unsigned(*p - '0')) < 10u) {
+        value = value * 10 + digit;
+        if (value > kMaxParsedMagnitude) {
+          return false;
+        }
+        p++;
+      }
+      if (negative) {
+        value = -value;
+      }
+      if (p == digits || depth == 0 || count == shard->cells ||
+          value < std::numeric_limits<Elevation>::min() ||
+          value > std::numeric_limits<Elevation>::max()) {
+        return false;
+      }
+      cells[count++] = Elevation(value);
+      shard->blank = false;
+      continue;
+    }
+
+    switch (c) {
+      case ',':
+      case ' ':
+      case '\t':
+      case '\r':
+      case '\n':
+        p++;
+        break;
+      case '[':
+        depth++;
+        shard->blank = false;
+        p++;
+        break;
+      case ']': {
+        if (depth == 0) {
+          return false;
+        }
+        depth--;
+        shard->blank = false;
+        const int row_size = int(count - row_start);
+        if (row_size > 0) {
+          if (shard->rows == 0) {
+            shard->cols = row_size;
+          } else if (row_size != shard->cols) {
+            return false;
+          }
+          shard->rows++;
+          row_start = count;
+        }
+        p++;
+        break;
+      }
+      case '(': {
+        if (end - p < 3 || p[2] != ')' || depth == 0 ||
+            count == shard->cells) {
+          return false;
+        }
+        const int marker = MarkerValue(p[1]);
+        if (marker == 0) {
+          return false;
+        }
+        cells[count++] = Elevation(marker);
+        shard->locations.push_back(MarkedLocation{
+            p[1], shard->rows, int(count - row_start) - 1});
+        shard->blank = false;
+        p += 3;
+        break;
+      }
+      default:
+        return false;
+    }
+  }
+  // Shards end between rows, so a row left open is malformed
+  shard->end_depth = depth;
+  return count == row_start && count == shard->cells;
+}
+
+/// @brief Get the seconds since a point in time
+double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+}  // namespace
+
+bool path_planning::ParseMapSharded(const char* text, size_t size,
+                                    ThreadPool* pool, ElevationMap* emap,
+                                    MapReadError* error,
+                                    size_t min_shard_bytes) {
+  const size_t threads = pool ? size_t(pool->size()) : 1;
+  // A few shards per thread so uneven rows balance out
+  const size_t num_shards =
+      std::min(threads * 4, size / std::max(min_shard_bytes, size_t(1)));
+  if (threads < 2 || num_shards < 2) {
+    return emap->ParseMap(text, size, error);
+  }
+
+  // The depth between rows is one less than the depth of the first row, 1
+  // inside an outer list and 0 for rows given one after another
+  const char* end = text + size;
+  const void* first_close = std::memchr(text, ']', size);
+  const char* first_row_end =
+      first_close ? static_cast<const char*>(first_close) : end;
+  const int row_depth =
+      std::max(int(std::count(text, first_row_end, '[')) - 1, 0);
+
+  // Move each split point forward to just past the next `]`, which ends a
+  // row unless the text is malformed
+  std::vector<Shard> shards;
+  const char* begin = text;
+  for (size_t k = 1; k <= num_shards && begin < end; k++) {
+    const char* split = end;
+    if (k < num_shards) {
+      split = std::max(text + size / num_shards * k, begin);
+      const void* close = std::memchr(split, ']', size_t(end - split));
+      split = close ? static_cast<const char*>(close) + 1 : end;
+    }
+    Shard shard;
+    shard.begin = begin;
+    shard.end = split;
+    shard.start_depth = row_depth;
+    shards.push_back(std::move(shard));
+    begin = split;
+  }
+  shards[0].start_depth = 0;
+
+  // Count the cells of every shard, then parse each into its own slice
+  pool->ParallelFor(shards.size(), [&](size_t i, int) {
+    shards[i].cells = CountCells(shards[i].begin, shards[i].end);
+  });
+  size_t total = 0;
+  for (Shard& shard : shards) {
+    shard.cell_offset = total;
+    total += shard.cells;
+  }
+  std::vector<Elevation> cells(total);
+  pool->ParallelFor(shards.size(), [&](size_t i, int) {
+    shards[i].parsed = ParseShard(&shards[i], cells.data() +
+                                                  shards[i].cell_offset);
+  });
+
+  // Check the shards fit together: each one starts where the last ended
+  // and all rows are the same size
+  bool consistent = true;
+  int depth = 0;
+  int rows = 0;
+  int cols = 0;
+  std::vector<MarkedLocation> locations;
+  for (const Shard& shard : shards) {
+    if (!shard.parsed) {
+      consistent = false;
+      break;
+    }
+    if (shard.blank) {
+      continue;
+    }
+    if (shard.start_depth != depth ||
+        (shard.rows > 0 && cols > 0 && shard.cols != cols)) {
+      consistent = false;
+      break;
+    }
+    for (const MarkedLocation& loc : shard.locations) {
+      locations.push_back(
+          MarkedLocation{loc.marker, rows + loc.row, loc.col});
+    }
+    depth = shard.end_depth;
+    cols = shard.rows > 0 ? shard.cols : cols;
+    rows += shard.rows;
+  }
+  if (!consistent || depth != 0 || rows == 0 ||
+      size_t(rows) * size_t(cols) != total) {
+    // Let the serial parser find and describe the problem
+    return emap->ParseMap(text, size, error);
+  }
+  return emap->Assign(rows, cols, std::move(cells), locations);
+}
+
+MapIngester::MapIngester(int num_threads)
+    : pool_(new ThreadPool(num_threads)) {
+}
+
+bool MapIngester::ReadMap(const std::string& map_filename,
+                          ElevationMap* emap, MapReadError* error) {
+  PP_SCOPED_TIMER(Stage::kMapLoad);
+  const auto start = std::chrono::steady_clock::now();
+  emap->Clear();
+  MappedFile file;
+  if (!file.Open(map_filename)) {
+    std::cerr << "MapIngester::ReadMap: ERROR! Unable to read map file: "
+              << map_filename << std::endl;
+    if (error) {
+      *error = MapReadError();
+      error->message = "Unable to open file";
+    }
+    return false;
+  }
+  file.AdviseSequential();
+
+  MapReadError local_error;
+  if (!error) {
+    error = &local_error;
+  }
+  if (!ParseMapSharded(file.data(), file.size(), pool_.get(), emap, error)) {
+    std::cerr << "MapIngester::ReadMap: " << map_filename << ":"
+              << error->line << ":" << error->column << ": "
+              << error->message << std::endl;
+    return false;
+  }
+  stats_.files++;
+  stats_.bytes += file.size();
+  stats_.cells += emap->size();
+  stats_.parse_seconds += SecondsSince(start);
+  return true;
+}
+
+bool MapIngester::Convert(const IngestJob& job, MapReadError* error) {
+  ElevationMap emap;
+  if (!ReadMap(job.input, &emap, error)) {
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  const bool written = emap.WriteBinaryMap(job.output, job.tile_size);
+  stats_.write_seconds += SecondsSince(start);
+  return written;
+}
+
+bool MapIngester::ConvertAll(const std::vector<IngestJob>& jobs,
+                             std::vector<IngestResult>* results) {
+  std::vector<IngestResult> local_results;
+  if (!results) {
+    results = &local_results;
+  }
+  results->assign(jobs.size(), IngestResult());
+
+  // The map being written, which thread writes it and how it went
+  ElevationMap writing;
+  size_t writing_index = 0;
+  std::thread writer;
+  bool written = false;
+  double write_seconds = 0.0;
+  auto finish_write = [&]() {
+    if (writer.joinable()) {
+      writer.join();
+      (*results)[writing_index].success = written;
+      stats_.write_seconds += write_seconds;
+    }
+  };
+
+  bool all_converted = true;
+  for (size_t i = 0; i < jobs.size(); i++) {
+    ElevationMap emap;
+    const bool read = ReadMap(jobs[i].input, &emap, &(*results)[i].error);
+    finish_write();
+    if (!read) {
+      all_converted = false;
+      continue;
+    }
+    writing = std::move(emap);
+    writing_index = i;
+    const IngestJob& job = jobs[i];
+    writer = std::thread([&writing, &written, &write_seconds, &job]() {
+      const auto start = std::chrono::steady_clock::now();
+      written = writing.WriteBinaryMap(job.output, job.tile_size);
+      write_seconds = SecondsSince(start);
+    });
+  }
+  finish_write();
+  for (const IngestResult& result : *results) {
+    all_converted = all_converted && result.success;
+  }
+  return all_converted;
+}
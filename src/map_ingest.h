@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "elevation_map.h"
+#include "thread_pool.h"
+
+namespace path_planning {
+
+/// The smallest shard of map text worth parsing on its own thread
+static const size_t kMinShardBytes = size_t(1) << 20;
+
+/// @brief Parse a map from the bracketed text format on several threads.
+///
+/// The text is split into shards that each end just after a row's closing
+/// `]`. A first parallel pass counts the cells of each shard, so the second
+/// pass can parse every shard straight into its slice of the destination
+/// grid. The special locations found by each shard are merged in row order.
+///
+/// The result is always the same as `ElevationMap::ParseMap`. If the shards
+/// do not fit together, e.g. the text is malformed, the whole text is parsed
+/// again on one thread to report the error exactly as `ParseMap` would.
+/// @param text - The start of the map text
+/// @param size - The number of bytes of map text
+/// @param pool - The threads to parse on. Null parses on the calling thread.
+/// @param emap - Output. The parsed map
+/// @param error - Optional. Filled in with the location and reason of a
+/// failure
+/// @param min_shard_bytes - The smallest shard to split the text into
+/// @return true if the map was successfully parsed
+bool ParseMapSharded(const char* text, size_t size, ThreadPool* pool,
+                     ElevationMap* emap, MapReadError* error = nullptr,
+                     size_t min_shard_bytes = kMinShardBytes);
+
+/// @struct A text map to convert to the binary format
+struct IngestJob {
+  /// The text map to read
+  std::string input;
+  /// The `.emap` file to write
+  std::string output;
+  /// The tile size to write with, see `ElevationMap::WriteBinaryMap`
+  int tile_size = 0;
+};
+
+/// @struct The outcome of a single `IngestJob`
+struct IngestResult {
+  /// true if the map was read and written
+  bool success = false;
+  /// Why the map failed to parse, if it did
+  MapReadError error;
+};
+
+/// @struct Totals over everything an ingester has processed
+struct IngestStats {
+  /// The number of maps read
+  size_t files = 0;
+  /// The bytes of map text read
+  size_t bytes = 0;
+  /// The cells of the maps read
+  size_t cells = 0;
+  /// The wall clock seconds spent reading and parsing
+  double parse_seconds = 0.0;
+  /// The wall clock seconds spent writing binary maps
+  double write_seconds = 0.0;
+};
+
+/// @class Reads text maps with `ParseMapSharded` on a pool of threads that
+/// is kept between maps, and converts them to the binary `.emap` format.
+/// When converting a batch, each map is written out on a separate thread
+/// while the next one is parsed.
+class MapIngester {
+ public:
+  /// @brief Constructor
+  /// @param num_threads - The number of parsing threads, or 0 to use one per
+  /// hardware thread
+  explicit MapIngester(int num_threads = 0);
+  /// @brief Read a text map
+  /// @param map_filename - The file to read the map from
+  /// @param emap - Output. The map
+  /// @param error - Optional. Filled in with the location and reason of a
+  /// failure
+  /// @return true if the map was successfully read
+  bool ReadMap(const std::string& map_filename, ElevationMap* emap,
+               MapReadError* error = nullptr);
+  /// @brief Read a text map and write it in the binary format
+  /// @param job - The files and tile size
+  /// @param error - Optional. Filled in with the location and reason of a
+  /// parse failure
+  /// @return true if the map was read and written
+  bool Convert(const IngestJob& job, MapReadError* error = nullptr);
+  /// @brief Convert many text maps, overlapping the write of each map with
+  /// parsing the next
+  /// @param jobs - The maps to convert
+  /// @param results - Optional. One result per job, in job order
+  /// @return true if every map was converted
+  bool ConvertAll(const std::vector<IngestJob>& jobs,
+                  std::vector<IngestResult>* results = nullptr);
+  /// @brief Get the number of parsing threads
+  int num_threads() const { return pool_->size(); }
+  /// @brief Get the totals over everything read so far
+  const IngestStats& stats() const { return stats_; }
+
+ private:
+  /// The parsing threads
+  std::unique_ptr<ThreadPool> pool_;
+  /// Totals over everything read so far
+  IngestStats stats_;
+};
+}
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+
+#include "arena.h"
+#include "map_pyramid.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// @brief Get the number of cells of a level along one side, given the
+/// number along the same side of the level below
+int HalfSize(int size) {
+  return (size + 1) / 2;
+}
+
+}  // namespace
+
+MapPyramid::MapPyramid() : rows_(0), cols_(0) {
+}
+
+void MapPyramid::Clear() {
+  levels_.clear();
+  rows_ = 0;
+  cols_ = 0;
+}
+
+bool MapPyramid::Build(const ElevationMap& emap, int num_levels,
+                       ThreadPool* pool) {
+  Clear();
+  if (emap.size() == 0 || num_levels < 0) {
+    std::cerr << "MapPyramid::Build: ERROR! The map is empty or the number "
+                 "of levels is negative" << std::endl;
+    return false;
+  }
+  rows_ = emap.rows();
+  cols_ = emap.cols();
+
+  int rows = rows_;
+  int cols = cols_;
+  while (num_levels > 0 ? int(levels_.size()) < num_levels
+                        : rows > 1 || cols > 1) {
+    rows = HalfSize(rows);
+    cols = HalfSize(cols);
+    PyramidLevel level;
+    level.scale = levels_.empty() ? 2 : 2 * levels_.back().scale;
+    const size_t cells = size_t(rows) * size_t(cols);
+    level.max.Assign(rows, cols, std::vector<Elevation>(cells));
+    level.min.Assign(rows, cols, std::vector<Elevation>(cells));
+    level.mean.Assign(rows, cols, std::vector<Elevation>(cells));
+    levels_.push_back(std::move(level));
+    ReduceRegion(emap, int(levels_.size()), 0, rows, 0, cols, pool);
+  }
+  return true;
+}
+
+bool MapPyramid::Update(const ElevationMap& emap, int row, int col, int rows,
+                        int cols, ThreadPool* pool) {
+  if (emap.rows() != rows_ || emap.cols() != cols_) {
+    std::cerr << "MapPyramid::Update: ERROR! The map is not the size the "
+                 "pyramid was built for" << std::endl;
+    return false;
+  }
+  // The changed rectangle, clipped to the map, in the cells of each level
+  int row_begin = std::max(0, row);
+  int row_end = std::min(rows_, row + rows);
+  int col_begin = std::max(0, col);
+  int col_end = std::min(cols_, col + cols);
+  for (int level = 1; level <= num_levels(); level++) {
+    if (row_begin >= row_end || col_begin >= col_end) {
+      break;
+    }
+    row_begin /= 2;
+    row_end = HalfSize(row_end);
+    col_begin /= 2;
+    col_end = HalfSize(col_end);
+    ReduceRegion(emap, level, row_begin, row_end, col_begin, col_end, pool);
+  }
+  return true;
+}
+
+void MapPyramid::ReduceRegion(const ElevationMap& emap, int level,
+                              int row_begin, int row_end, int col_begin,
+                              int col_end, ThreadPool* pool) {
+  PyramidLevel& out = levels_[size_t(level - 1)];
+  // Unshare the level maps here, never from the workers
+  Elevation* out_max = out.max.data();
+  Elevation* out_min = out.min.data();
+  Elevation* out_mean = out.mean.data();
+  const size_t out_cols = size_t(out.max.cols());
+  const PyramidLevel* below =
+      level > 1 ? &levels_[size_t(level - 2)] : nullptr;
+  const int child_rows = below ? below->max.rows() : emap.rows();
+  const int child_cols = below ? below->max.cols() : emap.cols();
+  const int child_scale = out.scale / 2;
+  // In memory maps are read through a pointer, tiled ones through the cache
+  const Elevation* map_cells = emap.data();
+
+  auto reduce_band = [&](size_t band, int) {
+    const int band_begin = row_begin + int(band) * kBandRows;
+    const int band_end = std::min(row_end, band_begin + kBandRows);
+    for (int row = band_begin; row < band_end; row++) {
+      for (int col = col_begin; col < col_end; col++) {
+        int64_t highest = std::numeric_limits<int64_t>::min();
+        int64_t lowest = std::numeric_limits<int64_t>::max();
+        // Level 1 averages the map cells, higher levels weight the means of
+        // the level below by the map cells each one covers
+        double sum = 0.0;
+        double weight = 0.0;
+        for (int child_row = 2 * row;
+             child_row < std::min(2 * row + 2, child_rows); child_row++) {
+          for (int child_col = 2 * col;
+               child_col < std::min(2 * col + 2, child_cols); child_col++) {
+            if (below == nullptr) {
+              const Elevation value =
+                  map_cells != nullptr
+                      ? map_cells[emap.Index(child_row, child_col)]
+                      : emap.At(child_row, child_col);
+              // Marked cells hold their marker's value, so only cells
+              // holding one are looked up in the map's locations
+              if (IsSpecialLocationValue(value) &&
+                  emap.IsMarked(child_row, child_col)) {
+                continue;
+              }
+              highest = std::max<int64_t>(highest, value);
+              lowest = std::min<int64_t>(lowest, value);
+              sum += value;
+              weight += 1.0;
+              continue;
+            }
+            const size_t child = below->max.Index(child_row, child_col);
+            highest = std::max<int64_t>(highest, below->max.data()[child]);
+            lowest = std::min<int64_t>(lowest, below->min.data()[child]);
+            const int covered_rows =
+                std::min((child_row + 1) * child_scale, rows_) -
+                child_row * child_scale;
+            const int covered_cols =
+                std::min((child_col + 1) * child_scale, cols_) -
+                child_col * child_scale;
+            const double area = double(covered_rows) * double(covered_cols);
+            sum += area * below->mean.data()[child];
+            weight += area;
+          }
+        }
+        const size_t index = size_t(row) * out_cols + size_t(col);
+        if (weight == 0.0) {
+          out_max[index] = 0;
+          out_min[index] = 0;
+          out_mean[index] = 0;
+          continue;
+        }
+        out_max[index] = Elevation(highest);
+        out_min[index] = Elevation(lowest);
+        out_mean[index] = Elevation(std::lround(sum / weight));
+      }
+    }
+  };
+
+  const size_t bands =
+      size_t(std::max(0, row_end - row_begin) + kBandRows - 1) / kBandRows;
+  if (pool != nullptr && bands > 1) {
+    pool->ParallelFor(bands, reduce_band);
+  } else {
+    for (size_t band = 0; band < bands; band++) {
+      reduce_band(band, 0);
+    }
+  }
+}
+
+void path_planning::CorridorAroundPath(
+    const std::vector<std::pair<int, int>>& coarse_path, int scale,
+    int margin, int rows, int cols, SearchCorridor* corridor) {
+  corridor->col_begin.clear();
+  corridor->col_end.clear();
+  corridor->row_begin = 0;
+  if (coarse_path.empty() || scale < 1) {
+    return;
+  }
+  margin = std::max(0, margin);
+  const int coarse_rows = (rows + scale - 1) / scale;
+  // The column extent of the path on each coarse row, from the thread's
+  // arena since they only live for this call
+  MonotonicArena& arena = ThreadArena();
+  ArenaScope scope(arena);
+  ArenaVector<int> path_low(size_t(coarse_rows),
+                            std::numeric_limits<int>::max(),
+                            ArenaAllocator<int>(&arena));
+  ArenaVector<int> path_high(size_t(coarse_rows),
+                             std::numeric_limits<int>::min(),
+                             ArenaAllocator<int>(&arena));
+  int first_row = coarse_rows;
+  int last_row = -1;
+  for (const auto& cell : coarse_path) {
+    if (cell.first < 0 || cell.first >= coarse_rows) {
+      continue;
+    }
+    path_low[size_t(cell.first)] =
+        std::min(path_low[size_t(cell.first)], cell.second);
+    path_high[size_t(cell.first)] =
+        std::max(path_high[size_t(cell.first)], cell.second);
+    first_row = std::min(first_row, cell.first);
+    last_row = std::max(last_row, cell.first);
+  }
+  if (last_row < 0) {
+    return;
+  }
+
+  first_row = std::max(0, first_row - margin);
+  last_row = std::min(coarse_rows - 1, last_row + margin);
+  corridor->row_begin = first_row * scale;
+  for (int row = first_row; row <= last_row; row++) {
+    // Every path cell within the margin rows widens this row
+    int low = std::numeric_limits<int>::max();
+    int high = std::numeric_limits<int>::min();
+    for (int other = std::max(0, row - margin);
+         other <= std::min(coarse_rows - 1, row + margin); other++) {
+      low = std::min(low, path_low[size_t(other)]);
+      high = std::max(high, path_high[size_t(other)]);
+    }
+    int col_begin = 0;
+    int col_end = 0;
+    if (low <= high) {
+      col_begin = std::max(0, (low - margin) * scale);
+      col_end = int(std::min<int64_t>(cols, int64_t(high + margin + 1) * scale));
+    }
+    const int fine_rows = std::min(rows, (row + 1) * scale) - row * scale;
+    corridor->col_begin.insert(corridor->col_begin.end(), size_t(fine_rows),
+                               col_begin);
+    corridor->col_end.insert(corridor->col_end.end(), size_t(fine_rows),
+                             col_end);
+  }
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "thread_pool.h"
+
+namespace path_planning {
+
+/// @struct One level of a `MapPyramid`. Each cell summarizes the
+/// `scale x scale` block of full resolution cells it covers, fewer at the
+/// bottom and right edges. Location markers are not terrain and are left
+/// out, a block of nothing but markers is 0.
+struct PyramidLevel {
+  /// The number of full resolution cells per side of a cell, `2^level`
+  int scale = 1;
+  /// The highest elevation in each block. Planning on it is conservative:
+  /// no cell of the block is higher.
+  ElevationMap max;
+  /// The lowest elevation in each block
+  ElevationMap min;
+  /// The mean elevation of each block, rounded to the nearest. Above level
+  /// 1 the means of the level below are weighted by the cells they cover, so
+  /// a marker counts as the mean of its level 1 block.
+  ElevationMap mean;
+};
+
+/// @class Multi-resolution summary of an `ElevationMap`. Level 1 halves the
+/// map in each direction and every further level halves the one before, so
+/// all the levels together take a third of the map's cells per statistic.
+///
+/// Levels are built from the level below rather than the map, row bands in
+/// parallel. After cells of the map change, `Update` rebuilds only the
+/// blocks above them. Level maps are copy-on-write, so copies handed out
+/// before an update keep the old values.
+class MapPyramid {
+ public:
+  /// Row bands of a level that a single parallel task builds
+  static const int kBandRows = 32;
+
+  /// @brief Constructor
+  MapPyramid();
+  /// @brief Build the pyramid of a map
+  /// @param emap - The map to summarize
+  /// @param num_levels - The number of levels above the map to build, or 0
+  /// to halve until a level is a single cell
+  /// @param pool - Optional. Threads to build each level with
+  /// @return true if the pyramid was built
+  bool Build(const ElevationMap& emap, int num_levels = 0,
+             ThreadPool* pool = nullptr);
+  /// @brief Rebuild the blocks above a changed region of the map
+  /// @param emap - The map the pyramid was built from, after the change.
+  /// It must have the same dimensions.
+  /// @param row - The first changed row
+  /// @param col - The first changed column
+  /// @param rows - The number of changed rows
+  /// @param cols - The number of changed columns
+  /// @param pool - Optional. Threads to rebuild each level with
+  /// @return true if the pyramid was updated
+  bool Update(const ElevationMap& emap, int row, int col, int rows, int cols,
+              ThreadPool* pool = nullptr);
+  /// @brief Get the number of levels above the map
+  int num_levels() const { return int(levels_.size()); }
+  /// @brief Get a level
+  /// @param level - The level on [1, num_levels()]
+  const PyramidLevel& level(int level) const {
+    return levels_[size_t(level - 1)];
+  }
+  /// @brief Get the number of rows of the map the pyramid was built from
+  int rows() const { return rows_; }
+  /// @brief Get the number of columns of the map the pyramid was built from
+  int cols() const { return cols_; }
+  /// @brief Drop every level
+  void Clear();
+
+ private:
+  /// @brief Compute the cells of `level` on the rows [row_begin, row_end)
+  /// and columns [col_begin, col_end) of that level from the level below,
+  /// in parallel bands if a pool is given
+  void ReduceRegion(const ElevationMap& emap, int level, int row_begin,
+                    int row_end, int col_begin, int col_end,
+                    ThreadPool* pool);
+
+  /// The levels, level 1 first
+  std::vector<PyramidLevel> levels_;
+  /// The dimensions of the map
+  int rows_;
+  int cols_;
+};
+
+/// @brief Widen a path found on a pyramid level into a corridor of full
+/// resolution cells, for refining the path with `GridSearch`
+/// @param coarse_path - The path in the cells of the level
+/// @param scale - The `PyramidLevel::scale` of the level
+/// @param margin - The number of level cells to widen the path by on every
+/// side
+/// @param rows - The number of rows of the full resolution map
+/// @param cols - The number of columns of the full resolution map
+/// @param corridor - Output. The full resolution cells within the margin
+void CorridorAroundPath(const std::vector<std::pair<int, int>>& coarse_path,
+                        int scale, int margin, int rows, int cols,
+                        SearchCorridor* corridor);
+}
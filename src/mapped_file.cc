@@ -0,0 +1,143 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace path_planning;
+
+MappedFile::MappedFile()
+    : data_(nullptr),
+      size_(0),
+      is_open_(false)
+#ifdef _WIN32
+      ,
+      file_handle_(INVALID_HANDLE_VALUE),
+      mapping_handle_(nullptr)
+#endif
+{
+}
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::string& filename, Mode mode) {
+  Close();
+  file_handle_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                             nullptr);
+  if (file_handle_ == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file_handle_, &file_size)) {
+    Close();
+    return false;
+  }
+  size_ = size_t(file_size.QuadPart);
+  is_open_ = true;
+  // Windows refuses to map empty files, which is fine since there is nothing
+  // to read anyway
+  if (size_ == 0) {
+    return true;
+  }
+  mapping_handle_ = CreateFileMappingA(
+      file_handle_, nullptr,
+      mode == Mode::kCopyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0,
+      nullptr);
+  if (mapping_handle_ == nullptr) {
+    Close();
+    return false;
+  }
+  data_ = MapViewOfFile(
+      mapping_handle_,
+      mode == Mode::kCopyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0);
+  if (data_ == nullptr) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_handle_) {
+    CloseHandle(mapping_handle_);
+  }
+  if (file_handle_ != INVALID_HANDLE_VALUE) {
+    CloseHandle(file_handle_);
+  }
+  data_ = nullptr;
+  mapping_handle_ = nullptr;
+  file_handle_ = INVALID_HANDLE_VALUE;
+  size_ = 0;
+  is_open_ = false;
+}
+
+void MappedFile::AdviseSequential() {
+}
+
+#else
+
+bool MappedFile::Open(const std::string& filename, Mode mode) {
+  Close();
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    close(fd);
+    return false;
+  }
+  size_ = size_t(file_stat.st_size);
+  is_open_ = true;
+  // mmap refuses zero length mappings, which is fine since there is nothing
+  // to read anyway
+  if (size_ > 0) {
+    int protection = PROT_READ;
+    if (mode == Mode::kCopyOnWrite) {
+      protection |= PROT_WRITE;
+    }
+    data_ = mmap(nullptr, size_, protection, MAP_PRIVATE, fd, 0);
+    if (data_ == MAP_FAILED) {
+      data_ = nullptr;
+      close(fd);
+      Close();
+      return false;
+    }
+  }
+  // The mapping keeps its own reference to the file
+  close(fd);
+  return true;
+}
+
+void MappedFile::Close() {
+  if (data_) {
+    munmap(data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  is_open_ = false;
+}
+
+void MappedFile::AdviseSequential() {
+  if (data_) {
+    madvise(data_, size_, MADV_SEQUENTIAL);
+  }
+}
+
+#endif
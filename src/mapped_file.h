@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace path_planning {
+
+/// @class Memory mapping of a whole file. The mapping is released when the
+/// object is destroyed or `Close()` is called.
+class MappedFile {
+ public:
+  /// How the mapped pages may be accessed
+  enum class Mode {
+    /// Pages can only be read
+    kReadOnly,
+    /// Pages can be written, but writes are private to this process and never
+    /// reach the file. Unwritten pages stay shared with the page cache.
+    kCopyOnWrite
+  };
+  /// @brief Constructor
+  MappedFile();
+  /// @brief Destructor
+  ~MappedFile();
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  /// @brief Map the given file into memory
+  /// @param filename - The file to map
+  /// @param mode - How the mapped pages may be accessed
+  /// @return true if the file was successfully mapped
+  bool Open(const std::string& filename, Mode mode = Mode::kReadOnly);
+  /// @brief Unmap the current file, if any
+  void Close();
+  /// @brief Hint to the OS that the mapping will be read front to back so it
+  /// can read ahead aggressively
+  void AdviseSequential();
+  /// @brief Check if a file is currently mapped
+  bool is_open() const { return is_open_; }
+  /// @brief Get the start of the mapped bytes. May be null for an empty file.
+  const char* data() const { return static_cast<const char*>(data_); }
+  /// @brief Get the start of the mapped bytes for writing. Only valid for
+  /// `Mode::kCopyOnWrite` mappings.
+  char* mutable_data() { return static_cast<char*>(data_); }
+  /// @brief Get the number of mapped bytes
+  size_t size() const { return size_; }
+
+ private:
+  /// The start of the mapping
+  void* data_;
+  /// The size of the mapping in bytes
+  size_t size_;
+  /// Whether a file is currently open, which may be true for an empty file
+  /// with no mapping
+  bool is_open_;
+#ifdef _WIN32
+  /// The native file handle
+  void* file_handle_;
+  /// The native file mapping handle
+  void* mapping_handle_;
+#endif
+};
+}
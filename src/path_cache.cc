@@ -0,0 +1,129 @@
+#include <cstring>
+#include <iterator>
+
+#include "instrumentation.h"
+#include "path_cache.h"
+
+using namespace path_planning;
+
+void PathCacheKey::AddDouble(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  words.push_back(bits);
+}
+
+size_t PathCacheKey::Hash() const {
+  // Mix each word in with the splitmix64 finalizer
+  uint64_t hash = words.size();
+  for (uint64_t word : words) {
+    uint64_t x = hash ^ (word + 0x9e3779b97f4a7c15ull);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    hash = x ^ (x >> 31);
+  }
+  return size_t(hash);
+}
+
+PathCache::PathCache(size_t budget_bytes) : budget_bytes_(budget_bytes) {
+}
+
+bool PathCache::Find(const PathCacheKey& key,
+                     std::vector<int>* elevation_profile,
+                     std::vector<int>* altitude_profile,
+                     std::vector<std::pair<int, int>>* path) {
+  std::shared_ptr<const Plan> plan;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+      stats_.misses++;
+      PP_COUNTER_ADD(Counter::kPathCacheMisses, 1);
+      return false;
+    }
+    stats_.hits++;
+    PP_COUNTER_ADD(Counter::kPathCacheHits, 1);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    plan = it->second->plan;
+  }
+  elevation_profile->assign(plan->elevation_profile.begin(),
+                            plan->elevation_profile.end());
+  altitude_profile->assign(plan->altitude_profile.begin(),
+                           plan->altitude_profile.end());
+  path->assign(plan->path.begin(), plan->path.end());
+  return true;
+}
+
+void PathCache::Insert(const PathCacheKey& key,
+                       const std::vector<int>& elevation_profile,
+                       const std::vector<int>& altitude_profile,
+                       const std::vector<std::pair<int, int>>& path) {
+  // The key is held twice, in the entry and in the index
+  const size_t bytes =
+      sizeof(Entry) + sizeof(Plan) + 2 * key.words.size() * sizeof(uint64_t) +
+      (elevation_profile.size() + altitude_profile.size()) * sizeof(int) +
+      path.size() * sizeof(std::pair<int, int>);
+  // Copied outside the lock, which is only held to link the entry in
+  std::shared_ptr<Plan> plan = std::make_shared<Plan>();
+  plan->elevation_profile = elevation_profile;
+  plan->altitude_profile = altitude_profile;
+  plan->path = path;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (bytes > budget_bytes_) {
+    return;
+  }
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    Erase(it->second);
+  }
+  lru_.push_front(Entry{key, std::move(plan), bytes});
+  index_.emplace(key, lru_.begin());
+  stats_.entries++;
+  stats_.bytes += bytes;
+  EvictToBudget();
+}
+
+void PathCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  lru_.clear();
+  index_.clear();
+  stats_.entries = 0;
+  stats_.bytes = 0;
+}
+
+void PathCache::EvictToBudget() {
+  while (!lru_.empty() && stats_.bytes > budget_bytes_) {
+    Erase(std::prev(lru_.end()));
+    stats_.evictions++;
+  }
+}
+
+void PathCache::Erase(EntryList::iterator entry) {
+  stats_.entries--;
+  stats_.bytes -= entry->bytes;
+  index_.erase(entry->key);
+  lru_.erase(entry);
+}
+
+void PathCache::SetBudget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_bytes_ = budget_bytes;
+  EvictToBudget();
+}
+
+size_t PathCache::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_bytes_;
+}
+
+PathCacheStats PathCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PathCache::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.hits = 0;
+  stats_.misses = 0;
+  stats_.evictions = 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace path_planning {
+
+/// The default memory budget of a `PathCache`
+static const size_t kDefaultPathCacheBytes = size_t(64) << 20;
+
+/// @struct Counters of a `PathCache`
+struct PathCacheStats {
+  /// Lookups that found the plan
+  uint64_t hits = 0;
+  /// Lookups that did not
+  uint64_t misses = 0;
+  /// Plans dropped to stay inside the memory budget
+  uint64_t evictions = 0;
+  /// The number of plans currently cached
+  size_t entries = 0;
+  /// The bytes of profiles, paths and keys currently cached
+  size_t bytes = 0;
+  /// @brief Get the fraction of lookups that were hits, 0 with no lookups
+  double hit_rate() const {
+    return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+  }
+};
+
+/// @struct Everything a plan depends on, e.g. the map's `id()` and
+/// `version()`, the query, the options and the filter stages, as a sequence
+/// of words. Keys are compared in full, so different plans never share an
+/// entry however their hashes collide.
+struct PathCacheKey {
+  /// The words of the key
+  std::vector<uint64_t> words;
+  /// @brief Remove all the words, keeping the capacity
+  void Clear() { words.clear(); }
+  /// @brief Append an integer
+  void Add(int64_t value) { words.push_back(uint64_t(value)); }
+  /// @brief Append the bits of a floating point value
+  void AddDouble(double value);
+  /// @brief Get the hash of the words
+  size_t Hash() const;
+  bool operator==(const PathCacheKey& other) const {
+    return words == other.words;
+  }
+};
+
+/// @class Thread safe cache of planned paths and their profiles, keeping the
+/// most recently used plans up to a byte budget. `PathPlanner::SetPathCache`
+/// puts one in front of planning and filtering, so repeated queries on an
+/// unchanged map skip the search and the filters.
+///
+/// Plans are keyed by the map's `id()` and `version()`, so once a planner
+/// plans on an edited map its older plans are never served again. They are
+/// evicted as newer plans take their place. A plan is copied out after the
+/// lock is released, so long paths do not hold up other threads.
+class PathCache {
+ public:
+  /// @brief Constructor
+  /// @param budget_bytes - The most memory to keep plans in
+  explicit PathCache(size_t budget_bytes = kDefaultPathCacheBytes);
+  PathCache(const PathCache&) = delete;
+  PathCache& operator=(const PathCache&) = delete;
+  /// @brief Look a plan up and copy it out, reusing the outputs' capacity
+  /// @param key - The key the plan was inserted with
+  /// @param elevation_profile - Output. The elevation profile of the plan
+  /// @param altitude_profile - Output. The agl or filtered profile
+  /// @param path - Output. The path of the plan
+  /// @return true if the plan was cached, else the outputs are untouched
+  bool Find(const PathCacheKey& key, std::vector<int>* elevation_profile,
+            std::vector<int>* altitude_profile,
+            std::vector<std::pair<int, int>>* path);
+  /// @brief Cache a copy of a plan, replacing any with the same key.
+  /// Evicts the least recently used plans to stay inside the budget, and a
+  /// plan larger than the whole budget is not cached.
+  /// @param key - The inputs the plan was made from
+  /// @param elevation_profile - The elevation profile of the plan
+  /// @param altitude_profile - The agl or filtered profile
+  /// @param path - The path of the plan
+  void Insert(const PathCacheKey& key,
+              const std::vector<int>& elevation_profile,
+              const std::vector<int>& altitude_profile,
+              const std::vector<std::pair<int, int>>& path);
+  /// @brief Drop every plan
+  void Clear();
+  /// @brief Change the memory budget, evicting plans if it shrank
+  void SetBudget(size_t budget_bytes);
+  /// @brief Get the memory budget
+  size_t budget() const;
+  /// @brief Get a snapshot of the counters
+  PathCacheStats stats() const;
+  /// @brief Zero the hit, miss and eviction counters
+  void ResetStats();
+
+ private:
+  /// @struct A cached plan, shared with the lookups still copying it out
+  struct Plan {
+    std::vector<int> elevation_profile;
+    std::vector<int> altitude_profile;
+    std::vector<std::pair<int, int>> path;
+  };
+  /// @struct A plan and its key, in the recency list
+  struct Entry {
+    PathCacheKey key;
+    std::shared_ptr<const Plan> plan;
+    /// The bytes the entry counts against the budget
+    size_t bytes;
+  };
+  /// The least recently used plan is at the back
+  using EntryList = std::list<Entry>;
+  /// @struct Hashes keys for `index_`
+  struct KeyHash {
+    size_t operator()(const PathCacheKey& key) const { return key.Hash(); }
+  };
+
+  /// @brief Drop plans until inside the budget. Must hold `mutex_`.
+  void EvictToBudget();
+  /// @brief Drop an entry. Must hold `mutex_`.
+  void Erase(EntryList::iterator entry);
+
+  /// Guards everything below
+  mutable std::mutex mutex_;
+  /// Cached plans, most recently used first
+  EntryList lru_;
+  /// Where each cached plan is in `lru_`
+  std::unordered_map<PathCacheKey, EntryList::iterator, KeyHash> index_;
+  /// The memory budget
+  size_t budget_bytes_;
+  /// The counters
+  PathCacheStats stats_;
+};
+}
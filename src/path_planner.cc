@@ -1,152 +1,725 @@
 #include <iostream>
 #include <algorithm>
-#include <numeric>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
 
 #include "path_planner.h"
+#include "instrumentation.h"
 
 using namespace path_planning;
 
-PathPlanner::PathPlanner(const ElevationMap& emap) : emap_(emap) {
+namespace {
+
+/// @brief Step one cell along the straight line path towards the goal,
+/// giving row movement priority over column movement
+void StepTowards(const std::pair<int, int>& goal,
+                 std::pair<int, int>* position) {
+  const int row_diff = goal.first - position->first;
+  const int col_diff = goal.second - position->second;
+  // Give row movement priority over column by checking the magnitude of
+  // the differences
+  if (row_diff > 0 && abs(row_diff) >= abs(col_diff)) {
+    position->first += 1;
+  } else if (row_diff < 0 && abs(row_diff) >= abs(col_diff)) {
+    position->first -= 1;
+  } else if (col_diff > 0) {
+    position->second += 1;
+  } else if (col_diff < 0) {
+    position->second -= 1;
+  }
+}
+
+/// @brief Get the goals of a query, its single goal unless it has several
+Span<const std::pair<int, int>> QueryGoals(const PlanQuery& query) {
+  return query.goals.empty() ? Span<const std::pair<int, int>>(&query.goal, 1)
+                             : query.goals;
+}
+
+/// @brief Get the goal a straight line path flies to. Straight lines ignore
+/// the terrain, so the nearest goal in a straight line is the cheapest.
+const std::pair<int, int>& NearestGoal(
+    const std::pair<int, int>& from, Span<const std::pair<int, int>> goals) {
+  size_t nearest = 0;
+  int64_t nearest_distance = std::numeric_limits<int64_t>::max();
+  for (size_t i = 0; i < goals.size(); i++) {
+    const int64_t rows = int64_t(goals[i].first) - from.first;
+    const int64_t cols = int64_t(goals[i].second) - from.second;
+    const int64_t distance = rows * rows + cols * cols;
+    if (distance < nearest_distance) {
+      nearest = i;
+      nearest_distance = distance;
+    }
+  }
+  return goals[nearest];
+}
+
+/// @brief Check if a start and every goal are inside a map
+bool EndpointsInMap(const ElevationMap& emap, const std::pair<int, int>& start,
+                    Span<const std::pair<int, int>> goals) {
+  auto in_map = [&emap](const std::pair<int, int>& cell) {
+    return cell.first >= 0 && cell.first < emap.rows() && cell.second >= 0 &&
+           cell.second < emap.cols();
+  };
+  return !goals.empty() && in_map(start) &&
+         std::all_of(goals.begin(), goals.end(), in_map);
+}
+
+/// @brief Check if a profile entry was read from a marked cell itself, so
+/// it holds the marker's value rather than terrain. Markers are found by
+/// position, so a real elevation equal to a marker's value is kept.
+bool ReadFromMarker(const ElevationMap& emap, const std::pair<int, int>& cell,
+                    int elevation) {
+  return emap.IsMarked(cell.first, cell.second) &&
+         elevation == int(emap.At(cell.first, cell.second));
+}
+
+/// @brief Give the first and last entries of a profile the elevation of
+/// their neighbor if they were read from a marked cell
+/// @param emap - The map the profile was read from
+/// @param path - The cells of the profile
+/// @param elevation_profile - Input and output. One elevation per cell.
+void ReplaceMarkedEnds(const ElevationMap& emap,
+                       const std::vector<std::pair<int, int>>& path,
+                       std::vector<int>* elevation_profile) {
+  const size_t size = elevation_profile->size();
+  if (size >= 2 && path.size() == size) {
+    if (ReadFromMarker(emap, path[0], (*elevation_profile)[0])) {
+      (*elevation_profile)[0] = (*elevation_profile)[1];
+    }
+    if (ReadFromMarker(emap, path[size - 1], (*elevation_profile)[size - 1])) {
+      (*elevation_profile)[size - 1] = (*elevation_profile)[size - 2];
+    }
+  }
+}
+
+/// The kinds of output cached for a query, see `PathPlanner::BuildCacheKey`
+const int kAglPlan = 0;
+const int kFilteredPlan = 1;
+
+}  // namespace
+
+PathPlanner::PathPlanner() : contexts_(new PlannerContextPool()) {
+}
+
+PathPlanner::PathPlanner(const ElevationMap& emap)
+    : emap_(emap), contexts_(new PlannerContextPool()) {
 }
 
 PathPlanner::~PathPlanner() {
 }
 
+PathPlanner::PathPlanner(PathPlanner&& other) = default;
+
+PathPlanner& PathPlanner::operator=(PathPlanner&& other) = default;
+
+void PathPlanner::UpdateMap(const ElevationMap& emap, int row, int col,
+                            int rows, int cols) {
+  const bool same_size =
+      emap.rows() == emap_.rows() && emap.cols() == emap_.cols();
+  emap_ = emap;
+  if (pyramid_.num_levels() == 0) {
+    return;
+  }
+  // A map of a different size needs a new pyramid, built on the next plan
+  if (!same_size ||
+      !pyramid_.Update(emap_, row, col, rows, cols, pool_.get())) {
+    pyramid_.Clear();
+  }
+}
+
 bool PathPlanner::PlanPath(std::vector<int>* elevation_profile,
                            std::vector<int>* agl_elevation_profile,
                            const int& agl,
                            std::vector<std::pair<int, int>>* path) {
-  // First generate the base path and elevation
-  if(!GenerateBasePath(elevation_profile, path)) {
-    std::cerr << "PathPlanner::PlanPath: Unable to generate a base path from "
-                 "start to finish!"
-              << std::endl;
+  PlanQuery query;
+  if (!FindEndpoints(&query)) {
     return false;
   }
-
-  // Set the begining and end to the same as the next/previous since they are
-  // marked with negative numbers
-  (*elevation_profile)[0] = (*elevation_profile)[1];
-  (*elevation_profile)[elevation_profile->size() - 1] =
-      (*elevation_profile)[elevation_profile->size() - 2];
-
-  // Filter the elevation profile based on the agl
-  *agl_elevation_profile = *elevation_profile;
-  for(auto& el : *agl_elevation_profile) {
-    el += agl;
+  query.agl = agl;
+  if (!path) {
+    path = &path_scratch_;
   }
-
-  return true;
+  EnsurePyramid();
+  return PlanBetween(query, &context_, elevation_profile,
+                     agl_elevation_profile, path);
 }
 
-bool PathPlanner::GenerateBasePath(std::vector<int>* elevation_profile,
-                                   std::vector<std::pair<int, int>>* path) {
-  // Check that we have exactly one start and one end position
+bool PathPlanner::FindEndpoints(PlanQuery* query) const {
+  // Check that we have exactly one start and at least one end position
   auto start_pos = emap_.GetLocations(kStartPos);
   if(start_pos.size() != 1) {
     std::cerr << "PathPlanner::PlanPath: ERROR! Map has no start position "
               << "or multiple start positions. No path will be planned!"
               << std::endl;
+    PP_COUNTER_ADD(Counter::kFailedPlans, 1);
     return false;
   }
   auto end_pos = emap_.GetLocations(kEndPos);
-  if(end_pos.size() != 1) {
-    std::cerr << "PathPlanner::PlanPath: ERROR! Map has no end position "
-              << "or multiple end positions. No path will be planned!"
-              << std::endl;
+  if(end_pos.empty()) {
+    std::cerr << "PathPlanner::PlanPath: ERROR! Map has no end position. "
+              << "No path will be planned!" << std::endl;
+    PP_COUNTER_ADD(Counter::kFailedPlans, 1);
     return false;
   }
-  // Define the line between the start and the beginning
-  // TODO Replace this with an actual path planning algorithm to minimize 
-  //  elevation change cost?
-  auto current_pos = start_pos[0];
-  if(path) path->emplace_back(current_pos);
-  elevation_profile->emplace_back(emap_(current_pos.first, current_pos.second));
-  while(current_pos != end_pos[0]) {
-    int row_diff = end_pos[0].first - current_pos.first;
-    int col_diff = end_pos[0].second - current_pos.second;
-
-    // Give row movement priority over column by checking the magnitude of 
-    // the differences
-    if(row_diff > 0 && abs(row_diff) >= abs(col_diff)) {
-      current_pos.first += 1;
-    } else if (row_diff < 0 && abs(row_diff) >= abs(col_diff)) {
-      current_pos.first -= 1;
-    } else if(col_diff > 0) {
-      current_pos.second += 1;
-    } else if (col_diff < 0) {
-      current_pos.second -= 1;
-    }
-    if (path) path->emplace_back(current_pos);
-    elevation_profile->emplace_back(
-      emap_(current_pos.first, current_pos.second));
+  query->start = start_pos[0];
+  query->goal = end_pos[0];
+  // The end positions are viewed in the map's index, not copied
+  query->goals = end_pos.size() > 1 ? end_pos
+                                    : Span<const std::pair<int, int>>();
+  return true;
+}
+
+bool PathPlanner::PlanFilteredPath(ProfilePipeline* pipeline,
+                                   std::vector<int>* elevation_profile,
+                                   std::vector<int>* filtered_profile,
+                                   std::vector<std::pair<int, int>>* path) {
+  if (!path) {
+    path = &path_scratch_;
+  }
+  if (cache_) {
+    PlanQuery query;
+    if (!FindEndpoints(&query)) {
+      return false;
+    }
+    BuildCacheKey(query, kFilteredPlan, &filtered_key_);
+    pipeline->AppendKey(&filtered_key_);
+    if (cache_->Find(filtered_key_, elevation_profile, filtered_profile,
+                     path)) {
+      return true;
+    }
+  }
+  // The pipeline applies its own agl, so plan at ground level and use the
+  // filtered profile as the scratch for the unused agl profile
+  if (!PlanPath(elevation_profile, filtered_profile, 0, path)) {
+    return false;
+  }
+  if (!pipeline->Run(*elevation_profile, filtered_profile)) {
+    std::cerr << "PathPlanner::PlanFilteredPath: A filter stage has invalid "
+                 "parameters!" << std::endl;
+    return false;
+  }
+  if (cache_) {
+    cache_->Insert(filtered_key_, *elevation_profile, *filtered_profile,
+                   *path);
   }
   return true;
 }
 
-std::vector<int> PathPlanner::MedianFilter(
-    const std::vector<int>& elevation_profile, const int& filter_width) {
-  std::vector<int> filtered_data;
-  // Just a slow median filter because we sort sooo much
-  for (int i = 0; i < elevation_profile.size(); i++) {
-    // Don't try to filter the first values
-    if(i < filter_width) {
-      filtered_data.emplace_back(elevation_profile[i]);
-      continue;
-    }
-
-    std::vector<int> filter_vals(elevation_profile.begin() + i - filter_width,
-                                 elevation_profile.begin() + i);
-    std::sort(filter_vals.begin(), filter_vals.end());
-    // Take the average if there's an even number
-    if (filter_width % 2 == 0) {
-      filtered_data.emplace_back(
-          (filter_vals[filter_width / 2 - 1] + filter_vals[filter_width / 2]) /
-          2);
+bool PathPlanner::StreamPath(ProfilePipeline* pipeline,
+                             const ProfileChunkCallback& on_chunk,
+                             size_t chunk_size) {
+  PP_SCOPED_TIMER(Stage::kPlanPath);
+  if (chunk_size == 0) {
+    std::cerr << "PathPlanner::StreamPath: ERROR! The chunk size must be "
+                 "positive!" << std::endl;
+    return false;
+  }
+  PlanQuery query;
+  if (!FindEndpoints(&query)) {
+    return false;
+  }
+  const std::pair<int, int>& start = query.start;
+  const Span<const std::pair<int, int>> goals = QueryGoals(query);
+  if (!EndpointsInMap(emap_, start, goals)) {
+    std::cerr << "PathPlanner::StreamPath: ERROR! Start or end position is "
+              << "outside of the map. No path will be planned!" << std::endl;
+    PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+    return false;
+  }
+
+  // The pipeline applies its own agl, so plan at ground level like
+  // `PlanFilteredPath`. Straight line paths are generated as they stream
+  // unless they are smoothed, which needs the whole path first.
+  const bool straight =
+      context_.search.options().algorithm == SearchAlgorithm::kStraightLine;
+  const bool generate = straight && !smoothing_.enabled;
+  const std::pair<int, int>& straight_goal = NearestGoal(start, goals);
+  if (!generate) {
+    PP_SCOPED_TIMER(Stage::kBasePath);
+    if (straight) {
+      auto position = start;
+      path_scratch_.assign(1, position);
+      while (position != straight_goal) {
+        StepTowards(straight_goal, &position);
+        path_scratch_.push_back(position);
+      }
+    } else {
+      EnsurePyramid();
+      const bool refined =
+          hierarchical_.enabled &&
+          FindHierarchicalPath(start, goals, 0, &context_, &path_scratch_);
+      if (!refined && !context_.search.FindPathToAny(emap_, start, goals, 0,
+                                                     &path_scratch_)) {
+        std::cerr << "PathPlanner::StreamPath: ERROR! No path exists from "
+                  << "the start to the end position." << std::endl;
+        PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+        return false;
+      }
+    }
+    if (smoothing_.enabled) {
+      Smooth(context_.search.options(), 0, &path_scratch_);
+      SegmentProfile(emap_, path_scratch_, &stream_profile_);
+    } else {
+      StepProfile(emap_, path_scratch_, &stream_profile_);
+    }
+  }
+
+  stream_samples_.clear();
+  stream_elevations_.clear();
+  stream_altitudes_.clear();
+  if (pipeline) {
+    pipeline->Begin();
+  }
+  // The leading samples of `stream_samples_` that have their altitude
+  size_t ready = 0;
+  bool stopped = false;
+  // Run the pending elevations through the pipeline and hand every full
+  // chunk, or with `last` everything, to the callback
+  auto flush = [&](bool last) {
+    if (pipeline) {
+      pipeline->Push(stream_elevations_.data(), stream_elevations_.size(),
+                     &stream_altitudes_);
+      stream_elevations_.clear();
+      if (last && !pipeline->Finish(&stream_altitudes_)) {
+        std::cerr << "PathPlanner::StreamPath: A filter stage has invalid "
+                     "parameters!" << std::endl;
+        stopped = true;
+      }
+      for (size_t i = 0; i < stream_altitudes_.size(); i++) {
+        stream_samples_[ready + i].altitude = stream_altitudes_[i];
+      }
+      ready += stream_altitudes_.size();
+      stream_altitudes_.clear();
     } else {
-      filtered_data.emplace_back(
-          filter_vals[int(std::ceil(filter_width / 2.0))]);
+      for (; ready < stream_samples_.size(); ready++) {
+        stream_samples_[ready].altitude = stream_samples_[ready].elevation;
+      }
+    }
+    size_t sent = 0;
+    while (!stopped && (ready - sent >= chunk_size || (last && ready > sent))) {
+      const size_t count = std::min(chunk_size, ready - sent);
+      stopped = !on_chunk(stream_samples_.data() + sent, count);
+      sent += count;
+    }
+    stream_samples_.erase(stream_samples_.begin(),
+                          stream_samples_.begin() + sent);
+    ready -= sent;
+  };
+  auto emit = [&](const ProfileSample& sample) {
+    stream_samples_.push_back(sample);
+    stream_elevations_.push_back(sample.elevation);
+    if (stream_elevations_.size() == chunk_size) {
+      flush(false);
+    }
+  };
+
+  // Each sample is held back by one cell, so a start marker can take the
+  // elevation after it and an end marker the one before it. The map is read
+  // through a const view so its cells stay shared.
+  const ElevationMap& emap = emap_;
+  size_t count = 0;
+  ProfileSample held = ProfileSample();
+  int previous_elevation = 0;
+  auto visit = [&](const std::pair<int, int>& cell, int elevation) {
+    const ProfileSample sample{cell.first, cell.second, elevation, 0};
+    if (count > 0) {
+      if (count == 1 && ReadFromMarker(emap, {held.row, held.col},
+                                       held.elevation)) {
+        held.elevation = sample.elevation;
+      }
+      previous_elevation = held.elevation;
+      emit(held);
+    }
+    held = sample;
+    count++;
+  };
+  if (generate) {
+    auto position = start;
+    visit(position, emap.At(position.first, position.second));
+    while (position != straight_goal && !stopped) {
+      StepTowards(straight_goal, &position);
+      visit(position, emap.At(position.first, position.second));
+    }
+  } else {
+    for (size_t i = 0; i < path_scratch_.size() && !stopped; i++) {
+      const auto& cell = path_scratch_[i];
+      visit(cell, stream_profile_[i]);
     }
   }
+  if (stopped) {
+    return false;
+  }
+  if (count >= 2 &&
+      ReadFromMarker(emap, {held.row, held.col}, held.elevation)) {
+    held.elevation = previous_elevation;
+  }
+  emit(held);
+  flush(true);
+  PP_COUNTER_ADD(Counter::kPathCells, count);
+  return !stopped;
+}
+
+bool PathPlanner::PlanPaths(const std::vector<PlanQuery>& queries,
+                            std::vector<PlanResult>* results,
+                            int num_threads) {
+  results->resize(queries.size());
+  if (!pool_ || (num_threads > 0 && pool_->size() != num_threads)) {
+    pool_.reset(new ThreadPool(num_threads));
+  }
+  Prepare(pool_->size());
+
+  std::atomic<bool> all_planned(true);
+  auto plan = [&](size_t i, int) {
+    if (!Plan(queries[i], &(*results)[i])) {
+      all_planned = false;
+    }
+  };
+  // Wrapped in a reference so the `std::function` does not allocate a copy
+  pool_->ParallelFor(queries.size(), std::ref(plan));
+  return all_planned;
+}
+
+void PathPlanner::Prepare(int num_contexts) {
+  EnsurePyramid();
+  contexts_->Reserve(size_t(std::max(num_contexts, 0)));
+}
+
+bool PathPlanner::Plan(const PlanQuery& query, PlanResult* result) const {
+  PlannerContextPool::Lease context = contexts_->Acquire();
+  context->search.SetOptions(context_.search.options());
+  result->success =
+      PlanBetween(query, context.get(), &result->elevation_profile,
+                  &result->agl_elevation_profile, &result->path);
+  return result->success;
+}
+
+bool PathPlanner::PlanBetween(const PlanQuery& query,
+                              PlannerContext* context,
+                              std::vector<int>* elevation_profile,
+                              std::vector<int>* agl_elevation_profile,
+                              std::vector<std::pair<int, int>>* path) const {
+  PP_SCOPED_TIMER(Stage::kPlanPath);
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  const size_t capacity = elevation_profile->capacity() +
+                          agl_elevation_profile->capacity() + path->capacity();
+#endif
+  if (cache_) {
+    BuildCacheKey(query, kAglPlan, &context->cache_key);
+    if (cache_->Find(context->cache_key, elevation_profile,
+                     agl_elevation_profile, path)) {
+      return true;
+    }
+  }
+  const CancellationToken* cancel = query.cancel;
+  if (cancel != nullptr && cancel->IsCancelled()) {
+    PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+    return false;
+  }
+  context->search.SetCancellation(cancel);
+  context->coarse_search.SetCancellation(cancel);
+  const int agl = query.agl;
+  const Span<const std::pair<int, int>> goals = QueryGoals(query);
+
+  // First generate the base path and elevation, a leg at a time through
+  // the waypoints. The start and end of each leg are set to the same as
+  // the next/previous if they were read from a marked cell.
+  if (query.waypoints.empty()) {
+    if (!GenerateBasePath(query.start, goals, agl, context,
+                          elevation_profile, path)) {
+      if (cancel == nullptr || !cancel->IsCancelled()) {
+        std::cerr << "PathPlanner::PlanPath: Unable to generate a base path "
+                     "from start to finish!"
+                  << std::endl;
+      }
+      PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+      return false;
+    }
+    ReplaceMarkedEnds(emap_, *path, elevation_profile);
+  } else {
+    elevation_profile->clear();
+    path->clear();
+    std::pair<int, int> from = query.start;
+    for (size_t leg = 0; leg <= query.waypoints.size(); leg++) {
+      // The last leg searches towards every goal at once
+      const Span<const std::pair<int, int>> to =
+          leg < query.waypoints.size()
+              ? Span<const std::pair<int, int>>(query.waypoints.data() + leg, 1)
+              : goals;
+      // A cancelled plan stops between legs as well as inside them
+      const bool cancelled = cancel != nullptr && cancel->IsCancelled();
+      if (cancelled ||
+          !GenerateBasePath(from, to, agl, context, &context->leg_profile,
+                            &context->leg_path)) {
+        if (cancel == nullptr || !cancel->IsCancelled()) {
+          std::cerr << "PathPlanner::PlanPath: Unable to generate a base "
+                       "path to waypoint " << leg << "!" << std::endl;
+        }
+        PP_COUNTER_ADD(Counter::kFailedPlans, 1);
+        return false;
+      }
+      ReplaceMarkedEnds(emap_, context->leg_path, &context->leg_profile);
+      // Each leg starts where the last one finished, and the waypoint
+      // between them keeps the higher of their elevations
+      const size_t skip = path->empty() ? 0 : 1;
+      if (skip && !context->leg_profile.empty()) {
+        elevation_profile->back() =
+            std::max(elevation_profile->back(), context->leg_profile[0]);
+      }
+      path->insert(path->end(), context->leg_path.begin() + skip,
+                   context->leg_path.end());
+      elevation_profile->insert(elevation_profile->end(),
+                                context->leg_profile.begin() + skip,
+                                context->leg_profile.end());
+      from = to[0];
+    }
+  }
+
+  // Filter the elevation profile based on the agl
+  {
+    PP_SCOPED_TIMER(Stage::kAglOffset);
+    *agl_elevation_profile = *elevation_profile;
+    AddOffset(agl_elevation_profile->data(), agl_elevation_profile->size(),
+              agl);
+  }
+
+  PP_COUNTER_ADD(Counter::kPathCells, path->size());
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  // Any output that grew had to reallocate, which a warm caller avoids
+  const bool grew = elevation_profile->capacity() +
+                        agl_elevation_profile->capacity() +
+                        path->capacity() != capacity;
+  PP_COUNTER_ADD(Counter::kAllocations, grew);
+#endif
+  if (cache_) {
+    cache_->Insert(context->cache_key, *elevation_profile,
+                   *agl_elevation_profile, *path);
+  }
+  return true;
+}
+
+void PathPlanner::BuildCacheKey(const PlanQuery& query, int kind,
+                                PathCacheKey* key) const {
+  key->Clear();
+  key->Add(kind);
+  // Edits through a map's `operator()` give it a new id or version, so
+  // plans made before them are never looked up again
+  key->Add(int64_t(emap_.id()));
+  key->Add(int64_t(emap_.version()));
+  const Span<const std::pair<int, int>> goals = QueryGoals(query);
+  key->Add(query.start.first);
+  key->Add(query.start.second);
+  key->Add(int64_t(goals.size()));
+  for (const auto& goal : goals) {
+    key->Add(goal.first);
+    key->Add(goal.second);
+  }
+  key->Add(query.agl);
+  key->Add(int64_t(query.waypoints.size()));
+  for (const auto& waypoint : query.waypoints) {
+    key->Add(waypoint.first);
+    key->Add(waypoint.second);
+  }
+  const SearchOptions& options = context_.search.options();
+  key->Add(int(options.algorithm));
+  key->Add(int(options.connectivity));
+  key->Add(int(options.cost_policy));
+  key->AddDouble(options.cost.distance_weight);
+  key->AddDouble(options.cost.climb_weight);
+  key->AddDouble(options.cost.descent_weight);
+  key->Add(options.cost.max_altitude);
+  key->Add(options.window_margin);
+  // Rebuilding a field gives its cells a new id, like editing the map
+  key->Add(options.clearance != nullptr);
+  if (options.clearance != nullptr) {
+    key->Add(int64_t(options.clearance->max_elevation().id()));
+    key->Add(int64_t(options.clearance->max_elevation().version()));
+    key->Add(options.clearance->radius());
+  }
+  key->Add(options.bidirectional_threads);
+  // Plans made before the pyramid is built are full resolution plans,
+  // whatever the hierarchical options ask for
+  const int coarse_level = CoarseLevel();
+  key->Add(hierarchical_.enabled ? coarse_level : 0);
+  if (hierarchical_.enabled && coarse_level > 0) {
+    key->Add(hierarchical_.corridor_margin);
+  }
+  key->Add(smoothing_.enabled);
+  key->Add(smoothing_.allowed_rise);
+}
+
+bool PathPlanner::GenerateBasePath(const std::pair<int, int>& start,
+                                   Span<const std::pair<int, int>> goals,
+                                   int agl,
+                                   PlannerContext* context,
+                                   std::vector<int>* elevation_profile,
+                                   std::vector<std::pair<int, int>>* path)
+    const {
+  PP_SCOPED_TIMER(Stage::kBasePath);
+  elevation_profile->clear();
+  path->clear();
+  if (!EndpointsInMap(emap_, start, goals)) {
+    std::cerr << "PathPlanner::PlanPath: ERROR! Start or end position is "
+              << "outside of the map. No path will be planned!" << std::endl;
+    return false;
+  }
+
+  GridSearch* search = &context->search;
+  if (search->options().algorithm != SearchAlgorithm::kStraightLine) {
+    // Search for the path that minimizes distance and elevation change,
+    // near a coarse path first if planning hierarchically
+    const bool refined =
+        hierarchical_.enabled &&
+        FindHierarchicalPath(start, goals, agl, context, path);
+    if (!refined && !search->FindPathToAny(emap_, start, goals, agl, path)) {
+      const CancellationToken* cancel = search->cancellation();
+      if (cancel == nullptr || !cancel->IsCancelled()) {
+        std::cerr << "PathPlanner::PlanPath: ERROR! No path exists from the "
+                  << "start to the end position." << std::endl;
+      }
+      return false;
+    }
+  } else {
+    // Define the line between the start and the nearest goal
+    const std::pair<int, int>& goal = NearestGoal(start, goals);
+    auto current_pos = start;
+    path->emplace_back(current_pos);
+    while(current_pos != goal) {
+      StepTowards(goal, &current_pos);
+      path->emplace_back(current_pos);
+    }
+  }
+
+  if (smoothing_.enabled) {
+    Smooth(search->options(), agl, path);
+    SegmentProfile(emap_, *path, elevation_profile);
+    return true;
+  }
+  StepProfile(emap_, *path, elevation_profile);
+  return true;
+}
+
+void PathPlanner::Smooth(const SearchOptions& options, int agl,
+                         std::vector<std::pair<int, int>>* path) const {
+  PP_SCOPED_TIMER(Stage::kSmoothPath);
+  // A straight line path is not searched, so a field from another map has
+  // not been refused yet
+  const ClearanceField* field = options.clearance;
+  const ElevationMap& terrain =
+      field && field->rows() == emap_.rows() && field->cols() == emap_.cols()
+          ? field->max_elevation()
+          : emap_;
+  SmoothPath(terrain, int64_t(options.cost.max_altitude) - agl,
+             smoothing_.allowed_rise, path);
+}
+
+bool PathPlanner::FindHierarchicalPath(
+    const std::pair<int, int>& start, Span<const std::pair<int, int>> goals,
+    int agl, PlannerContext* context,
+    std::vector<std::pair<int, int>>* path) const {
+  const int level = CoarseLevel();
+  if (level == 0) {
+    return false;
+  }
+  const PyramidLevel& coarse = pyramid_.level(level);
+  const int scale = coarse.scale;
+  // A coarse step crosses `scale` cells, the climbs are already those of
+  // the whole block
+  SearchOptions options = context->search.options();
+  options.cost.distance_weight *= scale;
+  // The field has the fine level's cells, and the max level already lifts
+  // each block to its highest terrain
+  options.clearance = nullptr;
+  if (options.window_margin >= 0) {
+    options.window_margin = (options.window_margin + scale - 1) / scale;
+  }
+  context->coarse_search.SetOptions(options);
+  // The coarse search heads for the blocks of every goal, and the fine one
+  // for the goals inside the corridor around the coarse path
+  std::vector<std::pair<int, int>>& coarse_goals = context->coarse_goals;
+  coarse_goals.clear();
+  for (const auto& goal : goals) {
+    coarse_goals.emplace_back(goal.first / scale, goal.second / scale);
+  }
+  if (!context->coarse_search.FindPathToAny(
+          coarse.max, std::make_pair(start.first / scale, start.second / scale),
+          Span<const std::pair<int, int>>(coarse_goals.data(),
+                                          coarse_goals.size()),
+          agl, path)) {
+    return false;
+  }
+  CorridorAroundPath(*path, scale, hierarchical_.corridor_margin,
+                     emap_.rows(), emap_.cols(), &context->corridor);
+  return context->search.FindPathToAny(emap_, start, goals, agl,
+                                       context->corridor, path);
+}
+
+void PathPlanner::EnsurePyramid() {
+  if (!hierarchical_.enabled || pyramid_.num_levels() > 0 ||
+      emap_.size() == 0) {
+    return;
+  }
+  if (!pool_) {
+    pool_.reset(new ThreadPool());
+  }
+  pyramid_.Build(emap_, 0, pool_.get());
+}
+
+int PathPlanner::CoarseLevel() const {
+  if (pyramid_.num_levels() == 0) {
+    return 0;
+  }
+  if (hierarchical_.level > 0) {
+    return std::min(hierarchical_.level, pyramid_.num_levels());
+  }
+  int level = 0;
+  while (level < pyramid_.num_levels()) {
+    const PyramidLevel& next = pyramid_.level(level + 1);
+    if (std::max(next.max.rows(), next.max.cols()) < kMinCoarseSize) {
+      break;
+    }
+    level++;
+  }
+  return level;
+}
+
+std::vector<int> PathPlanner::MedianFilter(
+    const std::vector<int>& elevation_profile, const int& filter_width) {
+  PP_SCOPED_TIMER(Stage::kMedianFilter);
+  std::vector<int> filtered_data(elevation_profile.size());
+  median_.Filter(elevation_profile.data(), elevation_profile.size(),
+                 filter_width, filtered_data.data());
   return filtered_data;
 }
 
 std::vector<int> PathPlanner::LowpassFilter(
     const std::vector<int>& elevation_profile, const double& alpha) {
-  if(alpha < 0.0 || alpha > 1.0) {
+  PP_SCOPED_TIMER(Stage::kLowpassFilter);
+  std::vector<int> filtered_data(elevation_profile.size());
+  if (!path_planning::LowpassFilter(elevation_profile.data(),
+                                    elevation_profile.size(), alpha,
+                                    filtered_data.data())) {
     std::cerr << "PathPlanner::LowpassFilter: Alpha must be between 0 and 1!"
               << std::endl;
-    return elevation_profile;
-  }
-  std::vector<int> filtered_data{elevation_profile[1]};
-  for (int i = 1; i < elevation_profile.size(); i++) {
-    filtered_data.emplace_back(int(alpha * elevation_profile[i] +
-                                   (1.0 - alpha) * filtered_data.back()));
   }
-
   return filtered_data;
 }
 
 std::vector<int> PathPlanner::MeanFilter(
     const std::vector<int>& elevation_profile, const int& filter_size) {
-  std::vector<int> filtered_data;
-  for (size_t i = 0; i < elevation_profile.size()-1; i++) {
-    int real_filt_idx =
-        std::min(int(i) + filter_size, int(elevation_profile.size() - 1));
-    double sum = std::accumulate(elevation_profile.begin() + i,
-                              elevation_profile.begin() + real_filt_idx, 0.0);
-    filtered_data.emplace_back(int(std::round(sum / (real_filt_idx - i))));
-  }
-  /// Accumulate will return 0 for the the final index, so just append it since
-  /// that will be the output of the mean filter anyway
-  filtered_data.emplace_back(elevation_profile.back());
-
+  PP_SCOPED_TIMER(Stage::kMeanFilter);
+  std::vector<int> filtered_data(elevation_profile.size());
+  path_planning::MeanFilter(elevation_profile.data(),
+                            elevation_profile.size(), filter_size,
+                            filtered_data.data());
   return filtered_data;
 }
 
 std::vector<int> PathPlanner::CorrectPath(
     const std::vector<int>& elevation_profile,
     const std::vector<int>& filtered_profile, const int& min_alt) {
+  PP_SCOPED_TIMER(Stage::kCorrectPath);
   if (elevation_profile.size() != filtered_profile.size()) {
     std::cerr << "PathPlanner::CorrectPath: Unable to correct path, the "
                  "elevation profile and filtered profile are different sizes!"
@@ -154,11 +727,74 @@ std::vector<int> PathPlanner::CorrectPath(
     return filtered_profile;
   }
 
-  std::vector<int> clipped_data;
-  for (size_t i = 0; i < elevation_profile.size(); i++) {
-    clipped_data.emplace_back(
-        std::max(elevation_profile[i] + min_alt, filtered_profile[i]));
+  std::vector<int> clipped_data = filtered_profile;
+  ClipToClearance(elevation_profile.data(), elevation_profile.size(),
+                  min_alt, clipped_data.data());
+  return clipped_data;
+}
+
+std::vector<int> PathPlanner::CorrectPath(
+    const ClearanceField& field, const std::vector<std::pair<int, int>>& path,
+    const std::vector<int>& filtered_profile, const int& min_alt) {
+  PP_SCOPED_TIMER(Stage::kCorrectPath);
+  if (path.size() != filtered_profile.size()) {
+    std::cerr << "PathPlanner::CorrectPath: Unable to correct path, the path "
+                 "and filtered profile are different sizes!" << std::endl;
+    return filtered_profile;
+  }
+
+  std::vector<int> clipped_data = filtered_profile;
+  for (size_t i = 0; i < path.size(); i++) {
+    const std::pair<int, int>& cell = path[i];
+    if (cell.first < 0 || cell.first >= field.rows() || cell.second < 0 ||
+        cell.second >= field.cols()) {
+      std::cerr << "PathPlanner::CorrectPath: Unable to correct path, it "
+                   "leaves the clearance field!" << std::endl;
+      return filtered_profile;
+    }
+    clipped_data[i] =
+        std::max(int(field.MaxElevation(cell.first, cell.second)) + min_alt,
+                 clipped_data[i]);
   }
-  
   return clipped_data;
-}
\ No newline at end of file
+}
+
+std::vector<int> PathPlanner::OptimizeAltitude(
+    const std::vector<int>& elevation_profile, const int& min_alt,
+    const int& max_climb, const int& max_descent,
+    const AltitudeEnergy& energy) {
+  PP_SCOPED_TIMER(Stage::kOptimizeAltitude);
+  std::vector<int> altitude = elevation_profile;
+  AddOffset(altitude.data(), altitude.size(), min_alt);
+  if (!MinimizeEnergy(altitude.data(), altitude.size(), max_climb,
+                      max_descent, energy, altitude.data())) {
+    std::cerr << "PathPlanner::OptimizeAltitude: The climb and descent "
+                 "rates and energy costs must not be negative!" << std::endl;
+  }
+  return altitude;
+}
+
+std::vector<int> PathPlanner::OptimizeAltitude(
+    const ClearanceField& field, const std::vector<std::pair<int, int>>& path,
+    const int& min_alt, const int& max_climb, const int& max_descent,
+    const AltitudeEnergy& energy) {
+  PP_SCOPED_TIMER(Stage::kOptimizeAltitude);
+  std::vector<int> altitude(path.size());
+  for (size_t i = 0; i < path.size(); i++) {
+    const std::pair<int, int>& cell = path[i];
+    if (cell.first < 0 || cell.first >= field.rows() || cell.second < 0 ||
+        cell.second >= field.cols()) {
+      std::cerr << "PathPlanner::OptimizeAltitude: Unable to plan the "
+                   "altitude, the path leaves the clearance field!"
+                << std::endl;
+      return std::vector<int>();
+    }
+    altitude[i] = int(field.MaxElevation(cell.first, cell.second)) + min_alt;
+  }
+  if (!MinimizeEnergy(altitude.data(), altitude.size(), max_climb,
+                      max_descent, energy, altitude.data())) {
+    std::cerr << "PathPlanner::OptimizeAltitude: The climb and descent "
+                 "rates and energy costs must not be negative!" << std::endl;
+  }
+  return altitude;
+}
@@ -1,28 +1,203 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
+#include <memory>
 #include <vector>
 #include <utility>
 
+#include "cancellation.h"
+#include "clearance_field.h"
 #include "elevation_map.h"
+#include "grid_search.h"
+#include "line_of_sight.h"
+#include "map_pyramid.h"
+#include "path_cache.h"
+#include "planner_context.h"
+#include "profile_filters.h"
+#include "thread_pool.h"
 
 namespace path_planning {
 
+/// @struct A single start and goal pair for `PathPlanner::PlanPaths`
+struct PlanQuery {
+  /// The row and column to start from
+  std::pair<int, int> start;
+  /// The row and column to finish at
+  std::pair<int, int> goal;
+  /// The minimum altitude to maintain over the terrain
+  int agl = 0;
+  /// Optional. The cells to pass through in order on the way to the goal,
+  /// e.g. `emap.GetLocations(kWaypoint)`. Only viewed, so the cells must
+  /// outlive the plan.
+  Span<const std::pair<int, int>> waypoints;
+  /// Optional. Several cells to finish at, e.g. `emap.GetLocations(kEndPos)`.
+  /// When set `goal` is ignored, and the last leg searches towards every
+  /// goal at once and finishes at the cheapest to reach. Unreachable goals
+  /// are passed over. A straight line path flies to the goal nearest the
+  /// last waypoint, or the start. Only viewed, so the cells must outlive
+  /// the plan.
+  Span<const std::pair<int, int>> goals;
+  /// Optional. Stops the plan early once cancelled or past its deadline,
+  /// and the plan then fails. Not owned, it must outlive the plan.
+  const CancellationToken* cancel = nullptr;
+};
+
+/// @struct The outcome of a single `PlanQuery`
+struct PlanResult {
+  /// true if a path was successfully planned
+  bool success = false;
+  /// The elevation profile along the path
+  std::vector<int> elevation_profile;
+  /// The elevation profile with the agl applied to it
+  std::vector<int> agl_elevation_profile;
+  /// The path that was taken in row and column coordinates
+  std::vector<std::pair<int, int>> path;
+};
+
+/// @struct A single cell of a streamed path, see `PathPlanner::StreamPath`
+struct ProfileSample {
+  /// The row and column of the cell
+  int row;
+  int col;
+  /// The terrain elevation, with the start and end markers replaced by the
+  /// elevation of their neighbor along the path
+  int elevation;
+  /// The output of the filter pipeline, or the elevation without one
+  int altitude;
+};
+
+/// Receives each chunk of a streamed path in order. Returning false stops
+/// the stream.
+using ProfileChunkCallback =
+    std::function<bool(const ProfileSample* samples, size_t count)>;
+
+/// The default number of samples in a chunk of a streamed path
+static const size_t kDefaultChunkSize = 4096;
+
+/// The fewest cells along the longer side of an automatically chosen coarse
+/// level, see `HierarchicalOptions::level`
+static const int kMinCoarseSize = 256;
+
+/// @struct Options for coarse-to-fine planning. The path is first planned on
+/// the max elevation of a `MapPyramid` level, which never underestimates the
+/// terrain, then refined at full resolution inside a corridor around it.
+/// When either step finds no path the whole map is searched instead.
+struct HierarchicalOptions {
+  /// Plan coarse-to-fine. Off plans on the full resolution map only.
+  bool enabled = false;
+  /// The pyramid level to plan the coarse path on, 1 is half resolution.
+  /// 0 picks the coarsest level with at least `kMinCoarseSize` cells along
+  /// its longer side, and smaller maps are planned at full resolution.
+  int level = 0;
+  /// The half width of the refinement corridor, in cells of the coarse level
+  int corridor_margin = 2;
+};
+
+/// @struct Options for pulling planned paths taut into straight segments,
+/// see `SmoothPath`. A smoothed path holds only the cells where it turns,
+/// and its elevation profile has one entry per corner, the highest terrain
+/// of the segments on either side of it, see `SegmentProfile`.
+struct SmoothingOptions {
+  /// Smooth planned paths. Off keeps one path entry per cell.
+  bool enabled = false;
+  /// How far a shortcut may pass above the highest terrain of the section
+  /// of path it replaces. Shortcuts never pass above
+  /// `CostModel::max_altitude`, less the planning agl.
+  int allowed_rise = 0;
+};
+
 /// @class Path planner for generating elevation and paths for a given map
 class PathPlanner {
  public:
   /// @brief Constructor
   PathPlanner();
-  /// @brief Constructor
+  /// @brief Constructor. Takes constant time, the planner shares the map's
+  /// cells instead of copying them.
   /// @param An instantiated elevation map 
   PathPlanner(const ElevationMap& emap);
   /// @brief Destructor
   ~PathPlanner();
-  /// @brief Set the current map to use for path planning
+  /// @brief Move constructor and assignment. A planner owns its worker
+  /// threads and context pool, so it moves but does not copy. A moved from
+  /// planner may only be assigned to or destroyed.
+  PathPlanner(PathPlanner&& other);
+  PathPlanner& operator=(PathPlanner&& other);
+  PathPlanner(const PathPlanner&) = delete;
+  PathPlanner& operator=(const PathPlanner&) = delete;
+  /// @brief Set the current map to use for path planning. Takes constant
+  /// time, the planner shares the map's cells instead of copying them. Later
+  /// writes to `emap` are not seen by the planner.
   /// @param emap - The Elevation map to use for path planning
-  void SetMap(const ElevationMap& emap) { emap_ = emap; };
+  void SetMap(const ElevationMap& emap) {
+    emap_ = emap;
+    pyramid_.Clear();
+  }
+  /// @brief Set the current map to an edited copy of it where only a region
+  /// changed. The map pyramid of hierarchical planning is updated above the
+  /// region instead of being rebuilt.
+  /// @param emap - The edited map, the same size as the current one
+  /// @param row - The first changed row
+  /// @param col - The first changed column
+  /// @param rows - The number of changed rows
+  /// @param cols - The number of changed columns
+  void UpdateMap(const ElevationMap& emap, int row, int col, int rows,
+                 int cols);
+  /// @brief Get the map used for path planning
+  const ElevationMap& map() const { return emap_; }
+  /// @brief Set how the base path between the start and end is searched for
+  /// @param options - The search options to use for subsequent plans
+  void SetSearchOptions(const SearchOptions& options) {
+    context_.search.SetOptions(options);
+  }
+  /// @brief Get the current search options
+  const SearchOptions& search_options() const {
+    return context_.search.options();
+  }
+  /// @brief Get the search counters from the most recent plan
+  const SearchStats& search_stats() const {
+    return context_.search.stats();
+  }
+  /// @brief Set how paths are planned coarse-to-fine. The map pyramid is
+  /// built in parallel on the first plan that needs it.
+  /// @param options - The hierarchical options to use for subsequent plans
+  void SetHierarchicalOptions(const HierarchicalOptions& options) {
+    hierarchical_ = options;
+  }
+  /// @brief Get the current hierarchical options
+  const HierarchicalOptions& hierarchical_options() const {
+    return hierarchical_;
+  }
+  /// @brief Set how planned paths are smoothed. Applies to searched and
+  /// straight line paths alike. With `SearchOptions::clearance` set,
+  /// shortcuts are checked against the clearance field instead of the
+  /// terrain beneath them.
+  /// @param options - The smoothing options to use for subsequent plans
+  void SetSmoothingOptions(const SmoothingOptions& options) {
+    smoothing_ = options;
+  }
+  /// @brief Get the current smoothing options
+  const SmoothingOptions& smoothing_options() const { return smoothing_; }
+  /// @brief Get the search counters of the coarse step of the most recent
+  /// hierarchical plan
+  const SearchStats& coarse_search_stats() const {
+    return context_.coarse_search.stats();
+  }
+  /// @brief Put a cache of plans in front of planning and filtering. Plans
+  /// are looked up by everything they depend on, the map's `id()` and
+  /// `version()`, the query and the options, so a plan made before the map
+  /// was set or updated is never returned. A hit fills the outputs without
+  /// searching, and leaves `search_stats()` as they were.
+  /// @param cache - Optional. The cache to use, or nullptr for none. Not
+  /// owned, it must outlive the planner and may be shared between planners.
+  void SetPathCache(PathCache* cache) { cache_ = cache; }
+  /// @brief Get the cache of plans, nullptr if there is none
+  PathCache* path_cache() const { return cache_; }
+  /// @brief Get the map pyramid, empty until a hierarchical plan needs it
+  const MapPyramid& pyramid() const { return pyramid_; }
   /// @brief Plan a path from the beginning to the end locations on the current
-  /// elevation map.
-  /// @brief
+  /// elevation map. The map must have one start location, and the path
+  /// finishes at whichever of its end locations is cheapest to reach.
   /// @param elevation_profile - The output elevation profile from the
   /// planned path.
   /// @param agl_elevation_profile - The elevation profile with the agl applied
@@ -36,7 +211,66 @@ class PathPlanner {
                 std::vector<int>* agl_elevation_profile,
                 const int& agl = 0,
                 std::vector<std::pair<int, int>>* path = nullptr);
-  /// @brief Apply a median filter to the input data
+  /// @brief Plan a path from the beginning to the end locations and run it
+  /// through a filter pipeline, e.g. agl offset, smoothing and clipping. With
+  /// reused output vectors and pipeline a plan does not allocate once warm.
+  /// @param pipeline - The filter stages to apply to the elevation profile
+  /// @param elevation_profile - The output elevation profile from the
+  /// planned path.
+  /// @param filtered_profile - The output of the filter pipeline
+  /// @param path - Optional. The full path that was taken in row and
+  /// column coordinates
+  /// @return true if a path was successfully planned and filtered
+  bool PlanFilteredPath(ProfilePipeline* pipeline,
+                        std::vector<int>* elevation_profile,
+                        std::vector<int>* filtered_profile,
+                        std::vector<std::pair<int, int>>* path = nullptr);
+  /// @brief Plan a path from the beginning to the end locations and stream
+  /// it through a filter pipeline in fixed-size chunks instead of
+  /// materializing the profiles. Gives the same values as
+  /// `PlanFilteredPath`, while only the chunk and the look-back of the
+  /// filter stages are held in memory. Straight line paths are generated as
+  /// they are streamed. Searched paths are only known once the search
+  /// finishes, so their cells are held until then, but no profile is.
+  /// @param pipeline - Optional. The filter stages to apply to the elevation
+  /// profile
+  /// @param on_chunk - Receives the samples of the path in order, every
+  /// chunk but the last holding `chunk_size` of them
+  /// @param chunk_size - The number of samples in a chunk
+  /// @return true if a path was planned, filtered and streamed to the end
+  bool StreamPath(ProfilePipeline* pipeline,
+                  const ProfileChunkCallback& on_chunk,
+                  size_t chunk_size = kDefaultChunkSize);
+  /// @brief Plan many start and goal pairs on the current map in parallel.
+  /// The map is shared read-only by a pool of worker threads, each plan
+  /// leasing a context from the same pool as `Plan`. The threads and
+  /// contexts are kept between calls.
+  /// @param queries - The start and goal pairs to plan
+  /// @param results - Output. One result per query, in query order
+  /// @param num_threads - The number of worker threads, or 0 to use one per
+  /// hardware thread
+  /// @return true if every query was successfully planned
+  bool PlanPaths(const std::vector<PlanQuery>& queries,
+                 std::vector<PlanResult>* results, int num_threads = 0);
+  /// @brief Build the state planning needs ahead of time, so plans from
+  /// many threads through `Plan` can share the planner. Builds the map
+  /// pyramid if hierarchical planning is enabled and warms the pool of
+  /// planner contexts.
+  /// @param num_contexts - The number of contexts to create up front, e.g.
+  /// the number of threads that will plan at once
+  void Prepare(int num_contexts = 0);
+  /// @brief Plan a single start and goal pair on the current map. Safe to
+  /// call from many threads at once, each plan leasing a context from a
+  /// pool of warmed-up ones, so reused results are filled without
+  /// allocating. The planner's map and options must not change meanwhile.
+  /// Hierarchical plans search the full map until `Prepare` has built the
+  /// pyramid.
+  /// @param query - The start and goal pair to plan
+  /// @param result - Output. The planned path and profiles.
+  /// @return true if a path was successfully planned
+  bool Plan(const PlanQuery& query, PlanResult* result) const;
+  /// @brief Apply a median filter to the input data. Runs in
+  /// O(n log filter_width), see `SlidingMedian`.
   /// @param elevation_profile The data to filter
   /// @param filter_width The width of the data to consider for the median
   /// @return The filtered signal
@@ -49,7 +283,8 @@ class PathPlanner {
   /// @return The filtered signal
   std::vector<int> LowpassFilter(const std::vector<int>& elevation_profile,
                                  const double& alpha);
-  /// @brief Apply a mean filter to the input data
+  /// @brief Apply a mean filter to the input data. Runs in O(n) regardless
+  /// of the filter width.
   /// @param elevation_profile The data to filter
   /// @param filter_width The width of the data to consider for the mean
   /// @return The filtered signal
@@ -65,18 +300,149 @@ class PathPlanner {
   std::vector<int> CorrectPath(const std::vector<int>& elevation_profile,
                                const std::vector<int>& filtered_profile,
                                const int& min_alt);
+  /// @brief Correct the path by making sure it clears all the terrain within
+  /// the radius of a clearance field, not only the terrain beneath it
+  /// @param field - The clearance field of the planned map
+  /// @param path - The path that was planned
+  /// @param filtered_profile The output of applying a filter to the profile
+  /// @param min_alt The minimum value the path must be above the highest
+  /// terrain around each cell
+  /// @return The clipped path that will not collide with the terrain nearby
+  std::vector<int> CorrectPath(const ClearanceField& field,
+                               const std::vector<std::pair<int, int>>& path,
+                               const std::vector<int>& filtered_profile,
+                               const int& min_alt);
+  /// @brief Plan the altitude along a path in one pass instead of filtering
+  /// and correcting it. Gives the profile that spends the least energy
+  /// while staying `min_alt` above the terrain and climbing and descending
+  /// within the given rates, see `MinimizeEnergy`, so there is no step for
+  /// a clip to put back. Valleys that cost more to fly down into and climb
+  /// out of than to fly over are bridged.
+  /// @param elevation_profile The original elevation profile of the map,
+  /// one value per cell of the path
+  /// @param min_alt The minimum value the path must be above the
+  /// `elevation_profile`
+  /// @param max_climb The most the altitude may rise from one cell to the
+  /// next
+  /// @param max_descent The most the altitude may fall from one cell to the
+  /// next
+  /// @param energy The costs of climbing, descending and holding altitude
+  /// @return The altitude profile, or the terrain plus `min_alt` if a rate
+  /// or a cost is negative
+  std::vector<int> OptimizeAltitude(
+      const std::vector<int>& elevation_profile, const int& min_alt,
+      const int& max_climb, const int& max_descent,
+      const AltitudeEnergy& energy = AltitudeEnergy());
+  /// @brief Plan the altitude along a path clear of all the terrain within
+  /// the radius of a clearance field, not only the terrain beneath it
+  /// @param field - The clearance field of the planned map
+  /// @param path - The path that was planned, one entry per cell
+  /// @param min_alt The minimum value the path must be above the highest
+  /// terrain around each cell
+  /// @param max_climb The most the altitude may rise from one cell to the
+  /// next
+  /// @param max_descent The most the altitude may fall from one cell to the
+  /// next
+  /// @param energy The costs of climbing, descending and holding altitude
+  /// @return The altitude profile, empty if the path leaves the field
+  std::vector<int> OptimizeAltitude(
+      const ClearanceField& field,
+      const std::vector<std::pair<int, int>>& path, const int& min_alt,
+      const int& max_climb, const int& max_descent,
+      const AltitudeEnergy& energy = AltitudeEnergy());
 
  private:
+  /// @brief Plan a query through its waypoints and produce the elevation
+  /// profiles. Each leg between waypoints is planned on its own and the
+  /// legs are joined. Only reads the map, so it is safe to call from
+  /// several threads with different contexts.
+  /// @param query - The start, waypoints, goals and agl to plan
+  /// @param context - The search engines and scratch state to plan with
+  /// @param elevation_profile - The output elevation profile
+  /// @param agl_elevation_profile - The output profile with agl applied
+  /// @param path - The output path in row and column coordinates
+  /// @return true if a path was successfully planned
+  bool PlanBetween(const PlanQuery& query, PlannerContext* context,
+                   std::vector<int>* elevation_profile,
+                   std::vector<int>* agl_elevation_profile,
+                   std::vector<std::pair<int, int>>* path) const;
   /// @brief Generate the base elevation profile and path prior to filtering
+  /// @param start - The row and column to start from
+  /// @param goals - The rows and columns to finish at, searched towards at
+  /// once. A straight line path flies to the nearest.
+  /// @param agl - The minimum altitude to maintain over the terrain
+  /// @param context - The search engines and scratch state to plan with
   /// @param elevation_profile - The output elevation profile from the 
   /// planned path.
-  /// @param path - Optional. The full path that was taken in row and 
-  /// column coordinates
+  /// @param path - The full path that was taken in row and column
+  /// coordinates
   /// @return true if a path was successfully planned
-  bool GenerateBasePath(std::vector<int>* elevation_profile,
-                        std::vector<std::pair<int, int>>* path = nullptr);
+  bool GenerateBasePath(const std::pair<int, int>& start,
+                        Span<const std::pair<int, int>> goals, int agl,
+                        PlannerContext* context,
+                        std::vector<int>* elevation_profile,
+                        std::vector<std::pair<int, int>>* path) const;
+  /// @brief Search for a path coarse-to-fine, see `HierarchicalOptions`
+  /// @return true if both steps found a path
+  bool FindHierarchicalPath(const std::pair<int, int>& start,
+                            Span<const std::pair<int, int>> goals, int agl,
+                            PlannerContext* context,
+                            std::vector<std::pair<int, int>>* path) const;
+  /// @brief Pull a planned path taut, see `SmoothingOptions`
+  /// @param options - The options the path was searched with
+  /// @param agl - The minimum altitude the path was planned at
+  /// @param path - Input and output. The path to smooth.
+  void Smooth(const SearchOptions& options, int agl,
+              std::vector<std::pair<int, int>>* path) const;
+  /// @brief Get the start and end locations of the map, viewing the end
+  /// locations as the query's goals if there are several
+  /// @param query - Output. The start and goal of the query.
+  /// @return false if the map does not have exactly one start location and
+  /// at least one end location
+  bool FindEndpoints(PlanQuery* query) const;
+  /// @brief Build the key of a plan in the path cache from the map, the
+  /// options and the query
+  /// @param query - The query that is planned
+  /// @param kind - Tells apart the outputs cached for the same query
+  /// @param key - Output. The key of the plan.
+  void BuildCacheKey(const PlanQuery& query, int kind,
+                     PathCacheKey* key) const;
+  /// @brief Build the map pyramid if hierarchical planning needs it
+  void EnsurePyramid();
+  /// @brief Get the pyramid level to plan coarse paths on, 0 for none
+  int CoarseLevel() const;
 
-  /// The current elevation map to plan a path for
+  /// The current elevation map to plan a path for. Shares its cells with the
+  /// map it was set from and is never written, so it never copies them.
   ElevationMap emap_;
+  /// The search engines and reusable scratch state of single plans
+  PlannerContext context_;
+  /// How paths are planned coarse-to-fine
+  HierarchicalOptions hierarchical_;
+  /// How planned paths are smoothed
+  SmoothingOptions smoothing_;
+  /// Optional. The cache of plans in front of planning, not owned.
+  PathCache* cache_ = nullptr;
+  /// The key filtered plans are looked up with
+  PathCacheKey filtered_key_;
+  /// The summary of `emap_` coarse paths are planned on, built on demand
+  MapPyramid pyramid_;
+  /// Holds the path when the caller does not ask for it
+  std::vector<std::pair<int, int>> path_scratch_;
+  /// The elevation profile of a searched path being streamed
+  std::vector<int> stream_profile_;
+  /// The samples of a stream waiting for their filter output or their chunk
+  std::vector<ProfileSample> stream_samples_;
+  /// Scratch for the elevations pushed into and altitudes pulled out of the
+  /// filter pipeline of a stream
+  std::vector<int> stream_elevations_;
+  std::vector<int> stream_altitudes_;
+  /// The median filter and its reusable scratch state
+  SlidingMedian median_;
+  /// The worker threads for `PlanPaths`, created on first use
+  std::unique_ptr<ThreadPool> pool_;
+  /// The contexts leased by `Plan` and `PlanPaths`, which manages its own
+  /// locking. Held by pointer so the planner stays movable.
+  std::unique_ptr<PlannerContextPool> contexts_;
 };
 }
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "planner_context.h"
+
+using namespace path_planning;
+
+PlannerContextPool::Lease::~Lease() {
+  if (context_) {
+    pool_->Release(std::move(context_));
+  }
+}
+
+PlannerContextPool::PlannerContextPool() : size_(0) {
+}
+
+void PlannerContextPool::Reserve(size_t count) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.reserve(count);
+  while (size_ < count) {
+    idle_.emplace_back(new PlannerContext());
+    size_++;
+  }
+}
+
+PlannerContextPool::Lease PlannerContextPool::Acquire() {
+  std::unique_ptr<PlannerContext> context;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!idle_.empty()) {
+      context = std::move(idle_.back());
+      idle_.pop_back();
+    } else {
+      idle_.reserve(++size_);
+    }
+  }
+  if (!context) {
+    context.reset(new PlannerContext());
+  }
+  return Lease(this, std::move(context));
+}
+
+size_t PlannerContextPool::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+size_t PlannerContextPool::idle() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return idle_.size();
+}
+
+void PlannerContextPool::Release(std::unique_ptr<PlannerContext> context) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  idle_.push_back(std::move(context));
+}
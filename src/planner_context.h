@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "grid_search.h"
+#include "path_cache.h"
+
+namespace path_planning {
+
+/// @struct The scratch state a single plan needs, kept between plans so a
+/// warm context plans without allocating. A context is used by one plan at
+/// a time.
+struct PlannerContext {
+  /// The search engine for the full resolution path
+  GridSearch search;
+  /// The search engine for the coarse step of hierarchical plans
+  GridSearch coarse_search;
+  /// The blocks of the goals the coarse step of hierarchical plans heads for
+  std::vector<std::pair<int, int>> coarse_goals;
+  /// The corridor hierarchical plans refine the coarse path in
+  SearchCorridor corridor;
+  /// The path and elevation profile of one leg of a plan with waypoints
+  std::vector<std::pair<int, int>> leg_path;
+  std::vector<int> leg_profile;
+  /// The key the plan is looked up in a `PathCache` with
+  PathCacheKey cache_key;
+};
+
+/// @class Thread safe pool of `PlannerContext`s for planning from many
+/// threads at once. A context is leased for the length of a plan and then
+/// returned with its buffers still sized, so the next plan to lease it
+/// starts warm. Contexts are created when the pool runs dry and kept until
+/// the pool is destroyed.
+class PlannerContextPool {
+ public:
+  /// @class A leased context, returned to its pool on destruction
+  class Lease {
+   public:
+    /// @brief Constructor
+    /// @param pool - The pool to return the context to
+    /// @param context - The leased context
+    Lease(PlannerContextPool* pool, std::unique_ptr<PlannerContext> context)
+        : pool_(pool), context_(std::move(context)) {}
+    /// @brief Destructor, returns the context
+    ~Lease();
+    Lease(Lease&& other) = default;
+    Lease& operator=(Lease&& other) = delete;
+    Lease(const Lease&) = delete;
+    Lease& operator=(const Lease&) = delete;
+    /// @brief Get the leased context
+    PlannerContext* get() const { return context_.get(); }
+    PlannerContext* operator->() const { return context_.get(); }
+
+   private:
+    /// The pool to return the context to
+    PlannerContextPool* pool_;
+    /// The leased context, empty once moved from
+    std::unique_ptr<PlannerContext> context_;
+  };
+
+  /// @brief Constructor. Creates no contexts.
+  PlannerContextPool();
+  PlannerContextPool(const PlannerContextPool&) = delete;
+  PlannerContextPool& operator=(const PlannerContextPool&) = delete;
+  /// @brief Create contexts until at least `count` exist, e.g. one per
+  /// thread that will plan at once
+  /// @param count - The number of contexts
+  void Reserve(size_t count);
+  /// @brief Lease an idle context, or a new one if none is idle. Never
+  /// blocks on other plans.
+  Lease Acquire();
+  /// @brief Get the number of contexts the pool has created
+  size_t size() const;
+  /// @brief Get the number of contexts not leased
+  size_t idle() const;
+
+ private:
+  /// @brief Take back a leased context
+  void Release(std::unique_ptr<PlannerContext> context);
+
+  /// Guards the fields below
+  mutable std::mutex mutex_;
+  /// The contexts that are not leased. Reserved for every context created,
+  /// so returning one never allocates.
+  std::vector<std::unique_ptr<PlannerContext>> idle_;
+  /// The number of contexts created
+  size_t size_;
+};
+}
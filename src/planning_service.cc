@@ -0,0 +1,211 @@
+#include <algorithm>
+#include <utility>
+
+#include "instrumentation.h"
+#include "planning_service.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// @brief Get the seconds from one time to another
+double SecondsBetween(PlanningService::Clock::time_point begin,
+                      PlanningService::Clock::time_point end) {
+  return std::chrono::duration<double>(end - begin).count();
+}
+
+}  // namespace
+
+const char* path_planning::PlanStatusName(PlanStatus status) {
+  switch (status) {
+    case PlanStatus::kOk:
+      return "ok";
+    case PlanStatus::kNoPath:
+      return "no_path";
+    case PlanStatus::kCancelled:
+      return "cancelled";
+    case PlanStatus::kDeadlineExceeded:
+      return "deadline_exceeded";
+    case PlanStatus::kRejected:
+      return "rejected";
+    default:
+      return "unknown";
+  }
+}
+
+PlanningService::PlanningService(const PathPlanner* planner,
+                                 const PlanningServiceOptions& options)
+    : planner_(planner),
+      queue_capacity_(std::max<size_t>(options.queue_capacity, 1)),
+      block_when_full_(options.block_when_full),
+      stop_(false) {
+  int num_threads = options.num_threads;
+  if (num_threads <= 0) {
+    num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+  }
+  running_.resize(size_t(num_threads));
+  for (int i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&PlanningService::WorkerLoop, this, i);
+  }
+}
+
+PlanningService::~PlanningService() {
+  Shutdown();
+}
+
+PlanTicket PlanningService::Submit(const PlanQuery& query,
+                                   Clock::time_point deadline) {
+  std::unique_ptr<Request> request(new Request());
+  request->query = query;
+  request->cancel = std::make_shared<CancellationToken>(deadline);
+  PlanTicket ticket;
+  ticket.response_ = request->promise.get_future();
+  ticket.cancel_ = request->cancel;
+  Enqueue(std::move(request));
+  return ticket;
+}
+
+PlanTicket PlanningService::Submit(const PlanQuery& query,
+                                   Clock::time_point deadline,
+                                   PlanCallback on_response) {
+  std::unique_ptr<Request> request(new Request());
+  request->query = query;
+  request->cancel = std::make_shared<CancellationToken>(deadline);
+  request->on_response = std::move(on_response);
+  PlanTicket ticket;
+  ticket.cancel_ = request->cancel;
+  Enqueue(std::move(request));
+  return ticket;
+}
+
+void PlanningService::Enqueue(std::unique_ptr<Request> request) {
+  request->query.cancel = request->cancel.get();
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (block_when_full_) {
+      room_cv_.wait(lock, [this]() {
+        return stop_ || queue_.size() < queue_capacity_;
+      });
+    }
+    if (!stop_ && queue_.size() < queue_capacity_) {
+      request->queued = Clock::now();
+      queue_.push_back(std::move(request));
+      stats_.submitted++;
+      stats_.queue_depth = queue_.size();
+      stats_.max_queue_depth =
+          std::max(stats_.max_queue_depth, stats_.queue_depth);
+      lock.unlock();
+      work_cv_.notify_one();
+      return;
+    }
+    stats_.rejected++;
+  }
+  PP_COUNTER_ADD(Counter::kRejectedRequests, 1);
+  Respond(request.get(), PlanResponse());
+}
+
+void PlanningService::Shutdown() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_ && threads_.empty()) {
+      return;
+    }
+    stop_ = true;
+    for (auto& request : queue_) {
+      request->cancel->Cancel();
+    }
+    for (auto& cancel : running_) {
+      if (cancel) {
+        cancel->Cancel();
+      }
+    }
+  }
+  work_cv_.notify_all();
+  room_cv_.notify_all();
+  // The threads answer the queued requests as cancelled on their way out
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+}
+
+PlanningServiceStats PlanningService::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void PlanningService::WorkerLoop(int worker) {
+  while (true) {
+    std::unique_ptr<Request> request;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this]() { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      request = std::move(queue_.front());
+      queue_.pop_front();
+      stats_.queue_depth = queue_.size();
+      stats_.running++;
+      running_[size_t(worker)] = request->cancel;
+    }
+    room_cv_.notify_one();
+    Run(worker, request.get());
+  }
+}
+
+void PlanningService::Run(int worker, Request* request) {
+  const Clock::time_point started = Clock::now();
+  PP_LATENCY_ADD(Stage::kQueueWait,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(
+                     started - request->queued)
+                     .count());
+  PlanResponse response;
+  response.queue_seconds = SecondsBetween(request->queued, started);
+  // A request that was cancelled or expired while queued is not planned
+  const CancellationToken& cancel = *request->cancel;
+  const bool planned =
+      !cancel.IsCancelled() && planner_->Plan(request->query, &response.result);
+  response.plan_seconds = SecondsBetween(started, Clock::now());
+  if (planned) {
+    response.status = PlanStatus::kOk;
+  } else if (cancel.cancel_requested()) {
+    response.status = PlanStatus::kCancelled;
+    PP_COUNTER_ADD(Counter::kCancelledRequests, 1);
+  } else if (cancel.expired()) {
+    response.status = PlanStatus::kDeadlineExceeded;
+    PP_COUNTER_ADD(Counter::kExpiredRequests, 1);
+  } else {
+    response.status = PlanStatus::kNoPath;
+  }
+  {
+    // Counted before answering, so the counters add up once every response
+    // has been received
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.running--;
+    running_[size_t(worker)].reset();
+    switch (response.status) {
+      case PlanStatus::kOk:
+        stats_.planned++;
+        break;
+      case PlanStatus::kCancelled:
+        stats_.cancelled++;
+        break;
+      case PlanStatus::kDeadlineExceeded:
+        stats_.expired++;
+        break;
+      default:
+        stats_.failed++;
+        break;
+    }
+  }
+  Respond(request, std::move(response));
+}
+
+void PlanningService::Respond(Request* request, PlanResponse&& response) {
+  if (request->on_response) {
+    request->on_response(std::move(response));
+  } else {
+    request->promise.set_value(std::move(response));
+  }
+}
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "cancellation.h"
+#include "path_planner.h"
+
+namespace path_planning {
+
+/// The default number of requests a `PlanningService` holds in its queue
+static const size_t kDefaultQueueCapacity = 1024;
+
+/// How a request to a `PlanningService` ended
+enum class PlanStatus {
+  /// A path was planned
+  kOk = 0,
+  /// The plan failed, e.g. no path exists
+  kNoPath,
+  /// `PlanTicket::Cancel` was called, or the service shut down first
+  kCancelled,
+  /// The deadline passed before the plan finished
+  kDeadlineExceeded,
+  /// The queue was full, or the service was shutting down
+  kRejected
+};
+
+/// @brief Get the name of a status, e.g. for logs
+const char* PlanStatusName(PlanStatus status);
+
+/// @struct Options for a `PlanningService`
+struct PlanningServiceOptions {
+  /// The number of planning threads, or 0 to use one per hardware thread
+  int num_threads = 0;
+  /// The most requests that may wait for a thread
+  size_t queue_capacity = kDefaultQueueCapacity;
+  /// With a full queue, `Submit` waits for room instead of rejecting the
+  /// request. Blocking pushes back on the caller, rejecting lets it shed
+  /// the load.
+  bool block_when_full = false;
+};
+
+/// @struct The outcome of a request to a `PlanningService`
+struct PlanResponse {
+  /// How the request ended
+  PlanStatus status = PlanStatus::kRejected;
+  /// The plan, filled in when `status` is `kOk`
+  PlanResult result;
+  /// The seconds the request waited in the queue
+  double queue_seconds = 0.0;
+  /// The seconds spent planning
+  double plan_seconds = 0.0;
+};
+
+/// Receives the response to a request on the planning thread that finished
+/// it, or on the submitting thread if it was rejected. Must not block.
+using PlanCallback = std::function<void(PlanResponse&& response)>;
+
+/// @class A request submitted to a `PlanningService`. The response is
+/// collected through `Get`, unless the request was submitted with a
+/// callback. Either way it can be cancelled.
+class PlanTicket {
+ public:
+  /// @brief Cancel the request. A queued request is dropped when a thread
+  /// takes it, a running one stops within a few thousand expansions.
+  void Cancel() const {
+    if (cancel_) {
+      cancel_->Cancel();
+    }
+  }
+  /// @brief Check if the response can be collected with `Get`
+  bool valid() const { return response_.valid(); }
+  /// @brief Wait for the response for at most a while
+  /// @return true if the response is ready
+  template <typename Rep, typename Period>
+  bool WaitFor(const std::chrono::duration<Rep, Period>& timeout) const {
+    return response_.wait_for(timeout) == std::future_status::ready;
+  }
+  /// @brief Wait for the response and take it. Only once, and only for
+  /// requests submitted without a callback.
+  PlanResponse Get() { return response_.get(); }
+
+ private:
+  friend class PlanningService;
+
+  /// The response, empty for requests with a callback
+  std::future<PlanResponse> response_;
+  /// Cancels the request
+  std::shared_ptr<CancellationToken> cancel_;
+};
+
+/// @struct Counters of a `PlanningService`
+struct PlanningServiceStats {
+  /// Requests accepted into the queue
+  uint64_t submitted = 0;
+  /// Requests turned away, see `PlanStatus::kRejected`
+  uint64_t rejected = 0;
+  /// Requests that finished with each status
+  uint64_t planned = 0;
+  uint64_t failed = 0;
+  uint64_t cancelled = 0;
+  uint64_t expired = 0;
+  /// The requests waiting in the queue now
+  size_t queue_depth = 0;
+  /// The most requests that have waited in the queue at once
+  size_t max_queue_depth = 0;
+  /// The requests being planned now
+  size_t running = 0;
+};
+
+/// @class Asynchronous front end of a `PathPlanner` for servers. Requests
+/// wait in a bounded queue for one of a fixed set of planning threads, and
+/// are answered through a future or a callback. Each request may have a
+/// deadline and may be cancelled. Both stop the search cooperatively
+/// through its `CancellationToken`, so a pathological query cannot hold a
+/// thread for long.
+///
+/// Plans go through `PathPlanner::Plan`, so the planner's map and options
+/// must not change while the service is running. Call `Prepare` on the
+/// planner first to plan hierarchically. A context's first plan allocates
+/// its search nodes before any deadline is checked, so plan once per thread
+/// to warm the contexts when the first deadlines are tight.
+class PlanningService {
+ public:
+  using Clock = CancellationToken::Clock;
+
+  /// @brief Constructor. Starts the planning threads.
+  /// @param planner - The planner to plan with. Not owned, it must outlive
+  /// the service.
+  /// @param options - The threads and queue of the service
+  explicit PlanningService(
+      const PathPlanner* planner,
+      const PlanningServiceOptions& options = PlanningServiceOptions());
+  /// @brief Destructor, see `Shutdown`
+  ~PlanningService();
+  PlanningService(const PlanningService&) = delete;
+  PlanningService& operator=(const PlanningService&) = delete;
+  /// @brief Queue a plan and collect its response from the ticket
+  /// @param query - The query to plan. Any `cancel` of its own is replaced
+  /// by the ticket's. The cells it views must outlive the request.
+  /// @param deadline - When to give up on the plan
+  /// @return The ticket of the request, answered at once with `kRejected`
+  /// if it was not queued
+  PlanTicket Submit(const PlanQuery& query,
+                    Clock::time_point deadline = Clock::time_point::max());
+  /// @brief Queue a plan and hand its response to a callback
+  /// @param query - The query to plan, see the other overload
+  /// @param deadline - When to give up on the plan
+  /// @param on_response - Receives the response, exactly once
+  /// @return The ticket of the request, only good for cancelling it
+  PlanTicket Submit(const PlanQuery& query, Clock::time_point deadline,
+                    PlanCallback on_response);
+  /// @brief Stop taking requests, cancel the queued and running ones, and
+  /// wait for the threads to finish. Every request is still answered.
+  void Shutdown();
+  /// @brief Get the number of planning threads
+  int num_threads() const { return int(threads_.size()); }
+  /// @brief Get a snapshot of the counters
+  PlanningServiceStats stats() const;
+
+ private:
+  /// @struct A queued or running request
+  struct Request {
+    PlanQuery query;
+    std::shared_ptr<CancellationToken> cancel;
+    /// Set for requests answered through a future
+    std::promise<PlanResponse> promise;
+    /// Set for requests answered through a callback
+    PlanCallback on_response;
+    /// When the request was queued
+    Clock::time_point queued;
+  };
+
+  /// @brief Queue a request, or answer it with `kRejected`
+  void Enqueue(std::unique_ptr<Request> request);
+  /// @brief Plan a request and answer it
+  /// @param worker - The index of the thread planning it
+  void Run(int worker, Request* request);
+  /// @brief Hand a response to the request's future or callback
+  static void Respond(Request* request, PlanResponse&& response);
+  /// @brief The body of each planning thread
+  /// @param worker - The index of the thread
+  void WorkerLoop(int worker);
+
+  /// The planner to plan with
+  const PathPlanner* planner_;
+  /// The most requests that may wait
+  size_t queue_capacity_;
+  /// Whether a full queue blocks `Submit`
+  bool block_when_full_;
+  /// The planning threads
+  std::vector<std::thread> threads_;
+  /// Guards the fields below
+  mutable std::mutex mutex_;
+  /// Signals the threads that a request is queued or the service stopping
+  std::condition_variable work_cv_;
+  /// Signals blocked submitters that the queue has room
+  std::condition_variable room_cv_;
+  /// The requests waiting for a thread, oldest first
+  std::deque<std::unique_ptr<Request>> queue_;
+  /// The token of the request each thread is planning, if any
+  std::vector<std::shared_ptr<CancellationToken>> running_;
+  /// Set once the service stops taking requests
+  bool stop_;
+  /// The counters
+  PlanningServiceStats stats_;
+};
+}
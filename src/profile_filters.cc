@@ -0,0 +1,665 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PROFILE_FILTERS_AVX2
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define PROFILE_FILTERS_SSE2
+#define PROFILE_FILTERS_SSE4_1
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROFILE_FILTERS_SSE2
+#endif
+
+#include "instrumentation.h"
+#include "path_cache.h"
+#include "profile_filters.h"
+
+using namespace path_planning;
+
+void path_planning::AddOffset(int* data, size_t size, int offset) {
+  size_t i = 0;
+#if defined(PROFILE_FILTERS_AVX2)
+  const __m256i offsets = _mm256_set1_epi32(offset);
+  for (; i + 8 <= size; i += 8) {
+    __m256i* block = reinterpret_cast<__m256i*>(data + i);
+    _mm256_storeu_si256(block,
+                        _mm256_add_epi32(_mm256_loadu_si256(block), offsets));
+  }
+#elif defined(PROFILE_FILTERS_SSE2)
+  const __m128i offsets = _mm_set1_epi32(offset);
+  for (; i + 4 <= size; i += 4) {
+    __m128i* block = reinterpret_cast<__m128i*>(data + i);
+    _mm_storeu_si128(block, _mm_add_epi32(_mm_loadu_si128(block), offsets));
+  }
+#endif
+  for (; i < size; i++) {
+    data[i] += offset;
+  }
+}
+
+void path_planning::ClipToClearance(const int* elevation, size_t size,
+                                    int min_alt, int* data) {
+  size_t i = 0;
+#if defined(PROFILE_FILTERS_AVX2)
+  const __m256i min_alts = _mm256_set1_epi32(min_alt);
+  for (; i + 8 <= size; i += 8) {
+    const __m256i floor = _mm256_add_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(elevation + i)),
+        min_alts);
+    __m256i* block = reinterpret_cast<__m256i*>(data + i);
+    _mm256_storeu_si256(block,
+                        _mm256_max_epi32(floor, _mm256_loadu_si256(block)));
+  }
+#elif defined(PROFILE_FILTERS_SSE2)
+  const __m128i min_alts = _mm_set1_epi32(min_alt);
+  for (; i + 4 <= size; i += 4) {
+    const __m128i floor = _mm_add_epi32(
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(elevation + i)),
+        min_alts);
+    __m128i* block = reinterpret_cast<__m128i*>(data + i);
+    const __m128i values = _mm_loadu_si128(block);
+#if defined(PROFILE_FILTERS_SSE4_1)
+    _mm_storeu_si128(block, _mm_max_epi32(floor, values));
+#else
+    // SSE2 has no 32-bit max, so select with a compare mask
+    const __m128i floor_is_higher = _mm_cmpgt_epi32(floor, values);
+    _mm_storeu_si128(block,
+                     _mm_or_si128(_mm_and_si128(floor_is_higher, floor),
+                                  _mm_andnot_si128(floor_is_higher, values)));
+#endif
+  }
+#endif
+  for (; i < size; i++) {
+    data[i] = std::max(elevation[i] + min_alt, data[i]);
+  }
+}
+
+void path_planning::MeanFilter(const int* input, size_t size,
+                               int filter_width, int* output) {
+  if (size == 0) {
+    return;
+  }
+  if (filter_width <= 0) {
+    std::copy(input, input + size, output);
+    return;
+  }
+  // Each window is [i, end) and both ends only move forward, so keep a
+  // running sum instead of re-adding the window for every value
+  const size_t last = size - 1;
+  size_t end = 0;
+  int64_t sum = 0;
+  for (size_t i = 0; i < last; i++) {
+    const size_t window_end = std::min(i + size_t(filter_width), last);
+    for (; end < window_end; end++) {
+      sum += input[end];
+    }
+    output[i] = int(std::round(double(sum) / double(window_end - i)));
+    sum -= input[i];
+  }
+  // The final value is its own mean
+  output[last] = input[last];
+}
+
+bool path_planning::LowpassFilter(const int* input, size_t size,
+                                  double alpha, int* output) {
+  if (alpha < 0.0 || alpha > 1.0 || size < 2) {
+    if (output != input) {
+      std::copy(input, input + size, output);
+    }
+    return alpha >= 0.0 && alpha <= 1.0;
+  }
+  // Seed with the second value since the first is usually a location marker
+  int previous = input[1];
+  output[0] = previous;
+  for (size_t i = 1; i < size; i++) {
+    previous = int(alpha * input[i] + (1.0 - alpha) * previous);
+    output[i] = previous;
+  }
+  return true;
+}
+
+bool path_planning::LimitSlopes(const int* floor, size_t size, int max_climb,
+                                int max_descent, int* output) {
+  if (max_climb < 0 || max_descent < 0 || size == 0) {
+    if (output != floor) {
+      std::copy(floor, floor + size, output);
+    }
+    return max_climb >= 0 && max_descent >= 0;
+  }
+  // Forward, no lower than the floor behind less the descent since. In 64
+  // bits so unlimited rates do not overflow.
+  int64_t previous = floor[0];
+  output[0] = floor[0];
+  for (size_t i = 1; i < size; i++) {
+    previous = std::max<int64_t>(floor[i], previous - max_descent);
+    output[i] = int(previous);
+  }
+  // Backward, no lower than the floor ahead less the climb to reach it
+  previous = output[size - 1];
+  for (size_t i = size - 1; i-- > 0;) {
+    previous = std::max<int64_t>(output[i], previous - max_climb);
+    output[i] = int(previous);
+  }
+  return true;
+}
+
+double path_planning::ProfileEnergy(const int* profile, size_t size,
+                                    const AltitudeEnergy& energy) {
+  double spent = 0.0;
+  for (size_t i = 0; i < size; i++) {
+    spent += energy.hold * profile[i];
+    if (i > 0) {
+      const int64_t rise = int64_t(profile[i]) - profile[i - 1];
+      spent += rise > 0 ? energy.climb * double(rise)
+                        : energy.descent * double(-rise);
+    }
+  }
+  return spent;
+}
+
+bool path_planning::MinimizeEnergy(const int* floor, size_t size,
+                                   int max_climb, int max_descent,
+                                   const AltitudeEnergy& energy,
+                                   int* output) {
+  if (energy.climb < 0.0 || energy.descent < 0.0 || energy.hold < 0.0) {
+    if (output != floor) {
+      std::copy(floor, floor + size, output);
+    }
+    return false;
+  }
+  if (!LimitSlopes(floor, size, max_climb, max_descent, output)) {
+    return false;
+  }
+  // The width of the narrowest gap not worth bridging. Without a cost to
+  // hold altitude every valley between two higher values is bridged.
+  const double ratio = (energy.climb + energy.descent) / energy.hold;
+  const size_t width =
+      energy.hold > 0.0 && ratio < double(size)
+          ? size_t(std::max(std::ceil(ratio), 1.0))
+          : size;
+  if (width <= 1 || size < 3) {
+    return true;
+  }
+  // Sliding maximum over the windows ending at each value, running past the
+  // end with the windows cut short so the last values close like the first.
+  // A window narrower than a gap fits inside it and keeps it open.
+  const size_t extended = size + width - 1;
+  std::vector<int> highest(extended);
+  std::vector<size_t> queue(extended);
+  size_t head = 0;
+  size_t tail = 0;
+  for (size_t i = 0; i < extended; i++) {
+    if (i < size) {
+      while (tail > head && output[queue[tail - 1]] <= output[i]) {
+        tail--;
+      }
+      queue[tail++] = i;
+    }
+    if (queue[head] + width <= i) {
+      head++;
+    }
+    highest[i] = output[queue[head]];
+  }
+  // Sliding minimum of those over the windows starting at each value
+  head = 0;
+  tail = 0;
+  for (size_t i = extended; i-- > 0;) {
+    while (tail > head && highest[queue[tail - 1]] >= highest[i]) {
+      tail--;
+    }
+    queue[tail++] = i;
+    if (queue[head] >= i + width) {
+      head++;
+    }
+    if (i < size) {
+      output[i] = highest[queue[head]];
+    }
+  }
+  return true;
+}
+
+void SlidingMedian::Filter(const int* input, size_t size, int filter_width,
+                           int* output) {
+  if (filter_width <= 0) {
+    std::copy(input, input + size, output);
+    return;
+  }
+  width_ = size_t(filter_width);
+  // Don't try to filter the first values
+  const size_t passthrough = std::min(width_, size);
+  std::copy(input, input + passthrough, output);
+  if (size <= width_) {
+    return;
+  }
+
+  values_.assign(input, input + width_);
+  Initialize();
+  output[width_] = Current();
+  for (size_t i = width_ + 1; i < size; i++) {
+    // The value at i - 1 enters the window and takes the ring slot of the
+    // value at i - 1 - width that leaves it
+    Replace((i - 1) % width_, input[i - 1]);
+    output[i] = Current();
+  }
+}
+
+void SlidingMedian::Start(int filter_width) {
+  width_ = size_t(std::max(filter_width, 0));
+  count_ = 0;
+  values_.resize(width_);
+}
+
+int SlidingMedian::Push(int value) {
+  const size_t i = count_++;
+  if (i < width_) {
+    // The first window passes through while it fills
+    values_[i] = value;
+    return value;
+  }
+  if (i == width_) {
+    Initialize();
+  } else {
+    Replace((i - 1) % width_, pending_);
+  }
+  pending_ = value;
+  return Current();
+}
+
+void SlidingMedian::Initialize() {
+  positions_.resize(width_);
+  in_low_.resize(width_);
+  order_.resize(width_);
+  std::iota(order_.begin(), order_.end(), size_t(0));
+  std::sort(order_.begin(), order_.end(), [this](size_t a, size_t b) {
+    return values_[a] < values_[b];
+  });
+
+  // The low heap holds everything up to and including the output element.
+  // For odd widths that is sorted index (w + 1) / 2, clamped for a width of
+  // one, and for even widths it is the lower of the two middle elements.
+  const size_t low_size = width_ % 2 == 0
+                              ? width_ / 2
+                              : std::min((width_ + 1) / 2, width_ - 1) + 1;
+  // A descending run is a valid max heap and an ascending run a min heap
+  low_.assign(order_.rbegin() + (width_ - low_size), order_.rend());
+  high_.assign(order_.begin() + low_size, order_.end());
+  for (size_t i = 0; i < low_.size(); i++) {
+    positions_[low_[i]] = i;
+    in_low_[low_[i]] = 1;
+  }
+  for (size_t i = 0; i < high_.size(); i++) {
+    positions_[high_[i]] = i;
+    in_low_[high_[i]] = 0;
+  }
+}
+
+void SlidingMedian::Replace(size_t slot, int value) {
+  const int old_value = values_[slot];
+  values_[slot] = value;
+  if (in_low_[slot]) {
+    if (value > old_value) {
+      SiftUpLow(positions_[slot]);
+    } else {
+      SiftDownLow(positions_[slot]);
+    }
+  } else {
+    if (value < old_value) {
+      SiftUpHigh(positions_[slot]);
+    } else {
+      SiftDownHigh(positions_[slot]);
+    }
+  }
+
+  // Only one value changed, so a single swap of the tops restores the
+  // ordering between the heaps
+  if (!high_.empty() && values_[low_[0]] > values_[high_[0]]) {
+    std::swap(low_[0], high_[0]);
+    positions_[low_[0]] = 0;
+    in_low_[low_[0]] = 1;
+    positions_[high_[0]] = 0;
+    in_low_[high_[0]] = 0;
+    SiftDownLow(0);
+    SiftDownHigh(0);
+  }
+}
+
+int SlidingMedian::Current() const {
+  if (width_ % 2 == 0) {
+    // Take the average if there's an even number
+    return int((int64_t(values_[low_[0]]) + values_[high_[0]]) / 2);
+  }
+  return values_[low_[0]];
+}
+
+void SlidingMedian::SiftUpLow(size_t index) {
+  const size_t slot = low_[index];
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (values_[low_[parent]] >= values_[slot]) {
+      break;
+    }
+    low_[index] = low_[parent];
+    positions_[low_[index]] = index;
+    index = parent;
+  }
+  low_[index] = slot;
+  positions_[slot] = index;
+}
+
+void SlidingMedian::SiftDownLow(size_t index) {
+  const size_t slot = low_[index];
+  const size_t size = low_.size();
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size && values_[low_[child + 1]] > values_[low_[child]]) {
+      child++;
+    }
+    if (values_[slot] >= values_[low_[child]]) {
+      break;
+    }
+    low_[index] = low_[child];
+    positions_[low_[index]] = index;
+    index = child;
+  }
+  low_[index] = slot;
+  positions_[slot] = index;
+}
+
+void SlidingMedian::SiftUpHigh(size_t index) {
+  const size_t slot = high_[index];
+  while (index > 0) {
+    const size_t parent = (index - 1) / 2;
+    if (values_[high_[parent]] <= values_[slot]) {
+      break;
+    }
+    high_[index] = high_[parent];
+    positions_[high_[index]] = index;
+    index = parent;
+  }
+  high_[index] = slot;
+  positions_[slot] = index;
+}
+
+void SlidingMedian::SiftDownHigh(size_t index) {
+  const size_t slot = high_[index];
+  const size_t size = high_.size();
+  while (true) {
+    size_t child = 2 * index + 1;
+    if (child >= size) {
+      break;
+    }
+    if (child + 1 < size &&
+        values_[high_[child + 1]] < values_[high_[child]]) {
+      child++;
+    }
+    if (values_[slot] <= values_[high_[child]]) {
+      break;
+    }
+    high_[index] = high_[child];
+    positions_[high_[index]] = index;
+    index = child;
+  }
+  high_[index] = slot;
+  positions_[slot] = index;
+}
+
+ProfilePipeline& ProfilePipeline::AddAgl(int agl) {
+  stages_.push_back(Stage{Stage::kAgl, agl, 0.0});
+  return *this;
+}
+
+ProfilePipeline& ProfilePipeline::Median(int filter_width) {
+  stages_.push_back(Stage{Stage::kMedian, filter_width, 0.0});
+  return *this;
+}
+
+ProfilePipeline& ProfilePipeline::Mean(int filter_width) {
+  stages_.push_back(Stage{Stage::kMean, filter_width, 0.0});
+  return *this;
+}
+
+ProfilePipeline& ProfilePipeline::Lowpass(double alpha) {
+  stages_.push_back(Stage{Stage::kLowpass, 0, alpha});
+  return *this;
+}
+
+ProfilePipeline& ProfilePipeline::Clip(int min_alt) {
+  stages_.push_back(Stage{Stage::kClip, min_alt, 0.0});
+  return *this;
+}
+
+bool ProfilePipeline::Run(const std::vector<int>& elevation_profile,
+                          std::vector<int>* output) {
+  // The pipeline's own `Stage` shadows the instrumentation stages
+  using Timed = path_planning::Stage;
+  const size_t size = elevation_profile.size();
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  const size_t capacity = output->capacity() + scratch_.capacity();
+#endif
+  output->assign(elevation_profile.begin(), elevation_profile.end());
+  bool valid = true;
+  for (const Stage& stage : stages_) {
+    switch (stage.type) {
+      case Stage::kAgl: {
+        PP_SCOPED_TIMER(Timed::kAglOffset);
+        AddOffset(output->data(), size, stage.value);
+        break;
+      }
+      case Stage::kMedian: {
+        PP_SCOPED_TIMER(Timed::kMedianFilter);
+        scratch_.resize(size);
+        median_.Filter(output->data(), size, stage.value, scratch_.data());
+        output->swap(scratch_);
+        break;
+      }
+      case Stage::kMean: {
+        PP_SCOPED_TIMER(Timed::kMeanFilter);
+        scratch_.resize(size);
+        MeanFilter(output->data(), size, stage.value, scratch_.data());
+        output->swap(scratch_);
+        break;
+      }
+      case Stage::kLowpass: {
+        PP_SCOPED_TIMER(Timed::kLowpassFilter);
+        valid = LowpassFilter(output->data(), size, stage.alpha,
+                              output->data()) && valid;
+        break;
+      }
+      case Stage::kClip: {
+        PP_SCOPED_TIMER(Timed::kCorrectPath);
+        ClipToClearance(elevation_profile.data(), size, stage.value,
+                        output->data());
+        break;
+      }
+    }
+  }
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  PP_COUNTER_ADD(Counter::kAllocations,
+                 output->capacity() + scratch_.capacity() != capacity);
+#endif
+  return valid;
+}
+
+void ProfilePipeline::ValueQueue::Reset(size_t capacity) {
+  values_.resize(std::max(capacity, size_t(1)));
+  head_ = 0;
+  size_ = 0;
+}
+
+void ProfilePipeline::ValueQueue::Push(int value) {
+  if (size_ == values_.size()) {
+    // Unroll the ring into a larger one
+    std::rotate(values_.begin(), values_.begin() + head_, values_.end());
+    values_.resize(values_.size() * 2);
+    head_ = 0;
+  }
+  values_[(head_ + size_) % values_.size()] = value;
+  size_++;
+}
+
+int ProfilePipeline::ValueQueue::Pop() {
+  const int value = values_[head_];
+  head_ = (head_ + 1) % values_.size();
+  size_--;
+  return value;
+}
+
+void ProfilePipeline::AppendKey(PathCacheKey* key) const {
+  key->Add(int64_t(stages_.size()));
+  for (const Stage& stage : stages_) {
+    key->Add(int64_t(stage.type));
+    key->Add(stage.value);
+    key->AddDouble(stage.alpha);
+  }
+}
+
+size_t ProfilePipeline::stream_delay() const {
+  size_t delay = 0;
+  for (const Stage& stage : stages_) {
+    if (stage.type == Stage::kMean) {
+      delay += size_t(std::max(stage.value, 0));
+    } else if (stage.type == Stage::kLowpass) {
+      delay += 1;
+    }
+  }
+  return delay;
+}
+
+void ProfilePipeline::Begin() {
+  stream_.resize(stages_.size());
+  stream_valid_ = true;
+  size_t delay = 0;
+  for (size_t s = 0; s < stages_.size(); s++) {
+    const Stage& stage = stages_[s];
+    StreamState& state = stream_[s];
+    state.count = 0;
+    state.sum = 0;
+    state.previous = 0;
+    switch (stage.type) {
+      case Stage::kMedian:
+        state.median.Start(stage.value);
+        break;
+      case Stage::kMean:
+        state.queue.Reset(size_t(std::max(stage.value, 0)));
+        delay += size_t(std::max(stage.value, 0));
+        break;
+      case Stage::kLowpass:
+        stream_valid_ = stream_valid_ && stage.alpha >= 0.0 &&
+                        stage.alpha <= 1.0;
+        delay += 1;
+        break;
+      case Stage::kClip:
+        // Holds the terrain from the stream input until the values delayed
+        // by the stages before this one catch up
+        state.queue.Reset(delay + 1);
+        break;
+      case Stage::kAgl:
+        break;
+    }
+  }
+}
+
+void ProfilePipeline::Push(const int* elevation, size_t size,
+                           std::vector<int>* output) {
+  for (size_t i = 0; i < size; i++) {
+    for (size_t s = 0; s < stages_.size(); s++) {
+      if (stages_[s].type == Stage::kClip) {
+        stream_[s].queue.Push(elevation[i]);
+      }
+    }
+    Feed(0, elevation[i], output);
+  }
+}
+
+bool ProfilePipeline::Finish(std::vector<int>* output) {
+  // Flush the stages in order, so each one sees the tail of the stage
+  // before it before it is flushed itself
+  for (size_t s = 0; s < stages_.size(); s++) {
+    const Stage& stage = stages_[s];
+    StreamState& state = stream_[s];
+    if (stage.type == Stage::kMean && state.queue.size() > 0) {
+      // The windows of the last values are cut short at the final value,
+      // which is its own mean
+      int64_t sum = state.sum - state.queue.back();
+      while (state.queue.size() > 1) {
+        const size_t count = state.queue.size() - 1;
+        Feed(s + 1, int(std::round(double(sum) / double(count))), output);
+        sum -= state.queue.Pop();
+      }
+      Feed(s + 1, state.queue.Pop(), output);
+    } else if (stage.type == Stage::kLowpass && state.count == 1 &&
+               stage.alpha >= 0.0 && stage.alpha <= 1.0) {
+      // A single value has nothing to smooth
+      Feed(s + 1, state.previous, output);
+    }
+  }
+  return stream_valid_;
+}
+
+void ProfilePipeline::Feed(size_t stage_index, int value,
+                           std::vector<int>* output) {
+  if (stage_index == stages_.size()) {
+    output->push_back(value);
+    return;
+  }
+  const Stage& stage = stages_[stage_index];
+  StreamState& state = stream_[stage_index];
+  const size_t i = state.count++;
+  switch (stage.type) {
+    case Stage::kAgl:
+      Feed(stage_index + 1, value + stage.value, output);
+      break;
+    case Stage::kMedian:
+      Feed(stage_index + 1,
+           stage.value <= 0 ? value : state.median.Push(value), output);
+      break;
+    case Stage::kMean:
+      if (stage.value <= 0) {
+        Feed(stage_index + 1, value, output);
+        break;
+      }
+      // A full window ahead of the oldest value, which can not contain the
+      // final value since this one comes after it
+      if (state.queue.size() == size_t(stage.value)) {
+        Feed(stage_index + 1,
+             int(std::round(double(state.sum) / double(stage.value))),
+             output);
+        state.sum -= state.queue.Pop();
+      }
+      state.queue.Push(value);
+      state.sum += value;
+      break;
+    case Stage::kLowpass: {
+      const double alpha = stage.alpha;
+      if (alpha < 0.0 || alpha > 1.0) {
+        Feed(stage_index + 1, value, output);
+        break;
+      }
+      if (i == 0) {
+        // Wait for the second value, which seeds the filter
+        state.previous = value;
+        break;
+      }
+      if (i == 1) {
+        state.previous = value;
+        Feed(stage_index + 1, value, output);
+      }
+      state.previous = int(alpha * value + (1.0 - alpha) * state.previous);
+      Feed(stage_index + 1, state.previous, output);
+      break;
+    }
+    case Stage::kClip:
+      Feed(stage_index + 1,
+           std::max(state.queue.Pop() + stage.value, value), output);
+      break;
+  }
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace path_planning {
+
+struct PathCacheKey;
+
+/// @brief Add a constant to every value, e.g. to apply the agl to an
+/// elevation profile. Vectorized with AVX2 or SSE2 when available.
+/// @param data - The values to offset in place
+/// @param size - The number of values
+/// @param offset - The amount to add to each value
+void AddOffset(int* data, size_t size, int offset);
+
+/// @brief Clip a filtered profile so it stays at least `min_alt` above the
+/// terrain: `data[i] = max(elevation[i] + min_alt, data[i])`. Vectorized with
+/// AVX2, SSE4.1 or SSE2 when available.
+/// @param elevation - The elevation profile of the terrain
+/// @param size - The number of values in `elevation` and `data`
+/// @param min_alt - The minimum distance to keep above the terrain
+/// @param data - The filtered profile to clip in place
+void ClipToClearance(const int* elevation, size_t size, int min_alt,
+                     int* data);
+
+/// @brief Mean filter with the semantics of `PathPlanner::MeanFilter`: value
+/// `i` is the rounded mean of [i, min(i + filter_width, size - 1)) and the
+/// last value is copied through. Uses a running sum, so it is O(n) in the
+/// profile length regardless of the width.
+/// @param input - The data to filter
+/// @param size - The number of values in `input` and `output`
+/// @param filter_width - The number of values to average
+/// @param output - The filtered data. Must not overlap `input`.
+void MeanFilter(const int* input, size_t size, int filter_width, int* output);
+
+/// @brief Lowpass filter with the semantics of `PathPlanner::LowpassFilter`:
+/// `output[0] = input[1]` and `output[i] = alpha * input[i] + (1 - alpha) *
+/// output[i - 1]`. May run in place with `input == output`.
+/// @param input - The data to filter
+/// @param size - The number of values in `input` and `output`
+/// @param alpha - The weight of the newest value, on [0, 1]
+/// @param output - The filtered data
+/// @return false, with `input` copied to `output`, if alpha is out of range
+bool LowpassFilter(const int* input, size_t size, double alpha, int* output);
+
+/// @brief Get the lowest altitude profile that stays on or above a floor,
+/// e.g. the terrain plus the minimum clearance, while climbing at most
+/// `max_climb` and descending at most `max_descent` from one value to the
+/// next. Each value is the highest of the floor's cones: the floor ahead
+/// less the climb needed to reach it, and the floor behind less the
+/// descent since. That is one forward and one backward pass, O(n) with no
+/// filter width or weight to tune. The profile is the lowest at every
+/// value of all the profiles within the limits, so it flies no higher and
+/// climbs no sooner than the terrain forces it to. May run in place with
+/// `floor == output`.
+/// @param floor - The lowest each value may be
+/// @param size - The number of values in `floor` and `output`
+/// @param max_climb - The most a value may rise over the one before it
+/// @param max_descent - The most a value may fall below the one before it
+/// @param output - The profile
+/// @return false, with `floor` copied to `output`, if a limit is negative
+bool LimitSlopes(const int* floor, size_t size, int max_climb,
+                 int max_descent, int* output);
+
+/// @struct The energy an altitude profile spends, in units of one unit of
+/// altitude held for one value. Climbing spends energy that flying level
+/// does not, so each valley is either flown down into and climbed back out
+/// of, or bridged at the altitude before it, whichever spends less.
+struct AltitudeEnergy {
+  /// Spent climbing one unit
+  double climb = 100.0;
+  /// Spent descending one unit
+  double descent = 0.0;
+  /// Spent holding one unit of altitude for one value, which keeps the
+  /// profile low where there is no climb to save
+  double hold = 1.0;
+};
+
+/// @brief Get the energy a profile spends: the climbs, the descents and the
+/// altitude held at each value
+/// @param profile - The altitude profile
+/// @param size - The number of values in `profile`
+/// @param energy - The costs of climbing, descending and holding altitude
+/// @return The energy spent flying the profile
+double ProfileEnergy(const int* profile, size_t size,
+                     const AltitudeEnergy& energy);
+
+/// @brief Get the altitude profile that spends the least energy while
+/// staying on or above a floor and within the climb and descent rates of
+/// `LimitSlopes`. Between two values that reach an altitude, dropping below
+/// it for `w` values and coming back saves `w * hold` for each unit of
+/// height and spends `climb + descent`, so every gap narrower than
+/// `(climb + descent) / hold` values is bridged, level by level. That is
+/// the closing of the lowest profile within the rates by a window that
+/// wide: a sliding maximum then a sliding minimum, O(n) in the profile
+/// length whatever the width. The first and last values keep the altitude
+/// of the lowest profile. May run in place with `floor == output`.
+/// @param floor - The lowest each value may be
+/// @param size - The number of values in `floor` and `output`
+/// @param max_climb - The most a value may rise over the one before it
+/// @param max_descent - The most a value may fall below the one before it
+/// @param energy - The costs of climbing, descending and holding altitude
+/// @param output - The profile
+/// @return false, with `floor` copied to `output`, if a limit or a cost is
+/// negative
+bool MinimizeEnergy(const int* floor, size_t size, int max_climb,
+                    int max_descent, const AltitudeEnergy& energy,
+                    int* output);
+
+/// @class Sliding window median filter that runs in O(n log w).
+///
+/// The window is kept in a ring buffer split across two indexed heaps: a max
+/// heap of the smallest values and a min heap of the rest. Every step
+/// overwrites the ring slot of the value leaving the window with the value
+/// entering it, re-sifts that one heap entry and swaps the heap tops if they
+/// crossed. The buffers are kept between calls so filtering many profiles
+/// does not allocate.
+class SlidingMedian {
+ public:
+  /// @brief Constructor
+  SlidingMedian() : width_(0), count_(0), pending_(0) {}
+  /// @brief Median filter a profile, with the same output as
+  /// `PathPlanner::MedianFilter`: the first `filter_width` values are copied
+  /// through, and every later value `i` is the median of the `filter_width`
+  /// values before it, [i - filter_width, i). For odd widths the median is
+  /// the element at sorted index `(filter_width + 1) / 2`, and for even
+  /// widths it is the truncated mean of the two middle elements.
+  /// @param input - The data to filter
+  /// @param size - The number of values in `input` and `output`
+  /// @param filter_width - The number of values in the window
+  /// @param output - The filtered data. Must not overlap `input`.
+  void Filter(const int* input, size_t size, int filter_width, int* output);
+  /// @brief Start filtering a profile that arrives one value at a time
+  /// through `Push`. The outputs are the same as `Filter`'s.
+  /// @param filter_width - The number of values in the window
+  void Start(int filter_width);
+  /// @brief Filter the next value of a profile started with `Start`. Each
+  /// output only depends on earlier values, so it is available right away.
+  /// @param value - The next input value
+  /// @return The output for the value
+  int Push(int value);
+
+ private:
+  /// @brief Fill the heaps with the first window of values, which are
+  /// already in `values_`
+  void Initialize();
+  /// @brief Overwrite the value in a ring slot and restore the heaps
+  void Replace(size_t slot, int value);
+  /// @brief Get the filter output for the current window
+  int Current() const;
+  /// @brief Move a low heap entry towards the root
+  void SiftUpLow(size_t index);
+  /// @brief Move a low heap entry towards the leaves
+  void SiftDownLow(size_t index);
+  /// @brief Move a high heap entry towards the root
+  void SiftUpHigh(size_t index);
+  /// @brief Move a high heap entry towards the leaves
+  void SiftDownHigh(size_t index);
+
+  /// The number of values in the window
+  size_t width_;
+  /// The values in the window, indexed by ring slot
+  std::vector<int> values_;
+  /// The position of each ring slot in `low_` or `high_`
+  std::vector<size_t> positions_;
+  /// Whether each ring slot is in `low_`
+  std::vector<char> in_low_;
+  /// Max heap of the ring slots holding the smallest values
+  std::vector<size_t> low_;
+  /// Min heap of the ring slots holding the largest values
+  std::vector<size_t> high_;
+  /// Scratch for sorting the first window
+  std::vector<size_t> order_;
+  /// The number of values pushed since `Start`
+  size_t count_;
+  /// The last pushed value, which enters the window on the next push
+  int pending_;
+};
+
+/// @class A chain of profile filters that runs over caller provided buffers.
+///
+/// Stages are added in the order they run, for example
+///
+///     pipeline.AddAgl(20).Median(9).Clip(5);
+///
+/// `Run` ping-pongs between the output buffer and one internal scratch
+/// buffer, so once both have grown to the profile length a run does not
+/// allocate.
+///
+/// A profile can also be streamed through the pipeline in pieces with
+/// `Begin`, `Push` and `Finish`, giving the same values as `Run`. Each stage
+/// keeps only the look-back it needs: the median stages their window, the
+/// mean stages the `filter_width` values they look ahead, and the lowpass
+/// stages the one value they are seeded with. The outputs trail the inputs by
+/// the sum of those look-aheads.
+class ProfilePipeline {
+ public:
+  /// @brief Add the agl to every value
+  ProfilePipeline& AddAgl(int agl);
+  /// @brief Median filter, see `SlidingMedian::Filter`
+  ProfilePipeline& Median(int filter_width);
+  /// @brief Mean filter, see `MeanFilter`
+  ProfilePipeline& Mean(int filter_width);
+  /// @brief Lowpass filter, see `LowpassFilter`
+  ProfilePipeline& Lowpass(double alpha);
+  /// @brief Clip the values to stay `min_alt` above the elevation profile
+  /// that was passed to `Run`, see `ClipToClearance`
+  ProfilePipeline& Clip(int min_alt);
+  /// @brief Remove all the stages
+  void Clear() { stages_.clear(); }
+  /// @brief Get the number of stages
+  size_t num_stages() const { return stages_.size(); }
+  /// @brief Run every stage in order
+  /// @param elevation_profile - The terrain elevation profile to filter
+  /// @param output - The filtered profile. Its previous contents are
+  /// discarded but its capacity is reused.
+  /// @return false if a stage had invalid parameters
+  bool Run(const std::vector<int>& elevation_profile,
+           std::vector<int>* output);
+  /// @brief Start streaming a profile through the stages
+  void Begin();
+  /// @brief Filter the next values of the profile started with `Begin`
+  /// @param elevation - The next values of the terrain elevation profile
+  /// @param size - The number of values
+  /// @param output - The outputs that are final so far are appended
+  void Push(const int* elevation, size_t size, std::vector<int>* output);
+  /// @brief Finish the streamed profile
+  /// @param output - The remaining outputs are appended
+  /// @return false if a stage had invalid parameters
+  bool Finish(std::vector<int>* output);
+  /// @brief Get how many values the outputs of a stream trail its inputs
+  size_t stream_delay() const;
+  /// @brief Append the type and parameters of every stage to a key, so
+  /// pipelines that filter differently never share a `PathCache` entry
+  void AppendKey(PathCacheKey* key) const;
+
+ private:
+  /// @struct A single filter stage
+  struct Stage {
+    /// The kind of filter
+    enum Type { kAgl, kMedian, kMean, kLowpass, kClip } type;
+    /// The agl, width or minimum altitude of the stage
+    int value;
+    /// The alpha of a lowpass stage
+    double alpha;
+  };
+
+  /// @class First in first out queue of values in a ring buffer, which only
+  /// allocates when it has to grow
+  class ValueQueue {
+   public:
+    /// @brief Empty the queue and make room for `capacity` values
+    void Reset(size_t capacity);
+    /// @brief Add a value at the back
+    void Push(int value);
+    /// @brief Remove the value at the front
+    int Pop();
+    /// @brief Get the value at the back
+    int back() const {
+      return values_[(head_ + size_ - 1) % values_.size()];
+    }
+    /// @brief Get the number of queued values
+    size_t size() const { return size_; }
+
+   private:
+    /// The ring buffer
+    std::vector<int> values_;
+    /// The ring slot of the front value
+    size_t head_ = 0;
+    /// The number of queued values
+    size_t size_ = 0;
+  };
+  /// @struct The streaming state of a single stage
+  struct StreamState {
+    /// The number of values that entered the stage
+    size_t count = 0;
+    /// The sum of `queue` in a mean stage
+    int64_t sum = 0;
+    /// The last output of a lowpass stage, or its first input until it has
+    /// a second
+    int previous = 0;
+    /// The window of a median stage
+    SlidingMedian median;
+    /// The values a mean stage looks ahead over, or the terrain elevations
+    /// a clip stage has not reached yet
+    ValueQueue queue;
+  };
+
+  /// @brief Run a value through a stage and the stages after it
+  void Feed(size_t stage, int value, std::vector<int>* output);
+
+  /// The stages in the order they run
+  std::vector<Stage> stages_;
+  /// The streaming state of each stage
+  std::vector<StreamState> stream_;
+  /// Cleared if a stage of the stream had invalid parameters
+  bool stream_valid_ = true;
+  /// Output of the windowed stages, swapped with the output buffer
+  std::vector<int> scratch_;
+  /// State of the median stages
+  SlidingMedian median_;
+};
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <type_traits>
+
+#include "elevation_map.h"
+#include "grid_search.h"
+
+namespace path_planning {
+
+/// The length of a diagonal step
+constexpr double kSqrt2 = 1.41421356237309504880;
+/// The length of a knight's step, one row and two columns or the reverse
+constexpr double kSqrt5 = 2.23606797749978969641;
+
+/// Row offsets of the neighbors. The first four are the 4-connected ones,
+/// the first eight the 8-connected ones, and all sixteen add the knight's
+/// moves. Every neighborhood holds the reverse of each of its steps.
+constexpr int kNeighborRows[16] = {1, -1, 0, 0, 1, 1, -1, -1,
+                                   1, 1, -1, -1, 2, 2, -2, -2};
+/// Column offsets of the neighbors, in the order of `kNeighborRows`
+constexpr int kNeighborCols[16] = {0, 0, 1, -1, 1, -1, 1, -1,
+                                   2, -2, 2, -2, 1, -1, 1, -1};
+/// The horizontal distance to each neighbor, the same in both directions
+constexpr double kNeighborDistances[16] = {
+    1.0,    1.0,    1.0,    1.0,    kSqrt2, kSqrt2, kSqrt2, kSqrt2,
+    kSqrt5, kSqrt5, kSqrt5, kSqrt5, kSqrt5, kSqrt5, kSqrt5, kSqrt5};
+
+/// @struct The cells a search may step to from a cell, and the shortest
+/// distance between two cells using only those steps. The number of
+/// neighbors is a constant, so loops over them are unrolled.
+template <Connectivity kConnectivity>
+struct Neighborhood;
+
+template <>
+struct Neighborhood<Connectivity::kFour> {
+  static constexpr int kCount = 4;
+  /// @brief Manhattan distance
+  static double Distance(int row_diff, int col_diff) {
+    return double(row_diff + col_diff);
+  }
+};
+
+template <>
+struct Neighborhood<Connectivity::kEight> {
+  static constexpr int kCount = 8;
+  /// @brief Octile distance, diagonal steps first then straight ones
+  static double Distance(int row_diff, int col_diff) {
+    const int diagonal = std::min(row_diff, col_diff);
+    const int straight = std::max(row_diff, col_diff) - diagonal;
+    return diagonal * kSqrt2 + straight;
+  }
+};
+
+template <>
+struct Neighborhood<Connectivity::kSixteen> {
+  static constexpr int kCount = 16;
+  /// @brief Straight line distance. Knight's steps make the octile distance
+  /// an overestimate, but no step is shorter than the line it covers.
+  static double Distance(int row_diff, int col_diff) {
+    return std::sqrt(double(row_diff) * row_diff +
+                     double(col_diff) * col_diff);
+  }
+};
+
+/// @brief Get the shortest distance between two cells of a neighborhood
+/// chosen at run time
+/// @param connectivity - The neighborhood
+/// @param row_diff - The absolute row difference
+/// @param col_diff - The absolute column difference
+inline double NeighborhoodDistance(Connectivity connectivity, int row_diff,
+                                   int col_diff) {
+  switch (connectivity) {
+    case Connectivity::kFour:
+      return Neighborhood<Connectivity::kFour>::Distance(row_diff, col_diff);
+    case Connectivity::kEight:
+      return Neighborhood<Connectivity::kEight>::Distance(row_diff, col_diff);
+    case Connectivity::kSixteen:
+      return Neighborhood<Connectivity::kSixteen>::Distance(row_diff,
+                                                            col_diff);
+  }
+  return 0.0;
+}
+
+/// @struct `CostPolicy::kTerrain`, the full `CostModel`
+struct TerrainCost {
+  /// Whether the step cost depends on the climb
+  static constexpr bool kUsesClimb = true;
+  /// @brief Get the cost of a step
+  /// @param cost - The weights
+  /// @param distance - The weighted horizontal distance of the step
+  /// @param climb - The elevation gained, negative if lost
+  template <typename Value>
+  static double Step(const CostModel& cost, double distance, Value climb) {
+    return distance + (climb > 0 ? cost.climb_weight * double(climb)
+                                 : cost.descent_weight * double(-climb));
+  }
+};
+
+/// @struct `CostPolicy::kDistance`, the horizontal distance alone
+struct DistanceCost {
+  static constexpr bool kUsesClimb = false;
+  template <typename Value>
+  static double Step(const CostModel&, double distance, Value) {
+    return distance;
+  }
+};
+
+/// @brief Get the cost of a step under a policy chosen at run time
+inline double CostOfStep(CostPolicy policy, const CostModel& cost,
+                         double distance, int64_t climb) {
+  return policy == CostPolicy::kDistance
+             ? DistanceCost::Step(cost, distance, climb)
+             : TerrainCost::Step(cost, distance, climb);
+}
+
+/// @brief Check if a step slips between terrain above the ceiling. A
+/// diagonal step is blocked when both cells beside it are too high, so a
+/// path never passes through the corner where two walls touch. A knight's
+/// step crosses the two cells beside the middle of its line, and is blocked
+/// when either of them is too high.
+/// @param row - The row the step leaves from
+/// @param col - The column the step leaves from
+/// @param row_step - The rows the step moves
+/// @param col_step - The columns the step moves
+/// @param too_high - Tells if the cell at a row and column is above the
+/// ceiling
+template <typename TooHigh>
+bool StepSlipsThrough(int row, int col, int row_step, int col_step,
+                      const TooHigh& too_high) {
+  const int row_distance = std::abs(row_step);
+  const int col_distance = std::abs(col_step);
+  if (row_distance == 1 && col_distance == 1) {
+    return too_high(row + row_step, col) && too_high(row, col + col_step);
+  }
+  if (row_distance == 1 && col_distance == 2) {
+    return too_high(row, col + col_step / 2) ||
+           too_high(row + row_step, col + col_step / 2);
+  }
+  if (row_distance == 2 && col_distance == 1) {
+    return too_high(row + row_step / 2, col) ||
+           too_high(row + row_step / 2, col + col_step);
+  }
+  return false;
+}
+
+/// @struct Reads the elevations of row-major cells of type `T` through a
+/// pointer. Integer cells are widened to `int64_t` and floating point ones
+/// to `double`, so climbs never overflow.
+template <typename T>
+struct RowMajorTerrain {
+  using Value = typename std::conditional<std::is_floating_point<T>::value,
+                                          double, int64_t>::type;
+  /// The cell at row 0 and column 0 of the search
+  const T* cells;
+  /// The number of cells between the starts of two rows
+  size_t stride;
+  /// @brief Get the elevation of a cell
+  Value operator()(int row, int col) const {
+    return Value(cells[size_t(row) * stride + size_t(col)]);
+  }
+};
+
+/// @struct Reads the elevations of a tiled map through its tile cache
+struct TiledTerrain {
+  using Value = int64_t;
+  /// The map to read
+  const ElevationMap* emap;
+  /// The map row of row 0 of the search
+  int row_begin;
+  /// @brief Get the elevation of a cell
+  Value operator()(int row, int col) const {
+    return Value(emap->At(row + row_begin, col));
+  }
+};
+}
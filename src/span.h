@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+
+namespace path_planning {
+
+/// @class Non-owning view over a contiguous run of elements. A minimal stand in
+/// for C++20's `std::span` so the library can stay on C++14.
+template <typename T>
+class Span {
+ public:
+  /// @brief Constructor for an empty span
+  Span() : data_(nullptr), size_(0) {}
+  /// @brief Constructor
+  /// @param data - Pointer to the first element of the run
+  /// @param size - The number of elements in the run
+  Span(T* data, size_t size) : data_(data), size_(size) {}
+  /// @brief Get the first element of the span
+  T* begin() const { return data_; }
+  /// @brief Get one past the last element of the span
+  T* end() const { return data_ + size_; }
+  /// @brief Get the underlying pointer
+  T* data() const { return data_; }
+  /// @brief Get the number of elements in the span
+  size_t size() const { return size_; }
+  /// @brief Check if the span has no elements
+  bool empty() const { return size_ == 0; }
+  /// @brief Unchecked element access
+  T& operator[](size_t i) const { return data_[i]; }
+
+ private:
+  /// The first element in the span
+  T* data_;
+  /// The number of elements in the span
+  size_t size_;
+};
+}
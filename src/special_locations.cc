@@ -0,0 +1,34 @@
+#include "special_locations.h"
+
+#include <algorithm>
+
+using namespace path_planning;
+
+LocationIndex::LocationIndex() {
+  std::fill(offsets_, offsets_ + 257, 0u);
+}
+
+LocationIndex::LocationIndex(const std::vector<MarkedLocation>& locations) {
+  // Counting sort by marker, which keeps each marker's locations in order
+  std::fill(offsets_, offsets_ + 257, 0u);
+  for (const MarkedLocation& loc : locations) {
+    offsets_[size_t(static_cast<unsigned char>(loc.marker)) + 1]++;
+  }
+  for (size_t m = 0; m < 256; m++) {
+    offsets_[m + 1] += offsets_[m];
+  }
+  uint32_t next[256];
+  std::copy(offsets_, offsets_ + 256, next);
+  locations_.resize(locations.size());
+  for (const MarkedLocation& loc : locations) {
+    locations_[next[static_cast<unsigned char>(loc.marker)]++] =
+        std::make_pair(loc.row, loc.col);
+  }
+  sorted_ = locations_;
+  std::sort(sorted_.begin(), sorted_.end());
+}
+
+bool LocationIndex::Contains(int row, int col) const {
+  return std::binary_search(sorted_.begin(), sorted_.end(),
+                            std::make_pair(row, col));
+}
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "span.h"
+
+namespace path_planning {
+
+/// The default starting position for a map
+static const char kStartPos = 'A';
+/// The default end position for a map. A map may mark several, and plans
+/// go to the one cheapest to reach.
+static const char kEndPos = 'B';
+/// A waypoint, see `PlanQuery::waypoints`
+static const char kWaypoint = 'W';
+
+/// @struct A special character in the map, e.g. `(A)`, and the integer value
+/// its cell holds in place of an elevation
+struct Marker {
+  /// The character between the parentheses
+  char symbol;
+  /// The value stored in the marked cell
+  int value;
+};
+
+/// Every marker the map formats know. The values count down from -1 so a
+/// cell value is checked with a single range test. A marked cell holds its
+/// marker's value, but only the map's locations make a cell a marker, so a
+/// real elevation of -1 to -3 stays terrain, see `ElevationMap::IsMarked`.
+constexpr Marker kMarkers[] = {
+    {kStartPos, -1},  // Start location
+    {kEndPos, -2},    // End location
+    {kWaypoint, -3},  // Waypoint
+};
+
+/// The number of entries in `kMarkers`
+constexpr int kNumMarkers = int(sizeof(kMarkers) / sizeof(kMarkers[0]));
+
+/// @struct The value of every character as a marker, 0 for characters that
+/// are not one. Indexed directly by the character, so the parsers look a
+/// marker up without a search.
+struct MarkerTable {
+  /// The value of each character
+  int values[256];
+  /// @brief Get the value of a character, 0 if it is not a marker
+  constexpr int operator[](char c) const {
+    return values[static_cast<unsigned char>(c)];
+  }
+};
+
+/// @brief Build the `MarkerTable` of `kMarkers`
+constexpr MarkerTable MakeMarkerTable() {
+  MarkerTable table{};
+  for (const Marker& marker : kMarkers) {
+    table.values[static_cast<unsigned char>(marker.symbol)] = marker.value;
+  }
+  return table;
+}
+
+/// @brief Check the marker values are -1, -2, ... in order
+constexpr bool MarkerValuesAreDense() {
+  for (int i = 0; i < kNumMarkers; i++) {
+    if (kMarkers[i].value != -1 - i) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(MarkerValuesAreDense(),
+              "Marker values must count down from -1");
+
+/// The value of every character as a marker
+constexpr MarkerTable kMarkerTable = MakeMarkerTable();
+
+/// @brief Get the cell value of a marker character
+/// @return The value, or 0 if `c` is not a marker
+constexpr int MarkerValue(char c) { return kMarkerTable[c]; }
+
+/// @brief Check if a cell value is the value of one of the markers from
+/// `kMarkers`. Real elevations can hold the same values, so this only
+/// rules cells out before a lookup by position.
+constexpr bool IsSpecialLocationValue(int value) {
+  return value < 0 && value >= -kNumMarkers;
+}
+
+/// @struct A special location and the marker it was placed with
+struct MarkedLocation {
+  /// The marker character
+  char marker;
+  /// The row of the location
+  int row;
+  /// The column of the location
+  int col;
+};
+
+/// @class The special locations of a map, grouped by marker in one
+/// contiguous array with the offset of each marker's run in a 256-entry
+/// table. Looking a marker up is two loads, and its locations are handed
+/// out as a view, so thousands of waypoints are never copied.
+class LocationIndex {
+ public:
+  /// @brief Constructor for an index without locations
+  LocationIndex();
+  /// @brief Constructor
+  /// @param locations - The locations to index, in any order. The
+  /// locations of each marker keep their order, e.g. row-major as parsed.
+  explicit LocationIndex(const std::vector<MarkedLocation>& locations);
+  /// @brief Get the locations of a marker
+  /// @param marker - The marker character
+  /// @return The row and column of each location, valid as long as the index
+  Span<const std::pair<int, int>> Get(char marker) const {
+    const size_t m = static_cast<unsigned char>(marker);
+    return Span<const std::pair<int, int>>(locations_.data() + offsets_[m],
+                                           offsets_[m + 1] - offsets_[m]);
+  }
+  /// @brief Get the total number of locations of all markers
+  size_t size() const { return locations_.size(); }
+  /// @brief Check if any marker was placed at a cell. Takes logarithmic
+  /// time in the number of locations.
+  /// @param row - The row of the cell
+  /// @param col - The column of the cell
+  bool Contains(int row, int col) const;
+
+ private:
+  /// The locations of every marker, grouped by marker
+  std::vector<std::pair<int, int>> locations_;
+  /// The locations of every marker, sorted row-major for `Contains`
+  std::vector<std::pair<int, int>> sorted_;
+  /// The first location of each marker in `locations_`, and the end
+  uint32_t offsets_[257];
+};
+}
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "binary_map_format.h"
+#include "terrain_generator.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// @brief Hash a lattice point of an octave's noise
+uint32_t HashLattice(uint32_t seed, int64_t x, int64_t y) {
+  uint32_t h =
+      seed ^ (uint32_t(x) * 0x9E3779B1u) ^ (uint32_t(y) * 0x85EBCA77u);
+  h ^= h >> 16;
+  h *= 0x7FEB352Du;
+  h ^= h >> 15;
+  h *= 0x846CA68Bu;
+  h ^= h >> 16;
+  return h;
+}
+
+/// @brief Round down to an integer, without the library call `std::floor`
+/// makes on targets without a rounding instruction
+int64_t FloorToInt(double value) {
+  const int64_t truncated = int64_t(value);
+  return truncated - int64_t(value < double(truncated));
+}
+
+/// @brief Perlin's quintic fade, 0 at 0 and 1 at 1 with flat ends
+double Fade(double t) {
+  return t * t * t * (t * (t * 6.0 - 15.0) + 10.0);
+}
+
+/// The eight gradients of the lattice points, picked by their hash
+const double kGradients[8][2] = {{1, 1},  {-1, 1}, {1, -1}, {-1, -1},
+                                 {1, 0},  {-1, 0}, {0, 1},  {0, -1}};
+
+/// @brief Dot the offset from a lattice point with the point's gradient
+double Gradient(uint32_t hash, double dx, double dy) {
+  const double* gradient = kGradients[hash & 7u];
+  return gradient[0] * dx + gradient[1] * dy;
+}
+
+/// @brief Blend the gradients of the four lattice points around a point
+/// @param h00 - The hash of the lattice point above and to the left
+/// @param h10 - The hash of the one to the right of it
+/// @param h01 - The hash of the one below it
+/// @param h11 - The hash of the one below and to the right
+/// @param dx - The offset of the point from the top left point, on [0, 1)
+/// @param dy - The offset of the point from the top left point, on [0, 1)
+double BlendLattice(uint32_t h00, uint32_t h10, uint32_t h01, uint32_t h11,
+                    double dx, double dy) {
+  const double u = Fade(dx);
+  const double v = Fade(dy);
+  const double top =
+      Gradient(h00, dx, dy) + u * (Gradient(h10, dx - 1.0, dy) -
+                                   Gradient(h00, dx, dy));
+  const double bottom =
+      Gradient(h01, dx, dy - 1.0) +
+      u * (Gradient(h11, dx - 1.0, dy - 1.0) - Gradient(h01, dx, dy - 1.0));
+  return top + v * (bottom - top);
+}
+
+/// @brief Scale noise on [-1, 1] into the elevation range of the options
+Elevation ScaleNoise(const TerrainOptions& options, double noise) {
+  const double range =
+      double(options.max_elevation) - double(options.min_elevation);
+  const double value = options.min_elevation + (noise + 1.0) * 0.5 * range;
+  const int64_t rounded = FloorToInt(value + 0.5);
+  return Elevation(
+      std::min<int64_t>(options.max_elevation,
+                        std::max<int64_t>(options.min_elevation, rounded)));
+}
+
+/// @brief Order locations by row, then column
+bool RowMajorLess(const MarkedLocation& a, const MarkedLocation& b) {
+  return a.row != b.row ? a.row < b.row : a.col < b.col;
+}
+
+/// @brief Append the decimal digits of a non-negative value to a buffer
+void AppendNumber(int value, std::string* out) {
+  char digits[12];
+  int n = 0;
+  do {
+    digits[n++] = char('0' + value % 10);
+    value /= 10;
+  } while (value > 0);
+  while (n > 0) {
+    out->push_back(digits[--n]);
+  }
+}
+
+}  // namespace
+
+std::vector<MarkedLocation> path_planning::DefaultTerrainLocations(int rows,
+                                                                   int cols) {
+  return {{kStartPos, rows / 8, cols / 8},
+          {kEndPos, rows - 1 - rows / 8, cols - 1 - cols / 8}};
+}
+
+TerrainGenerator::TerrainGenerator(const TerrainOptions& options)
+    : options_(options), sorted_locations_(options.locations) {
+  std::sort(sorted_locations_.begin(), sorted_locations_.end(),
+            RowMajorLess);
+  // Normalize the amplitudes to sum to 1, so the noise stays on [-1, 1]
+  double frequency = 1.0 / std::max(options_.feature_size, 1.0);
+  double amplitude = 1.0;
+  double total = 0.0;
+  for (int octave = 0; octave < std::max(options_.octaves, 1); octave++) {
+    frequencies_.push_back(frequency);
+    amplitudes_.push_back(amplitude);
+    octave_seeds_.push_back(options_.seed + uint32_t(octave) * 0x632BE5ABu);
+    total += amplitude;
+    frequency *= 2.0;
+    amplitude *= options_.persistence;
+  }
+  for (double& a : amplitudes_) {
+    a /= total;
+  }
+}
+
+Elevation TerrainGenerator::At(int row, int col) const {
+  double noise = 0.0;
+  for (size_t o = 0; o < frequencies_.size(); o++) {
+    const double x = col * frequencies_[o];
+    const double y = row * frequencies_[o];
+    const int64_t ix = FloorToInt(x);
+    const int64_t iy = FloorToInt(y);
+    const uint32_t seed = octave_seeds_[o];
+    noise += amplitudes_[o] *
+             BlendLattice(HashLattice(seed, ix, iy),
+                          HashLattice(seed, ix + 1, iy),
+                          HashLattice(seed, ix, iy + 1),
+                          HashLattice(seed, ix + 1, iy + 1), x - double(ix),
+                          y - double(iy));
+  }
+  return ScaleNoise(options_, noise);
+}
+
+void TerrainGenerator::FillRow(int row, int cols, Elevation* cells) const {
+  std::vector<double> noise(size_t(cols), 0.0);
+  for (size_t o = 0; o < frequencies_.size(); o++) {
+    const double y = row * frequencies_[o];
+    const int64_t iy = FloorToInt(y);
+    const double dy = y - double(iy);
+    const uint32_t seed = octave_seeds_[o];
+    const double amplitude = amplitudes_[o];
+    // Neighboring cells share their lattice points, so the hashes are only
+    // taken when the row crosses into the next lattice square
+    int64_t ix = std::numeric_limits<int64_t>::min();
+    uint32_t h00 = 0, h10 = 0, h01 = 0, h11 = 0;
+    for (int col = 0; col < cols; col++) {
+      const double x = col * frequencies_[o];
+      const int64_t lattice_x = FloorToInt(x);
+      if (lattice_x != ix) {
+        ix = lattice_x;
+        h00 = HashLattice(seed, ix, iy);
+        h10 = HashLattice(seed, ix + 1, iy);
+        h01 = HashLattice(seed, ix, iy + 1);
+        h11 = HashLattice(seed, ix + 1, iy + 1);
+      }
+      noise[size_t(col)] +=
+          amplitude * BlendLattice(h00, h10, h01, h11, x - double(ix), dy);
+    }
+  }
+  for (int col = 0; col < cols; col++) {
+    cells[col] = ScaleNoise(options_, noise[size_t(col)]);
+  }
+  auto location = std::lower_bound(sorted_locations_.begin(),
+                                   sorted_locations_.end(),
+                                   MarkedLocation{0, row, 0}, RowMajorLess);
+  for (; location != sorted_locations_.end() && location->row == row;
+       ++location) {
+    cells[location->col] = Elevation(MarkerValue(location->marker));
+  }
+}
+
+bool TerrainGenerator::CheckSize(const char* method, int rows,
+                                 int cols) const {
+  auto fail = [method](const char* reason) {
+    std::cerr << "TerrainGenerator::" << method << ": ERROR! " << reason
+              << std::endl;
+    return false;
+  };
+  if (rows <= 0 || cols <= 0) {
+    return fail("The map must have at least one row and column");
+  }
+  if (options_.min_elevation < 0 ||
+      options_.max_elevation < options_.min_elevation ||
+      options_.max_elevation > std::numeric_limits<Elevation>::max()) {
+    return fail("The elevation range is invalid");
+  }
+  for (size_t i = 0; i < sorted_locations_.size(); i++) {
+    const MarkedLocation& location = sorted_locations_[i];
+    if (MarkerValue(location.marker) == 0) {
+      return fail("A special location is not a known marker");
+    }
+    if (location.row < 0 || location.row >= rows || location.col < 0 ||
+        location.col >= cols) {
+      return fail("A special location is outside the map");
+    }
+    if (i > 0 && location.row == sorted_locations_[i - 1].row &&
+        location.col == sorted_locations_[i - 1].col) {
+      return fail("Two special locations share a cell");
+    }
+  }
+  return true;
+}
+
+bool TerrainGenerator::Generate(int rows, int cols,
+                                ElevationMap* emap) const {
+  if (!CheckSize("Generate", rows, cols)) {
+    return false;
+  }
+  std::vector<Elevation> cells(size_t(rows) * size_t(cols));
+  for (int row = 0; row < rows; row++) {
+    FillRow(row, cols, cells.data() + size_t(row) * size_t(cols));
+  }
+  return emap->Assign(rows, cols, std::move(cells), sorted_locations_);
+}
+
+bool TerrainGenerator::WriteTextMap(const std::string& map_filename,
+                                    int rows, int cols) const {
+  if (!CheckSize("WriteTextMap", rows, cols)) {
+    return false;
+  }
+  std::ofstream out_file(map_filename, std::ios::binary | std::ios::trunc);
+  if (!out_file.is_open()) {
+    std::cerr << "TerrainGenerator::WriteTextMap: ERROR! Unable to open map "
+              << "file for writing: " << map_filename << std::endl;
+    return false;
+  }
+  std::vector<Elevation> cells(static_cast<size_t>(cols));
+  std::string line;
+  line.reserve(size_t(cols) * 5 + 8);
+  out_file.put('[');
+  for (int row = 0; row < rows && out_file; row++) {
+    FillRow(row, cols, cells.data());
+    line.clear();
+    line.push_back('[');
+    for (int col = 0; col < cols; col++) {
+      const int value = cells[size_t(col)];
+      if (IsSpecialLocationValue(value)) {
+        line.push_back('(');
+        line.push_back(kMarkers[-1 - value].symbol);
+        line.push_back(')');
+      } else {
+        AppendNumber(value, &line);
+      }
+      if (col + 1 < cols) {
+        line.push_back(',');
+      }
+    }
+    line += row + 1 < rows ? "],\n" : "]]\n";
+    out_file.write(line.data(), std::streamsize(line.size()));
+  }
+  if (!out_file) {
+    std::cerr << "TerrainGenerator::WriteTextMap: ERROR! Unable to write map "
+              << "file: " << map_filename << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool TerrainGenerator::WriteBinaryMap(const std::string& map_filename,
+                                      int rows, int cols,
+                                      int tile_size) const {
+  namespace bmf = binary_map;
+  if (!CheckSize("WriteBinaryMap", rows, cols)) {
+    return false;
+  }
+  if (tile_size < 0) {
+    std::cerr << "TerrainGenerator::WriteBinaryMap: ERROR! The tile size "
+              << "must not be negative" << std::endl;
+    return false;
+  }
+  // The table lists the locations by marker, like `ElevationMap` writes it
+  std::vector<MarkedLocation> by_marker = sorted_locations_;
+  std::stable_sort(by_marker.begin(), by_marker.end(),
+                   [](const MarkedLocation& a, const MarkedLocation& b) {
+                     return static_cast<unsigned char>(a.marker) <
+                            static_cast<unsigned char>(b.marker);
+                   });
+  std::vector<bmf::BinaryMapLocation> locations;
+  for (const MarkedLocation& location : by_marker) {
+    locations.push_back(bmf::BinaryMapLocation{location.marker, location.row,
+                                               location.col, 0});
+  }
+  const bmf::BinaryMapHeader header = bmf::MakeHeader(
+      rows, cols, uint32_t(tile_size), uint32_t(locations.size()));
+  const uint64_t locations_end =
+      header.locations_offset +
+      locations.size() * sizeof(bmf::BinaryMapLocation);
+
+  std::ofstream out_file(map_filename, std::ios::binary | std::ios::trunc);
+  if (!out_file.is_open()) {
+    std::cerr << "TerrainGenerator::WriteBinaryMap: ERROR! Unable to open "
+              << "map file for writing: " << map_filename << std::endl;
+    return false;
+  }
+  out_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  if (!locations.empty()) {
+    out_file.write(reinterpret_cast<const char*>(locations.data()),
+                   locations.size() * sizeof(bmf::BinaryMapLocation));
+  }
+  std::vector<char> padding(size_t(header.data_offset - locations_end), 0);
+  out_file.write(padding.data(), padding.size());
+  if (tile_size == 0) {
+    std::vector<Elevation> cells(static_cast<size_t>(cols));
+    for (int row = 0; row < rows && out_file; row++) {
+      FillRow(row, cols, cells.data());
+      out_file.write(reinterpret_cast<const char*>(cells.data()),
+                     cells.size() * sizeof(Elevation));
+    }
+  } else {
+    // A band of `tile_size` rows is generated at a time and written out as
+    // the row of tiles it covers, padded with zeros past the map edge
+    const size_t tiles_across = (size_t(cols) + size_t(tile_size) - 1) /
+                                size_t(tile_size);
+    const size_t band_cols = tiles_across * size_t(tile_size);
+    std::vector<Elevation> band(size_t(tile_size) * band_cols);
+    std::vector<Elevation> tile(size_t(tile_size) * size_t(tile_size));
+    for (int band_row = 0; band_row < rows && out_file;
+         band_row += tile_size) {
+      std::fill(band.begin(), band.end(), Elevation(0));
+      const int row_end = std::min(rows, band_row + tile_size);
+      for (int row = band_row; row < row_end; row++) {
+        FillRow(row, cols, band.data() + size_t(row - band_row) * band_cols);
+      }
+      for (size_t t = 0; t < tiles_across; t++) {
+        for (int r = 0; r < tile_size; r++) {
+          const Elevation* from =
+              band.data() + size_t(r) * band_cols + t * size_t(tile_size);
+          std::copy(from, from + tile_size,
+                    tile.data() + size_t(r) * size_t(tile_size));
+        }
+        out_file.write(reinterpret_cast<const char*>(tile.data()),
+                       tile.size() * sizeof(Elevation));
+      }
+    }
+  }
+  if (!out_file) {
+    std::cerr << "TerrainGenerator::WriteBinaryMap: ERROR! Unable to write "
+              << "map file: " << map_filename << std::endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "elevation_map.h"
+#include "special_locations.h"
+
+namespace path_planning {
+
+/// @struct Options for a `TerrainGenerator`
+struct TerrainOptions {
+  /// The noise seed. The same seed and options always give the same map.
+  uint32_t seed = 1;
+  /// The width in cells of the largest hills
+  double feature_size = 256.0;
+  /// The number of octaves of noise summed, each with half the feature size
+  /// of the one before
+  int octaves = 6;
+  /// The amplitude of each octave relative to the one before. Higher is
+  /// rougher.
+  double persistence = 0.5;
+  /// The lowest elevation generated, at least 0 so no cell reads as a
+  /// marker
+  int min_elevation = 0;
+  /// The highest elevation generated
+  int max_elevation = 1000;
+  /// The special locations to mark in the map, e.g. from
+  /// `DefaultTerrainLocations`. Each must be a marker from `kMarkers` on a
+  /// distinct cell of the map.
+  std::vector<MarkedLocation> locations;
+};
+
+/// @brief Get the placement `SyntheticMapText` uses: `(A)` an eighth of the
+/// way in from the top left, and `(B)` an eighth of the way in from the
+/// bottom right
+/// @param rows - The number of rows of the map
+/// @param cols - The number of columns of the map
+std::vector<MarkedLocation> DefaultTerrainLocations(int rows, int cols);
+
+/// @class Deterministic generator of synthetic terrain of any size, for
+/// testing how the library scales. The terrain is fractal Brownian motion:
+/// octaves of Perlin gradient noise at halving feature sizes, scaled into
+/// the elevation range. Every cell is computed on its own from the seed,
+/// so maps are written a row at a time in the text or binary formats
+/// without holding the map in memory.
+class TerrainGenerator {
+ public:
+  /// @brief Constructor
+  /// @param options - The terrain and the special locations to generate
+  explicit TerrainGenerator(const TerrainOptions& options = TerrainOptions());
+  /// @brief Get the options the terrain is generated with
+  const TerrainOptions& options() const { return options_; }
+  /// @brief Get the terrain elevation of a cell, ignoring the special
+  /// locations
+  /// @param row - The row of the cell
+  /// @param col - The column of the cell
+  Elevation At(int row, int col) const;
+  /// @brief Generate a map in memory
+  /// @param rows - The number of rows
+  /// @param cols - The number of columns
+  /// @param emap - Output. The generated map with its special locations
+  /// @return false if the size or options are invalid
+  bool Generate(int rows, int cols, ElevationMap* emap) const;
+  /// @brief Write a map in the bracketed text format `ElevationMap::ReadMap`
+  /// reads, a row at a time
+  /// @param map_filename - The file to write
+  /// @param rows - The number of rows
+  /// @param cols - The number of columns
+  /// @return false if the size or options are invalid or the file could
+  /// not be written
+  bool WriteTextMap(const std::string& map_filename, int rows,
+                    int cols) const;
+  /// @brief Write a map in the binary `.emap` format
+  /// `ElevationMap::OpenBinaryMap` reads, a row of cells, or of tiles, at a
+  /// time
+  /// @param map_filename - The file to write
+  /// @param rows - The number of rows
+  /// @param cols - The number of columns
+  /// @param tile_size - The edge length of the tiles to store the cells
+  /// in, or 0 for row-major storage, see `ElevationMap::WriteBinaryMap`
+  /// @return false if the size or options are invalid or the file could
+  /// not be written
+  bool WriteBinaryMap(const std::string& map_filename, int rows, int cols,
+                      int tile_size = 0) const;
+
+ private:
+  /// @brief Check a map of the given size can be generated
+  /// @param method - The calling method, for the error message
+  bool CheckSize(const char* method, int rows, int cols) const;
+  /// @brief Fill in a row of cells, with the markers of the special
+  /// locations in it
+  /// @param row - The row to fill in
+  /// @param cols - The number of columns
+  /// @param cells - Output. The `cols` cells of the row
+  void FillRow(int row, int cols, Elevation* cells) const;
+
+  /// The terrain and the special locations
+  TerrainOptions options_;
+  /// The special locations ordered by row and column
+  std::vector<MarkedLocation> sorted_locations_;
+  /// The frequency, amplitude and seed of each octave
+  std::vector<double> frequencies_;
+  std::vector<double> amplitudes_;
+  std::vector<uint32_t> octave_seeds_;
+};
+}
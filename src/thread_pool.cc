@@ -0,0 +1,77 @@
+#include <algorithm>
+
+#include "thread_pool.h"
+
+using namespace path_planning;
+
+ThreadPool::ThreadPool(int num_threads)
+    : job_(nullptr),
+      job_count_(0),
+      next_index_(0),
+      job_generation_(0),
+      busy_workers_(0),
+      stop_(false) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1, int(std::thread::hardware_concurrency()));
+  }
+  for (int i = 0; i < num_threads; i++) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::ParallelFor(size_t count,
+                             const std::function<void(size_t, int)>& fn) {
+  if (count == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> loop_lock(loop_mutex_);
+  std::unique_lock<std::mutex> lock(mutex_);
+  job_ = &fn;
+  job_count_ = count;
+  next_index_ = 0;
+  busy_workers_ = int(threads_.size());
+  job_generation_++;
+  work_cv_.notify_all();
+  done_cv_.wait(lock, [this]() { return busy_workers_ == 0; });
+  job_ = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int worker) {
+  uint64_t seen_generation = 0;
+  while (true) {
+    const std::function<void(size_t, int)>* job;
+    size_t count;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cv_.wait(lock, [this, seen_generation]() {
+        return stop_ || job_generation_ != seen_generation;
+      });
+      if (stop_) {
+        return;
+      }
+      seen_generation = job_generation_;
+      job = job_;
+      count = job_count_;
+    }
+
+    for (size_t i = next_index_++; i < count; i = next_index_++) {
+      (*job)(i, worker);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (--busy_workers_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
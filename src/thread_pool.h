@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace path_planning {
+
+/// @class Fixed set of worker threads for running data parallel loops. The
+/// threads are started once and reused by every `ParallelFor` call.
+class ThreadPool {
+ public:
+  /// @brief Constructor
+  /// @param num_threads - The number of worker threads, or 0 to use one per
+  /// hardware thread
+  explicit ThreadPool(int num_threads = 0);
+  /// @brief Destructor, joins the worker threads
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  /// @brief Get the number of worker threads
+  int size() const { return int(threads_.size()); }
+  /// @brief Call `fn(index, worker)` for every index on [0, count) and wait
+  /// for all of them to finish. Indices are handed out dynamically so uneven
+  /// work balances itself. `worker` is on [0, size()) and is never used by
+  /// two threads at once, so it can select per-thread scratch state.
+  /// @param count - The number of indices to run
+  /// @param fn - The function to run for each index
+  void ParallelFor(size_t count, const std::function<void(size_t, int)>& fn);
+
+ private:
+  /// @brief The body of each worker thread
+  void WorkerLoop(int worker);
+
+  /// The worker threads
+  std::vector<std::thread> threads_;
+  /// Only one loop runs at a time
+  std::mutex loop_mutex_;
+  /// Guards the job fields below
+  std::mutex mutex_;
+  /// Signals workers that a new job or shutdown is ready
+  std::condition_variable work_cv_;
+  /// Signals the caller that every worker finished the job
+  std::condition_variable done_cv_;
+  /// The function of the current job
+  const std::function<void(size_t, int)>* job_;
+  /// The number of indices in the current job
+  size_t job_count_;
+  /// The next index of the current job to hand out
+  std::atomic<size_t> next_index_;
+  /// Incremented for every job so workers can tell new work from old
+  uint64_t job_generation_;
+  /// The number of workers still running the current job
+  int busy_workers_;
+  /// Set when the pool is shutting down
+  bool stop_;
+};
+}
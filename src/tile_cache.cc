@@ -0,0 +1,179 @@
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+#include "binary_map_format.h"
+#include "instrumentation.h"
+#include "tile_cache.h"
+
+using namespace path_planning;
+
+namespace {
+
+/// Source of `TileCache::id_`
+std::atomic<uint64_t> g_next_cache_id(1);
+
+}  // namespace
+
+TileCache::TileCache()
+    : id_(g_next_cache_id.fetch_add(1)),
+      rows_(0),
+      cols_(0),
+      tile_size_(0),
+      tiles_per_row_(0),
+      elevation_type_(0),
+      data_offset_(0),
+      budget_bytes_(kDefaultTileCacheBytes) {
+}
+
+TileCache::~TileCache() {
+}
+
+bool TileCache::Open(const std::string& filename, int rows, int cols,
+                     int tile_size, uint32_t elevation_type,
+                     uint64_t data_offset, size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  file_.close();
+  file_.clear();
+  file_.open(filename, std::ios::binary);
+  if (!file_.is_open()) {
+    std::cerr << "TileCache::Open: ERROR! Unable to open tile file: "
+              << filename << std::endl;
+    return false;
+  }
+  rows_ = rows;
+  cols_ = cols;
+  tile_size_ = tile_size;
+  tiles_per_row_ = (size_t(cols) + size_t(tile_size) - 1) / size_t(tile_size);
+  elevation_type_ = elevation_type;
+  data_offset_ = data_offset;
+  budget_bytes_ = budget_bytes;
+  lru_.clear();
+  resident_.clear();
+  stats_ = TileCacheStats();
+  // Tiles remembered by threads for the previous file must not be reused
+  id_ = g_next_cache_id.fetch_add(1);
+  return true;
+}
+
+Elevation TileCache::Get(int row, int col) const {
+  /// @struct The tile this thread read last
+  struct LastTile {
+    uint64_t cache_id = 0;
+    std::shared_ptr<const Tile> tile;
+  };
+  static thread_local LastTile last;
+
+  const size_t index = size_t(row / tile_size_) * tiles_per_row_ +
+                       size_t(col / tile_size_);
+  if (last.cache_id != id_ || last.tile->index != index) {
+    last.tile = Fetch(index);
+    last.cache_id = id_;
+  }
+  return last.tile->cells[size_t(row % tile_size_) * size_t(tile_size_) +
+                          size_t(col % tile_size_)];
+}
+
+std::shared_ptr<const TileCache::Tile> TileCache::Fetch(size_t index) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = resident_.find(index);
+  if (it != resident_.end()) {
+    stats_.hits++;
+    PP_COUNTER_ADD(Counter::kTileCacheHits, 1);
+    lru_.splice(lru_.begin(), lru_, it->second);
+    return lru_.front();
+  }
+
+  stats_.misses++;
+  PP_COUNTER_ADD(Counter::kTileCacheMisses, 1);
+  std::shared_ptr<const Tile> tile = ReadTile(index);
+  lru_.push_front(tile);
+  resident_[index] = lru_.begin();
+  stats_.resident_tiles++;
+  stats_.resident_bytes += tile_bytes();
+  EvictToBudget();
+  return tile;
+}
+
+std::shared_ptr<const TileCache::Tile> TileCache::ReadTile(
+    size_t index) const {
+  namespace bmf = binary_map;
+  auto tile = std::make_shared<Tile>();
+  tile->index = index;
+  const size_t cell_count = size_t(tile_size_) * size_t(tile_size_);
+  tile->cells.resize(cell_count);
+
+  const uint64_t cell_size = bmf::ElevationTypeSize(elevation_type_);
+  const bool native = elevation_type_ == bmf::NativeElevationType();
+  char* destination = reinterpret_cast<char*>(tile->cells.data());
+  if (!native) {
+    read_buffer_.resize(cell_count * cell_size);
+    destination = read_buffer_.data();
+  }
+  file_.clear();
+  file_.seekg(std::streamoff(data_offset_ + index * cell_count * cell_size));
+  file_.read(destination, std::streamsize(cell_count * cell_size));
+  if (!file_) {
+    throw std::runtime_error("TileCache: unable to read tile " +
+                             std::to_string(index));
+  }
+  if (native) {
+    return tile;
+  }
+
+  // Convert from the stored type, which was range checked when written
+  for (size_t i = 0; i < cell_count; i++) {
+    int64_t value;
+    if (elevation_type_ == bmf::kInt16) {
+      int16_t cell;
+      std::memcpy(&cell, destination + i * sizeof(cell), sizeof(cell));
+      value = cell;
+    } else {
+      int32_t cell;
+      std::memcpy(&cell, destination + i * sizeof(cell), sizeof(cell));
+      value = cell;
+    }
+    if (value < std::numeric_limits<Elevation>::min() ||
+        value > std::numeric_limits<Elevation>::max()) {
+      throw std::runtime_error(
+          "TileCache: elevation does not fit in the elevation type");
+    }
+    tile->cells[i] = Elevation(value);
+  }
+  return tile;
+}
+
+void TileCache::EvictToBudget() const {
+  while (lru_.size() > 1 && stats_.resident_bytes > budget_bytes_) {
+    resident_.erase(lru_.back()->index);
+    lru_.pop_back();
+    stats_.evictions++;
+    stats_.resident_tiles--;
+    stats_.resident_bytes -= tile_bytes();
+  }
+}
+
+void TileCache::SetBudget(size_t budget_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  budget_bytes_ = budget_bytes;
+  EvictToBudget();
+}
+
+size_t TileCache::budget() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return budget_bytes_;
+}
+
+TileCacheStats TileCache::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void TileCache::ResetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.hits = 0;
+  stats_.misses = 0;
+  stats_.evictions = 0;
+}
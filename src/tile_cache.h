@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "elevation_map.h"
+
+namespace path_planning {
+
+/// @struct Counters of a `TileCache`
+struct TileCacheStats {
+  /// Tile lookups that found the tile resident
+  uint64_t hits = 0;
+  /// Tile lookups that had to read the tile from the file
+  uint64_t misses = 0;
+  /// Tiles dropped to stay inside the memory budget
+  uint64_t evictions = 0;
+  /// The number of tiles currently in memory
+  size_t resident_tiles = 0;
+  /// The bytes of cells currently in memory
+  size_t resident_bytes = 0;
+  /// @brief Get the fraction of lookups that were hits, 0 with no lookups
+  double hit_rate() const {
+    return hits + misses == 0 ? 0.0 : double(hits) / double(hits + misses);
+  }
+};
+
+/// @class Reads the square tiles of a tiled `.emap` file on demand and keeps
+/// the most recently used ones in memory, up to a byte budget. Only the tiles
+/// a caller touches are ever read, so maps much larger than memory can be
+/// planned over.
+///
+/// Lookups are thread safe. Each thread also remembers the last tile it read
+/// so runs of lookups in the same tile, the common case for a search, skip
+/// the lock. Those repeat lookups are not counted in the stats. A tile a
+/// thread is still holding on to stays alive after eviction, so resident
+/// memory can exceed the budget by one tile per thread.
+class TileCache {
+ public:
+  /// @brief Constructor
+  TileCache();
+  /// @brief Destructor
+  ~TileCache();
+  TileCache(const TileCache&) = delete;
+  TileCache& operator=(const TileCache&) = delete;
+  /// @brief Start serving tiles from a file. The caller has already
+  /// validated the header the layout came from.
+  /// @param filename - The tiled `.emap` file
+  /// @param rows - The number of rows in the map
+  /// @param cols - The number of columns in the map
+  /// @param tile_size - The edge length of the square tiles
+  /// @param elevation_type - The `binary_map::ElevationType` of the cells
+  /// @param data_offset - The offset of the first tile from the file start
+  /// @param budget_bytes - The most memory to keep tiles in
+  /// @return true if the file was opened
+  bool Open(const std::string& filename, int rows, int cols, int tile_size,
+            uint32_t elevation_type, uint64_t data_offset,
+            size_t budget_bytes = kDefaultTileCacheBytes);
+  /// @brief Get a cell. Throws `runtime_error` if its tile can not be read.
+  /// @param row - The row index into the map, must be in range
+  /// @param col - The column index into the map, must be in range
+  /// @return The value at row, col
+  Elevation Get(int row, int col) const;
+  /// @brief Change the memory budget, evicting tiles if it shrank. At least
+  /// one tile is always kept.
+  void SetBudget(size_t budget_bytes);
+  /// @brief Get the memory budget
+  size_t budget() const;
+  /// @brief Get the edge length of the tiles
+  int tile_size() const { return tile_size_; }
+  /// @brief Get the bytes of memory used by one tile
+  size_t tile_bytes() const {
+    return size_t(tile_size_) * size_t(tile_size_) * sizeof(Elevation);
+  }
+  /// @brief Get a snapshot of the counters
+  TileCacheStats stats() const;
+  /// @brief Zero the hit, miss and eviction counters
+  void ResetStats();
+
+ private:
+  /// @struct A resident tile
+  struct Tile {
+    /// The index of the tile in the file
+    size_t index;
+    /// The `tile_size * tile_size` row-major cells of the tile
+    std::vector<Elevation> cells;
+  };
+  /// The least recently used tile is at the back
+  using TileList = std::list<std::shared_ptr<const Tile>>;
+
+  /// @brief Get a tile, reading it and evicting others if needed
+  std::shared_ptr<const Tile> Fetch(size_t index) const;
+  /// @brief Read a tile from the file. Must hold `mutex_`.
+  std::shared_ptr<const Tile> ReadTile(size_t index) const;
+  /// @brief Drop tiles until inside the budget. Must hold `mutex_`.
+  void EvictToBudget() const;
+
+  /// Unique per cache, so a thread's remembered tile can not be mistaken for
+  /// a tile of a different cache at a reused address
+  uint64_t id_;
+  /// The map layout
+  int rows_;
+  int cols_;
+  int tile_size_;
+  size_t tiles_per_row_;
+  uint32_t elevation_type_;
+  uint64_t data_offset_;
+  /// Guards everything below
+  mutable std::mutex mutex_;
+  /// The open tile file
+  mutable std::ifstream file_;
+  /// Resident tiles, most recently used first
+  mutable TileList lru_;
+  /// Where each resident tile is in `lru_`
+  mutable std::unordered_map<size_t, TileList::iterator> resident_;
+  /// Scratch for converting tiles stored with a different elevation type
+  mutable std::vector<char> read_buffer_;
+  /// The memory budget
+  size_t budget_bytes_;
+  /// The counters
+  mutable TileCacheStats stats_;
+};
+}
@@ -0,0 +1,239 @@
+#include "arena.h"
+#include "elevation_map.h"
+#include "path_planner.h"
+#include "planner_context.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace pp = path_planning;
+
+/// Number of calls to the global operator new from each thread, to check
+/// warm plans do not allocate
+static thread_local size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/// @brief Build the text of a rolling map with a start and end marker
+std::string TestMapText(int size) {
+  std::string text = "[";
+  for (int row = 0; row < size; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < size; col++) {
+      text += col == 0 ? "" : ",";
+      if (row == 1 && col == 1) {
+        text += "(A)";
+      } else if (row == size - 2 && col == size - 2) {
+        text += "(B)";
+      } else {
+        text += std::to_string(100 + (row * 7 + col * 13) % 50 +
+                               (row / 16 + col / 16) % 3 * 40);
+      }
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+}  // namespace
+
+bool arena_allocates_and_rewinds() {
+  pp::MonotonicArena arena(256);
+  if (arena.num_blocks() != 0 || arena.bytes_used() != 0) {
+    return false;
+  }
+  // Allocations are aligned and do not overlap
+  char* a = static_cast<char*>(arena.Allocate(3, 1));
+  double* b = static_cast<double*>(arena.Allocate(sizeof(double), 8));
+  void* c = arena.Allocate(100, 64);
+  if (reinterpret_cast<uintptr_t>(b) % 8 != 0 ||
+      reinterpret_cast<uintptr_t>(c) % 64 != 0 ||
+      reinterpret_cast<char*>(b) < a + 3 ||
+      static_cast<char*>(c) < reinterpret_cast<char*>(b + 1) ||
+      arena.num_blocks() != 1) {
+    std::cout << "Arena allocations overlap or are misaligned" << std::endl;
+    return false;
+  }
+
+  // Rewinding hands the same memory out again
+  const pp::MonotonicArena::Mark mark = arena.mark();
+  void* first = arena.Allocate(64, 8);
+  arena.Rewind(mark);
+  if (arena.Allocate(64, 8) != first) {
+    std::cout << "Rewound arena did not reuse its memory" << std::endl;
+    return false;
+  }
+
+  // Outgrowing a block adds a bigger one, and once the arena has served a
+  // workload, serving it again does not call the system allocator
+  size_t blocks = 0;
+  for (int pass = 0; pass < 3; pass++) {
+    const size_t before = g_allocations;
+    pp::ArenaScope scope(arena);
+    pp::ArenaVector<int> values{pp::ArenaAllocator<int>(&arena)};
+    for (int i = 0; i < 1000; i++) {
+      values.push_back(i);
+    }
+    arena.Allocate(10000, 16);
+    if (values[999] != 999 || arena.num_blocks() < 2) {
+      return false;
+    }
+    if (pass > 0 &&
+        (g_allocations != before || arena.num_blocks() != blocks)) {
+      std::cout << "Warm arena called the system allocator" << std::endl;
+      return false;
+    }
+    blocks = arena.num_blocks();
+  }
+  if (arena.peak_bytes() < 10000 + 4000 ||
+      arena.capacity() < arena.peak_bytes()) {
+    return false;
+  }
+  arena.Reset();
+  if (arena.bytes_used() != 0) {
+    return false;
+  }
+  arena.Release();
+  if (arena.num_blocks() != 0 || arena.capacity() != 0) {
+    return false;
+  }
+
+  // Every thread has its own arena
+  pp::MonotonicArena* other = nullptr;
+  std::thread thread([&other]() { other = &pp::ThreadArena(); });
+  thread.join();
+  return other != &pp::ThreadArena();
+}
+
+bool pool_reuses_contexts() {
+  pp::PlannerContextPool pool;
+  pool.Reserve(2);
+  if (pool.size() != 2 || pool.idle() != 2) {
+    return false;
+  }
+  pp::PlannerContext* leased = nullptr;
+  {
+    pp::PlannerContextPool::Lease a = pool.Acquire();
+    pp::PlannerContextPool::Lease b = pool.Acquire();
+    pp::PlannerContextPool::Lease c = pool.Acquire();
+    if (pool.size() != 3 || pool.idle() != 0 || a.get() == b.get() ||
+        b.get() == c.get()) {
+      std::cout << "Pool leased a context twice" << std::endl;
+      return false;
+    }
+    // Destroyed last, so returned last
+    leased = a.get();
+  }
+  // The most recently returned context is leased first, as the warmest
+  if (pool.idle() != 3 || pool.Acquire().get() != leased) {
+    std::cout << "Pool did not take its contexts back" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool concurrent_plans_match() {
+  const std::string text = TestMapText(96);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::HierarchicalOptions hierarchical;
+  hierarchical.enabled = true;
+  hierarchical.level = 2;
+  planner.SetHierarchicalOptions(hierarchical);
+  std::vector<pp::PlanQuery> queries;
+  for (int i = 0; i < 24; i++) {
+    pp::PlanQuery query;
+    query.start = std::make_pair(i * 3, (i * 17) % 96);
+    query.goal = std::make_pair(95 - (i * 5) % 96, (i * 29) % 96);
+    query.agl = i % 4 * 10;
+    queries.push_back(query);
+  }
+  std::vector<pp::PlanResult> expected;
+  if (!planner.PlanPaths(queries, &expected, 2)) {
+    return false;
+  }
+
+  const int num_threads = 4;
+  planner.Prepare(num_threads);
+  std::vector<pp::PlanResult> results(queries.size());
+  std::atomic<bool> planned(true);
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < num_threads; thread++) {
+    threads.emplace_back([&, thread]() {
+      for (size_t i = size_t(thread); i < queries.size(); i += num_threads) {
+        if (!planner.Plan(queries[i], &results[i])) {
+          planned = false;
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (!planned) {
+    return false;
+  }
+  for (size_t i = 0; i < queries.size(); i++) {
+    if (results[i].path != expected[i].path ||
+        results[i].agl_elevation_profile !=
+            expected[i].agl_elevation_profile) {
+      std::cout << "Concurrent plan " << i << " does not match PlanPaths"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // Once a context and the results are warm, planning again allocates
+  // nothing. Which context a thread leases varies, so this is checked on
+  // one thread, which always gets the most recently returned context.
+  for (int pass = 0; pass < 3; pass++) {
+    const size_t before = g_allocations;
+    for (size_t i = 0; i < queries.size(); i++) {
+      if (!planner.Plan(queries[i], &results[i])) {
+        return false;
+      }
+    }
+    if (pass > 0 && g_allocations != before) {
+      std::cout << "Warm plans allocated " << g_allocations - before
+                << " times" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!arena_allocates_and_rewinds()) {
+    return -1;
+  }
+  if (!pool_reuses_contexts()) {
+    return -1;
+  }
+  if (!concurrent_plans_match()) {
+    return -1;
+  }
+  std::cout << "All arena tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,230 @@
+#include "bidirectional_search.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "path_planner.h"
+#include "search_policies.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Build a map of rolling hills with scattered peaks
+pp::ElevationMap HillyMap(int rows, int cols) {
+  std::vector<pp::Elevation> cells(size_t(rows) * size_t(cols));
+  uint32_t seed = 12345;
+  for (int row = 0; row < rows; row++) {
+    for (int col = 0; col < cols; col++) {
+      seed = seed * 1664525u + 1013904223u;
+      const double hills =
+          40.0 * std::sin(row * 0.21) * std::cos(col * 0.17) + 60.0;
+      const int peak = (seed >> 24) < 20 ? 400 : 0;
+      cells[size_t(row) * cols + col] =
+          pp::Elevation(100 + int(hills) + int((seed >> 16) % 8) + peak);
+    }
+  }
+  pp::ElevationMap emap;
+  emap.Assign(rows, cols, std::move(cells));
+  return emap;
+}
+
+/// @brief Check a path runs from start to goal in steps of the neighborhood
+/// and costs what the search says
+bool ValidPath(const pp::ElevationMap& emap,
+               const pp::SearchOptions& options,
+               const std::pair<int, int>& start,
+               const std::pair<int, int>& goal,
+               const std::vector<std::pair<int, int>>& path, double cost) {
+  if (path.empty() || path.front() != start || path.back() != goal) {
+    return false;
+  }
+  double total = 0.0;
+  for (size_t i = 1; i < path.size(); i++) {
+    const int row_diff = std::abs(path[i].first - path[i - 1].first);
+    const int col_diff = std::abs(path[i].second - path[i - 1].second);
+    const double distance = std::sqrt(double(row_diff * row_diff) +
+                                      double(col_diff * col_diff));
+    const bool knight = distance == std::sqrt(5.0);
+    const bool allowed =
+        row_diff + col_diff == 1 ||
+        (row_diff == 1 && col_diff == 1 &&
+         options.connectivity != pp::Connectivity::kFour) ||
+        (knight && options.connectivity == pp::Connectivity::kSixteen);
+    if (!allowed) {
+      return false;
+    }
+    const int64_t climb =
+        pp::TerrainElevation(emap, path[i].first, path[i].second) -
+        pp::TerrainElevation(emap, path[i - 1].first, path[i - 1].second);
+    total += pp::CostOfStep(options.cost_policy, options.cost,
+                            options.cost.distance_weight * distance, climb);
+  }
+  return std::abs(total - cost) <= 1e-3 * cost + 1e-3;
+}
+
+}  // namespace
+
+bool bidirectional_matches_a_star() {
+  const pp::ElevationMap emap = HillyMap(60, 80);
+  const std::vector<std::pair<std::pair<int, int>, std::pair<int, int>>>
+      queries = {{{0, 0}, {59, 79}},
+                 {{59, 0}, {0, 79}},
+                 {{30, 2}, {31, 77}},
+                 {{5, 40}, {7, 41}}};
+  for (auto connectivity :
+       {pp::Connectivity::kFour, pp::Connectivity::kEight,
+        pp::Connectivity::kSixteen}) {
+    for (auto policy : {pp::CostPolicy::kTerrain, pp::CostPolicy::kDistance}) {
+      pp::SearchOptions options;
+      options.connectivity = connectivity;
+      options.cost_policy = policy;
+      // The peaks are walls, so distance alone still has to go around them
+      options.cost.max_altitude = 400;
+      pp::GridSearch a_star(options);
+      for (int threads : {1, 2}) {
+        options.algorithm = pp::SearchAlgorithm::kBidirectional;
+        options.bidirectional_threads = threads;
+        // The same engine is reused for every query
+        pp::BidirectionalSearch search(options);
+        for (const auto& query : queries) {
+          std::vector<std::pair<int, int>> expected;
+          std::vector<std::pair<int, int>> path;
+          const bool expected_found = a_star.FindPath(
+              emap, query.first, query.second, 0, &expected);
+          const bool found =
+              search.FindPath(emap, query.first, query.second, 0, &path);
+          const double expected_cost = a_star.stats().path_cost;
+          const double cost = search.stats().path_cost;
+          if (found != expected_found ||
+              std::abs(cost - expected_cost) > 1e-4 * expected_cost ||
+              (found && !ValidPath(emap, options, query.first, query.second,
+                                   path, cost))) {
+            std::cout << "Bidirectional search on " << threads
+                      << " threads disagrees with A*: " << cost << " vs "
+                      << expected_cost << " with " << int(connectivity)
+                      << " neighbors" << std::endl;
+            return false;
+          }
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool bidirectional_ceiling_and_window() {
+  // A ridge separates the start and goal, with a gap on the far right
+  const std::string text =
+      "[[100,100,100,100,100],"
+      " [900,900,900,900,100],"
+      " [100,100,100,100,100]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kBidirectional;
+  options.cost.max_altitude = 500;
+  pp::BidirectionalSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 0, &path) || path.size() != 11 ||
+      search.stats().path_cost != 10) {
+    std::cout << "Bidirectional search did not go through the gap"
+              << std::endl;
+    return false;
+  }
+  // The window only holds the first column, so there is no way around
+  options.window_margin = 0;
+  search.SetOptions(options);
+  if (search.FindPath(emap, {0, 0}, {2, 0}, 0, &path) || !path.empty()) {
+    std::cout << "Bidirectional search left its window" << std::endl;
+    return false;
+  }
+  // Both ends may be above the ceiling, the cells between may not
+  options.window_margin = -1;
+  search.SetOptions(options);
+  if (!search.FindPath(emap, {1, 0}, {1, 3}, 0, &path) ||
+      path.front() != std::make_pair(1, 0) ||
+      path.back() != std::make_pair(1, 3) || path.size() != 6) {
+    std::cout << "Bidirectional search crossed the ridge" << std::endl;
+    return false;
+  }
+  if (!search.FindPath(emap, {2, 2}, {2, 2}, 0, &path) || path.size() != 1) {
+    std::cout << "A search to the start did not stay there" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool bidirectional_marked_and_tiled_maps() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  const auto start = emap.GetLocations(pp::kStartPos)[0];
+  const auto goal = emap.GetLocations(pp::kEndPos)[0];
+  const std::string tiled_filename = "bidirectional_search_test_tiled.emap";
+  pp::ElevationMap tiled;
+  if (!emap.WriteBinaryMap(tiled_filename, 8) ||
+      !tiled.OpenBinaryMap(tiled_filename)) {
+    return false;
+  }
+  std::remove(tiled_filename.c_str());
+
+  // The markers at both ends are costed like A* costs them, through the
+  // tile cache as well as in memory
+  pp::GridSearch a_star;
+  std::vector<std::pair<int, int>> expected;
+  if (!a_star.FindPath(emap, start, goal, 0, &expected)) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kBidirectional;
+  pp::BidirectionalSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  std::vector<std::pair<int, int>> tiled_path;
+  if (!search.FindPath(emap, start, goal, 0, &path) ||
+      std::abs(search.stats().path_cost - a_star.stats().path_cost) > 1e-2 ||
+      !search.FindPath(tiled, start, goal, 0, &tiled_path) ||
+      std::abs(search.stats().path_cost - a_star.stats().path_cost) > 1e-2) {
+    std::cout << "Bidirectional search disagrees with A* on the test map"
+              << std::endl;
+    return false;
+  }
+
+  // The planner runs it through its search options
+  pp::PathPlanner planner(emap);
+  planner.SetSearchOptions(options);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> planned;
+  if (!planner.PlanPath(&profile, &agl_profile, 0, &planned) ||
+      planned.front() != start || planned.back() != goal ||
+      std::abs(planner.search_stats().path_cost -
+               a_star.stats().path_cost) > 1e-2) {
+    std::cout << "Planner did not plan bidirectionally" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!bidirectional_matches_a_star()) {
+    return -1;
+  }
+  if (!bidirectional_ceiling_and_window()) {
+    return -1;
+  }
+  if (!bidirectional_marked_and_tiled_maps()) {
+    return -1;
+  }
+  std::cout << "All bidirectional search tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,216 @@
+#include "clearance_field.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "path_planner.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Build the text of a noisy map, with a start and end marker if it
+/// has room for them
+std::string TestMapText(int rows, int cols, uint32_t seed) {
+  std::string text = "[";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < cols; col++) {
+      if (col > 0) {
+        text += ',';
+      }
+      seed = seed * 1664525u + 1013904223u;
+      if (rows * cols > 2 && row == rows / 3 && col == cols / 4) {
+        text += "(A)";
+      } else if (rows * cols > 2 && row == rows - 1 && col == cols - 1) {
+        text += "(B)";
+      } else {
+        text += std::to_string(int((seed >> 12) % 1000) - 200);
+      }
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+/// @brief Get the highest terrain within a radius by scanning the square.
+/// Only the marked locations take the terrain of their neighbors, a noise
+/// value that happens to equal a marker is terrain like any other.
+int64_t BruteForceMax(const pp::ElevationMap& emap, int row, int col,
+                      int radius) {
+  const auto start = emap.GetLocations(pp::kStartPos);
+  const auto end = emap.GetLocations(pp::kEndPos);
+  int64_t highest = INT64_MIN;
+  for (int r = std::max(0, row - radius);
+       r <= std::min(emap.rows() - 1, row + radius); r++) {
+    for (int c = std::max(0, col - radius);
+         c <= std::min(emap.cols() - 1, col + radius); c++) {
+      const auto cell = std::make_pair(r, c);
+      const bool marked =
+          std::find(start.begin(), start.end(), cell) != start.end() ||
+          std::find(end.begin(), end.end(), cell) != end.end();
+      highest = std::max(highest, marked ? pp::TerrainElevation(emap, r, c)
+                                         : int64_t(emap(r, c)));
+    }
+  }
+  return highest;
+}
+
+}  // namespace
+
+bool field_matches_brute_force() {
+  pp::ThreadPool pool(3);
+  const int sizes[][2] = {{1, 1}, {1, 17}, {13, 1}, {23, 37}, {70, 45}};
+  for (const auto& size : sizes) {
+    const std::string text =
+        TestMapText(size[0], size[1], uint32_t(size[0] * 31 + size[1]));
+    pp::ElevationMap emap;
+    if (!emap.ParseMap(text.data(), text.size())) {
+      return false;
+    }
+    for (int radius : {0, 1, 2, 3, 7, 40}) {
+      for (pp::ThreadPool* threads : {static_cast<pp::ThreadPool*>(nullptr),
+                                      &pool}) {
+        pp::ClearanceField field;
+        if (!field.Build(emap, radius, threads) || field.radius() != radius ||
+            field.rows() != emap.rows() || field.cols() != emap.cols()) {
+          return false;
+        }
+        for (int row = 0; row < emap.rows(); row++) {
+          for (int col = 0; col < emap.cols(); col++) {
+            if (field.MaxElevation(row, col) !=
+                BruteForceMax(emap, row, col, radius)) {
+              std::cout << "Field of radius " << radius << " on a "
+                        << size[0] << " x " << size[1] << " map is wrong at "
+                        << row << ", " << col << std::endl;
+              return false;
+            }
+          }
+        }
+      }
+    }
+  }
+
+  pp::ClearanceField field;
+  pp::ElevationMap empty;
+  if (field.Build(empty, 1) || field.Build(empty, -1)) {
+    std::cout << "Built a field from nothing" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_keeps_clearance() {
+  // Flat ground with a tall spike between the start and the goal
+  const int size = 21;
+  std::vector<pp::Elevation> cells(size_t(size * size), 100);
+  cells[size_t(10 * size + 10)] = 900;
+  std::string text = "[";
+  for (int row = 0; row < size; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < size; col++) {
+      text += col == 0 ? "" : ",";
+      if (row == 10 && col == 2) {
+        text += "(A)";
+      } else if (row == 10 && col == 18) {
+        text += "(B)";
+      } else {
+        text += std::to_string(cells[size_t(row * size + col)]);
+      }
+    }
+    text += ']';
+  }
+  text += "]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+
+  pp::ClearanceField field;
+  if (!field.Build(emap, 3) || !field.IsSafe(0, 0, 100) ||
+      field.IsSafe(12, 12, 899) || !field.IsSafe(12, 12, 950, 50) ||
+      field.IsSafe(12, 12, 950, 51)) {
+    std::cout << "Clearance queries around the spike are wrong" << std::endl;
+    return false;
+  }
+
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  options.cost.max_altitude = 500;
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  const std::pair<int, int> start(10, 2);
+  const std::pair<int, int> goal(10, 18);
+  if (!search.FindPath(emap, start, goal, 0, &path)) {
+    return false;
+  }
+  const double direct_cost = search.stats().path_cost;
+  options.clearance = &field;
+  search.SetOptions(options);
+  if (!search.FindPath(emap, start, goal, 0, &path) ||
+      search.stats().path_cost <= direct_cost) {
+    std::cout << "Search with clearance did not detour" << std::endl;
+    return false;
+  }
+  for (const auto& cell : path) {
+    if (std::max(std::abs(cell.first - 10), std::abs(cell.second - 10)) <=
+        3) {
+      std::cout << "Path passes within the radius of the spike" << std::endl;
+      return false;
+    }
+  }
+
+  // The corrected profile clears the spike next to the path as well
+  pp::PathPlanner planner(emap);
+  std::vector<std::pair<int, int>> straight;
+  for (int col = 2; col <= 18; col++) {
+    straight.emplace_back(13, col);
+  }
+  const std::vector<int> flat(straight.size(), 150);
+  const std::vector<int> corrected =
+      planner.CorrectPath(field, straight, flat, 20);
+  if (corrected[8] != 920 || corrected[0] != 150 || corrected[4] != 150 ||
+      corrected[5] != 920) {
+    std::cout << "Corrected profile does not clear the spike" << std::endl;
+    return false;
+  }
+  // Planned in one pass, the climb to clear the spike starts early enough
+  const std::vector<int> optimized =
+      planner.OptimizeAltitude(field, straight, 20, 100, 50);
+  if (optimized.size() != straight.size() || optimized[5] != 920 ||
+      optimized[8] != 920 || optimized[4] != 820 || optimized[3] != 720 ||
+      optimized[12] != 870 ||
+      !planner.OptimizeAltitude(field, {{13, 40}}, 20, 100, 50).empty()) {
+    std::cout << "Optimized altitude does not clear the spike" << std::endl;
+    return false;
+  }
+
+  // A field from another map is refused
+  pp::ElevationMap other;
+  const std::string other_text = TestMapText(5, 5, 1);
+  pp::ClearanceField other_field;
+  if (!other.ParseMap(other_text.data(), other_text.size()) ||
+      !other_field.Build(other, 1)) {
+    return false;
+  }
+  options.clearance = &other_field;
+  search.SetOptions(options);
+  return !search.FindPath(emap, start, goal, 0, &path);
+}
+
+int main(int argc, char** argv) {
+  if (!field_matches_brute_force()) {
+    return -1;
+  }
+  if (!search_keeps_clearance()) {
+    return -1;
+  }
+  std::cout << "All clearance field tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,537 @@
+#include "clearance_field.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "incremental_planner.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// A ridge separates the start and goal, with a gap on the far right
+const std::string kRidgeMap =
+    "[[100,100,100,100,100],"
+    " [900,900,900,900,100],"
+    " [100,100,100,100,100]]";
+
+}  // namespace
+
+bool search_around_ridge() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+
+  pp::GridSearch search;
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 0, &path)) {
+    return false;
+  }
+  if (path.size() != 11 || path.front() != std::make_pair(0, 0) ||
+      path.back() != std::make_pair(2, 0) || search.stats().path_cost != 10) {
+    std::cout << "A* did not find the flat path around the ridge"
+              << std::endl;
+    return false;
+  }
+
+  // Every step of the path is to a 4-connected neighbor
+  for (size_t i = 1; i < path.size(); i++) {
+    if (std::abs(path[i].first - path[i - 1].first) +
+            std::abs(path[i].second - path[i - 1].second) != 1) {
+      std::cout << "Path has a step that is not 4-connected" << std::endl;
+      return false;
+    }
+  }
+
+  // Dijkstra finds a path with the same cost but looks at more cells
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kDijkstra;
+  pp::GridSearch dijkstra(options);
+  std::vector<std::pair<int, int>> dijkstra_path;
+  if (!dijkstra.FindPath(emap, {0, 0}, {2, 0}, 0, &dijkstra_path) ||
+      dijkstra.stats().path_cost != search.stats().path_cost ||
+      dijkstra.stats().nodes_expanded < search.stats().nodes_expanded) {
+    std::cout << "Dijkstra disagrees with A*" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_eight_connected() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 0, &path)) {
+    return false;
+  }
+  // Diagonals cut both corners of the gap
+  if (path.size() != 9 || search.stats().path_cost >= 10) {
+    std::cout << "8-connected search did not use the diagonals" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_altitude_ceiling() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+  emap(1, 4) = 900;
+
+  // Without a ceiling the only way is over the ridge
+  pp::GridSearch search;
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 50, &path) || path.size() != 3) {
+    std::cout << "Search did not climb over the ridge" << std::endl;
+    return false;
+  }
+
+  // With a ceiling under the ridge there is no path at all
+  pp::SearchOptions options;
+  options.cost.max_altitude = 900;
+  search.SetOptions(options);
+  if (search.FindPath(emap, {0, 0}, {2, 0}, 50, &path) || !path.empty()) {
+    std::cout << "Search flew above the altitude ceiling" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_diagonal_corners() {
+  // Two walls above the ceiling touch at a corner between the start and goal
+  pp::ElevationMap emap;
+  if (!emap.Assign(2, 2, {0, 1000, 1000, 0})) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  options.cost.max_altitude = 100;
+  std::vector<std::pair<int, int>> path;
+  for (auto algorithm :
+       {pp::SearchAlgorithm::kAStar, pp::SearchAlgorithm::kBidirectional}) {
+    options.algorithm = algorithm;
+    pp::GridSearch search(options);
+    if (search.FindPath(emap, {0, 0}, {1, 1}, 0, &path)) {
+      std::cout << "A diagonal step slipped between two walls" << std::endl;
+      return false;
+    }
+  }
+  pp::IncrementalPlanner incremental(options);
+  incremental.SetMap(emap);
+  if (incremental.Plan({0, 0}, {1, 1}, 0, &path)) {
+    std::cout << "An incremental plan slipped between two walls"
+              << std::endl;
+    return false;
+  }
+
+  // With one side open the diagonal is flown
+  emap(1, 0) = 0;
+  options.algorithm = pp::SearchAlgorithm::kAStar;
+  pp::GridSearch search(options);
+  if (!search.FindPath(emap, {0, 0}, {1, 1}, 0, &path) || path.size() != 2) {
+    std::cout << "A diagonal past a single wall was refused" << std::endl;
+    return false;
+  }
+  incremental.SetMap(emap);
+  if (!incremental.Plan({0, 0}, {1, 1}, 0, &path) || path.size() != 2) {
+    std::cout << "An incremental diagonal past a single wall was refused"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_reuses_scratch() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  auto start = emap.GetLocations(pp::kStartPos)[0];
+  auto goal = emap.GetLocations(pp::kEndPos)[0];
+
+  pp::GridSearch search;
+  std::vector<std::pair<int, int>> first_path;
+  std::vector<std::pair<int, int>> second_path;
+  if (!search.FindPath(emap, start, goal, 0, &first_path) ||
+      !search.FindPath(emap, start, goal, 0, &second_path) ||
+      first_path != second_path) {
+    std::cout << "Repeated searches gave different paths" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_window() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+
+  // The gap in the ridge is 4 columns from the start and goal, so a window
+  // of 3 can only climb over the ridge while a window of 4 goes around it
+  pp::SearchOptions options;
+  options.window_margin = 3;
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 0, &path) || path.size() != 3) {
+    std::cout << "Narrow window search did not go over the ridge"
+              << std::endl;
+    return false;
+  }
+  options.window_margin = 4;
+  search.SetOptions(options);
+  if (!search.FindPath(emap, {0, 0}, {2, 0}, 0, &path) || path.size() != 11 ||
+      search.stats().path_cost != 10) {
+    std::cout << "Window search did not go around the ridge" << std::endl;
+    return false;
+  }
+
+  // A window that does not start at the map origin reports map coordinates
+  if (!search.FindPath(emap, {2, 4}, {2, 2}, 0, &path) ||
+      path.front() != std::make_pair(2, 4) ||
+      path.back() != std::make_pair(2, 2)) {
+    std::cout << "Window search returned window coordinates" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_tiled_map() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  auto start = emap.GetLocations(pp::kStartPos)[0];
+  auto goal = emap.GetLocations(pp::kEndPos)[0];
+  const std::string tiled_filename = "grid_search_test_tiled.emap";
+  pp::ElevationMap tiled;
+  if (!emap.WriteBinaryMap(tiled_filename, 8) ||
+      !tiled.OpenBinaryMap(tiled_filename)) {
+    return false;
+  }
+  std::remove(tiled_filename.c_str());
+
+  // Searching through the tile cache gives the same path as in memory
+  pp::SearchOptions options;
+  options.window_margin = 16;
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> memory_path;
+  std::vector<std::pair<int, int>> tiled_path;
+  if (!search.FindPath(emap, start, goal, 0, &memory_path) ||
+      !search.FindPath(tiled, start, goal, 0, &tiled_path) ||
+      memory_path != tiled_path) {
+    std::cout << "Tiled search does not match the in memory search"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_sixteen_connected() {
+  // A flat map, where knight's moves shorten paths at shallow angles
+  pp::ElevationMap emap;
+  if (!emap.Assign(10, 20, std::vector<pp::Elevation>(200, 100))) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  pp::GridSearch eight(options);
+  options.connectivity = pp::Connectivity::kSixteen;
+  pp::GridSearch sixteen(options);
+  std::vector<std::pair<int, int>> eight_path;
+  std::vector<std::pair<int, int>> path;
+  if (!eight.FindPath(emap, {0, 0}, {4, 8}, 0, &eight_path) ||
+      !sixteen.FindPath(emap, {0, 0}, {4, 8}, 0, &path)) {
+    return false;
+  }
+  // Four knight's moves cover the straight line exactly
+  if (path.size() != 5 || path.back() != std::make_pair(4, 8) ||
+      std::abs(sixteen.stats().path_cost - 4 * std::sqrt(5.0)) > 1e-4 ||
+      sixteen.stats().path_cost >= eight.stats().path_cost) {
+    std::cout << "16-connected search did not take the knight's moves"
+              << std::endl;
+    return false;
+  }
+  // Dijkstra agrees, so the straight line heuristic is admissible
+  options.algorithm = pp::SearchAlgorithm::kDijkstra;
+  pp::GridSearch dijkstra(options);
+  std::vector<std::pair<int, int>> dijkstra_path;
+  if (!dijkstra.FindPath(emap, {9, 19}, {0, 3}, 0, &dijkstra_path) ||
+      !sixteen.FindPath(emap, {9, 19}, {0, 3}, 0, &path) ||
+      std::abs(dijkstra.stats().path_cost - sixteen.stats().path_cost) >
+          1e-4) {
+    std::cout << "16-connected A* disagrees with Dijkstra" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_knight_walls() {
+  // A wall above the ceiling that a knight's step would jump across
+  pp::ElevationMap emap;
+  std::vector<pp::Elevation> cells(15, 0);
+  for (int row = 0; row < 3; row++) {
+    cells[size_t(row * 5 + 2)] = 1000;
+  }
+  if (!emap.Assign(3, 5, cells)) {
+    return false;
+  }
+  pp::ClearanceField field;
+  if (!field.Build(emap, 0)) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kSixteen;
+  options.cost.max_altitude = 100;
+  std::vector<std::pair<int, int>> path;
+  for (auto algorithm :
+       {pp::SearchAlgorithm::kAStar, pp::SearchAlgorithm::kBidirectional}) {
+    options.algorithm = algorithm;
+    const pp::ClearanceField* clearances[] = {nullptr, &field};
+    for (const pp::ClearanceField* clearance : clearances) {
+      options.clearance = clearance;
+      pp::GridSearch search(options);
+      if (search.FindPath(emap, {0, 1}, {1, 3}, 0, &path)) {
+        std::cout << "A knight's step jumped a wall" << std::endl;
+        return false;
+      }
+    }
+  }
+  options.clearance = nullptr;
+  pp::IncrementalPlanner incremental(options);
+  incremental.SetMap(emap);
+  if (incremental.Plan({0, 1}, {1, 3}, 0, &path)) {
+    std::cout << "An incremental knight's step jumped a wall" << std::endl;
+    return false;
+  }
+
+  // Below the ceiling the wall is crossed in a single knight's step
+  for (int row = 0; row < 3; row++) {
+    emap(row, 2) = 50;
+  }
+  options.algorithm = pp::SearchAlgorithm::kAStar;
+  pp::GridSearch search(options);
+  if (!search.FindPath(emap, {0, 1}, {1, 3}, 0, &path) || path.size() != 2) {
+    std::cout << "A knight's step over low ground was refused" << std::endl;
+    return false;
+  }
+  incremental.SetMap(emap);
+  if (!incremental.Plan({0, 1}, {1, 3}, 0, &path) || path.size() != 2) {
+    std::cout << "An incremental knight's step over low ground was refused"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_many_goals() {
+  // A hill between the start and the nearest goal
+  std::vector<pp::Elevation> cells(15 * 15, 100);
+  for (int row = 4; row < 11; row++) {
+    for (int col = 4; col < 11; col++) {
+      cells[size_t(row * 15 + col)] = 160;
+    }
+  }
+  pp::ElevationMap emap;
+  if (!emap.Assign(15, 15, cells)) {
+    return false;
+  }
+  const std::vector<std::pair<int, int>> goals = {{7, 12}, {0, 14}, {14, 9}};
+  const pp::Span<const std::pair<int, int>> goal_span(goals.data(),
+                                                      goals.size());
+  std::vector<std::pair<int, int>> path;
+  for (auto algorithm : {pp::SearchAlgorithm::kAStar,
+                         pp::SearchAlgorithm::kDijkstra,
+                         pp::SearchAlgorithm::kBidirectional}) {
+    for (int margin : {-1, 1}) {
+      pp::SearchOptions options;
+      options.algorithm = algorithm;
+      options.connectivity = pp::Connectivity::kEight;
+      options.window_margin = margin;
+      pp::GridSearch search(options);
+      // The cheapest of the goals searched one at a time
+      double cheapest = 1e30;
+      std::pair<int, int> cheapest_goal;
+      for (const auto& goal : goals) {
+        if (search.FindPath(emap, {7, 0}, goal, 0, &path) &&
+            search.stats().path_cost < cheapest) {
+          cheapest = search.stats().path_cost;
+          cheapest_goal = goal;
+        }
+      }
+      if (!search.FindPathToAny(emap, {7, 0}, goal_span, 0, &path) ||
+          path.back() != cheapest_goal ||
+          std::abs(search.stats().path_cost - cheapest) > 1e-3) {
+        std::cout << "A search to several goals missed the cheapest"
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  // Goals outside the map are refused
+  const std::vector<std::pair<int, int>> outside = {{7, 12}, {15, 0}};
+  pp::GridSearch search;
+  if (search.FindPathToAny(
+          emap, {7, 0},
+          pp::Span<const std::pair<int, int>>(outside.data(), outside.size()),
+          0, &path) ||
+      search.FindPathToAny(emap, {7, 0}, pp::Span<const std::pair<int, int>>(),
+                           0, &path)) {
+    std::cout << "A search took a goal outside the map" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_cost_policies() {
+  // A hill in the middle of a flat map
+  std::vector<pp::Elevation> cells(15 * 15, 100);
+  for (int row = 4; row < 11; row++) {
+    for (int col = 4; col < 11; col++) {
+      cells[size_t(row * 15 + col)] = 130;
+    }
+  }
+  pp::ElevationMap emap;
+  if (!emap.Assign(15, 15, cells)) {
+    return false;
+  }
+  pp::SearchOptions options;
+  pp::GridSearch terrain(options);
+  options.cost_policy = pp::CostPolicy::kDistance;
+  pp::GridSearch distance(options);
+  std::vector<std::pair<int, int>> path;
+  // Climbing the hill costs more than going around it, unless only the
+  // distance counts
+  if (!terrain.FindPath(emap, {7, 0}, {7, 14}, 0, &path) ||
+      terrain.stats().path_cost != 22 ||
+      !distance.FindPath(emap, {7, 0}, {7, 14}, 0, &path) ||
+      distance.stats().path_cost != 14) {
+    std::cout << "Cost policies gave costs " << terrain.stats().path_cost
+              << " and " << distance.stats().path_cost << std::endl;
+    return false;
+  }
+  // The ceiling still applies to distance-only searches
+  options.cost.max_altitude = 120;
+  distance.SetOptions(options);
+  if (!distance.FindPath(emap, {7, 0}, {7, 14}, 0, &path) ||
+      distance.stats().path_cost != 22) {
+    std::cout << "Distance policy crossed the hill above the ceiling"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool search_terrain_grids() {
+  // The same terrain as a map and as grids of each cell type
+  const int rows = 30;
+  const int cols = 40;
+  std::vector<pp::Elevation> cells(size_t(rows * cols));
+  std::vector<int16_t> cells16(cells.size());
+  std::vector<int32_t> cells32(cells.size());
+  std::vector<float> cells_float(cells.size());
+  for (size_t i = 0; i < cells.size(); i++) {
+    const int value = 100 + int((i * 7919) % 61) + int(i % 40 / 10) * 20;
+    cells[i] = pp::Elevation(value);
+    cells16[i] = int16_t(value);
+    cells32[i] = value;
+    cells_float[i] = float(value);
+  }
+  pp::ElevationMap emap;
+  if (!emap.Assign(rows, cols, cells)) {
+    return false;
+  }
+  for (auto connectivity : {pp::Connectivity::kFour, pp::Connectivity::kEight,
+                            pp::Connectivity::kSixteen}) {
+    pp::SearchOptions options;
+    options.connectivity = connectivity;
+    pp::GridSearch search(options);
+    std::vector<std::pair<int, int>> expected;
+    std::vector<std::pair<int, int>> path;
+    if (!search.FindPath(emap, {2, 1}, {27, 38}, 0, &expected)) {
+      return false;
+    }
+    const double cost = search.stats().path_cost;
+    if (!search.FindPath(pp::TerrainGrid<int16_t>{cells16.data(), rows, cols},
+                         {2, 1}, {27, 38}, 0, &path) ||
+        path != expected || search.stats().path_cost != cost ||
+        !search.FindPath(pp::TerrainGrid<int32_t>{cells32.data(), rows, cols},
+                         {2, 1}, {27, 38}, 0, &path) ||
+        path != expected ||
+        !search.FindPath(pp::TerrainGrid<float>{cells_float.data(), rows,
+                                                cols},
+                         {2, 1}, {27, 38}, 0, &path) ||
+        path != expected) {
+      std::cout << int(connectivity)
+                << "-connected grid search differs from the map"
+                << std::endl;
+      return false;
+    }
+  }
+  // Fractional elevations are costed exactly
+  const std::vector<float> slope = {0.0f, 0.25f, 0.5f, 0.75f};
+  pp::GridSearch search;
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(pp::TerrainGrid<float>{slope.data(), 1, 4}, {0, 0},
+                       {0, 3}, 0, &path) ||
+      search.stats().path_cost != 3.75) {
+    std::cout << "Float grid was costed " << search.stats().path_cost
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!search_around_ridge()) {
+    return -1;
+  }
+  if (!search_eight_connected()) {
+    return -1;
+  }
+  if (!search_altitude_ceiling()) {
+    return -1;
+  }
+  if (!search_diagonal_corners()) {
+    return -1;
+  }
+  if (!search_reuses_scratch()) {
+    return -1;
+  }
+  if (!search_window()) {
+    return -1;
+  }
+  if (!search_tiled_map()) {
+    return -1;
+  }
+  if (!search_sixteen_connected()) {
+    return -1;
+  }
+  if (!search_knight_walls()) {
+    return -1;
+  }
+  if (!search_many_goals()) {
+    return -1;
+  }
+  if (!search_cost_policies()) {
+    return -1;
+  }
+  if (!search_terrain_grids()) {
+    return -1;
+  }
+  std::cout << "All grid search tests passed!" << std::endl;
+  return 0;
+}
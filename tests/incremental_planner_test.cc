@@ -0,0 +1,240 @@
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "incremental_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Build the text of a rolling test map with the start and goal at
+/// the given cells
+std::string TestMapText(int rows, int cols, std::pair<int, int> start,
+                        std::pair<int, int> goal) {
+  std::string text = "[";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < cols; col++) {
+      if (col > 0) {
+        text += ',';
+      }
+      if (std::make_pair(row, col) == start) {
+        text += "(A)";
+      } else if (std::make_pair(row, col) == goal) {
+        text += "(B)";
+      } else {
+        uint32_t noise = uint32_t(row) * 2654435761u ^ uint32_t(col) * 40503u;
+        noise ^= noise >> 13;
+        text += std::to_string(
+            300 + int(100.0 * std::sin(row / 7.0) * std::cos(col / 9.0)) +
+            int(noise % 17));
+      }
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+/// @brief Check an incremental plan against a search from scratch on the
+/// same map
+bool MatchesFullSearch(const pp::IncrementalPlanner& planner,
+                       const std::vector<std::pair<int, int>>& path,
+                       std::pair<int, int> start, std::pair<int, int> goal,
+                       int agl) {
+  pp::GridSearch search(planner.options());
+  std::vector<std::pair<int, int>> full_path;
+  const bool found =
+      search.FindPath(planner.map(), start, goal, agl, &full_path);
+  if (found != !path.empty()) {
+    std::cout << "Replan found a path: " << !path.empty()
+              << ", the full search: " << found << std::endl;
+    return false;
+  }
+  if (!found) {
+    return true;
+  }
+  // Equal cost paths can be summed in a different order
+  const double cost = planner.stats().path_cost;
+  const double expected = search.stats().path_cost;
+  if (std::abs(cost - expected) > 1e-4 * expected || path.front() != start ||
+      path.back() != goal) {
+    std::cout << "Replan cost " << cost << ", the full search " << expected
+              << std::endl;
+    return false;
+  }
+  // Every step is to a neighbor, at most a knight's move away
+  for (size_t i = 1; i < path.size(); i++) {
+    const int row_step = std::abs(path[i].first - path[i - 1].first);
+    const int col_step = std::abs(path[i].second - path[i - 1].second);
+    const int longer = std::max(row_step, col_step);
+    if (longer == 0 || longer > 2 ||
+        (longer == 2 && std::min(row_step, col_step) != 1)) {
+      std::cout << "Replanned path has a gap" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool replan_local_edits() {
+  const std::pair<int, int> start(4, 3);
+  const std::pair<int, int> goal(90, 110);
+  const std::string text = TestMapText(100, 120, start, goal);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+
+  for (auto connectivity : {pp::Connectivity::kFour,
+                            pp::Connectivity::kEight,
+                            pp::Connectivity::kSixteen}) {
+    pp::SearchOptions options;
+    options.connectivity = connectivity;
+    options.cost.max_altitude = 1000;
+    pp::IncrementalPlanner planner(options);
+    planner.SetMap(emap);
+    std::vector<std::pair<int, int>> path;
+    if (!planner.Plan(start, goal, 20, &path) ||
+        !MatchesFullSearch(planner, path, start, goal, 20)) {
+      return false;
+    }
+    const size_t full_expanded = planner.stats().nodes_expanded;
+
+    // Raise an impassable block across the current path, then lower part of
+    // it again, then dig a cheap trench
+    const std::pair<int, int> middle = path[path.size() / 2];
+    for (int row = middle.first - 3; row <= middle.first + 3; row++) {
+      for (int col = middle.second - 3; col <= middle.second + 3; col++) {
+        planner.map()(row, col) = 2000;
+      }
+    }
+    if (!planner.Replan(&path) ||
+        !MatchesFullSearch(planner, path, start, goal, 20) ||
+        planner.changed_cells() != 49) {
+      return false;
+    }
+    if (std::find(path.begin(), path.end(), middle) != path.end()) {
+      std::cout << "Replanned path crosses the new obstacle" << std::endl;
+      return false;
+    }
+    for (int col = middle.second - 3; col <= middle.second + 3; col++) {
+      planner.map()(middle.first, col) = 250;
+    }
+    if (!planner.Replan(&path) ||
+        !MatchesFullSearch(planner, path, start, goal, 20)) {
+      return false;
+    }
+    for (int row = 20; row < 80; row++) {
+      planner.map()(row, 60) = 100;
+    }
+    if (!planner.Replan(&path) ||
+        !MatchesFullSearch(planner, path, start, goal, 20)) {
+      return false;
+    }
+
+    // An edit far from the path leaves the plan nearly untouched
+    planner.map()(99, 0) = 900;
+    if (!planner.Replan(&path) ||
+        !MatchesFullSearch(planner, path, start, goal, 20) ||
+        planner.stats().nodes_expanded * 20 > full_expanded) {
+      std::cout << "Remote edit expanded " << planner.stats().nodes_expanded
+                << " of " << full_expanded << " nodes" << std::endl;
+      return false;
+    }
+    // Nothing changed, nothing to expand
+    if (!planner.Replan(&path) || planner.stats().nodes_expanded != 0 ||
+        planner.changed_cells() != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool replan_blocked_goal() {
+  const std::pair<int, int> start(2, 2);
+  const std::pair<int, int> goal(20, 25);
+  const std::string text = TestMapText(30, 30, start, goal);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  options.cost.max_altitude = 1000;
+  pp::IncrementalPlanner planner(options);
+  planner.SetMap(emap);
+  std::vector<std::pair<int, int>> path;
+  if (planner.Replan(&path) || !planner.Plan(start, goal, 0, &path)) {
+    std::cout << "Replan ran before Plan" << std::endl;
+    return false;
+  }
+
+  // Wall the goal in, then open a gap
+  for (int row = 17; row <= 23; row++) {
+    for (int col = 22; col <= 28; col++) {
+      if (row == 17 || row == 23 || col == 22 || col == 28) {
+        planner.map()(row, col) = 5000;
+      }
+    }
+  }
+  if (planner.Replan(&path) ||
+      !MatchesFullSearch(planner, path, start, goal, 0)) {
+    std::cout << "Planned into a walled in goal" << std::endl;
+    return false;
+  }
+  planner.map()(23, 25) = 300;
+  if (!planner.Replan(&path) ||
+      !MatchesFullSearch(planner, path, start, goal, 0) ||
+      std::find(path.begin(), path.end(), std::make_pair(23, 25)) ==
+          path.end()) {
+    std::cout << "Replan did not use the gap" << std::endl;
+    return false;
+  }
+
+  // The start marker takes its terrain from its neighbors, so raising them
+  // changes the cost of leaving it
+  for (int k = 0; k < 4; k++) {
+    const int rows[4] = {1, 3, 2, 2};
+    const int cols[4] = {2, 2, 1, 3};
+    planner.map()(rows[k], cols[k]) = 800;
+  }
+  if (!planner.Replan(&path) ||
+      !MatchesFullSearch(planner, path, start, goal, 0)) {
+    return false;
+  }
+
+  // New options or a raw write can not be repaired, so the planner starts
+  // over
+  options.cost.climb_weight = 3.0;
+  planner.SetOptions(options);
+  if (!planner.Replan(&path) || planner.changed_cells() != emap.size() ||
+      !MatchesFullSearch(planner, path, start, goal, 0)) {
+    return false;
+  }
+  planner.map().data()[0] = 700;
+  if (!planner.Replan(&path) || planner.changed_cells() != emap.size()) {
+    return false;
+  }
+  planner.map()(5, 5) = 700;
+  return planner.Replan(&path) && planner.changed_cells() == 1 &&
+         MatchesFullSearch(planner, path, start, goal, 0);
+}
+
+int main(int argc, char** argv) {
+  if (!replan_local_edits()) {
+    return -1;
+  }
+  if (!replan_blocked_goal()) {
+    return -1;
+  }
+  std::cout << "All incremental planner tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include "elevation_map.h"
+#include "instrumentation.h"
+#include "path_planner.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// A ridge separates the start and goal, with a gap on the far right
+const std::string kRidgeMap =
+    "[[(A),100,100,100,100],"
+    " [900,900,900,900,100],"
+    " [(B),100,100,100,100]]";
+
+/// @brief Plan across the ridge map and run every filter once
+bool PlanAndFilter(pp::PathPlanner* planner) {
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  if (!planner->PlanPath(&profile, &agl_profile, 50)) {
+    return false;
+  }
+  std::vector<int> filtered = planner->MedianFilter(agl_profile, 3);
+  filtered = planner->MeanFilter(filtered, 3);
+  filtered = planner->LowpassFilter(filtered, 0.5);
+  planner->CorrectPath(profile, filtered, 20);
+  return true;
+}
+
+}  // namespace
+
+bool histogram_sink() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::HistogramSink sink;
+  pp::SetMetricsSink(&sink);
+  bool planned = PlanAndFilter(&planner) && PlanAndFilter(&planner);
+  pp::SetMetricsSink(nullptr);
+  if (!planned) {
+    return false;
+  }
+
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  for (pp::Stage stage :
+       {pp::Stage::kPlanPath, pp::Stage::kBasePath, pp::Stage::kSearch,
+        pp::Stage::kAglOffset, pp::Stage::kMedianFilter,
+        pp::Stage::kMeanFilter, pp::Stage::kLowpassFilter,
+        pp::Stage::kCorrectPath}) {
+    if (sink.count(stage) != 2 ||
+        sink.Percentile(stage, 50) > sink.max_ns(stage)) {
+      std::cout << "Stage " << pp::StageName(stage) << " was recorded "
+                << sink.count(stage) << " times" << std::endl;
+      return false;
+    }
+  }
+  if (sink.counter(pp::Counter::kNodesExpanded) !=
+          2 * int64_t(planner.search_stats().nodes_expanded) ||
+      sink.counter(pp::Counter::kCellsVisited) !=
+          2 * int64_t(planner.search_stats().cells_visited) ||
+      sink.counter(pp::Counter::kPathCells) != 22) {
+    std::cout << "Search counters do not match the search stats"
+              << std::endl;
+    return false;
+  }
+  // The first plan grows the outputs and the search nodes, the second reuses
+  // the search but returns new vectors from PlanAndFilter
+  if (sink.counter(pp::Counter::kAllocations) < 2) {
+    std::cout << "Buffer growth was not counted" << std::endl;
+    return false;
+  }
+
+  std::ostringstream json;
+  sink.WriteJson(json);
+  if (json.str().find("\"search\": {\"count\": 2") == std::string::npos ||
+      json.str().find("\"nodes_expanded\": ") == std::string::npos) {
+    std::cout << "Unexpected JSON dump:" << std::endl << json.str();
+    return false;
+  }
+#else
+  // Compiled out, nothing reaches the sink
+  if (sink.count(pp::Stage::kPlanPath) != 0 ||
+      sink.counter(pp::Counter::kNodesExpanded) != 0) {
+    return false;
+  }
+#endif
+
+  // Nothing is recorded once the sink is removed
+  sink.Reset();
+  PlanAndFilter(&planner);
+  return sink.count(pp::Stage::kPlanPath) == 0;
+}
+
+bool callback_sink() {
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(kRidgeMap.data(), kRidgeMap.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  std::vector<pp::Stage> stages;
+  int64_t failed = 0;
+  pp::CallbackSink sink(
+      [&stages](pp::Stage stage, int64_t) { stages.push_back(stage); },
+      [&failed](pp::Counter counter, int64_t value) {
+        if (counter == pp::Counter::kFailedPlans) {
+          failed += value;
+        }
+      });
+  pp::SetMetricsSink(&sink);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  planner.PlanPath(&profile, &agl_profile);
+  // Without a map there is nothing to plan
+  pp::PathPlanner empty_planner;
+  empty_planner.PlanPath(&profile, &agl_profile);
+  pp::SetMetricsSink(nullptr);
+
+#ifdef DRONE_PATH_PLANNING_INSTRUMENTATION
+  // Scopes close innermost first
+  if (stages.size() < 4 || stages[0] != pp::Stage::kSearch ||
+      stages[1] != pp::Stage::kBasePath ||
+      stages[2] != pp::Stage::kAglOffset ||
+      stages[3] != pp::Stage::kPlanPath) {
+    std::cout << "Unexpected stage order" << std::endl;
+    return false;
+  }
+  if (failed != 1) {
+    std::cout << "The failed plan was not counted" << std::endl;
+    return false;
+  }
+#else
+  if (!stages.empty() || failed != 0) {
+    return false;
+  }
+#endif
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!histogram_sink()) {
+    return -1;
+  }
+  if (!callback_sink()) {
+    return -1;
+  }
+  std::cout << "All instrumentation tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,321 @@
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "line_of_sight.h"
+#include "path_planner.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Check if the segment between the centers of two cells touches a
+/// cell, in doubled coordinates so every corner is on the integer grid
+bool SegmentTouchesCell(const std::pair<int, int>& from,
+                        const std::pair<int, int>& to, int row, int col) {
+  const int64_t r0 = 2 * from.first, c0 = 2 * from.second;
+  const int64_t r1 = 2 * to.first, c1 = 2 * to.second;
+  if (std::min(r0, r1) > 2 * row + 1 || std::max(r0, r1) < 2 * row - 1 ||
+      std::min(c0, c1) > 2 * col + 1 || std::max(c0, c1) < 2 * col - 1) {
+    return false;
+  }
+  // The segment misses the cell if every corner is strictly on one side
+  int above = 0;
+  int below = 0;
+  for (int64_t r : {2 * row - 1, 2 * row + 1}) {
+    for (int64_t c : {2 * col - 1, 2 * col + 1}) {
+      const int64_t cross = (r1 - r0) * (c - c0) - (c1 - c0) * (r - r0);
+      above += cross > 0;
+      below += cross < 0;
+    }
+  }
+  return above < 4 && below < 4;
+}
+
+/// @brief Build the text of a map from its cells and markers
+std::string MapText(int rows, int cols, const std::vector<int>& cells,
+                    const std::pair<int, int>& start,
+                    const std::pair<int, int>& goal) {
+  std::string text = "[";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < cols; col++) {
+      text += col == 0 ? "" : ",";
+      if (std::make_pair(row, col) == start) {
+        text += "(A)";
+      } else if (std::make_pair(row, col) == goal) {
+        text += "(B)";
+      } else {
+        text += std::to_string(cells[size_t(row * cols + col)]);
+      }
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+}  // namespace
+
+bool traversal_matches_geometry() {
+  // One raised cell at a time, so the max shows whether it was visited
+  const int rows = 9;
+  const int cols = 11;
+  for (int spike = 0; spike < rows * cols; spike++) {
+    std::vector<pp::Elevation> cells(size_t(rows * cols), 0);
+    cells[size_t(spike)] = 1;
+    pp::ElevationMap emap;
+    emap.Assign(rows, cols, cells);
+    for (int from = 0; from < rows * cols; from++) {
+      for (int to = 0; to < rows * cols; to++) {
+        const std::pair<int, int> a(from / cols, from % cols);
+        const std::pair<int, int> b(to / cols, to % cols);
+        const bool touches =
+            SegmentTouchesCell(a, b, spike / cols, spike % cols);
+        if ((pp::MaxElevationAlong(emap, a, b) == 1) != touches ||
+            pp::LineOfSight(emap, a, b, 0) == touches) {
+          std::cout << "Segment from " << a.first << ", " << a.second
+                    << " to " << b.first << ", " << b.second
+                    << (touches ? " missed " : " wrongly visited ")
+                    << spike / cols << ", " << spike % cols << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  // A tiled map is read cell by cell and gives the same answers
+  const int size = 23;
+  std::vector<int> noise(size_t(size * size));
+  uint32_t seed = 3;
+  for (int& cell : noise) {
+    seed = seed * 1664525u + 1013904223u;
+    cell = int((seed >> 12) % 1000);
+  }
+  const std::string text = MapText(size, size, noise, {-1, -1}, {-1, -1});
+  pp::ElevationMap emap;
+  const std::string filename = "line_of_sight_test_tiled.emap";
+  if (!emap.ParseMap(text.data(), text.size()) ||
+      !emap.WriteBinaryMap(filename, 5)) {
+    return false;
+  }
+  pp::ElevationMap tiled;
+  const bool opened = tiled.OpenBinaryMap(filename);
+  std::remove(filename.c_str());
+  if (!opened || !tiled.is_tiled()) {
+    std::cout << "Unable to open the tiled map" << std::endl;
+    return false;
+  }
+  for (int from = 0; from < size * size; from += 7) {
+    for (int to = 0; to < size * size; to++) {
+      const std::pair<int, int> a(from / size, from % size);
+      const std::pair<int, int> b(to / size, to % size);
+      if (pp::MaxElevationAlong(tiled, a, b) !=
+          pp::MaxElevationAlong(emap, a, b)) {
+        std::cout << "Tiled map traversal does not match" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool smoothing_pulls_taut() {
+  // A path along the top and right edges of a hill is only cut across it
+  // when allowed to rise
+  const int size = 12;
+  std::vector<pp::Elevation> cells(size_t(size * size), 300);
+  for (int i = 0; i < size; i++) {
+    cells[size_t(i)] = 100;
+    cells[size_t(i * size + size - 1)] = 100;
+  }
+  pp::ElevationMap emap;
+  emap.Assign(size, size, cells);
+  std::vector<std::pair<int, int>> around;
+  for (int col = 0; col < size; col++) {
+    around.emplace_back(0, col);
+  }
+  for (int row = 1; row < size; row++) {
+    around.emplace_back(row, size - 1);
+  }
+  std::vector<std::pair<int, int>> path = around;
+  pp::SmoothPath(emap, INT64_MAX, 0, &path);
+  const std::vector<std::pair<int, int>> corner = {
+      {0, 0}, {0, size - 1}, {size - 1, size - 1}};
+  if (path != corner) {
+    std::cout << "Path around the hill was not pulled to its corner"
+              << std::endl;
+    return false;
+  }
+  path = around;
+  pp::SmoothPath(emap, INT64_MAX, 200, &path);
+  if (path.size() != 2 || path.back() != around.back()) {
+    std::cout << "Path was not cut across the hill" << std::endl;
+    return false;
+  }
+  // The ceiling holds however far a shortcut may rise
+  path = around;
+  pp::SmoothPath(emap, 299, 1000, &path);
+  if (path != corner) {
+    std::cout << "Shortcut passed above the ceiling" << std::endl;
+    return false;
+  }
+  std::vector<int> profile;
+  pp::SegmentProfile(emap, corner, &profile);
+  if (profile != std::vector<int>{100, 100, 100}) {
+    return false;
+  }
+  pp::SegmentProfile(emap, {{0, 0}, {size - 1, size - 1}}, &profile);
+  return profile == std::vector<int>{300, 300};
+}
+
+bool planner_smooths_paths() {
+  // A wall with a gap at the bottom, too high to fly over
+  const int size = 30;
+  std::vector<int> cells(size_t(size * size), 100);
+  for (int row = 0; row < 25; row++) {
+    cells[size_t(row * size + 15)] = 900;
+  }
+  const std::pair<int, int> start(2, 3);
+  const std::pair<int, int> goal(4, 27);
+  const std::string text = MapText(size, size, cells, start, goal);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  // Diagonal steps past the end of the wall would touch it, so search
+  // 4-connected paths for the smoother to pull taut
+  pp::SearchOptions options;
+  options.cost.max_altitude = 500;
+  planner.SetSearchOptions(options);
+  std::vector<int> elevation_profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> cell_path;
+  if (!planner.PlanPath(&elevation_profile, &agl_profile, 0, &cell_path)) {
+    return false;
+  }
+  pp::SmoothingOptions smoothing;
+  smoothing.enabled = true;
+  planner.SetSmoothingOptions(smoothing);
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&elevation_profile, &agl_profile, 10, &path) ||
+      path.front() != start || path.back() != goal || path.size() > 4 ||
+      path.size() >= cell_path.size() ||
+      elevation_profile.size() != path.size() ||
+      agl_profile.size() != path.size()) {
+    std::cout << "Planned path was not smoothed" << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i + 1 < path.size(); i++) {
+    if (pp::MaxElevationAlong(emap, path[i], path[i + 1]) > 490 ||
+        elevation_profile[i] != 100 || agl_profile[i] != 110) {
+      std::cout << "Smoothed path crosses the wall" << std::endl;
+      return false;
+    }
+  }
+
+  // Streaming plans at ground level and gives the same corners and
+  // elevations
+  if (!planner.PlanPath(&elevation_profile, &agl_profile, 0, &path)) {
+    return false;
+  }
+  std::vector<pp::ProfileSample> samples;
+  if (!planner.StreamPath(nullptr, [&](const pp::ProfileSample* chunk,
+                                       size_t count) {
+        samples.insert(samples.end(), chunk, chunk + count);
+        return true;
+      }, 2) || samples.size() != path.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (std::make_pair(samples[i].row, samples[i].col) != path[i] ||
+        samples[i].elevation != elevation_profile[i]) {
+      std::cout << "Streamed path does not match the planned one"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // A straight line over open ground is a single segment
+  options.algorithm = pp::SearchAlgorithm::kStraightLine;
+  options.cost.max_altitude = 1000;
+  planner.SetSearchOptions(options);
+  if (!planner.PlanPath(&elevation_profile, &agl_profile, 0, &path) ||
+      path.size() != 2 || elevation_profile != std::vector<int>{900, 900}) {
+    std::cout << "Straight line path was not smoothed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool knight_steps_raise_profile() {
+  // A ridge below the ceiling that a knight's step crosses without landing
+  // on it
+  std::vector<int> cells(15, 0);
+  for (int row = 0; row < 3; row++) {
+    cells[size_t(row * 5 + 2)] = 50;
+  }
+  const std::pair<int, int> start(0, 1);
+  const std::pair<int, int> goal(1, 3);
+  const std::string text = MapText(3, 5, cells, start, goal);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  std::vector<int> profile;
+  pp::StepProfile(emap, {{2, 0}, {2, 1}, {1, 3}}, &profile);
+  if (profile != std::vector<int>{0, 50, 50}) {
+    std::cout << "Step profile missed the cells a knight's step crosses"
+              << std::endl;
+    return false;
+  }
+
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kSixteen;
+  options.cost.max_altitude = 100;
+  planner.SetSearchOptions(options);
+  std::vector<int> elevation_profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&elevation_profile, &agl_profile, 10, &path) ||
+      path != std::vector<std::pair<int, int>>{start, goal} ||
+      elevation_profile != std::vector<int>{50, 50} ||
+      agl_profile != std::vector<int>{60, 60}) {
+    std::cout << "Planned profile dips below a knight's step" << std::endl;
+    return false;
+  }
+  std::vector<pp::ProfileSample> samples;
+  if (!planner.StreamPath(nullptr, [&](const pp::ProfileSample* chunk,
+                                       size_t count) {
+        samples.insert(samples.end(), chunk, chunk + count);
+        return true;
+      }) || samples.size() != 2 || samples[0].elevation != 50 ||
+      samples[1].elevation != 50) {
+    std::cout << "Streamed profile dips below a knight's step" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!traversal_matches_geometry()) {
+    return -1;
+  }
+  if (!smoothing_pulls_taut()) {
+    return -1;
+  }
+  if (!planner_smooths_paths()) {
+    return -1;
+  }
+  if (!knight_steps_raise_profile()) {
+    return -1;
+  }
+  std::cout << "All line of sight tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,210 @@
+#include "elevation_map.h"
+#include "map_ingest.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Read a whole file into a string
+std::string ReadText(const std::string& filename) {
+  std::ifstream in_file(filename, std::ios::binary);
+  std::stringstream text;
+  text << in_file.rdbuf();
+  return text.str();
+}
+
+/// @brief Build the text of a map with markers spread over its rows, in
+/// the given row and line separator styles
+std::string TestMapText(int rows, int cols, const std::string& separator,
+                        bool outer_list) {
+  std::string text = outer_list ? "[" : "";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : separator + "[";
+    for (int col = 0; col < cols; col++) {
+      if (col > 0) {
+        text += col % 3 == 0 ? ", " : ",";
+      }
+      if ((row * cols + col) % 97 == 5) {
+        text += "(A)";
+      } else if ((row * cols + col) % 131 == 7) {
+        text += "(B)";
+      } else {
+        text += std::to_string((row * 7919 + col * 104729) % 2000 - 300);
+      }
+    }
+    text += ']';
+    if (row % 5 == 2) {
+      // Empty rows are skipped
+      text += separator + "[ ]";
+    }
+  }
+  return text + (outer_list ? "]\n\n" : "\n");
+}
+
+/// @brief Check two maps have the same cells and locations
+bool SameMap(const pp::ElevationMap& a, const pp::ElevationMap& b) {
+  if (a.rows() != b.rows() || a.cols() != b.cols()) {
+    return false;
+  }
+  for (const pp::Marker& marker : pp::kMarkers) {
+    const auto a_locations = a.GetLocations(marker.symbol);
+    const auto b_locations = b.GetLocations(marker.symbol);
+    if (a_locations.size() != b_locations.size() ||
+        !std::equal(a_locations.begin(), a_locations.end(),
+                    b_locations.begin())) {
+      return false;
+    }
+  }
+  for (int row = 0; row < a.rows(); row++) {
+    for (int col = 0; col < a.cols(); col++) {
+      if (a(row, col) != b(row, col)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool sharded_matches_serial() {
+  std::vector<std::string> texts = {
+      ReadText("example_data/test_map.txt"),
+      TestMapText(60, 45, ",\n", true),
+      TestMapText(33, 20, "\r\n", false),
+      TestMapText(40, 7, ",", true),
+      "[[1,(A),3]]",
+      // A run the parser splits in two, which the shards fall back on
+      "[[1,2-3],[4,5,6]]"};
+  pp::ThreadPool two(2);
+  pp::ThreadPool three(3);
+  for (size_t t = 0; t < texts.size(); t++) {
+    const std::string& text = texts[t];
+    pp::ElevationMap serial;
+    if (!serial.ParseMap(text.data(), text.size())) {
+      std::cout << "Test map " << t << " does not parse" << std::endl;
+      return false;
+    }
+    for (pp::ThreadPool* pool : {&two, &three}) {
+      for (size_t shard_bytes : {size_t(1), size_t(7), size_t(64),
+                                 size_t(1000), pp::kMinShardBytes}) {
+        pp::ElevationMap sharded;
+        if (!pp::ParseMapSharded(text.data(), text.size(), pool, &sharded,
+                                 nullptr, shard_bytes) ||
+            !SameMap(serial, sharded)) {
+          std::cout << "Sharded parse of map " << t << " in shards of "
+                    << shard_bytes << " bytes on " << pool->size()
+                    << " threads does not match" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+bool sharded_errors_match() {
+  const std::vector<std::string> texts = {
+      "[[1,2,3],\n[4,x,6]]",
+      "[[1,2,3],\n[4,5]]",
+      "[[1,2,3],\n[4,5,6],\n[7,8,9,10]]",
+      "[[1,(Q),3],[4,5,6]]",
+      "[[1,2,3],[4,5,6]",
+      "[[1,2,3],[4,5,6]]]",
+      "[[1,2,3],[4,5,6]],7",
+      "[[1,2,3],[4,5,6],[7,8",
+      "[[1,2,3],[4,5,-],[7,8,9]]",
+      "[[],[]]"};
+  pp::ThreadPool pool(3);
+  for (const std::string& text : texts) {
+    pp::ElevationMap serial;
+    pp::MapReadError expected;
+    serial.ParseMap(text.data(), text.size(), &expected);
+    for (size_t shard_bytes : {size_t(1), size_t(5)}) {
+      pp::ElevationMap sharded;
+      pp::MapReadError error;
+      if (pp::ParseMapSharded(text.data(), text.size(), &pool, &sharded,
+                              &error, shard_bytes) ||
+          error.offset != expected.offset ||
+          error.message != expected.message || sharded.rows() != 0) {
+        std::cout << "Sharded parse of " << text << " reported \""
+                  << error.message << "\" at " << error.offset
+                  << ", expected \"" << expected.message << "\" at "
+                  << expected.offset << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool convert_maps() {
+  const std::string generated = "map_ingest_test_generated.txt";
+  {
+    std::ofstream out_file(generated, std::ios::binary);
+    out_file << TestMapText(50, 70, ",\n", true);
+  }
+  std::vector<pp::IngestJob> jobs(3);
+  jobs[0].input = "example_data/test_map.txt";
+  jobs[0].output = "map_ingest_test_0.emap";
+  jobs[1].input = "example_data/does_not_exist.txt";
+  jobs[1].output = "map_ingest_test_1.emap";
+  jobs[2].input = generated;
+  jobs[2].output = "map_ingest_test_2.emap";
+  jobs[2].tile_size = 16;
+
+  pp::MapIngester ingester(2);
+  std::vector<pp::IngestResult> results;
+  if (ingester.ConvertAll(jobs, &results) || results.size() != 3 ||
+      !results[0].success || results[1].success || !results[2].success ||
+      results[1].error.message.empty() || ingester.stats().files != 2) {
+    std::cout << "Batch conversion did not report each map" << std::endl;
+    return false;
+  }
+  for (size_t i : {size_t(0), size_t(2)}) {
+    pp::ElevationMap text_map;
+    pp::ElevationMap binary_map;
+    if (!text_map.ReadMap(jobs[i].input) ||
+        !binary_map.OpenBinaryMap(jobs[i].output) ||
+        binary_map.is_tiled() != (jobs[i].tile_size > 0) ||
+        !SameMap(text_map, binary_map)) {
+      std::cout << "Converted map " << i << " does not match its text"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // A single map through the same pool
+  pp::ElevationMap emap;
+  if (!ingester.ReadMap(generated, &emap) ||
+      !ingester.Convert(jobs[0]) || ingester.stats().files != 4) {
+    return false;
+  }
+  std::remove(generated.c_str());
+  std::remove(jobs[0].output.c_str());
+  std::remove(jobs[2].output.c_str());
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!sharded_matches_serial()) {
+    return -1;
+  }
+  if (!sharded_errors_match()) {
+    return -1;
+  }
+  if (!convert_maps()) {
+    return -1;
+  }
+  std::cout << "All map ingest tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,389 @@
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "map_pyramid.h"
+#include "path_planner.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Get the elevation of rolling test terrain with some noise
+int TestElevation(int row, int col) {
+  uint32_t noise = uint32_t(row) * 2654435761u ^ uint32_t(col) * 40503u;
+  noise ^= noise >> 13;
+  return 400 + int(150.0 * std::sin(row / 11.0) * std::cos(col / 17.0)) +
+         int(noise % 23);
+}
+
+/// @brief Build the text of a test map with the start and goal at the
+/// given cells
+std::string TestMapText(int rows, int cols, std::pair<int, int> start,
+                        std::pair<int, int> goal) {
+  std::string text = "[";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < cols; col++) {
+      if (col > 0) {
+        text += ',';
+      }
+      if (std::make_pair(row, col) == start) {
+        text += "(A)";
+      } else if (std::make_pair(row, col) == goal) {
+        text += "(B)";
+      } else {
+        text += std::to_string(TestElevation(row, col));
+      }
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+/// @brief Check every level of a pyramid against the map cells it covers
+bool MatchesMap(const pp::MapPyramid& pyramid, const pp::ElevationMap& emap) {
+  for (int l = 1; l <= pyramid.num_levels(); l++) {
+    const pp::PyramidLevel& level = pyramid.level(l);
+    for (int row = 0; row < level.max.rows(); row++) {
+      for (int col = 0; col < level.max.cols(); col++) {
+        int highest = std::numeric_limits<int>::min();
+        int lowest = std::numeric_limits<int>::max();
+        double sum = 0.0;
+        int count = 0;
+        for (int r = row * level.scale;
+             r < std::min(emap.rows(), (row + 1) * level.scale); r++) {
+          for (int c = col * level.scale;
+               c < std::min(emap.cols(), (col + 1) * level.scale); c++) {
+            if (pp::IsSpecialLocationValue(emap(r, c))) {
+              continue;
+            }
+            highest = std::max(highest, int(emap(r, c)));
+            lowest = std::min(lowest, int(emap(r, c)));
+            sum += emap(r, c);
+            count++;
+          }
+        }
+        // Means are rounded once per level. Above level 1 a marker counts
+        // as the mean of its level 1 block, so only bound those blocks.
+        const int area =
+            (std::min(emap.rows(), (row + 1) * level.scale) -
+             row * level.scale) *
+            (std::min(emap.cols(), (col + 1) * level.scale) -
+             col * level.scale);
+        const bool mean_ok =
+            count == area || l == 1
+                ? std::abs(level.mean(row, col) - sum / count) <= 0.5 * l
+                : level.mean(row, col) >= lowest &&
+                      level.mean(row, col) <= highest;
+        if (level.max(row, col) != highest || level.min(row, col) != lowest ||
+            !mean_ok) {
+          std::cout << "Level " << l << " cell " << row << ", " << col
+                    << " does not summarize its block" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+/// @brief Check two pyramids hold the same values
+bool SamePyramid(const pp::MapPyramid& a, const pp::MapPyramid& b) {
+  if (a.num_levels() != b.num_levels()) {
+    return false;
+  }
+  for (int l = 1; l <= a.num_levels(); l++) {
+    const pp::PyramidLevel& x = a.level(l);
+    const pp::PyramidLevel& y = b.level(l);
+    if (x.max.size() != y.max.size() ||
+        !std::equal(x.max.data(), x.max.data() + x.max.size(),
+                    y.max.data()) ||
+        !std::equal(x.min.data(), x.min.data() + x.min.size(),
+                    y.min.data()) ||
+        !std::equal(x.mean.data(), x.mean.data() + x.mean.size(),
+                    y.mean.data())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool pyramid_levels() {
+  // Odd sizes leave partial blocks on the bottom and right edges
+  const std::string text = TestMapText(75, 101, {3, 4}, {70, 99});
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+
+  pp::MapPyramid pyramid;
+  if (!pyramid.Build(emap)) {
+    return false;
+  }
+  // 101 columns halve 7 times down to one cell
+  const pp::PyramidLevel& top = pyramid.level(pyramid.num_levels());
+  if (pyramid.num_levels() != 7 || top.scale != 128 || top.max.rows() != 1 ||
+      top.max.cols() != 1 || pyramid.level(1).max.rows() != 38 ||
+      pyramid.level(1).max.cols() != 51) {
+    std::cout << "Unexpected pyramid shape" << std::endl;
+    return false;
+  }
+  if (!MatchesMap(pyramid, emap)) {
+    return false;
+  }
+
+  // Parallel bands give the same levels
+  pp::ThreadPool pool(3);
+  pp::MapPyramid parallel;
+  if (!parallel.Build(emap, 0, &pool) || !SamePyramid(pyramid, parallel)) {
+    std::cout << "Parallel build differs from the serial one" << std::endl;
+    return false;
+  }
+
+  pp::MapPyramid two_levels;
+  if (!two_levels.Build(emap, 2) || two_levels.num_levels() != 2) {
+    return false;
+  }
+  return !pyramid.Build(pp::ElevationMap());
+}
+
+bool pyramid_update() {
+  const std::string text = TestMapText(150, 130, {3, 4}, {140, 120});
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::ThreadPool pool(2);
+  pp::MapPyramid pyramid;
+  if (!pyramid.Build(emap, 0, &pool)) {
+    return false;
+  }
+  const pp::ElevationMap old_top = pyramid.level(pyramid.num_levels()).max;
+
+  // Raise a block that straddles level boundaries
+  for (int row = 37; row < 101; row++) {
+    for (int col = 61; col < 66; col++) {
+      emap(row, col) = 5000;
+    }
+  }
+  if (!pyramid.Update(emap, 37, 61, 64, 5, &pool)) {
+    return false;
+  }
+  pp::MapPyramid rebuilt;
+  if (!rebuilt.Build(emap) || !SamePyramid(pyramid, rebuilt) ||
+      !MatchesMap(pyramid, emap)) {
+    std::cout << "Update differs from a rebuild" << std::endl;
+    return false;
+  }
+  // A level copied before the update keeps the old values
+  if (old_top(0, 0) == 5000 ||
+      pyramid.level(pyramid.num_levels()).max(0, 0) != 5000) {
+    std::cout << "Update leaked into an earlier copy" << std::endl;
+    return false;
+  }
+
+  // A map of another size can not be updated into the pyramid
+  pp::ElevationMap other;
+  const std::string small = TestMapText(10, 10, {0, 0}, {9, 9});
+  return other.ParseMap(small.data(), small.size()) &&
+         !pyramid.Update(other, 0, 0, 1, 1);
+}
+
+bool corridor_search() {
+  const std::string text = TestMapText(120, 160, {5, 5}, {110, 150});
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  // A staircase path on a level with 8x8 blocks
+  std::vector<std::pair<int, int>> coarse_path = {
+      {0, 0}, {1, 0}, {1, 1}, {2, 2}, {3, 3}, {4, 4}, {5, 5},
+      {6, 6}, {7, 7}, {8, 8}, {9, 9}, {10, 10}, {11, 11}, {12, 12},
+      {13, 13}, {13, 14}, {13, 15}, {13, 16}, {13, 17}, {13, 18}};
+  pp::SearchCorridor corridor;
+  pp::CorridorAroundPath(coarse_path, 8, 1, emap.rows(), emap.cols(),
+                         &corridor);
+  if (corridor.row_begin != 0 || corridor.rows() != 120 ||
+      corridor.col_begin[0] != 0 || corridor.col_end[0] != 24 ||
+      corridor.col_begin[119] != 96 || corridor.col_end[119] != 160) {
+    std::cout << "Unexpected corridor" << std::endl;
+    return false;
+  }
+
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  pp::GridSearch search(options);
+  std::vector<std::pair<int, int>> path;
+  if (!search.FindPath(emap, {5, 5}, {110, 150}, 0, corridor, &path)) {
+    return false;
+  }
+  for (const auto& cell : path) {
+    const int span = cell.first - corridor.row_begin;
+    if (cell.second < corridor.col_begin[size_t(span)] ||
+        cell.second >= corridor.col_end[size_t(span)]) {
+      std::cout << "Path left the corridor" << std::endl;
+      return false;
+    }
+  }
+  // Never cheaper than the whole map search
+  const double corridor_cost = search.stats().path_cost;
+  std::vector<std::pair<int, int>> full_path;
+  if (!search.FindPath(emap, {5, 5}, {110, 150}, 0, &full_path) ||
+      corridor_cost < search.stats().path_cost) {
+    return false;
+  }
+  // An endpoint outside the corridor is an error
+  return !search.FindPath(emap, {5, 5}, {110, 2}, 0, corridor, &path);
+}
+
+bool hierarchical_planning() {
+  const std::pair<int, int> start(10, 12);
+  const std::pair<int, int> goal(300, 280);
+  const std::string text = TestMapText(320, 300, start, goal);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+
+  pp::PathPlanner full(emap);
+  full.SetSearchOptions(options);
+  std::vector<int> full_profile;
+  std::vector<int> agl_profile;
+  if (!full.PlanPath(&full_profile, &agl_profile, 10)) {
+    return false;
+  }
+
+  pp::PathPlanner planner(emap);
+  planner.SetSearchOptions(options);
+  pp::HierarchicalOptions hierarchical;
+  hierarchical.enabled = true;
+  hierarchical.level = 3;
+  planner.SetHierarchicalOptions(hierarchical);
+  std::vector<int> profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&profile, &agl_profile, 10, &path)) {
+    return false;
+  }
+  if (path.front() != start || path.back() != goal ||
+      profile.size() != path.size() || planner.pyramid().num_levels() == 0) {
+    std::cout << "Hierarchical plan is malformed" << std::endl;
+    return false;
+  }
+  for (size_t i = 1; i < path.size(); i++) {
+    if (std::max(std::abs(path[i].first - path[i - 1].first),
+                 std::abs(path[i].second - path[i - 1].second)) != 1) {
+      std::cout << "Hierarchical path has a gap" << std::endl;
+      return false;
+    }
+  }
+  const size_t expanded = planner.coarse_search_stats().nodes_expanded +
+                          planner.search_stats().nodes_expanded;
+  const double cost = planner.search_stats().path_cost;
+  const double optimal = full.search_stats().path_cost;
+  if (expanded >= full.search_stats().nodes_expanded || cost < optimal ||
+      cost > 1.1 * optimal) {
+    std::cout << "Hierarchical plan expanded " << expanded << " nodes for "
+              << "cost " << cost << ", the full search "
+              << full.search_stats().nodes_expanded << " for " << optimal
+              << std::endl;
+    return false;
+  }
+
+  // Batch planning takes the same coarse-to-fine route
+  std::vector<pp::PlanResult> results;
+  if (!planner.PlanPaths({{start, goal, 10}}, &results, 2) ||
+      results[0].path != path) {
+    std::cout << "Batch plan differs" << std::endl;
+    return false;
+  }
+
+  // A wall raised around the goal is seen after an incremental update
+  pp::ElevationMap walled = emap;
+  for (int row = 290; row < 310; row++) {
+    for (int col = 270; col < 290; col++) {
+      if (std::abs(row - goal.first) == 9 || std::abs(col - goal.second) == 9) {
+        walled(row, col) = 9000;
+      }
+    }
+  }
+  planner.UpdateMap(walled, 290, 270, 20, 20);
+  pp::MapPyramid rebuilt;
+  if (!rebuilt.Build(walled) || !SamePyramid(planner.pyramid(), rebuilt)) {
+    std::cout << "Planner did not update its pyramid" << std::endl;
+    return false;
+  }
+  options.cost.max_altitude = 5000;
+  planner.SetSearchOptions(options);
+  if (planner.PlanPath(&profile, &agl_profile, 10, &path)) {
+    std::cout << "Planned through the wall" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool hierarchical_fallback() {
+  // Every 2x2 block of the narrow pass holds a peak, so its max level is
+  // impassable and only the full resolution search gets through
+  const std::string text =
+      "[[(A),100,100,100,100,100,100,100],"
+      " [100,100,100,100,100,100,100,100],"
+      " [900,900,900,900,900,900,100,900],"
+      " [900,900,900,900,900,900,100,900],"
+      " [100,100,100,100,100,100,100,100],"
+      " [100,100,100,100,100,100,100,(B)]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.cost.max_altitude = 500;
+  planner.SetSearchOptions(options);
+  pp::HierarchicalOptions hierarchical;
+  hierarchical.enabled = true;
+  hierarchical.level = 1;
+  planner.SetHierarchicalOptions(hierarchical);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&profile, &agl_profile, 0, &path) ||
+      std::find(path.begin(), path.end(), std::make_pair(2, 6)) ==
+          path.end()) {
+    std::cout << "Planner did not fall back to the full resolution map"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!pyramid_levels()) {
+    return -1;
+  }
+  if (!pyramid_update()) {
+    return -1;
+  }
+  if (!corridor_search()) {
+    return -1;
+  }
+  if (!hierarchical_planning()) {
+    return -1;
+  }
+  if (!hierarchical_fallback()) {
+    return -1;
+  }
+  std::cout << "All map pyramid tests passed!" << std::endl;
+  return 0;
+}
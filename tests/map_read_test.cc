@@ -1,6 +1,27 @@
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "elevation_map.h"
+#include "tile_cache.h"
+
+namespace {
+
+/// @brief Check two maps have the same locations for a marker
+bool SameLocations(const path_planning::ElevationMap& a,
+                   const path_planning::ElevationMap& b, char marker) {
+  const auto a_locations = a.GetLocations(marker);
+  const auto b_locations = b.GetLocations(marker);
+  return a_locations.size() == b_locations.size() &&
+         std::equal(a_locations.begin(), a_locations.end(),
+                    b_locations.begin());
+}
+
+}  // namespace
 
 bool read_map() {
   path_planning::ElevationMap emap;
@@ -9,9 +30,9 @@ bool read_map() {
   }
 
   std::vector<std::vector<int>> small_map = {
-      {123, path_planning::kSpecialLocations.at('A'), 121, 120},
+      {123, path_planning::MarkerValue('A'), 121, 120},
       {122, 121, 120, 121},
-      {122, 122, path_planning::kSpecialLocations.at('B'), 120},
+      {122, 122, path_planning::MarkerValue('B'), 120},
       {124, 123, 122, 121}};
     
   for(int row = 0; row < small_map.size(); row++) {
@@ -58,6 +79,314 @@ bool map_assign() {
   return true;
 }
 
+bool contiguous_access() {
+  path_planning::ElevationMap emap;
+  if (!emap.ReadMap("example_data/small_map.txt")) {
+    return false;
+  }
+
+  if (emap.size() != size_t(emap.rows() * emap.cols())) {
+    std::cout << "Map storage is not contiguous" << std::endl;
+    return false;
+  }
+  for (int row = 0; row < emap.rows(); row++) {
+    auto row_view = emap.Row(row);
+    for (int col = 0; col < emap.cols(); col++) {
+      if (row_view[col] != emap(row, col) ||
+          emap.At(row, col) != emap(row, col) ||
+          emap.data()[emap.Index(row, col)] != emap(row, col)) {
+        std::cout << "Fast accessors disagree at " << row << ", " << col
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+
+  try {
+    emap(emap.rows(), 0);
+    std::cout << "Out of range access did not throw" << std::endl;
+    return false;
+  } catch (const std::out_of_range&) {
+  }
+  return true;
+}
+
+bool parse_errors() {
+  path_planning::ElevationMap emap;
+  path_planning::MapReadError error;
+
+  const std::string bad_token = "[[1,2,3],\n[4,x,6]]";
+  if (emap.ParseMap(bad_token.data(), bad_token.size(), &error) ||
+      error.line != 2 || error.column != 4) {
+    std::cout << "Bad token reported at " << error.line << ":"
+              << error.column << std::endl;
+    return false;
+  }
+  if (emap.rows() != 0) {
+    std::cout << "Map was not cleared after a failed parse" << std::endl;
+    return false;
+  }
+
+  const std::string ragged = "[[1,2,3],\n[4,5]]";
+  if (emap.ParseMap(ragged.data(), ragged.size(), &error) ||
+      error.line != 2 || error.column != 5) {
+    std::cout << "Inconsistent row reported at " << error.line << ":"
+              << error.column << std::endl;
+    return false;
+  }
+
+  const std::string unknown_marker = "[[1,(Q),3]]";
+  if (emap.ParseMap(unknown_marker.data(), unknown_marker.size(), &error) ||
+      error.column != 5) {
+    std::cout << "Unknown marker reported at " << error.line << ":"
+              << error.column << std::endl;
+    return false;
+  }
+
+  // Rows given one per line without an outer list parse the same
+  const std::string flat = "[-5,+7,096]\r\n[1,(A),(B)]\r\n";
+  if (!emap.ParseMap(flat.data(), flat.size(), &error) || emap.rows() != 2 ||
+      emap.cols() != 3 || emap(0, 0) != -5 || emap(0, 1) != 7 ||
+      emap(0, 2) != 96 || *emap.GetLocations('B').begin() !=
+                              std::make_pair(1, 2)) {
+    std::cout << "Unable to parse a map without an outer list" << std::endl;
+    return false;
+  }
+
+  if (emap.ReadMap("example_data/does_not_exist.txt", &error)) {
+    return false;
+  }
+  return true;
+}
+
+bool binary_round_trip() {
+  path_planning::ElevationMap text_map;
+  if (!text_map.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  const std::string binary_filename = "map_read_test_map.emap";
+  if (!text_map.WriteBinaryMap(binary_filename)) {
+    return false;
+  }
+
+  path_planning::ElevationMap binary_map;
+  if (!binary_map.OpenBinaryMap(binary_filename) || !binary_map.is_mapped()) {
+    std::cout << "Unable to open the binary map" << std::endl;
+    return false;
+  }
+  if (binary_map.rows() != text_map.rows() ||
+      binary_map.cols() != text_map.cols()) {
+    std::cout << "Binary map has the wrong dimensions" << std::endl;
+    return false;
+  }
+  for (int row = 0; row < text_map.rows(); row++) {
+    for (int col = 0; col < text_map.cols(); col++) {
+      if (binary_map(row, col) != text_map(row, col)) {
+        std::cout << "Binary map does not match at " << row << ", " << col
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  if (!SameLocations(binary_map, text_map, 'A') ||
+      !SameLocations(binary_map, text_map, 'B')) {
+    std::cout << "Binary map locations do not match" << std::endl;
+    return false;
+  }
+
+  // Writes to a mapped map stay private, both to the file and to copies
+  path_planning::ElevationMap copy = binary_map;
+  binary_map(0, 0) = -100;
+  path_planning::ElevationMap reopened;
+  if (!reopened.OpenBinaryMap(binary_filename) ||
+      reopened(0, 0) != text_map(0, 0) || copy(0, 0) != text_map(0, 0) ||
+      binary_map(0, 0) != -100) {
+    std::cout << "Writes to a mapped map leaked" << std::endl;
+    return false;
+  }
+  std::remove(binary_filename.c_str());
+
+  if (reopened.OpenBinaryMap("example_data/small_map.txt")) {
+    std::cout << "Opened a text map as a binary map" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool copy_on_write() {
+  path_planning::ElevationMap emap;
+  if (!emap.ReadMap("example_data/small_map.txt")) {
+    return false;
+  }
+
+  // Copies share the cells until one of them writes
+  path_planning::ElevationMap copy = emap;
+  const path_planning::ElevationMap& const_copy = copy;
+  if (!copy.SharesCellsWith(emap) || const_copy(1, 1) != emap(1, 1) ||
+      !copy.SharesCellsWith(emap)) {
+    std::cout << "Copy did not share the map cells" << std::endl;
+    return false;
+  }
+  copy(1, 1) = 999;
+  if (copy.SharesCellsWith(emap) || emap(1, 1) != 121 || copy(1, 1) != 999) {
+    std::cout << "Write to a copy was seen by the original" << std::endl;
+    return false;
+  }
+  if (!SameLocations(copy, emap, 'A')) {
+    std::cout << "Copy lost the special locations" << std::endl;
+    return false;
+  }
+
+  // A map that is no longer shared is written in place
+  const path_planning::Elevation* cells = copy.data();
+  copy(2, 3) = 5;
+  if (copy.data() != cells) {
+    std::cout << "Unshared map copied its cells on write" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool tiled_map() {
+  path_planning::ElevationMap text_map;
+  if (!text_map.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  // A tile size that does not divide the map exercises the padded edges
+  const std::string tiled_filename = "map_read_test_tiled.emap";
+  const int tile_size = 7;
+  if (!text_map.WriteBinaryMap(tiled_filename, tile_size)) {
+    return false;
+  }
+
+  // Budget for only four tiles so a full scan has to evict
+  const size_t tile_bytes =
+      size_t(tile_size) * size_t(tile_size) * sizeof(path_planning::Elevation);
+  // Mutable accessors like data() and At() would read the whole map into
+  // memory, so read through a const view
+  path_planning::ElevationMap tiled;
+  const path_planning::ElevationMap& view = tiled;
+  if (!tiled.OpenBinaryMap(tiled_filename, 4 * tile_bytes) ||
+      !tiled.is_tiled() || tiled.is_mapped() || view.data() != nullptr) {
+    std::cout << "Unable to open the tiled map" << std::endl;
+    return false;
+  }
+  if (tiled.rows() != text_map.rows() || tiled.cols() != text_map.cols() ||
+      !SameLocations(tiled, text_map, 'A') ||
+      !SameLocations(tiled, text_map, 'B')) {
+    std::cout << "Tiled map has the wrong dimensions or locations"
+              << std::endl;
+    return false;
+  }
+  for (int row = 0; row < text_map.rows(); row++) {
+    for (int col = 0; col < text_map.cols(); col++) {
+      if (tiled(row, col) != text_map(row, col) ||
+          view.At(row, col) != text_map.At(row, col)) {
+        std::cout << "Tiled map does not match at " << row << ", " << col
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  path_planning::TileCacheStats stats = tiled.tile_cache()->stats();
+  if (stats.misses == 0 || stats.evictions == 0 || stats.resident_tiles > 4 ||
+      stats.resident_bytes > 4 * tile_bytes) {
+    std::cout << "Tile cache did not stay inside its budget" << std::endl;
+    return false;
+  }
+
+  // Reading one tile over and over only misses once
+  tiled.tile_cache()->ResetStats();
+  for (int i = 0; i < 3; i++) {
+    view(0, 0);
+    view(tile_size * 2, 0);
+  }
+  stats = tiled.tile_cache()->stats();
+  if (stats.misses != 2 || stats.hits != 4 || stats.hit_rate() < 0.6) {
+    std::cout << "Unexpected tile cache hits " << stats.hits << " misses "
+              << stats.misses << std::endl;
+    return false;
+  }
+
+  // Copies share the cache, and writing reads the map into private memory
+  path_planning::ElevationMap copy = tiled;
+  tiled(1, 1) = 12345;
+  if (tiled.is_tiled() || !copy.is_tiled() || tiled(1, 1) != 12345 ||
+      copy(1, 1) != text_map(1, 1) || tiled(5, 9) != text_map(5, 9)) {
+    std::cout << "Writing to a tiled map did not copy it" << std::endl;
+    return false;
+  }
+
+  // A tiled map can be written back out row-major
+  const std::string flat_filename = "map_read_test_flat.emap";
+  path_planning::ElevationMap flat;
+  if (!copy.WriteBinaryMap(flat_filename) ||
+      !flat.OpenBinaryMap(flat_filename) || !flat.is_mapped() ||
+      flat(20, 30) != text_map(20, 30)) {
+    std::cout << "Unable to convert a tiled map back to row-major"
+              << std::endl;
+    return false;
+  }
+  std::remove(tiled_filename.c_str());
+  std::remove(flat_filename.c_str());
+  return true;
+}
+
+bool change_journal() {
+  path_planning::ElevationMap emap;
+  if (!emap.ReadMap("example_data/small_map.txt")) {
+    return false;
+  }
+  std::vector<std::pair<int, int>> changes;
+  // Writes are counted but not journaled until tracking is turned on
+  const uint64_t loaded = emap.version();
+  emap(0, 0) = 1;
+  if (emap.version() != loaded + 1 || emap.ChangesSince(loaded, &changes)) {
+    std::cout << "Untracked write was journaled" << std::endl;
+    return false;
+  }
+
+  emap.SetChangeTracking(true);
+  const uint64_t tracked = emap.version();
+  emap(1, 2) = 7;
+  emap(0, 1) += 3;
+  emap(1, 2) = 8;
+  // Reading through the mutable accessor is not a write
+  path_planning::Elevation value = emap(1, 1);
+  if (value != 121 || emap.version() != tracked + 3 ||
+      !emap.ChangesSince(tracked, &changes) || changes.size() != 3 ||
+      changes[0] != std::make_pair(1, 2) ||
+      changes[1] != std::make_pair(0, 1) ||
+      !emap.ChangesSince(tracked + 2, &changes) || changes.size() != 1) {
+    std::cout << "Unexpected change journal" << std::endl;
+    return false;
+  }
+
+  // Copies start without a journal, the original keeps its own
+  path_planning::ElevationMap copy = emap;
+  if (copy.change_tracking() || copy.version() != emap.version() ||
+      copy.ChangesSince(tracked, &changes) ||
+      !emap.ChangesSince(tracked, &changes)) {
+    std::cout << "Copy shares the change journal" << std::endl;
+    return false;
+  }
+
+  emap.ClearChanges();
+  if (emap.ChangesSince(tracked, &changes) ||
+      !emap.ChangesSince(emap.version(), &changes) || !changes.empty()) {
+    return false;
+  }
+  // A raw mutable view can change anything, so the journal is dropped
+  const uint64_t before_raw = emap.version();
+  emap.data()[0] = 2;
+  if (emap.version() == before_raw ||
+      emap.ChangesSince(before_raw, &changes)) {
+    std::cout << "Raw write was not counted as a change" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   if(!read_map()) {
     return -1;
@@ -68,6 +397,24 @@ int main(int argc, char** argv) {
   if(!map_assign()) {
     return -1;
   }
+  if(!contiguous_access()) {
+    return -1;
+  }
+  if(!parse_errors()) {
+    return -1;
+  }
+  if(!binary_round_trip()) {
+    return -1;
+  }
+  if(!copy_on_write()) {
+    return -1;
+  }
+  if(!tiled_map()) {
+    return -1;
+  }
+  if(!change_journal()) {
+    return -1;
+  }
   std::cout << "All map read tests passed!" << std::endl;
   return 0;
 }
\ No newline at end of file
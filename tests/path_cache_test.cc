@@ -0,0 +1,319 @@
+#include "clearance_field.h"
+#include "elevation_map.h"
+#include "path_cache.h"
+#include "path_planner.h"
+#include "profile_filters.h"
+#include "thread_pool.h"
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+namespace pp = path_planning;
+
+bool repeated_plans_hit() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&profile, &agl_profile, 20, &path) ||
+      cache.stats().misses != 1 || cache.stats().entries != 1) {
+    std::cout << "The first plan was not cached" << std::endl;
+    return false;
+  }
+  // A hit gives what planning gave, however the outputs start
+  std::vector<int> cached_profile(3, -1);
+  std::vector<int> cached_agl_profile;
+  std::vector<std::pair<int, int>> cached_path;
+  if (!planner.PlanPath(&cached_profile, &cached_agl_profile, 20,
+                        &cached_path) ||
+      cache.stats().hits != 1 || cached_profile != profile ||
+      cached_agl_profile != agl_profile || cached_path != path) {
+    std::cout << "The repeated plan was not served from the cache"
+              << std::endl;
+    return false;
+  }
+  // Another agl or other options are another plan
+  planner.PlanPath(&cached_profile, &cached_agl_profile, 30, &cached_path);
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  planner.SetSearchOptions(options);
+  planner.PlanPath(&cached_profile, &cached_agl_profile, 20, &cached_path);
+  if (cache.stats().hits != 1 || cache.stats().misses != 3 ||
+      cached_agl_profile == agl_profile) {
+    std::cout << "A different query was served from the cache" << std::endl;
+    return false;
+  }
+
+  // Filtered plans are keyed by their stages, and share the plan at ground
+  // level they filter
+  pp::ProfilePipeline median;
+  median.AddAgl(20).Median(5);
+  pp::ProfilePipeline mean;
+  mean.AddAgl(20).Mean(5);
+  std::vector<int> filtered;
+  std::vector<int> expected;
+  cache.ResetStats();
+  if (!planner.PlanFilteredPath(&median, &profile, &expected) ||
+      !planner.PlanFilteredPath(&mean, &profile, &filtered) ||
+      cache.stats().hits != 1 || filtered == expected ||
+      !planner.PlanFilteredPath(&median, &profile, &filtered) ||
+      cache.stats().hits != 2 || filtered != expected) {
+    std::cout << "Filtered plans were not cached by their stages"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool edits_invalidate_plans() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  // Copies share the lineage until one of them is written
+  pp::ElevationMap copy = emap;
+  if (copy.id() != emap.id() || copy.version() != emap.version()) {
+    std::cout << "A copy does not share the map's id" << std::endl;
+    return false;
+  }
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&profile, &agl_profile, 0, &path)) {
+    return false;
+  }
+  // Raise the terrain in the middle of the path
+  const auto cell = path[path.size() / 2];
+  emap(cell.first, cell.second) = pp::Elevation(250);
+  if (emap.id() == copy.id() || planner.map().id() != copy.id()) {
+    std::cout << "A written map kept the id of its copies" << std::endl;
+    return false;
+  }
+  // The planner holds its own copy, so until it is given the edit its
+  // plans still hold
+  std::vector<int> edited_profile;
+  planner.PlanPath(&edited_profile, &agl_profile, 0, &path);
+  if (cache.stats().hits != 1) {
+    std::cout << "The planner's map changed under it" << std::endl;
+    return false;
+  }
+  planner.UpdateMap(emap, cell.first, cell.second, 1, 1);
+  planner.PlanPath(&edited_profile, &agl_profile, 0, &path);
+  if (cache.stats().hits != 1 || cache.stats().misses != 2) {
+    std::cout << "A plan was served for an edited map" << std::endl;
+    return false;
+  }
+  planner.SetMap(copy);
+  planner.PlanPath(&edited_profile, &agl_profile, 0, &path);
+  if (cache.stats().hits != 1 || edited_profile != profile) {
+    std::cout << "A plan was served after setting another map" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool rebuilt_field_misses() {
+  // A peak beside the only row the path can take
+  pp::ElevationMap emap;
+  std::vector<pp::Elevation> cells(21, 0);
+  cells[3] = 1000;
+  if (!emap.Assign(3, 7, cells)) {
+    return false;
+  }
+  pp::ClearanceField field;
+  if (!field.Build(emap, 0)) {
+    return false;
+  }
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  pp::SearchOptions options;
+  options.cost.max_altitude = 100;
+  options.clearance = &field;
+  planner.SetSearchOptions(options);
+  pp::PlanQuery query;
+  query.start = std::make_pair(2, 0);
+  query.goal = std::make_pair(2, 6);
+  pp::PlanResult result;
+  if (!planner.Plan(query, &result) || !planner.Plan(query, &result) ||
+      cache.stats().hits != 1) {
+    std::cout << "A plan with a clearance field was not cached" << std::endl;
+    return false;
+  }
+  // Rebuilt in place with a wider radius, the peak blocks every path
+  if (!field.Build(emap, 2)) {
+    return false;
+  }
+  if (planner.Plan(query, &result) || cache.stats().hits != 1) {
+    std::cout << "A plan was served for a rebuilt clearance field"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool pyramid_changes_plans() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::HierarchicalOptions hierarchical;
+  hierarchical.enabled = true;
+  hierarchical.level = 1;
+  pp::SearchOptions options;
+  options.connectivity = pp::Connectivity::kEight;
+  pp::PlanQuery query;
+  query.start = std::make_pair(0, 0);
+  query.goal = std::make_pair(emap.rows() - 1, emap.cols() - 1);
+  // Without a pyramid a hierarchical planner plans at full resolution
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  planner.SetSearchOptions(options);
+  planner.SetHierarchicalOptions(hierarchical);
+  pp::PathPlanner uncached(emap);
+  uncached.SetSearchOptions(options);
+  uncached.SetHierarchicalOptions(hierarchical);
+  pp::PlanResult result;
+  pp::PlanResult expected;
+  if (!planner.Plan(query, &result) || !uncached.Plan(query, &expected) ||
+      result.path != expected.path) {
+    return false;
+  }
+  // Once built, plans are coarse-to-fine and no longer match those cached
+  planner.Prepare();
+  uncached.Prepare();
+  if (!planner.Plan(query, &result) || !uncached.Plan(query, &expected) ||
+      cache.stats().hits != 0 || cache.stats().misses != 2 ||
+      result.path != expected.path) {
+    std::cout << "A plan made without the pyramid was served with it"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool budget_evicts_oldest() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  planner.PlanPath(&profile, &agl_profile, 0);
+  // Room for about two plans
+  cache.SetBudget(cache.stats().bytes * 5 / 2);
+  for (int agl = 1; agl <= 3; agl++) {
+    planner.PlanPath(&profile, &agl_profile, agl);
+  }
+  const pp::PathCacheStats stats = cache.stats();
+  if (stats.entries != 2 || stats.evictions != 2 ||
+      stats.bytes > cache.budget()) {
+    std::cout << "The cache did not keep to its budget: " << stats.entries
+              << " entries, " << stats.evictions << " evictions"
+              << std::endl;
+    return false;
+  }
+  // The most recent plans are the ones kept
+  planner.PlanPath(&profile, &agl_profile, 3);
+  planner.PlanPath(&profile, &agl_profile, 2);
+  planner.PlanPath(&profile, &agl_profile, 0);
+  if (cache.stats().hits != 2) {
+    std::cout << "The cache evicted a recent plan" << std::endl;
+    return false;
+  }
+  cache.SetBudget(0);
+  if (cache.stats().entries != 0 || cache.stats().bytes != 0) {
+    std::cout << "Shrinking the budget kept plans" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool shared_between_threads() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::PathCache cache;
+  pp::PathPlanner planner(emap);
+  planner.SetPathCache(&cache);
+  const int kThreads = 4;
+  const size_t kQueries = 64;
+  planner.Prepare(kThreads);
+  std::vector<pp::PlanQuery> queries(kQueries);
+  for (size_t i = 0; i < kQueries; i++) {
+    queries[i].start = {0, int(i % 4)};
+    queries[i].goal = {emap.rows() - 1, emap.cols() - 1};
+    queries[i].agl = int(i % 32 / 4);
+  }
+  std::vector<pp::PlanResult> expected;
+  {
+    pp::PathPlanner uncached(emap);
+    if (!uncached.PlanPaths(queries, &expected, 1)) {
+      return false;
+    }
+  }
+  std::atomic<bool> all_match(true);
+  pp::ThreadPool pool(kThreads);
+  // Every query is asked twice a round, often by two threads at once
+  for (int round = 0; round < 2; round++) {
+    std::function<void(size_t, int)> plan = [&](size_t i, int) {
+      pp::PlanResult result;
+      if (!planner.Plan(queries[i], &result) ||
+          result.path != expected[i].path ||
+          result.agl_elevation_profile !=
+              expected[i].agl_elevation_profile) {
+        all_match = false;
+      }
+    };
+    pool.ParallelFor(kQueries, plan);
+  }
+  // 32 distinct queries, each asked four times
+  const pp::PathCacheStats stats = cache.stats();
+  if (!all_match || stats.entries != 32 || stats.hits + stats.misses != 128 ||
+      stats.hits < 64) {
+    std::cout << "Plans from several threads did not share the cache: "
+              << stats.hits << " hits, " << stats.misses << " misses"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!repeated_plans_hit()) {
+    return -1;
+  }
+  if (!edits_invalidate_plans()) {
+    return -1;
+  }
+  if (!rebuilt_field_misses()) {
+    return -1;
+  }
+  if (!pyramid_changes_plans()) {
+    return -1;
+  }
+  if (!budget_evicts_oldest()) {
+    return -1;
+  }
+  if (!shared_between_threads()) {
+    return -1;
+  }
+  std::cout << "All path cache tests passed!" << std::endl;
+  return 0;
+}
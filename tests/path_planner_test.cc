@@ -4,6 +4,8 @@
 #include <iostream>
 #include <iomanip>
 #include <fstream>
+#include <string>
+#include <utility>
 
 namespace pp = path_planning;
 
@@ -15,6 +17,9 @@ bool plan_path() {
   }
 
   pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kStraightLine;
+  planner.SetSearchOptions(options);
 
   std::vector<int> el_profile;
   std::vector<int> agl_el_profile;
@@ -102,6 +107,18 @@ bool filter_large_path() {
       planner.CorrectPath(el_profile, planner.MeanFilter(agl_el_profile, 3), 5);
   std::vector<int> mean9_filt_profile =
       planner.CorrectPath(el_profile, planner.MeanFilter(agl_el_profile, 9), 5);
+  // One pass in place of the filters, within 3 up and 5 down per cell
+  std::vector<int> optimized_profile =
+      planner.OptimizeAltitude(el_profile, 20, 3, 5);
+  for (size_t i = 0; i < el_profile.size(); i++) {
+    if (optimized_profile[i] < el_profile[i] + 20 ||
+        (i > 0 && (optimized_profile[i] - optimized_profile[i - 1] > 3 ||
+                   optimized_profile[i - 1] - optimized_profile[i] > 5))) {
+      std::cerr << "filter_large_path: ERROR! Optimized altitude is out of "
+                   "bounds at " << i << std::endl;
+      return false;
+    }
+  }
 
   // output as json for easy parsing
   std::ofstream out_file;
@@ -131,6 +148,8 @@ bool filter_large_path() {
   write_path("lowpass_0.05", lp005_filt_profile);
   out_file << ",";
   write_path("lowpass_0.2", lp02_filt_profile);
+  out_file << ",";
+  write_path("optimized_altitude", optimized_profile);
   out_file << "]";
   out_file.close();
   std::cout << "Test files written to: " << test_filename << std::endl;
@@ -138,10 +157,196 @@ bool filter_large_path() {
   return true;
 }
 
+bool plan_around_ridge() {
+  // A ridge separates the start and end, with a gap on the far right
+  const std::string ridge_map =
+      "[[(A),100,100,100,100],"
+      " [900,900,900,900,100],"
+      " [(B),100,100,100,100]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(ridge_map.data(), ridge_map.size())) {
+    return false;
+  }
+
+  pp::PathPlanner planner(emap);
+  std::vector<int> el_profile;
+  std::vector<int> agl_el_profile;
+  std::vector<std::pair<int, int>> path;
+  if (!planner.PlanPath(&el_profile, &agl_el_profile, 10, &path)) {
+    return false;
+  }
+  if (path.size() != 11 || path[5] != std::make_pair(1, 4)) {
+    std::cout << "Path did not go around the ridge!" << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < el_profile.size(); i++) {
+    if (el_profile[i] != 100 || agl_el_profile[i] != 110) {
+      std::cout << "Elevation profile crossed the ridge!" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool plan_batch() {
+  pp::ElevationMap emap;
+  if(!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+
+  // Plan between every cell of the first row and a few end points
+  std::vector<pp::PlanQuery> queries;
+  for (int col = 0; col < emap.cols(); col++) {
+    pp::PlanQuery query;
+    query.start = std::make_pair(0, col);
+    query.goal = std::make_pair(emap.rows() - 1 - col % 5, emap.cols() / 2);
+    query.agl = col;
+    queries.push_back(query);
+  }
+
+  pp::PathPlanner planner(emap);
+  if (!planner.map().SharesCellsWith(emap)) {
+    std::cout << "Planner copied the map!" << std::endl;
+    return false;
+  }
+  std::vector<pp::PlanResult> results;
+  if (!planner.PlanPaths(queries, &results, 4) ||
+      results.size() != queries.size()) {
+    std::cout << "Batch planning failed!" << std::endl;
+    return false;
+  }
+
+  // Each result matches planning the same query on its own
+  pp::ElevationMap query_map = emap;
+  for (size_t i = 0; i < queries.size(); i++) {
+    pp::PathPlanner single_planner;
+    single_planner.SetMap(query_map);
+    std::vector<pp::PlanResult> single_result;
+    if (!single_planner.PlanPaths({queries[i]}, &single_result, 1)) {
+      return false;
+    }
+    if (results[i].path != single_result[0].path ||
+        results[i].elevation_profile != single_result[0].elevation_profile ||
+        results[i].agl_elevation_profile !=
+            single_result[0].agl_elevation_profile ||
+        results[i].path.front() != queries[i].start ||
+        results[i].path.back() != queries[i].goal) {
+      std::cout << "Batch result " << i << " does not match its query!"
+                << std::endl;
+      return false;
+    }
+  }
+
+  // A bad query fails on its own without spoiling the rest
+  queries[1].goal = std::make_pair(-1, 0);
+  if (planner.PlanPaths(queries, &results, 2) || results[1].success ||
+      !results[0].success || !results[2].success) {
+    std::cout << "Bad batch query was not isolated!" << std::endl;
+    return false;
+  }
+
+  // A moved planner keeps its map, threads and contexts
+  pp::PathPlanner moved(std::move(planner));
+  pp::PlanResult moved_result;
+  if (!moved.Plan(queries[0], &moved_result) ||
+      moved_result.path != results[0].path) {
+    std::cout << "Moved planner did not plan!" << std::endl;
+    return false;
+  }
+  planner = std::move(moved);
+  if (!planner.PlanPaths({queries[2]}, &results, 2) ||
+      results[0].path.back() != queries[2].goal) {
+    std::cout << "Move assigned planner did not plan!" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool stream_path() {
+  pp::ElevationMap emap;
+  if(!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::ProfilePipeline pipeline;
+  pipeline.AddAgl(100).Median(9).Mean(5).Lowpass(0.3).Clip(50);
+
+  for (auto algorithm : {pp::SearchAlgorithm::kStraightLine,
+                         pp::SearchAlgorithm::kAStar}) {
+    pp::SearchOptions options;
+    options.algorithm = algorithm;
+    planner.SetSearchOptions(options);
+    std::vector<int> el_profile;
+    std::vector<int> filtered;
+    std::vector<std::pair<int, int>> path;
+    if (!planner.PlanFilteredPath(&pipeline, &el_profile, &filtered, &path)) {
+      return false;
+    }
+
+    // Every chunk size streams the same samples as the batch plan
+    for (size_t chunk_size : {size_t(1), size_t(3), size_t(64),
+                              pp::kDefaultChunkSize}) {
+      std::vector<pp::ProfileSample> samples;
+      size_t chunks = 0;
+      bool short_chunk = false;
+      auto collect = [&](const pp::ProfileSample* chunk, size_t count) {
+        // Only the last chunk may be short
+        short_chunk = short_chunk || samples.size() % chunk_size != 0;
+        samples.insert(samples.end(), chunk, chunk + count);
+        chunks++;
+        return true;
+      };
+      if (!planner.StreamPath(&pipeline, collect, chunk_size) ||
+          samples.size() != path.size() || short_chunk ||
+          chunks != (path.size() + chunk_size - 1) / chunk_size) {
+        std::cout << "Streamed " << samples.size() << " samples in "
+                  << chunks << " chunks of " << chunk_size << std::endl;
+        return false;
+      }
+      for (size_t i = 0; i < samples.size(); i++) {
+        if (std::make_pair(samples[i].row, samples[i].col) != path[i] ||
+            samples[i].elevation != el_profile[i] ||
+            samples[i].altitude != filtered[i]) {
+          std::cout << "Streamed sample " << i << " does not match the "
+                    << "batch plan" << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+
+  // Without a pipeline the altitude is the elevation, and the callback can
+  // stop the stream early
+  size_t received = 0;
+  auto first_chunk = [&](const pp::ProfileSample* chunk, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      if (chunk[i].altitude != chunk[i].elevation) {
+        return false;
+      }
+    }
+    received += count;
+    return false;
+  };
+  if (planner.StreamPath(nullptr, first_chunk, 8) || received != 8) {
+    std::cout << "Stream did not stop after the first chunk" << std::endl;
+    return false;
+  }
+  return true;
+}
+
 int main(int argc, char** argv) {
   if (!plan_path()) {
     return -1;
   }
+  if (!plan_around_ridge()) {
+    return -1;
+  }
+  if (!plan_batch()) {
+    return -1;
+  }
+  if (!stream_path()) {
+    return -1;
+  }
   if(!plan_large_path()) {
     return -1;
   }
@@ -0,0 +1,293 @@
+#include "bidirectional_search.h"
+#include "cancellation.h"
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "path_planner.h"
+#include "planning_service.h"
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Build a flat map a whole-map Dijkstra search takes a long time on
+pp::ElevationMap LargeMap(int size) {
+  pp::ElevationMap emap;
+  emap.Assign(size, size,
+              std::vector<pp::Elevation>(size_t(size) * size_t(size),
+                                         pp::Elevation(100)));
+  return emap;
+}
+
+/// @brief Get a query from corner to corner of a map
+pp::PlanQuery CornerQuery(const pp::ElevationMap& emap) {
+  pp::PlanQuery query;
+  query.start = {0, 0};
+  query.goal = {emap.rows() - 1, emap.cols() - 1};
+  return query;
+}
+
+/// @brief Wait until the service has a request running
+bool WaitUntilRunning(const pp::PlanningService& service) {
+  for (int i = 0; i < 2000 && service.stats().running == 0; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return service.stats().running > 0;
+}
+
+}  // namespace
+
+bool searches_stop_when_cancelled() {
+  const pp::ElevationMap emap = LargeMap(600);
+  pp::CancellationToken cancel;
+  cancel.Cancel();
+  std::vector<std::pair<int, int>> path;
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kDijkstra;
+  pp::GridSearch search(options);
+  search.SetCancellation(&cancel);
+  if (search.FindPath(emap, {0, 0}, {599, 599}, 0, &path) ||
+      search.stats().nodes_expanded != pp::kCancelCheckInterval) {
+    std::cout << "A cancelled search did not stop at its first check"
+              << std::endl;
+    return false;
+  }
+  options.algorithm = pp::SearchAlgorithm::kBidirectional;
+  pp::BidirectionalSearch bidirectional(options);
+  bidirectional.SetCancellation(&cancel);
+  if (bidirectional.FindPath(emap, {0, 0}, {599, 599}, 0, &path) ||
+      bidirectional.stats().nodes_expanded > 2 * pp::kCancelCheckInterval) {
+    std::cout << "A cancelled bidirectional search did not stop"
+              << std::endl;
+    return false;
+  }
+  // Without a token, and with one that has not fired, the path is found
+  pp::CancellationToken later(pp::CancellationToken::Clock::now() +
+                              std::chrono::hours(1));
+  search.SetCancellation(&later);
+  bidirectional.SetCancellation(nullptr);
+  if (!search.FindPath(emap, {0, 0}, {599, 599}, 0, &path) ||
+      !bidirectional.FindPath(emap, {0, 0}, {599, 599}, 0, &path)) {
+    std::cout << "A search that was not cancelled failed" << std::endl;
+    return false;
+  }
+
+  // Plans stop, and cancelled ones are not reported as missing paths
+  pp::PathPlanner planner(emap);
+  pp::PlanQuery query = CornerQuery(emap);
+  query.cancel = &cancel;
+  pp::PlanResult result;
+  if (planner.Plan(query, &result)) {
+    std::cout << "A cancelled plan succeeded" << std::endl;
+    return false;
+  }
+  query.cancel = &later;
+  if (!planner.Plan(query, &result)) {
+    std::cout << "A plan with a distant deadline failed" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool responses_match_plans() {
+  pp::ElevationMap emap;
+  if (!emap.ReadMap("example_data/test_map.txt")) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  planner.Prepare(2);
+  std::vector<pp::PlanQuery> queries;
+  for (int row = 0; row < emap.rows(); row += 5) {
+    pp::PlanQuery query;
+    query.start = {row, 0};
+    query.goal = {emap.rows() - 1 - row, emap.cols() - 1};
+    query.agl = row;
+    queries.push_back(query);
+  }
+  pp::PlanningServiceOptions options;
+  options.num_threads = 2;
+  pp::PlanningService service(&planner, options);
+  std::vector<pp::PlanTicket> tickets;
+  for (const auto& query : queries) {
+    tickets.push_back(service.Submit(query));
+  }
+  // Half again through callbacks
+  std::atomic<int> answered(0);
+  std::atomic<bool> callbacks_match(true);
+  std::vector<pp::PlanResult> expected(queries.size());
+  for (size_t i = 0; i < queries.size(); i++) {
+    planner.Plan(queries[i], &expected[i]);
+  }
+  for (size_t i = 0; i < queries.size(); i += 2) {
+    service.Submit(queries[i], pp::PlanningService::Clock::time_point::max(),
+                   [&, i](pp::PlanResponse&& response) {
+                     if (response.status != pp::PlanStatus::kOk ||
+                         response.result.path != expected[i].path) {
+                       callbacks_match = false;
+                     }
+                     answered++;
+                   });
+  }
+  for (size_t i = 0; i < queries.size(); i++) {
+    pp::PlanResponse response = tickets[i].Get();
+    if (response.status != pp::PlanStatus::kOk ||
+        response.result.path != expected[i].path ||
+        response.result.agl_elevation_profile !=
+            expected[i].agl_elevation_profile) {
+      std::cout << "Response " << i << " does not match its plan: "
+                << pp::PlanStatusName(response.status) << std::endl;
+      return false;
+    }
+  }
+  // Shutting down would cancel the callbacks still queued
+  const size_t expected_callbacks = (queries.size() + 1) / 2;
+  for (int i = 0; i < 5000 && size_t(answered) < expected_callbacks; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  service.Shutdown();
+  const pp::PlanningServiceStats stats = service.stats();
+  if (!callbacks_match || size_t(answered) != expected_callbacks ||
+      stats.planned != queries.size() + expected_callbacks ||
+      stats.submitted != stats.planned || stats.queue_depth != 0 ||
+      stats.running != 0) {
+    std::cout << "Callbacks or counters do not add up" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool deadlines_and_cancellation() {
+  const pp::ElevationMap emap = LargeMap(1500);
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions search;
+  search.algorithm = pp::SearchAlgorithm::kDijkstra;
+  planner.SetSearchOptions(search);
+  pp::PlanningServiceOptions options;
+  options.num_threads = 1;
+  pp::PlanningService service(&planner, options);
+  const pp::PlanQuery query = CornerQuery(emap);
+  // The first plan of a context sizes its nodes to the map before it first
+  // checks the deadline, so warm the only context with a short plan
+  pp::PlanQuery short_query;
+  short_query.start = {0, 0};
+  short_query.goal = {0, 1};
+  if (service.Submit(short_query).Get().status != pp::PlanStatus::kOk) {
+    return false;
+  }
+
+  // A deadline stops the search long before it would finish
+  pp::PlanTicket expiring = service.Submit(
+      query, pp::PlanningService::Clock::now() + std::chrono::milliseconds(5));
+  pp::PlanResponse response = expiring.Get();
+  if (response.status != pp::PlanStatus::kDeadlineExceeded) {
+    std::cout << "A plan ran past its deadline: "
+              << pp::PlanStatusName(response.status) << std::endl;
+    return false;
+  }
+  // The same deadline on a warm search of its own, where the expansions can
+  // be counted. Wall clock bounds would fail on slow or sanitized builds.
+  std::vector<std::pair<int, int>> path;
+  pp::GridSearch grid_search(search);
+  if (!grid_search.FindPath(emap, short_query.start, short_query.goal, 0,
+                            &path)) {
+    return false;
+  }
+  const pp::CancellationToken deadline(
+      pp::CancellationToken::Clock::now() + std::chrono::milliseconds(5));
+  grid_search.SetCancellation(&deadline);
+  const size_t cells = size_t(emap.rows()) * size_t(emap.cols());
+  if (grid_search.FindPath(emap, query.start, query.goal, 0, &path) ||
+      grid_search.stats().nodes_expanded >= cells / 4) {
+    std::cout << "A search expanded "
+              << grid_search.stats().nodes_expanded
+              << " nodes past its deadline" << std::endl;
+    return false;
+  }
+
+  // The running plan and a queued one are both cancelled
+  pp::PlanTicket running = service.Submit(query);
+  pp::PlanTicket queued = service.Submit(query);
+  if (!WaitUntilRunning(service)) {
+    return false;
+  }
+  queued.Cancel();
+  running.Cancel();
+  if (running.Get().status != pp::PlanStatus::kCancelled ||
+      queued.Get().status != pp::PlanStatus::kCancelled) {
+    std::cout << "A cancelled plan was not reported as cancelled"
+              << std::endl;
+    return false;
+  }
+  const pp::PlanningServiceStats stats = service.stats();
+  if (stats.expired != 1 || stats.cancelled != 2 || stats.planned != 1) {
+    std::cout << "Cancellation counters do not add up" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool full_queue_and_shutdown() {
+  const pp::ElevationMap emap = LargeMap(1500);
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions search;
+  search.algorithm = pp::SearchAlgorithm::kDijkstra;
+  planner.SetSearchOptions(search);
+  pp::PlanningServiceOptions options;
+  options.num_threads = 1;
+  options.queue_capacity = 2;
+  pp::PlanningService service(&planner, options);
+  const pp::PlanQuery query = CornerQuery(emap);
+
+  // One running and two queued fill the service, so the next is turned away
+  std::vector<pp::PlanTicket> tickets;
+  tickets.push_back(service.Submit(query));
+  if (!WaitUntilRunning(service)) {
+    return false;
+  }
+  tickets.push_back(service.Submit(query));
+  tickets.push_back(service.Submit(query));
+  pp::PlanTicket rejected = service.Submit(query);
+  if (!rejected.WaitFor(std::chrono::seconds(0)) ||
+      rejected.Get().status != pp::PlanStatus::kRejected ||
+      service.stats().queue_depth != 2 ||
+      service.stats().max_queue_depth != 2) {
+    std::cout << "A full queue did not turn a request away" << std::endl;
+    return false;
+  }
+
+  // Shutting down answers everything still queued or running
+  service.Shutdown();
+  for (auto& ticket : tickets) {
+    if (ticket.Get().status != pp::PlanStatus::kCancelled) {
+      std::cout << "Shutdown left a request unanswered" << std::endl;
+      return false;
+    }
+  }
+  if (service.Submit(query).Get().status != pp::PlanStatus::kRejected) {
+    std::cout << "A stopped service took a request" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!searches_stop_when_cancelled()) {
+    return -1;
+  }
+  if (!responses_match_plans()) {
+    return -1;
+  }
+  if (!deadlines_and_cancellation()) {
+    return -1;
+  }
+  if (!full_queue_and_shutdown()) {
+    return -1;
+  }
+  std::cout << "All planning service tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,516 @@
+#include "profile_filters.h"
+#include "path_planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <new>
+#include <vector>
+
+namespace pp = path_planning;
+
+/// Number of calls to the global operator new, to check the pipeline does not
+/// allocate once it is warm
+static size_t g_allocations = 0;
+
+void* operator new(size_t size) {
+  g_allocations++;
+  void* p = std::malloc(size == 0 ? 1 : size);
+  if (p == nullptr) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+namespace {
+
+/// @brief Mean filter the way `PathPlanner::MeanFilter` was originally
+/// written, re-summing every window
+std::vector<int> ReferenceMeanFilter(const std::vector<int>& profile,
+                                     int width) {
+  std::vector<int> filtered;
+  if (profile.empty()) {
+    return filtered;
+  }
+  for (size_t i = 0; i < profile.size() - 1; i++) {
+    double sum = 0;
+    int count = 0;
+    for (size_t j = i;
+         j < std::min(i + std::max(width, 0), profile.size() - 1); j++) {
+      sum += profile[j];
+      count++;
+    }
+    filtered.push_back(count > 0 ? int(std::round(sum / count)) : profile[i]);
+  }
+  filtered.push_back(profile.back());
+  return filtered;
+}
+
+/// @brief Lowpass filter the way `PathPlanner::LowpassFilter` was originally
+/// written
+std::vector<int> ReferenceLowpassFilter(const std::vector<int>& profile,
+                                        double alpha) {
+  std::vector<int> filtered(profile.size());
+  filtered[0] = profile[1];
+  for (size_t i = 1; i < profile.size(); i++) {
+    filtered[i] = int(alpha * profile[i] + (1.0 - alpha) * filtered[i - 1]);
+  }
+  return filtered;
+}
+
+/// @brief Median filter by sorting every window, the way
+/// `PathPlanner::MedianFilter` was originally written
+std::vector<int> ReferenceMedianFilter(const std::vector<int>& profile,
+                                       int width) {
+  std::vector<int> filtered;
+  for (int i = 0; i < int(profile.size()); i++) {
+    if (i < width) {
+      filtered.push_back(profile[i]);
+      continue;
+    }
+    std::vector<int> window(profile.begin() + i - width, profile.begin() + i);
+    std::sort(window.begin(), window.end());
+    if (width % 2 == 0) {
+      filtered.push_back((window[width / 2 - 1] + window[width / 2]) / 2);
+    } else {
+      filtered.push_back(window[int(std::ceil(width / 2.0))]);
+    }
+  }
+  return filtered;
+}
+
+/// @brief Lowest profile above a floor within the rates, by taking the
+/// highest cone of every floor value at every value
+std::vector<int> ReferenceLimitSlopes(const std::vector<int>& floor,
+                                      int max_climb, int max_descent) {
+  std::vector<int> profile(floor.size());
+  for (size_t i = 0; i < floor.size(); i++) {
+    int64_t highest = floor[i];
+    for (size_t j = 0; j < floor.size(); j++) {
+      const int64_t distance = j < i ? int64_t(i - j) : int64_t(j - i);
+      const int64_t rate = j < i ? max_descent : max_climb;
+      highest = std::max(highest, floor[j] - distance * rate);
+    }
+    profile[i] = int(highest);
+  }
+  return profile;
+}
+
+/// @brief Deterministic noisy profile with long runs of repeated values
+std::vector<int> TestProfile(size_t length, uint32_t seed) {
+  std::vector<int> profile(length);
+  for (size_t i = 0; i < length; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    profile[i] = int(100 * std::sin(i / 7.0)) + int((seed >> 16) % 40) - 20;
+    if ((seed >> 8) % 5 == 0 && i > 0) {
+      profile[i] = profile[i - 1];
+    }
+  }
+  return profile;
+}
+
+}  // namespace
+
+bool median_matches_reference() {
+  pp::SlidingMedian median;
+  for (size_t length : {size_t(0), size_t(1), size_t(5), size_t(300)}) {
+    std::vector<int> profile = TestProfile(length, uint32_t(length));
+    for (int width = 2; width <= 41; width++) {
+      std::vector<int> filtered(profile.size());
+      median.Filter(profile.data(), profile.size(), width, filtered.data());
+      if (filtered != ReferenceMedianFilter(profile, width)) {
+        std::cout << "Median filter of width " << width << " over "
+                  << length << " values does not match the reference"
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool median_degenerate_widths() {
+  pp::SlidingMedian median;
+  std::vector<int> profile = TestProfile(50, 3);
+  std::vector<int> filtered(profile.size());
+
+  // Nothing to filter with an empty window
+  median.Filter(profile.data(), profile.size(), 0, filtered.data());
+  if (filtered != profile) {
+    return false;
+  }
+
+  // A single value window just delays the signal by one sample
+  median.Filter(profile.data(), profile.size(), 1, filtered.data());
+  if (filtered[0] != profile[0]) {
+    return false;
+  }
+  for (size_t i = 1; i < profile.size(); i++) {
+    if (filtered[i] != profile[i - 1]) {
+      std::cout << "Median filter of width 1 is not a delay" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool mean_matches_reference() {
+  for (size_t length : {size_t(0), size_t(1), size_t(2), size_t(300)}) {
+    std::vector<int> profile = TestProfile(length, uint32_t(length) + 7);
+    for (int width = 0; width <= 41; width++) {
+      std::vector<int> filtered(profile.size());
+      pp::MeanFilter(profile.data(), profile.size(), width, filtered.data());
+      if (filtered != ReferenceMeanFilter(profile, width)) {
+        std::cout << "Mean filter of width " << width << " over " << length
+                  << " values does not match the reference" << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool lowpass_matches_reference() {
+  std::vector<int> profile = TestProfile(300, 11);
+  for (double alpha : {0.0, 0.1, 0.5, 0.9, 1.0}) {
+    std::vector<int> filtered(profile.size());
+    if (!pp::LowpassFilter(profile.data(), profile.size(), alpha,
+                           filtered.data()) ||
+        filtered != ReferenceLowpassFilter(profile, alpha)) {
+      std::cout << "Lowpass filter with alpha " << alpha
+                << " does not match the reference" << std::endl;
+      return false;
+    }
+    // In place gives the same result
+    std::vector<int> in_place = profile;
+    pp::LowpassFilter(in_place.data(), in_place.size(), alpha,
+                      in_place.data());
+    if (in_place != filtered) {
+      std::cout << "In place lowpass filter does not match" << std::endl;
+      return false;
+    }
+  }
+
+  std::vector<int> filtered(profile.size());
+  if (pp::LowpassFilter(profile.data(), profile.size(), 1.5,
+                        filtered.data()) ||
+      filtered != profile) {
+    std::cout << "Lowpass filter accepted a bad alpha" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool limit_slopes_matches_reference() {
+  const std::vector<int> floor = TestProfile(400, 13);
+  const int kUnlimited = std::numeric_limits<int>::max();
+  for (int max_climb : {0, 1, 4, 25, kUnlimited}) {
+    for (int max_descent : {0, 2, 25, kUnlimited}) {
+      std::vector<int> profile(floor.size());
+      if (!pp::LimitSlopes(floor.data(), floor.size(), max_climb,
+                           max_descent, profile.data()) ||
+          profile != ReferenceLimitSlopes(floor, max_climb, max_descent)) {
+        std::cout << "Slope limits " << max_climb << " up and "
+                  << max_descent << " down do not match the reference"
+                  << std::endl;
+        return false;
+      }
+      for (size_t i = 1; i < profile.size(); i++) {
+        const int64_t rise = int64_t(profile[i]) - profile[i - 1];
+        if (profile[i] < floor[i] || rise > max_climb || -rise > max_descent) {
+          std::cout << "Slope limited profile is out of bounds at " << i
+                    << std::endl;
+          return false;
+        }
+      }
+      std::vector<int> in_place = floor;
+      pp::LimitSlopes(in_place.data(), in_place.size(), max_climb,
+                      max_descent, in_place.data());
+      if (in_place != profile) {
+        std::cout << "In place slope limits do not match" << std::endl;
+        return false;
+      }
+    }
+  }
+  // Without limits the profile is the floor
+  std::vector<int> profile(floor.size());
+  pp::LimitSlopes(floor.data(), floor.size(), kUnlimited, kUnlimited,
+                  profile.data());
+  if (profile != floor) {
+    std::cout << "Unlimited slopes changed the floor" << std::endl;
+    return false;
+  }
+  if (pp::LimitSlopes(floor.data(), floor.size(), -1, 5, profile.data()) ||
+      profile != floor) {
+    std::cout << "Slope limits accepted a negative rate" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool minimize_energy_bridges_valleys() {
+  // Diving into a valley of fifty values and climbing back out spends more
+  // than flying over it
+  std::vector<int> floor(52, 0);
+  floor.front() = 100;
+  floor.back() = 100;
+  std::vector<int> profile(floor.size());
+  pp::AltitudeEnergy energy;
+  if (!pp::MinimizeEnergy(floor.data(), floor.size(), 3, 5, energy,
+                          profile.data()) ||
+      profile != std::vector<int>(floor.size(), 100)) {
+    std::cout << "A narrow valley was not bridged" << std::endl;
+    return false;
+  }
+  pp::PathPlanner planner;
+  if (planner.OptimizeAltitude(floor, 20, 3, 5) !=
+      std::vector<int>(floor.size(), 120)) {
+    std::cout << "The optimized altitude dove into a narrow valley"
+              << std::endl;
+    return false;
+  }
+  // When holding altitude costs more, it dives and only cuts across the
+  // narrow bottom of the valley
+  energy.hold = 10.0;
+  std::vector<int> lowest(floor.size());
+  pp::LimitSlopes(floor.data(), floor.size(), 3, 5, lowest.data());
+  pp::MinimizeEnergy(floor.data(), floor.size(), 3, 5, energy,
+                     profile.data());
+  if (profile[10] != lowest[10] || profile == lowest ||
+      pp::ProfileEnergy(profile.data(), profile.size(), energy) >=
+          pp::ProfileEnergy(lowest.data(), lowest.size(), energy)) {
+    std::cout << "A wide valley was bridged" << std::endl;
+    return false;
+  }
+
+  // Against every profile of small floors from and to the same altitudes,
+  // within the rates or not
+  const int kUnlimited = std::numeric_limits<int>::max();
+  const int kValues = 5;
+  const size_t kLength = 6;
+  for (uint32_t seed = 1; seed <= 40; seed++) {
+    std::vector<int> small(kLength);
+    uint32_t state = seed;
+    for (size_t i = 0; i < kLength; i++) {
+      state = state * 1664525u + 1013904223u;
+      small[i] = int((state >> 16) % kValues);
+    }
+    energy.climb = double(seed % 4);
+    energy.descent = double(seed % 3);
+    energy.hold = 0.5 + double(seed % 5) / 4.0;
+    const int max_climb = seed % 2 == 0 ? kUnlimited : 2;
+    const int max_descent = seed % 3 == 0 ? kUnlimited : 1;
+    std::vector<int> ends(kLength);
+    pp::LimitSlopes(small.data(), kLength, max_climb, max_descent,
+                    ends.data());
+    std::vector<int> best(kLength);
+    if (!pp::MinimizeEnergy(small.data(), kLength, max_climb, max_descent,
+                            energy, best.data())) {
+      return false;
+    }
+    std::vector<int> candidate(kLength, 0);
+    double least = 1e30;
+    for (;;) {
+      bool feasible = candidate.front() == ends.front() &&
+                      candidate.back() == ends.back();
+      for (size_t i = 0; i < kLength; i++) {
+        const int64_t rise = i > 0 ? candidate[i] - candidate[i - 1] : 0;
+        feasible &= candidate[i] >= small[i] && rise <= max_climb &&
+                    -rise <= max_descent;
+      }
+      if (feasible) {
+        least = std::min(
+            least, pp::ProfileEnergy(candidate.data(), kLength, energy));
+      }
+      size_t digit = 0;
+      while (digit < kLength && ++candidate[digit] == kValues) {
+        candidate[digit++] = 0;
+      }
+      if (digit == kLength) {
+        break;
+      }
+    }
+    for (size_t i = 0; i < kLength; i++) {
+      const int64_t rise = i > 0 ? best[i] - best[i - 1] : 0;
+      if (best[i] < small[i] || rise > max_climb || -rise > max_descent) {
+        std::cout << "Minimum energy profile is out of bounds at " << i
+                  << std::endl;
+        return false;
+      }
+    }
+    if (pp::ProfileEnergy(best.data(), kLength, energy) > least + 1e-9) {
+      std::cout << "Minimum energy profile " << seed << " spends "
+                << pp::ProfileEnergy(best.data(), kLength, energy)
+                << ", another spends " << least << std::endl;
+      return false;
+    }
+  }
+
+  // Long profiles keep within the rates and spend no more than the lowest
+  const std::vector<int> noisy = TestProfile(2000, 21);
+  energy = pp::AltitudeEnergy();
+  lowest.resize(noisy.size());
+  profile = noisy;
+  pp::LimitSlopes(noisy.data(), noisy.size(), 4, 6, lowest.data());
+  pp::MinimizeEnergy(profile.data(), profile.size(), 4, 6, energy,
+                     profile.data());
+  for (size_t i = 1; i < profile.size(); i++) {
+    const int rise = profile[i] - profile[i - 1];
+    if (profile[i] < lowest[i] || rise > 4 || -rise > 6) {
+      std::cout << "Minimum energy profile is out of bounds at " << i
+                << std::endl;
+      return false;
+    }
+  }
+  if (pp::ProfileEnergy(profile.data(), profile.size(), energy) >=
+      pp::ProfileEnergy(lowest.data(), lowest.size(), energy)) {
+    std::cout << "Minimum energy profile spends more than the lowest"
+              << std::endl;
+    return false;
+  }
+  energy.hold = -1.0;
+  if (pp::MinimizeEnergy(noisy.data(), noisy.size(), 4, 6, energy,
+                         profile.data()) ||
+      profile != noisy) {
+    std::cout << "Minimum energy accepted a negative cost" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool vector_kernels_match_scalar() {
+  // Odd lengths exercise the scalar tails after the vector loops
+  for (size_t length : {size_t(0), size_t(3), size_t(17), size_t(1001)}) {
+    std::vector<int> elevation = TestProfile(length, 5);
+    std::vector<int> data = TestProfile(length, 9);
+
+    std::vector<int> offset = data;
+    pp::AddOffset(offset.data(), offset.size(), -37);
+    std::vector<int> clipped = data;
+    pp::ClipToClearance(elevation.data(), elevation.size(), 25,
+                        clipped.data());
+    for (size_t i = 0; i < length; i++) {
+      if (offset[i] != data[i] - 37 ||
+          clipped[i] != std::max(elevation[i] + 25, data[i])) {
+        std::cout << "Vector kernel mismatch at " << i << " of " << length
+                  << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool pipeline_matches_planner() {
+  std::vector<int> profile = TestProfile(500, 21);
+  pp::PathPlanner planner;
+  const int agl = 100;
+  std::vector<int> agl_profile = profile;
+  for (auto& el : agl_profile) {
+    el += agl;
+  }
+  std::vector<int> expected = planner.CorrectPath(
+      profile,
+      planner.LowpassFilter(
+          planner.MeanFilter(planner.MedianFilter(agl_profile, 9), 5), 0.3),
+      50);
+
+  pp::ProfilePipeline pipeline;
+  pipeline.AddAgl(agl).Median(9).Mean(5).Lowpass(0.3).Clip(50);
+  std::vector<int> filtered;
+  if (!pipeline.Run(profile, &filtered) || filtered != expected) {
+    std::cout << "Pipeline does not match the chained planner filters"
+              << std::endl;
+    return false;
+  }
+
+  // Once the buffers have grown, running again must not allocate
+  size_t allocations = g_allocations;
+  for (int i = 0; i < 10; i++) {
+    pipeline.Run(profile, &filtered);
+  }
+  if (g_allocations != allocations || filtered != expected) {
+    std::cout << "Warm pipeline made " << g_allocations - allocations
+              << " allocations" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool streaming_matches_batch() {
+  std::vector<pp::ProfilePipeline> pipelines(5);
+  pipelines[0].AddAgl(100).Median(9).Mean(5).Lowpass(0.3).Clip(50);
+  pipelines[1].Mean(4).Lowpass(0.5).Mean(7).Clip(20).Median(6).Clip(80);
+  pipelines[2].Median(0).Mean(0).Lowpass(1.0).Clip(0);
+  pipelines[3].Lowpass(1.5).Mean(3);
+  for (size_t length : {size_t(0), size_t(1), size_t(2), size_t(3),
+                        size_t(12), size_t(401)}) {
+    const std::vector<int> profile = TestProfile(length, uint32_t(length));
+    for (size_t p = 0; p < pipelines.size(); p++) {
+      std::vector<int> expected;
+      const bool valid = pipelines[p].Run(profile, &expected);
+      for (size_t chunk : {size_t(1), size_t(2), size_t(7), size_t(64),
+                           size_t(1000)}) {
+        std::vector<int> streamed;
+        pipelines[p].Begin();
+        for (size_t i = 0; i < length; i += chunk) {
+          pipelines[p].Push(profile.data() + i, std::min(chunk, length - i),
+                            &streamed);
+          // Outputs only trail the inputs by the look-ahead of the stages
+          if (streamed.size() + pipelines[p].stream_delay() <
+              std::min(i + chunk, length)) {
+            std::cout << "Pipeline " << p << " held back too many values"
+                      << std::endl;
+            return false;
+          }
+        }
+        if (pipelines[p].Finish(&streamed) != valid || streamed != expected) {
+          std::cout << "Streamed pipeline " << p << " in chunks of " << chunk
+                    << " over " << length << " values does not match Run"
+                    << std::endl;
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!median_matches_reference()) {
+    return -1;
+  }
+  if (!median_degenerate_widths()) {
+    return -1;
+  }
+  if (!mean_matches_reference()) {
+    return -1;
+  }
+  if (!lowpass_matches_reference()) {
+    return -1;
+  }
+  if (!limit_slopes_matches_reference()) {
+    return -1;
+  }
+  if (!minimize_energy_bridges_valleys()) {
+    return -1;
+  }
+  if (!vector_kernels_match_scalar()) {
+    return -1;
+  }
+  if (!pipeline_matches_planner()) {
+    return -1;
+  }
+  if (!streaming_matches_batch()) {
+    return -1;
+  }
+  std::cout << "All profile filter tests passed!" << std::endl;
+  return 0;
+}
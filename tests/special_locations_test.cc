@@ -0,0 +1,367 @@
+#include "elevation_map.h"
+#include "grid_search.h"
+#include "map_ingest.h"
+#include "map_pyramid.h"
+#include "path_planner.h"
+#include "special_locations.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace pp = path_planning;
+
+// The marker table is usable at compile time
+static_assert(pp::MarkerValue(pp::kStartPos) == -1 &&
+                  pp::MarkerValue(pp::kEndPos) == -2 &&
+                  pp::MarkerValue(pp::kWaypoint) == -3 &&
+                  pp::MarkerValue('Q') == 0 && pp::MarkerValue('\xff') == 0,
+              "Unexpected marker values");
+static_assert(pp::IsSpecialLocationValue(-3) &&
+                  !pp::IsSpecialLocationValue(-4) &&
+                  !pp::IsSpecialLocationValue(0),
+              "Unexpected marker range");
+
+namespace {
+
+/// @brief Build the text of a flat map of height 100 with a marker on the
+/// given cells
+std::string MarkedMapText(int rows, int cols,
+                          const std::vector<pp::MarkedLocation>& markers) {
+  std::string text = "[";
+  for (int row = 0; row < rows; row++) {
+    text += row == 0 ? "[" : ",[";
+    for (int col = 0; col < cols; col++) {
+      text += col == 0 ? "" : ",";
+      std::string cell = "100";
+      for (const pp::MarkedLocation& marker : markers) {
+        if (marker.row == row && marker.col == col) {
+          cell = std::string("(") + marker.marker + ")";
+        }
+      }
+      text += cell;
+    }
+    text += ']';
+  }
+  return text + "]";
+}
+
+}  // namespace
+
+bool index_groups_locations() {
+  // Out of order across markers, each marker's own order is kept
+  const std::vector<pp::MarkedLocation> locations = {
+      {'W', 0, 4}, {'A', 1, 1}, {'W', 2, 0}, {'B', 3, 3}, {'W', 1, 7}};
+  const pp::LocationIndex index(locations);
+  const auto waypoints = index.Get(pp::kWaypoint);
+  const std::vector<std::pair<int, int>> expected = {{0, 4}, {2, 0}, {1, 7}};
+  if (index.size() != 5 || waypoints.size() != 3 ||
+      !std::equal(expected.begin(), expected.end(), waypoints.begin()) ||
+      index.Get(pp::kStartPos).size() != 1 ||
+      index.Get(pp::kStartPos)[0] != std::make_pair(1, 1) ||
+      index.Get(pp::kEndPos)[0] != std::make_pair(3, 3) ||
+      !index.Get('Q').empty() || !pp::LocationIndex().Get('A').empty()) {
+    std::cout << "Location index grouped the locations wrongly" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool map_views_many_waypoints() {
+  // A waypoint on every other cell of a 100 x 100 map
+  std::vector<pp::MarkedLocation> markers = {{'A', 0, 1}, {'B', 99, 98}};
+  for (int row = 1; row < 99; row++) {
+    for (int col = row % 2; col < 100; col += 2) {
+      markers.push_back(pp::MarkedLocation{'W', row, col});
+    }
+  }
+  const std::string text = MarkedMapText(100, 100, markers);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  const auto waypoints = emap.GetLocations(pp::kWaypoint);
+  if (waypoints.size() != markers.size() - 2 ||
+      emap(1, 1) != pp::MarkerValue(pp::kWaypoint)) {
+    std::cout << "Parsed map lost its waypoints" << std::endl;
+    return false;
+  }
+  for (size_t i = 0; i < waypoints.size(); i++) {
+    if (waypoints[i] != std::make_pair(markers[i + 2].row,
+                                       markers[i + 2].col)) {
+      std::cout << "Waypoint " << i << " is out of order" << std::endl;
+      return false;
+    }
+  }
+  // Every lookup and every copy of the map views the same locations
+  const pp::ElevationMap copy = emap;
+  if (emap.GetLocations(pp::kWaypoint).data() != waypoints.data() ||
+      copy.GetLocations(pp::kWaypoint).data() != waypoints.data()) {
+    std::cout << "Locations were copied" << std::endl;
+    return false;
+  }
+  // The sharded parser indexes the same locations
+  pp::ThreadPool pool(2);
+  pp::ElevationMap sharded;
+  if (!pp::ParseMapSharded(text.data(), text.size(), &pool, &sharded,
+                           nullptr, 1024)) {
+    return false;
+  }
+  const auto sharded_waypoints = sharded.GetLocations(pp::kWaypoint);
+  if (sharded_waypoints.size() != waypoints.size() ||
+      !std::equal(waypoints.begin(), waypoints.end(),
+                  sharded_waypoints.begin())) {
+    std::cout << "Sharded map has different waypoints" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool plans_through_waypoints_to_nearest_goal() {
+  // Two goals, the second nearer the last waypoint
+  const std::vector<pp::MarkedLocation> markers = {
+      {'A', 0, 0}, {'W', 5, 15}, {'W', 12, 3}, {'B', 1, 15}, {'B', 18, 1}};
+  const std::string text = MarkedMapText(20, 20, markers);
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kAStar;
+  planner.SetSearchOptions(options);
+
+  pp::PlanQuery query;
+  query.start = emap.GetLocations(pp::kStartPos)[0];
+  query.waypoints = emap.GetLocations(pp::kWaypoint);
+  query.goals = emap.GetLocations(pp::kEndPos);
+  query.agl = 10;
+  pp::PlanResult result;
+  if (!planner.Plan(query, &result)) {
+    return false;
+  }
+  // The path passes each waypoint in order and finishes at the nearest goal
+  const auto& path = result.path;
+  auto first = std::find(path.begin(), path.end(), std::make_pair(5, 15));
+  auto second = std::find(first, path.end(), std::make_pair(12, 3));
+  if (path.front() != std::make_pair(0, 0) || first == path.end() ||
+      second == path.end() || path.back() != std::make_pair(18, 1)) {
+    std::cout << "Path missed a waypoint or the nearest goal" << std::endl;
+    return false;
+  }
+  // Every cell is a step from the last, and the markers along the way take
+  // the terrain of their neighbors
+  for (size_t i = 1; i < path.size(); i++) {
+    if (std::abs(path[i].first - path[i - 1].first) > 1 ||
+        std::abs(path[i].second - path[i - 1].second) > 1 ||
+        path[i] == path[i - 1]) {
+      std::cout << "Legs were not joined at " << i << std::endl;
+      return false;
+    }
+  }
+  if (result.elevation_profile.size() != path.size() ||
+      std::any_of(result.elevation_profile.begin(),
+                  result.elevation_profile.end(),
+                  [](int value) { return value != 100; }) ||
+      result.agl_elevation_profile.back() != 110) {
+    std::cout << "Waypoints were left in the elevation profile" << std::endl;
+    return false;
+  }
+
+  // A map with several end positions is planned to the nearest one
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> map_path;
+  if (!planner.PlanPath(&profile, &agl_profile, 0, &map_path) ||
+      map_path.back() != std::make_pair(1, 15)) {
+    std::cout << "Map plan did not finish at the nearest end" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool markers_found_by_position() {
+  // A real elevation equal to a marker's value is still terrain
+  const std::string text = "[[(A),0,0,-3,0,0,(B)]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  if (!emap.IsMarked(0, 0) || !emap.IsMarked(0, 6) || emap.IsMarked(0, 3) ||
+      pp::TerrainElevation(emap, 0, 3) != -3 ||
+      pp::TerrainElevation(emap, 0, 0) != 0) {
+    std::cout << "A cell was taken for a marker by its value" << std::endl;
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  if (!planner.PlanPath(&profile, &agl_profile, 0) ||
+      profile != std::vector<int>{0, 0, 0, -3, 0, 0, 0}) {
+    std::cout << "Planned profile reinterpreted a real elevation"
+              << std::endl;
+    return false;
+  }
+  // A path may also end on a cell that only looks like a marker
+  pp::PlanQuery query;
+  query.start = {0, 1};
+  query.goal = {0, 3};
+  pp::PlanResult result;
+  if (!planner.Plan(query, &result) ||
+      result.elevation_profile != std::vector<int>{0, 0, -3}) {
+    std::cout << "A profile end was replaced by its value" << std::endl;
+    return false;
+  }
+
+  // Neighboring markers are skipped when taking a marker's terrain
+  const std::string neighbors = "[[(A),(W),7],[4,9,9]]";
+  if (!emap.ParseMap(neighbors.data(), neighbors.size()) ||
+      pp::TerrainElevation(emap, 0, 0) != 4 ||
+      pp::TerrainElevation(emap, 0, 1) != 7) {
+    std::cout << "A marker took the value of a neighboring marker"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool literal_marker_values_are_terrain() {
+  // A valley 3 m below sea level, the value a waypoint is stored as
+  const std::string text = "[[(A),4,4,4],[4,-3,4,4],[4,4,4,(B)]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  if (!emap.GetLocations(pp::kWaypoint).empty() || emap.IsMarked(1, 1) ||
+      emap(1, 1) != -3) {
+    std::cout << "A literal -3 was read as a waypoint" << std::endl;
+    return false;
+  }
+  pp::ThreadPool pool(2);
+  pp::ElevationMap sharded;
+  if (!pp::ParseMapSharded(text.data(), text.size(), &pool, &sharded,
+                           nullptr, 8) ||
+      sharded(1, 1) != -3 || !sharded.GetLocations(pp::kWaypoint).empty()) {
+    std::cout << "The sharded parser read a literal -3 as a waypoint"
+              << std::endl;
+    return false;
+  }
+  // The pyramid keeps the valley, leaving out only the marked start
+  pp::MapPyramid pyramid;
+  if (!pyramid.Build(emap, 1) || pyramid.level(1).min(0, 0) != -3 ||
+      pyramid.level(1).max(0, 0) != 4) {
+    std::cout << "The pyramid left out a literal -3" << std::endl;
+    return false;
+  }
+  // Planned straight through the valley, its depth is in the profile
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kStraightLine;
+  planner.SetSearchOptions(options);
+  pp::PlanQuery query;
+  query.start = {0, 0};
+  query.goal = {2, 2};
+  pp::PlanResult result;
+  if (!planner.Plan(query, &result) ||
+      std::find(result.path.begin(), result.path.end(),
+                std::make_pair(1, 1)) == result.path.end() ||
+      *std::min_element(result.elevation_profile.begin(),
+                        result.elevation_profile.end()) != -3) {
+    std::cout << "A literal -3 was left out of the profile" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool plans_past_unreachable_nearest_goal() {
+  // The goal nearest the start is walled in above the ceiling, the other
+  // is reached along the flat bottom row
+  const std::string text =
+      "[[100,100,100,100,100,100,100],"
+      "[100,900,900,900,100,100,100],"
+      "[100,900,(B),900,100,100,(A)],"
+      "[100,900,900,900,100,100,100],"
+      "[(B),100,100,100,100,100,100]]";
+  pp::ElevationMap emap;
+  if (!emap.ParseMap(text.data(), text.size())) {
+    return false;
+  }
+  pp::PathPlanner planner(emap);
+  pp::SearchOptions options;
+  options.algorithm = pp::SearchAlgorithm::kAStar;
+  options.connectivity = pp::Connectivity::kEight;
+  options.cost.max_altitude = 500;
+  std::vector<int> profile;
+  std::vector<int> agl_profile;
+  std::vector<std::pair<int, int>> path;
+  for (int margin : {-1, 2}) {
+    options.window_margin = margin;
+    planner.SetSearchOptions(options);
+    if (!planner.PlanPath(&profile, &agl_profile, 0, &path) ||
+        path.back() != std::make_pair(4, 0)) {
+      std::cout << "An unreachable nearest goal failed the plan"
+                << std::endl;
+      return false;
+    }
+  }
+  size_t streamed = 0;
+  std::pair<int, int> last(-1, -1);
+  if (!planner.StreamPath(nullptr, [&](const pp::ProfileSample* chunk,
+                                       size_t count) {
+        streamed += count;
+        last = std::make_pair(chunk[count - 1].row, chunk[count - 1].col);
+        return true;
+      }) || streamed != path.size() || last != std::make_pair(4, 0)) {
+    std::cout << "An unreachable nearest goal failed the stream"
+              << std::endl;
+    return false;
+  }
+
+  // Below the ceiling the wall is only a climb, so the farther goal along
+  // flat ground is still the cheaper one
+  for (int row = 1; row <= 3; row++) {
+    for (int col = 1; col <= 3; col++) {
+      if (row != 2 || col != 2) {
+        emap(row, col) = 400;
+      }
+    }
+  }
+  planner.SetMap(emap);
+  pp::PlanQuery query;
+  query.start = {2, 6};
+  query.goals = emap.GetLocations(pp::kEndPos);
+  pp::PlanResult result;
+  if (!planner.Plan(query, &result) ||
+      result.path.back() != std::make_pair(4, 0)) {
+    std::cout << "The plan went to the nearest goal, not the cheapest"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!index_groups_locations()) {
+    return -1;
+  }
+  if (!map_views_many_waypoints()) {
+    return -1;
+  }
+  if (!plans_through_waypoints_to_nearest_goal()) {
+    return -1;
+  }
+  if (!markers_found_by_position()) {
+    return -1;
+  }
+  if (!literal_marker_values_are_terrain()) {
+    return -1;
+  }
+  if (!plans_past_unreachable_nearest_goal()) {
+    return -1;
+  }
+  std::cout << "All special location tests passed!" << std::endl;
+  return 0;
+}
@@ -0,0 +1,180 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "elevation_map.h"
+#include "terrain_generator.h"
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Check two maps have the same size, cells and locations
+bool SameMaps(const pp::ElevationMap& a, const pp::ElevationMap& b) {
+  if (a.rows() != b.rows() || a.cols() != b.cols()) {
+    return false;
+  }
+  for (int row = 0; row < a.rows(); row++) {
+    for (int col = 0; col < a.cols(); col++) {
+      if (a(row, col) != b(row, col)) {
+        return false;
+      }
+    }
+  }
+  for (const pp::Marker& marker : pp::kMarkers) {
+    const auto a_locations = a.GetLocations(marker.symbol);
+    const auto b_locations = b.GetLocations(marker.symbol);
+    if (a_locations.size() != b_locations.size() ||
+        !std::equal(a_locations.begin(), a_locations.end(),
+                    b_locations.begin())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+bool terrain_is_deterministic() {
+  pp::TerrainOptions options;
+  options.seed = 7;
+  options.feature_size = 32.0;
+  options.min_elevation = 100;
+  options.max_elevation = 900;
+  options.locations = pp::DefaultTerrainLocations(60, 90);
+  pp::ElevationMap first;
+  pp::ElevationMap second;
+  if (!pp::TerrainGenerator(options).Generate(60, 90, &first) ||
+      !pp::TerrainGenerator(options).Generate(60, 90, &second) ||
+      !SameMaps(first, second)) {
+    std::cout << "The same seed gave different maps" << std::endl;
+    return false;
+  }
+  options.seed = 8;
+  pp::ElevationMap reseeded;
+  if (!pp::TerrainGenerator(options).Generate(60, 90, &reseeded) ||
+      SameMaps(first, reseeded)) {
+    std::cout << "A different seed gave the same map" << std::endl;
+    return false;
+  }
+
+  // The cells match `At`, stay in range and vary, and the markers are placed
+  const pp::TerrainGenerator generator(options);
+  int lowest = options.max_elevation;
+  int highest = options.min_elevation;
+  for (int row = 0; row < reseeded.rows(); row++) {
+    for (int col = 0; col < reseeded.cols(); col++) {
+      const int cell = reseeded(row, col);
+      if (pp::IsSpecialLocationValue(cell)) {
+        continue;
+      }
+      if (cell != generator.At(row, col) || cell < options.min_elevation ||
+          cell > options.max_elevation) {
+        std::cout << "Cell " << row << ", " << col << " is wrong: " << cell
+                  << std::endl;
+        return false;
+      }
+      lowest = std::min(lowest, cell);
+      highest = std::max(highest, cell);
+    }
+  }
+  if (highest - lowest < 100) {
+    std::cout << "The terrain is nearly flat" << std::endl;
+    return false;
+  }
+  if (reseeded.GetLocations('A').size() != 1 ||
+      *reseeded.GetLocations('A').begin() != std::make_pair(7, 11) ||
+      reseeded.GetLocations('B').size() != 1 ||
+      *reseeded.GetLocations('B').begin() != std::make_pair(52, 78)) {
+    std::cout << "The default locations are misplaced" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool written_maps_match() {
+  const int rows = 45;
+  const int cols = 70;
+  pp::TerrainOptions options;
+  options.seed = 3;
+  options.feature_size = 20.0;
+  options.persistence = 0.7;
+  options.max_elevation = 30000;
+  options.locations = {{'B', 44, 0}, {'W', 20, 35}, {'A', 0, 69},
+                       {'B', 30, 10}};
+  const pp::TerrainGenerator generator(options);
+  pp::ElevationMap expected;
+  if (!generator.Generate(rows, cols, &expected)) {
+    return false;
+  }
+
+  const std::string text_filename = "terrain_generator_test.txt";
+  pp::ElevationMap text_map;
+  if (!generator.WriteTextMap(text_filename, rows, cols) ||
+      !text_map.ReadMap(text_filename) || !SameMaps(text_map, expected)) {
+    std::cout << "The text map does not match" << std::endl;
+    return false;
+  }
+  std::remove(text_filename.c_str());
+
+  for (int tile_size : {0, 16}) {
+    const std::string binary_filename = "terrain_generator_test.emap";
+    pp::ElevationMap binary_map;
+    if (!generator.WriteBinaryMap(binary_filename, rows, cols, tile_size) ||
+        !binary_map.OpenBinaryMap(binary_filename) ||
+        binary_map.is_tiled() != (tile_size > 0) ||
+        !SameMaps(binary_map, expected)) {
+      std::cout << "The binary map with tile size " << tile_size
+                << " does not match" << std::endl;
+      return false;
+    }
+    binary_map.Clear();
+    std::remove(binary_filename.c_str());
+  }
+  return true;
+}
+
+bool invalid_options_fail() {
+  pp::ElevationMap emap;
+  pp::TerrainOptions options;
+  options.locations = {{'A', 0, 0}, {'B', 10, 0}};
+  if (pp::TerrainGenerator(options).Generate(10, 10, &emap)) {
+    std::cout << "Generated a location outside the map" << std::endl;
+    return false;
+  }
+  options.locations = {{'A', 0, 0}, {'B', 0, 0}};
+  if (pp::TerrainGenerator(options).Generate(10, 10, &emap)) {
+    std::cout << "Generated two locations on one cell" << std::endl;
+    return false;
+  }
+  options.locations = {{'Q', 1, 1}};
+  if (pp::TerrainGenerator(options).Generate(10, 10, &emap)) {
+    std::cout << "Generated an unknown marker" << std::endl;
+    return false;
+  }
+  options.locations.clear();
+  options.min_elevation = -5;
+  if (pp::TerrainGenerator(options).WriteTextMap("unused.txt", 10, 10) ||
+      pp::TerrainGenerator().Generate(0, 10, &emap)) {
+    std::cout << "Generated an invalid map" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (!terrain_is_deterministic()) {
+    return -1;
+  }
+  if (!written_maps_match()) {
+    return -1;
+  }
+  if (!invalid_options_fail()) {
+    return -1;
+  }
+  std::cout << "All terrain generator tests passed!" << std::endl;
+  return 0;
+}
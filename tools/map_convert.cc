@@ -0,0 +1,35 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "elevation_map.h"
+
+namespace pp = path_planning;
+
+/// Converts a map in the bracketed text format into the binary `.emap` format
+/// that `ElevationMap::OpenBinaryMap` memory maps, or with a tile size into
+/// the tiled format it reads through a tile cache.
+///
+/// Usage: map_convert <input_map.txt> <output_map.emap> [tile_size]
+int main(int argc, char** argv) {
+  if (argc != 3 && argc != 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <input_map.txt> <output_map.emap> [tile_size]"
+              << std::endl;
+    return -1;
+  }
+  const std::string input_filename = argv[1];
+  const std::string output_filename = argv[2];
+  const int tile_size = argc == 4 ? std::atoi(argv[3]) : 0;
+
+  pp::ElevationMap emap;
+  if (!emap.ReadMap(input_filename)) {
+    return -1;
+  }
+  if (!emap.WriteBinaryMap(output_filename, tile_size)) {
+    return -1;
+  }
+  std::cout << "Converted " << emap.rows() << " x " << emap.cols()
+            << " map to " << output_filename << std::endl;
+  return 0;
+}
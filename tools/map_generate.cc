@@ -0,0 +1,99 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "terrain_generator.h"
+
+namespace pp = path_planning;
+
+namespace {
+
+/// @brief Check if an argument is a flag, and get its value
+bool FlagValue(const std::string& arg, const std::string& flag,
+               std::string* value) {
+  const std::string prefix = "--" + flag + "=";
+  if (arg.compare(0, prefix.size(), prefix) != 0) {
+    return false;
+  }
+  *value = arg.substr(prefix.size());
+  return true;
+}
+
+}  // namespace
+
+/// Writes a synthetic terrain map of any size from a seed, see
+/// `TerrainGenerator`. A file ending in `.emap` is written in the binary
+/// format, optionally tiled, and anything else in the bracketed text
+/// format. `(A)` and `(B)` are placed an eighth of the way in from opposite
+/// corners unless `--location` places the markers, once for each.
+///
+/// Usage: map_generate <output_map> <rows> <cols> [--seed=N]
+///          [--feature_size=CELLS] [--octaves=N] [--persistence=P]
+///          [--min_elevation=N] [--max_elevation=N] [--tile_size=N]
+///          [--location=MARKER:ROW,COL]...
+int main(int argc, char** argv) {
+  if (argc < 4) {
+    std::cerr << "Usage: " << argv[0]
+              << " <output_map> <rows> <cols> [--seed=N]"
+              << " [--feature_size=CELLS] [--octaves=N] [--persistence=P]"
+              << " [--min_elevation=N] [--max_elevation=N] [--tile_size=N]"
+              << " [--location=MARKER:ROW,COL]..." << std::endl;
+    return -1;
+  }
+  const std::string output_filename = argv[1];
+  const int rows = std::atoi(argv[2]);
+  const int cols = std::atoi(argv[3]);
+  pp::TerrainOptions options;
+  int tile_size = 0;
+  for (int i = 4; i < argc; i++) {
+    const std::string arg = argv[i];
+    std::string value;
+    if (FlagValue(arg, "seed", &value)) {
+      options.seed = uint32_t(std::strtoul(value.c_str(), nullptr, 10));
+    } else if (FlagValue(arg, "feature_size", &value)) {
+      options.feature_size = std::atof(value.c_str());
+    } else if (FlagValue(arg, "octaves", &value)) {
+      options.octaves = std::atoi(value.c_str());
+    } else if (FlagValue(arg, "persistence", &value)) {
+      options.persistence = std::atof(value.c_str());
+    } else if (FlagValue(arg, "min_elevation", &value)) {
+      options.min_elevation = std::atoi(value.c_str());
+    } else if (FlagValue(arg, "max_elevation", &value)) {
+      options.max_elevation = std::atoi(value.c_str());
+    } else if (FlagValue(arg, "tile_size", &value)) {
+      tile_size = std::atoi(value.c_str());
+    } else if (FlagValue(arg, "location", &value)) {
+      pp::MarkedLocation location;
+      if (std::sscanf(value.c_str(), "%c:%d,%d", &location.marker,
+                      &location.row, &location.col) != 3) {
+        std::cerr << "map_generate: ERROR! Locations are MARKER:ROW,COL, not "
+                  << value << std::endl;
+        return -1;
+      }
+      options.locations.push_back(location);
+    } else {
+      std::cerr << "map_generate: ERROR! Unknown argument " << arg
+                << std::endl;
+      return -1;
+    }
+  }
+  if (options.locations.empty()) {
+    options.locations = pp::DefaultTerrainLocations(rows, cols);
+  }
+
+  const pp::TerrainGenerator generator(options);
+  const std::string binary_suffix = ".emap";
+  const bool binary =
+      output_filename.size() >= binary_suffix.size() &&
+      output_filename.compare(output_filename.size() - binary_suffix.size(),
+                              binary_suffix.size(), binary_suffix) == 0;
+  if (binary ? !generator.WriteBinaryMap(output_filename, rows, cols,
+                                         tile_size)
+             : !generator.WriteTextMap(output_filename, rows, cols)) {
+    return -1;
+  }
+  std::cout << "Generated " << rows << " x " << cols << " map "
+            << output_filename << std::endl;
+  return 0;
+}